@@ -2,7 +2,18 @@
 #ifndef BASE_H_
 #define BASE_H_
 
+#include <vector>
+
 #include "SDL.h"
+#include "Input.h"
+#include "Latency.h"
+#include "Lifecycle.h"
+#include "Particles.h"
+#include "Replay.h"
+#include "Registry.h"
+#include "SpatialHash.h"
+#include "System.h"
+#include "Tilemap.h"
 
 /**
  *  The base class.
@@ -33,6 +44,73 @@ private:
     SDL_Surface* ScreenSurface;
     SDL_Window * window;
 
+    //Input seen during the current frame.
+    InputState Input;
+
+    //Input-to-present instrumentation.
+    LatencyTracker Latency;
+
+    //Frames rendered by the main loop, and the optional limit.
+    Uint32  iFrameIndex;
+    int     iFrameLimit;
+
+    //Inject a synthetic key press every this many frames, 0 to disable.
+    int     iInjectInterval;
+
+    //Deterministic input record and replay.
+    InputRecorder           Recorder;
+    InputReplayer           Replayer;
+    std::vector<SDL_Event>  ReplayEvents;
+
+    //Game objects and the systems that run over them.
+    Registry                EntityRegistry;
+    std::vector<System*>    Systems;
+
+    //Broadphase for collision and picking queries.
+    SpatialHash             Collision;
+
+    //Effects, run after the registered systems.
+    ParticleSystem          Effects;
+
+    //Particle timings of frame limited runs.
+    long                    lParticles;
+    double                  dParticleUpdateMs, dParticleRenderMs;
+
+    //Background state and the resources released there.
+    Lifecycle               AppLifecycle;
+
+    //Benchmark modes selected by BASE_BENCH, 0 to skip each: entities, most
+    //broadphase bodies, pointer events per second, tilemap frames, particles
+    //kept alive and time spent in the background.
+    int                     iEntityBenchCount;
+    int                     iBroadphaseBenchCount;
+    int                     iInputBenchRate;
+    int                     iTilemapBenchFrames;
+    int                     iParticleBenchCount;
+    int                     iLifecycleBenchMs;
+
+    /**
+     * Benchmark modes, all in BaseBench.cpp. BASE_BENCH is a comma separated
+     * list of mode[=n], e.g. BASE_BENCH=particles=20000,lifecycle=2000:
+     *     ecs[=entities]       BenchmarkEntities(n, 100) at start-up, default 100000
+     *     broadphase[=bodies]  BenchmarkBroadphase(n, 60) at start-up, default 50000
+     *     input[=Hz]           BenchmarkInput(n, 600) at start-up, default 1000
+     *     tilemap[=frames]     BenchmarkTilemap() at start-up, default 300
+     *     particles[=n]        BenchmarkParticles(n, 100) at start-up, then
+     *                          n particles kept alive, default 10000
+     *     lifecycle[=ms]       CheckLifecycle() at start-up, then the background
+     *                          for ms after 30 frames, default 2000
+     * Frame limited and replay runs print the per frame averages.
+     */
+    void        ParseBenchmarks     (const char* czModes);
+    void        RunBenchmarks       ();
+    void        UpdateBenchmarks    ();
+    void        ReportBenchmarks    ();
+
+    //Sends a particle pool through two background periods in a row and
+    //checks that it still emits; false and a message on stderr if not.
+    bool        CheckLifecycle      ();
+
 protected:
 
     //Function to update the frame rate counter
@@ -47,11 +125,21 @@ protected:
     //Handle the key events from keyboard.
     void HandleInput();
 
+    //Feed the recorded events of the current frame.
+    void HandleReplayInput();
+
     void HandleEvent(const SDL_Event &event);
 
+    //Follow the app and window events that move the app to or from the background.
+    void HandleLifecycleEvent(const SDL_Event &event);
+
+    //Pause the loop and release resources, or resume it.
+    void EnterBackground();
+    void EnterForeground();
+
 public:
     Base();
-    ~Base();
+    virtual ~Base();
 
     void Init();
     void Start();
@@ -76,36 +164,141 @@ public:
 
     int             GetFPS        ();
 
+    /**
+     * Input state of the current frame: pointer position, summed relative
+     * motion, buttons and keys, plus the raw and dispatched event counts.
+     */
+    const InputState& GetInputState ();
+
+    /**
+     * Queues a synthetic pointer stream of iRateHz motion events per second,
+     * a 60th of it per frame, for iFrames frames, and prints the dispatch
+     * time and callbacks per frame of HandleInput() next to one HandleEvent()
+     * per polled event. Also run at start-up when BASE_BENCH=input=Hz is set.
+     */
+    void            BenchmarkInput (int iRateHz, int iFrames);
+
+    /**
+     * Input-to-present latency measurement. Also enabled by setting the
+     * BASE_LATENCY environment variable; BASE_LATENCY_INJECT=n injects a key
+     * press every n frames and BASE_FRAME_LIMIT=n ends the loop after n frames,
+     * so the mode can run headless with SDL_VIDEODRIVER=dummy.
+     */
+    void        EnableLatencyTracking   (bool bEnable);
+    const LatencyTracker& GetLatencyTracker ();
+
+    void        SetFrameLimit   (int iFrames);
+    void        InjectEvent     (const SDL_Event& event);
+
+    /**
+     * Input record and replay for reproducible performance runs. Also set
+     * by the BASE_RECORD and BASE_REPLAY environment variables.
+     */
+    bool        RecordInput     (const char* czPath);
+    bool        ReplayInput     (const char* czPath);
+
+    /**
+     * Game objects of this game.
+     */
+    Registry&       GetRegistry   ();
+
+    /**
+     * Registers a system that runs every frame, in registration order.
+     * The system is not owned and must outlive the main loop.
+     */
+    void            AddSystem     (System* pSystem);
+
+    /**
+     * Moves iEntities entities with a Position, a Velocity and a Sprite for
+     * iFrames frames, once with MovementSystem over the registry and once as
+     * objects allocated one by one and updated through a pointer each, and
+     * prints the time per frame of both. Also run at start-up when
+     * BASE_BENCH=ecs=n is set.
+     */
+    void            BenchmarkEntities  (int iEntities, int iFrames);
+
+    /**
+     * Broadphase holding the game object boxes, e.g. for picking the object
+     * under the pointer in OnMouseButtonPressed() with QueryPoint().
+     */
+    SpatialHash&    GetSpatialHash ();
+
+    /**
+     * Moves 16x16 bodies through a SpatialHash for iFrames frames and finds
+     * their overlapping pairs, for 100 up to iMaxBodies bodies in a world
+     * that grows with them, and prints the move and pair time per frame
+     * next to naive pair checks up to 5000 bodies. Also run at start-up
+     * when BASE_BENCH=broadphase=n is set.
+     */
+    void            BenchmarkBroadphase (int iMaxBodies, int iFrames);
+
+    /**
+     * Particles updated every frame and drawn over the systems; frames
+     * without live particles skip both. The pool holds no particles until
+     * its capacity is set with SetCapacity().
+     * BASE_BENCH=particles=n keeps n particles alive, prints the update and
+     * draw time per frame in frame limited runs, and first runs
+     * BenchmarkParticles(n, 100).
+     */
+    ParticlePool&   GetParticles  ();
+
+    /**
+     * Prints the update time per frame of iParticles particles with the
+     * SIMD kernel and with the scalar one.
+     */
+    void            BenchmarkParticles (int iParticles, int iFrames);
+
+    /**
+     * Scrolls a 1024x1024 tile map with an opaque and a blended layer across
+     * the window size for iFrames frames, drawn from cached chunks and tile by
+     * tile, and prints the time, blits and chunk builds per frame. The tile by
+     * tile run is repeated with the scalar pixel kernels. Also run at start-up
+     * when BASE_BENCH=tilemap=n is set.
+     */
+    void            BenchmarkTilemap   (int iFrames);
+
+    /**
+     * Background handling. When the app is minimized or sent to the
+     * background the loop sleeps in SDL_WaitEvent() and the registered
+     * resources are released down to the budget, set in bytes with
+     * SetBudget() or in kB by BASE_BACKGROUND_BUDGET; they come back on
+     * their next use. The particle pool is registered; register large
+     * tile maps and sounds of the game too.
+     * BASE_BENCH=lifecycle=ms sends the app to the background after 30
+     * frames for that long and reports its CPU use and memory.
+     */
+    Lifecycle&      GetLifecycle  ();
+
     //Addition data initilaized during the application launch can be implemented here.
-    void CustomInitialize    () {}
+    virtual void CustomInitialize    () {}
 
     //Updates the frame rate counter
-    void FPSCounter        ( const int& iElapsedTime ) {}
+    virtual void FPSCounter        ( const int& iElapsedTime ) {}
 
     // Handles rendering
-    void SurfaceRenderer        ( SDL_Surface* pDestSurface ) {}
+    virtual void SurfaceRenderer        ( SDL_Surface* pDestSurface ) {}
 
     /**
      * Additional allocated data that should be cleaned up.
      */
-    void End        () {}
+    virtual void End        () {}
 
     /**
      * Window is active again.
      */
-    void WindowActive    () {}
+    virtual void WindowActive    () {}
 
     /**
      * Window is inactive.
      */
-    void WindowInactive    () {}
+    virtual void WindowInactive    () {}
 
 
     //Key released from keyboard
-    void KeyReleased (const int& iKeyEnum) {}
+    virtual void KeyReleased (const int& iKeyEnum) {}
 
     //Key pressed from keyboard
-    void KeyPressed    (const int& iKeyEnum) {}
+    virtual void KeyPressed    (const int& iKeyEnum) {}
 
     /**
      * A mouse button has been released.
@@ -117,7 +310,7 @@ public:
      *
      */
 
-    void OnMouseButtonReleased    (const int& iButton,
+    virtual void OnMouseButtonReleased    (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
@@ -132,7 +325,7 @@ public:
      * @param iRelY    The mouse position on the Y-axis relative to the last position, in pixels.
      *
     **/
-    void OnMouseButtonPressed    (const int& iButton,
+    virtual void OnMouseButtonPressed    (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
@@ -149,7 +342,7 @@ public:
      *
      * @bug The iButton variable is always NULL.
      */
-    void MousePointerPosition        (const int& iButton,
+    virtual void MousePointerPosition        (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
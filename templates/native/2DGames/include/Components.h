@@ -0,0 +1,41 @@
+
+#ifndef COMPONENTS_H_
+#define COMPONENTS_H_
+
+#include "SDL.h"
+
+/**
+ * Built-in components understood by the framework systems.
+ * Games are free to register their own plain structs with the Registry.
+ */
+
+//Screen position in pixels.
+struct Position
+{
+    float x;
+    float y;
+};
+
+//Movement in pixels per second.
+struct Velocity
+{
+    float dx;
+    float dy;
+};
+
+//Image drawn at the entity Position.
+struct Sprite
+{
+    SDL_Surface*    pSurface;   // not owned
+    SDL_Rect        clip;       // source area, w or h of 0 draws the whole surface
+};
+
+//Box registered with the SpatialHash at the entity Position.
+struct Collider
+{
+    int w;
+    int h;
+    int iBody;                  // body id in the SpatialHash, -1 until CollisionSystem links it
+};
+
+#endif /* COMPONENTS_H_ */
@@ -0,0 +1,89 @@
+
+#ifndef CPUDISPATCH_H_
+#define CPUDISPATCH_H_
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+/**
+ * Instruction set extensions a kernel variant can use.
+ */
+enum CpuFeature
+{
+    CPU_FEATURE_SSE2    = 1 << 0,
+    CPU_FEATURE_AVX2    = 1 << 1,
+    CPU_FEATURE_NEON    = 1 << 2
+};
+
+/**
+ * Hot loops bound at start-up to the fastest variant the CPU runs.
+ *
+ * Pixels are 32-bit ARGB8888 values. Every variant returns bit-identical
+ * results. The frame clear and the tile map run on them through
+ * FillSurface32() and BlendSurfaceARGB().
+ */
+struct CpuKernels
+{
+    //Name of the variant: "scalar", "sse2", "avx2" or "neon".
+    const char* czName;
+
+    //The extensions the variant needs.
+    Uint32      iFeatures;
+
+    //Sets n pixels to iColor.
+    void (*FillRow32)       (Uint32* pDest, int n, Uint32 iColor);
+
+    //Blends n source pixels over the destination by source alpha, on all four channels.
+    void (*BlendRowARGB)    (Uint32* pDest, const Uint32* pSource, int n);
+};
+
+/**
+ * Extensions of the running CPU that this build has kernels for.
+ */
+Uint32  DetectCpuFeatures   ();
+
+/**
+ * Parses a comma separated list such as "sse2,avx2"; "scalar" or "none"
+ * is the empty set.
+ */
+Uint32  ParseCpuFeatures    (const char* czList);
+
+/**
+ * Binds GetCpuKernels() to the fastest variant that only needs extensions
+ * in iFeatures. Base::Init() calls it with DetectCpuFeatures(), limited by
+ * the BASE_CPU_FEATURES environment variable.
+ */
+void    InitCpuDispatch     (Uint32 iFeatures);
+
+const CpuKernels& GetCpuKernels ();
+
+/**
+ * Variants compiled into this build, from the scalar reference up.
+ */
+int     GetCpuVariantCount  ();
+const CpuKernels& GetCpuVariant (int iIndex);
+
+/**
+ * SDL_FillRect() through FillRow32 on 32-bit surfaces that need no lock,
+ * clipped the same way; other surfaces go to SDL_FillRect().
+ */
+int     FillSurface32       (SDL_Surface* pDest, const SDL_Rect* pRect, Uint32 iColor);
+
+/**
+ * Blends an ARGB8888 source by its alpha at (x, y) of a 32-bit xRGB
+ * destination without alpha, such as the window surface, through
+ * BlendRowARGB, clipped like SDL_BlitSurface(). The blend mode of the
+ * source is not looked at. Other formats go to SDL_BlitSurface().
+ */
+int     BlendSurfaceARGB    (SDL_Surface* pSource, const SDL_Rect* pSourceRect, SDL_Surface* pDest, int x, int y);
+
+/**
+ * Runs every variant the CPU supports on the same random input, compares it
+ * with the scalar reference and prints the result of each kernel. Base::Init()
+ * runs it and exits with its result when BASE_CPU_SELFTEST is set.
+ * @return The number of mismatches.
+ */
+int     CpuDispatchSelfTest (FILE* pOut);
+
+#endif /* CPUDISPATCH_H_ */
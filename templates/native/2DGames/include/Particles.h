@@ -0,0 +1,104 @@
+
+#ifndef PARTICLES_H_
+#define PARTICLES_H_
+
+#include <vector>
+
+#include "SDL.h"
+#include "Lifecycle.h"
+#include "System.h"
+
+/**
+ * Particles stored as a structure of arrays: one array per field, so the
+ * update kernel streams through memory four particles at a time with SSE or
+ * NEON. Dead particles are removed by moving the last one into their slot,
+ * which keeps the live particles packed at the front of every array.
+ * In the background the arrays are freed with the live particles; the
+ * capacity comes back on EnsureResident() or the next Spawn().
+ * Positions are screen pixels, velocities pixels per second.
+ */
+class ParticlePool : public Releasable
+{
+private:
+    std::vector<float>  X, Y;
+    std::vector<float>  VX, VY;
+
+    //Seconds left to live, and one over the lifetime for the fade.
+    std::vector<float>  Life, InvLifetime;
+
+    //Life left from 1 down to 0, scales the alpha of Color.
+    std::vector<float>  Fade;
+
+    //RGBA bytes in memory order.
+    std::vector<Uint32> Color;
+
+    int     iCount;
+    int     iCapacity;
+    int     iReleasedCapacity;
+    float   Gravity[2];
+    Uint32  iSeed;
+
+    float   Random      ();
+    void    Compact     ();
+
+protected:
+    void    OnRelease   ();
+    bool    OnRestore   ();
+
+public:
+    ParticlePool();
+
+    /**
+     * Sets the maximum number of live particles; drops the current ones.
+     */
+    void    SetCapacity (int iMax);
+    void    Clear       ();
+
+    void    SetGravity  (float x, float y);
+
+    /**
+     * Adds a particle; false when the pool is full.
+     */
+    bool    Spawn       (float x, float y, float fVelocityX, float fVelocityY, float fLifetime, Uint32 iColor);
+
+    /**
+     * Adds up to iParticles particles at (x, y) flying in random directions
+     * at up to fSpeed. The random sequence is seeded, so replays match.
+     * @return The number of particles added.
+     */
+    int     Emit        (int iParticles, float x, float y, float fSpeed, float fLifetime, Uint32 iColor);
+
+    /**
+     * Integrates, ages and fades every particle, then removes the dead ones.
+     */
+    void    Update      (float fSeconds);
+    void    UpdateScalar(float fSeconds);
+
+    int     GetCount    () const { return iCount; }
+    int     GetCapacity () const { return iCapacity; }
+
+    size_t  GetResidentBytes () const;
+
+    const float*  GetX      () const { return &X[0]; }
+    const float*  GetY      () const { return &Y[0]; }
+    const float*  GetFade   () const { return &Fade[0]; }
+    const Uint32* GetColor  () const { return &Color[0]; }
+};
+
+/**
+ * Updates a ParticlePool every frame and plots it onto 32-bit surfaces,
+ * one blended pixel per particle.
+ */
+class ParticleSystem : public System
+{
+private:
+    ParticlePool Pool;
+
+public:
+    ParticlePool& GetPool () { return Pool; }
+
+    void Update (Registry& registry, const int& iElapsedTime);
+    void Render (Registry& registry, SDL_Surface* pDestSurface);
+};
+
+#endif /* PARTICLES_H_ */
@@ -0,0 +1,330 @@
+
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Entity handle.
+ *
+ * The low ENTITY_INDEX_BITS hold the slot index, the remaining bits hold a
+ * generation counter that is bumped every time the slot is recycled, so a
+ * stale handle never aliases a newer entity.
+ */
+typedef Uint32 Entity;
+
+const int    ENTITY_INDEX_BITS    = 20;
+const Uint32 ENTITY_INDEX_MASK    = (1u << ENTITY_INDEX_BITS) - 1;
+const Uint32 ENTITY_GEN_MASK      = 0xFFFFFFFFu >> ENTITY_INDEX_BITS;
+const Entity NULL_ENTITY          = 0xFFFFFFFFu;
+
+inline Uint32 EntityIndex       (Entity e) { return e & ENTITY_INDEX_MASK; }
+inline Uint32 EntityGeneration  (Entity e) { return e >> ENTITY_INDEX_BITS; }
+
+/**
+ * Type erased interface so the registry can drop components of a destroyed
+ * entity without knowing their types.
+ */
+class ComponentPoolBase
+{
+public:
+    virtual ~ComponentPoolBase() {}
+
+    virtual bool Has    (Uint32 iIndex) const = 0;
+    virtual void Remove (Uint32 iIndex) = 0;
+    virtual void Clear  () = 0;
+};
+
+/**
+ * Sparse set storage for one component type.
+ *
+ * Components live packed in a dense array (one array per component type), so
+ * systems walk contiguous memory. The sparse array maps an entity index to
+ * its dense slot; removal swaps the last element into the hole.
+ */
+template <class T>
+class ComponentPool : public ComponentPoolBase
+{
+private:
+    static const Uint32 INVALID_SLOT = 0xFFFFFFFFu;
+
+    std::vector<Uint32> Sparse;
+    std::vector<Entity> Entities;
+    std::vector<T>      Data;
+
+public:
+    bool Has(Uint32 iIndex) const
+    {
+        return iIndex < Sparse.size() && Sparse[iIndex] != INVALID_SLOT;
+    }
+
+    T& Add(Entity e, const T& value)
+    {
+        Uint32 iIndex = EntityIndex(e);
+
+        if ( iIndex >= Sparse.size() )
+            Sparse.resize(iIndex + 1, INVALID_SLOT);
+
+        if ( Sparse[iIndex] != INVALID_SLOT ) {
+            Data[Sparse[iIndex]] = value;
+            return Data[Sparse[iIndex]];
+        }
+
+        Sparse[iIndex] = (Uint32)Data.size();
+        Entities.push_back(e);
+        Data.push_back(value);
+        return Data.back();
+    }
+
+    void Remove(Uint32 iIndex)
+    {
+        if ( !Has(iIndex) )
+            return;
+
+        Uint32 iSlot = Sparse[iIndex];
+        Uint32 iLast = (Uint32)Data.size() - 1;
+
+        if ( iSlot != iLast ) {
+            Data[iSlot]     = Data[iLast];
+            Entities[iSlot] = Entities[iLast];
+            Sparse[EntityIndex(Entities[iSlot])] = iSlot;
+        }
+
+        Data.pop_back();
+        Entities.pop_back();
+        Sparse[iIndex] = INVALID_SLOT;
+    }
+
+    void Clear()
+    {
+        Sparse.clear();
+        Entities.clear();
+        Data.clear();
+    }
+
+    T* Get(Uint32 iIndex)
+    {
+        return Has(iIndex) ? &Data[Sparse[iIndex]] : 0;
+    }
+
+    /**
+     * Swaps two dense slots, keeping the sparse map in sync.
+     */
+    void SwapSlots(Uint32 iA, Uint32 iB)
+    {
+        if ( iA == iB )
+            return;
+
+        std::swap(Data[iA], Data[iB]);
+        std::swap(Entities[iA], Entities[iB]);
+        Sparse[EntityIndex(Entities[iA])] = iA;
+        Sparse[EntityIndex(Entities[iB])] = iB;
+    }
+
+    Uint32          Slot        (Uint32 iIndex) const   { return Sparse[iIndex]; }
+    size_t          Size        () const                { return Data.size(); }
+    T*              DataArray   ()                      { return Data.empty() ? 0 : &Data[0]; }
+    const Entity*   EntityArray () const                { return Entities.empty() ? 0 : &Entities[0]; }
+    void            Reserve     (size_t n)              { Entities.reserve(n); Data.reserve(n); }
+};
+
+//Sparse.resize() takes the sentinel by reference, so it needs a definition.
+template <class T>
+const Uint32 ComponentPool<T>::INVALID_SLOT;
+
+//Returns a process wide unique id for each component type.
+int NextComponentTypeId();
+
+template <class T>
+int ComponentTypeId()
+{
+    static int id = NextComponentTypeId();
+    return id;
+}
+
+/**
+ * Owns the entities and one ComponentPool per component type.
+ */
+class Registry
+{
+private:
+
+    //Generation counter for each entity slot.
+    std::vector<Uint32> Generations;
+
+    //Recycled entity slots.
+    std::vector<Uint32> FreeSlots;
+
+    //Component storage, indexed by ComponentTypeId<T>().
+    std::vector<ComponentPoolBase*> Pools;
+
+    size_t iAliveCount;
+
+    Registry(const Registry&);
+    Registry& operator=(const Registry&);
+
+public:
+    Registry();
+    ~Registry();
+
+    Entity  Create      ();
+    void    Destroy     (Entity e);
+    bool    IsAlive     (Entity e) const;
+    void    Clear       ();
+
+    size_t  AliveCount  () const { return iAliveCount; }
+
+    template <class T>
+    ComponentPool<T>& Pool()
+    {
+        size_t id = (size_t)ComponentTypeId<T>();
+
+        if ( id >= Pools.size() )
+            Pools.resize(id + 1, 0);
+
+        if ( Pools[id] == 0 )
+            Pools[id] = new ComponentPool<T>();
+
+        return *static_cast<ComponentPool<T>*>(Pools[id]);
+    }
+
+    /**
+     * Adds the component to the entity, or replaces the one it has.
+     * @return The stored component, or NULL if the entity is not alive.
+     */
+    template <class T>
+    T* Assign(Entity e, const T& value)
+    {
+        return IsAlive(e) ? &Pool<T>().Add(e, value) : 0;
+    }
+
+    template <class T>
+    void Remove(Entity e)
+    {
+        if ( IsAlive(e) )
+            Pool<T>().Remove(EntityIndex(e));
+    }
+
+    template <class T>
+    T* Get(Entity e)
+    {
+        return IsAlive(e) ? Pool<T>().Get(EntityIndex(e)) : 0;
+    }
+
+    template <class T>
+    bool Has(Entity e)
+    {
+        return IsAlive(e) && Pool<T>().Has(EntityIndex(e));
+    }
+
+    /**
+     * Reorders the pool of B so that entities which also own an A come
+     * first and in the same order as in A. Joins over <A, B> then walk
+     * both dense arrays front to back.
+     */
+    template <class A, class B>
+    void Align()
+    {
+        ComponentPool<A>& a = Pool<A>();
+        ComponentPool<B>& b = Pool<B>();
+
+        const Entity* pEntities = a.EntityArray();
+        Uint32 iNext = 0;
+
+        for ( size_t i = 0; i < a.Size(); ++i ) {
+            Uint32 iIndex = EntityIndex(pEntities[i]);
+            if ( b.Has(iIndex) )
+                b.SwapSlots(b.Slot(iIndex), iNext++);
+        }
+    }
+
+    /**
+     * Calls fn(Entity, A&) for every entity owning an A.
+     */
+    template <class A, class Fn>
+    void Each(Fn& fn)
+    {
+        ComponentPool<A>& a = Pool<A>();
+
+        A* pA = a.DataArray();
+        const Entity* pEntities = a.EntityArray();
+
+        for ( size_t i = 0; i < a.Size(); ++i )
+            fn(pEntities[i], pA[i]);
+    }
+
+    /**
+     * Calls fn(Entity, A&, B&) for every entity owning both an A and a B.
+     * The smaller pool drives the iteration and the other one is probed;
+     * on a tie A drives, so pools aligned with Align<A, B>() stay sequential.
+     */
+    template <class A, class B, class Fn>
+    void Each(Fn& fn)
+    {
+        ComponentPool<A>& a = Pool<A>();
+        ComponentPool<B>& b = Pool<B>();
+
+        if ( b.Size() < a.Size() ) {
+            B* pB = b.DataArray();
+            const Entity* pEntities = b.EntityArray();
+
+            for ( size_t i = 0; i < b.Size(); ++i ) {
+                A* pA = a.Get(EntityIndex(pEntities[i]));
+                if ( pA )
+                    fn(pEntities[i], *pA, pB[i]);
+            }
+            return;
+        }
+
+        A* pA = a.DataArray();
+        const Entity* pEntities = a.EntityArray();
+
+        for ( size_t i = 0; i < a.Size(); ++i ) {
+            B* pB = b.Get(EntityIndex(pEntities[i]));
+            if ( pB )
+                fn(pEntities[i], pA[i], *pB);
+        }
+    }
+
+    /**
+     * Calls fn(Entity, A&, B&, C&) for every entity owning an A, a B and a C.
+     * The entities of the smallest pool drive the iteration.
+     */
+    template <class A, class B, class C, class Fn>
+    void Each(Fn& fn)
+    {
+        ComponentPool<A>& a = Pool<A>();
+        ComponentPool<B>& b = Pool<B>();
+        ComponentPool<C>& c = Pool<C>();
+
+        const Entity* pEntities = a.EntityArray();
+        size_t iCount = a.Size();
+
+        if ( b.Size() < iCount ) {
+            pEntities = b.EntityArray();
+            iCount = b.Size();
+        }
+        if ( c.Size() < iCount ) {
+            pEntities = c.EntityArray();
+            iCount = c.Size();
+        }
+
+        for ( size_t i = 0; i < iCount; ++i ) {
+            Uint32 iIndex = EntityIndex(pEntities[i]);
+            A* pA = a.Get(iIndex);
+            if ( !pA )
+                continue;
+            B* pB = b.Get(iIndex);
+            if ( !pB )
+                continue;
+            C* pC = c.Get(iIndex);
+            if ( pC )
+                fn(pEntities[i], *pA, *pB, *pC);
+        }
+    }
+};
+
+#endif /* REGISTRY_H_ */
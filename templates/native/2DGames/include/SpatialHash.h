@@ -0,0 +1,79 @@
+
+#ifndef SPATIALHASH_H_
+#define SPATIALHASH_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Two bodies whose boxes overlap.
+ */
+struct BodyPair
+{
+    int iBodyA;
+    int iBodyB;
+};
+
+/**
+ * Uniform grid broadphase for axis aligned boxes in screen coordinates.
+ *
+ * Each body is linked into every grid cell its box touches. Cells are hashed
+ * into a fixed number of buckets, so the grid is unbounded and only costs
+ * memory where bodies are. Moving a body within the same cells only updates
+ * its box.
+ */
+class SpatialHash
+{
+private:
+
+    struct Body
+    {
+        SDL_Rect    box;
+        int         iCellX0, iCellY0, iCellX1, iCellY1;
+        Uint32      iUserData;
+        Uint32      iStamp;
+        bool        bAlive;
+    };
+
+    int iCellSize;
+    int iBucketMask;
+
+    std::vector<Body>               Bodies;
+    std::vector<int>                FreeBodies;
+    std::vector< std::vector<int> > Buckets;
+
+    //Marks bodies already reported by the current query.
+    Uint32 iQueryStamp;
+
+    int     CellOf          (int iCoord) const;
+    int     BucketOf        (int iCellX, int iCellY) const;
+    void    Link            (int iBody);
+    void    Unlink          (int iBody);
+    Uint32  NextStamp       ();
+
+public:
+    /**
+     * @param iCellSize    Edge of a grid cell in pixels; about the size of a typical body.
+     * @param iBucketCount    Number of hash buckets, rounded up to a power of two.
+     */
+    SpatialHash(int iCellSize = 64, int iBucketCount = 4096);
+
+    int         Insert      (const SDL_Rect& box, Uint32 iUserData);
+    void        Move        (int iBody, const SDL_Rect& box);
+    void        Remove      (int iBody);
+    void        Clear       ();
+
+    bool        IsValid     (int iBody) const;
+    SDL_Rect    GetBox      (int iBody) const;
+    Uint32      GetUserData (int iBody) const;
+
+    //Upper bound for body ids, for walking all bodies with IsValid().
+    int         Capacity    () const { return (int)Bodies.size(); }
+
+    size_t      QueryPoint  (int iX, int iY, std::vector<int>& out);
+    size_t      QueryRect   (const SDL_Rect& rect, std::vector<int>& out);
+    size_t      FindPairs   (std::vector<BodyPair>& out);
+};
+
+#endif /* SPATIALHASH_H_ */
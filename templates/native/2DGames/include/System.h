@@ -0,0 +1,65 @@
+
+#ifndef SYSTEM_H_
+#define SYSTEM_H_
+
+#include "SDL.h"
+#include "Registry.h"
+#include "SpatialHash.h"
+
+/**
+ * A system runs over the entities of a Registry once per frame.
+ * Register it with Base::AddSystem(); Update() runs right after FPSCounter()
+ * and Render() right after SurfaceRenderer().
+ */
+class System
+{
+public:
+    virtual ~System() {}
+
+    /**
+     * Advances the simulation.
+     * @param registry    The entities of the game.
+     * @param iElapsedTime    Milliseconds since the last frame.
+     */
+    virtual void Update (Registry& registry, const int& iElapsedTime) {}
+
+    /**
+     * Draws onto the (locked) screen surface.
+     */
+    virtual void Render (Registry& registry, SDL_Surface* pDestSurface) {}
+};
+
+/**
+ * Integrates Position by Velocity.
+ */
+class MovementSystem : public System
+{
+public:
+    void Update (Registry& registry, const int& iElapsedTime);
+};
+
+/**
+ * Blits every Sprite at its Position.
+ */
+class SpriteSystem : public System
+{
+public:
+    void Render (Registry& registry, SDL_Surface* pDestSurface);
+};
+
+/**
+ * Keeps the bodies of a SpatialHash in sync with the Collider and Position
+ * components, and drops the bodies of destroyed entities.
+ */
+class CollisionSystem : public System
+{
+private:
+    SpatialHash& Hash;
+
+public:
+    CollisionSystem(SpatialHash& hash) : Hash(hash) {}
+
+    void Update (Registry& registry, const int& iElapsedTime);
+};
+
+#endif /* SYSTEM_H_ */
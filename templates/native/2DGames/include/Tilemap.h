@@ -0,0 +1,127 @@
+
+#ifndef TILEMAP_H_
+#define TILEMAP_H_
+
+#include <vector>
+
+#include "SDL.h"
+#include "Lifecycle.h"
+
+//Target edge of a cached chunk in pixels, rounded down to whole tiles.
+const int TILEMAP_CHUNK_PIXELS  = 256;
+
+//Chunks kept by default; 48 chunks of 256x256 at 32 bits are 12 MB.
+const int TILEMAP_CHUNK_BUDGET  = 48;
+
+/**
+ * Static tile layers drawn from pre-rendered chunk surfaces.
+ *
+ * The map is split into square chunks of tiles. The first time a chunk is
+ * visible all its layers are blitted once into a chunk surface, so a frame
+ * costs a handful of chunk blits instead of one blit per tile and layer.
+ * SetTile() only marks the chunk holding the tile for a rebuild. Chunks that
+ * have not been seen for the longest time are recycled once the budget is
+ * reached, so memory stays bounded on large maps. In the background the
+ * chunks and the converted tileset are freed and rebuilt as they are drawn.
+ *
+ * Tile 0 is empty; tile n is the n-th cell of the tileset, row by row.
+ * The bottom layer is copied over the background colour. When the tileset
+ * has an alpha channel the layers above are blended by it; otherwise they
+ * are copied, with the colour key of the tileset as their only transparency.
+ * Chunks are opaque and in the format of the target, so drawing them stays
+ * a plain copy.
+ */
+class Tilemap : public Releasable
+{
+private:
+
+    struct Chunk
+    {
+        SDL_Surface*    pSurface;
+        int             iChunk;
+        Uint32          iLastUsed;
+        bool            bDirty;
+    };
+
+    int     iWidth, iHeight, iLayers;
+    int     iTileSize;
+    int     iChunkTiles;
+    int     iChunksX, iChunksY;
+    int     iChunkBudget;
+    Uint32  iBackground;
+
+    //Tile ids, layer after layer, row by row.
+    std::vector<Uint16> Tiles;
+
+    //The tileset as given, and converted to the format of the target.
+    SDL_Surface*    pTileset;
+    SDL_Surface*    pConverted;
+
+    //The tileset as ARGB8888 for the layers above the bottom one, 0 without alpha.
+    SDL_Surface*    pBlended;
+
+    //Cached chunk surfaces, and the cache slot of every map chunk or -1.
+    std::vector<Chunk>  Cache;
+    std::vector<int>    Slots;
+
+    Uint32  iFrame;
+    int     iChunksBuilt;
+    int     iBlits;
+
+    void    Prepare         (SDL_Surface* pDestSurface);
+    void    FreeCache       ();
+    int     Acquire         (int iChunk, SDL_Surface* pDestSurface);
+    void    BuildChunk      (Chunk& chunk);
+    SDL_Surface* GetLayerTiles (int iLayer) const;
+    void    DrawTile        (SDL_Surface* pTiles, Uint16 iTile, SDL_Surface* pDestSurface, int iX, int iY);
+
+    Tilemap(const Tilemap&);
+    Tilemap& operator=(const Tilemap&);
+
+protected:
+    void    OnRelease       ();
+    bool    OnRestore       ();
+
+public:
+    Tilemap();
+    ~Tilemap();
+
+    /**
+     * Creates an empty map.
+     * @param pTileset    Tile images in a grid; not owned, must outlive the map.
+     */
+    bool    Create          (int iWidth, int iHeight, int iLayers, SDL_Surface* pTileset, int iTileSize);
+    void    Release         ();
+
+    void    SetTile         (int iLayer, int iX, int iY, Uint16 iTile);
+    Uint16  GetTile         (int iLayer, int iX, int iY) const;
+
+    //Colour under the empty tiles of the bottom layer, in the format of the target surface.
+    void    SetBackground   (Uint32 iColor);
+
+    //Number of chunk surfaces kept, at least the number visible at once.
+    void    SetChunkBudget  (int iChunks);
+
+    /**
+     * Draws the map with its top left corner at (-iScrollX, -iScrollY),
+     * building the visible chunks that are missing or changed.
+     */
+    void    Render          (SDL_Surface* pDestSurface, int iScrollX, int iScrollY);
+
+    //Draws every visible tile directly, for comparison with Render().
+    void    RenderUncached  (SDL_Surface* pDestSurface, int iScrollX, int iScrollY);
+
+    int     GetWidth        () const { return iWidth; }
+    int     GetHeight       () const { return iHeight; }
+    int     GetTileSize     () const { return iTileSize; }
+
+    //Counters of the last Render() or RenderUncached().
+    int     GetChunksBuilt  () const { return iChunksBuilt; }
+    int     GetBlitCount    () const { return iBlits; }
+    int     GetCachedChunks () const { return (int)Cache.size(); }
+
+    //Bytes of the cached chunks and the converted tilesets.
+    size_t  GetResidentBytes () const;
+};
+
+#endif /* TILEMAP_H_ */
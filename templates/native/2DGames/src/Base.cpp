@@ -1,5 +1,6 @@
 
 #include "Base.h"
+#include "CpuDispatch.h"
 #include "SDL_ttf.h"
 
 /** Default constructor. **/
@@ -19,6 +20,21 @@ Base::Base()
     bMinimized        = false;
     bQuit            = false;
     window            = 0;
+
+    iFrameIndex        = 0;
+    iFrameLimit        = 0;
+    iInjectInterval    = 0;
+
+    iEntityBenchCount   = 0;
+    iBroadphaseBenchCount = 0;
+    iInputBenchRate     = 0;
+    iTilemapBenchFrames = 0;
+    iParticleBenchCount = 0;
+    lParticles          = 0;
+    dParticleUpdateMs   = 0.0;
+    dParticleRenderMs   = 0.0;
+
+    iLifecycleBenchMs   = 0;
 }
 
 /**
@@ -57,6 +73,15 @@ void Base::Init()
         exit( 1 );
     }
 
+    // Bind the pixel kernels to the fastest variant of this CPU.
+    Uint32 iCpuFeatures = DetectCpuFeatures();
+    if ( SDL_getenv("BASE_CPU_FEATURES") )
+        iCpuFeatures &= ParseCpuFeatures( SDL_getenv("BASE_CPU_FEATURES") );
+    InitCpuDispatch( iCpuFeatures );
+
+    if ( SDL_getenv("BASE_CPU_SELFTEST") )
+        exit( CpuDispatchSelfTest( stdout ) ? 1 : 0 );
+
     //Initialize the SDL_ttf sub system
     TTF_Init();
 
@@ -76,14 +101,42 @@ void Base::Init()
         exit( 1 );
     }
 
+    // Headless measurement switches, e.g. with SDL_VIDEODRIVER=dummy on CI.
+    if ( SDL_getenv("BASE_FRAME_LIMIT") )
+        SetFrameLimit( atoi( SDL_getenv("BASE_FRAME_LIMIT") ) );
+
+    if ( SDL_getenv("BASE_LATENCY") )
+        EnableLatencyTracking( true );
+
+    if ( SDL_getenv("BASE_LATENCY_INJECT") )
+        iInjectInterval = atoi( SDL_getenv("BASE_LATENCY_INJECT") );
+
+    if ( SDL_getenv("BASE_REPLAY") )
+        ReplayInput( SDL_getenv("BASE_REPLAY") );
+    else if ( SDL_getenv("BASE_RECORD") )
+        RecordInput( SDL_getenv("BASE_RECORD") );
+
+    if ( SDL_getenv("BASE_BENCH") )
+        ParseBenchmarks( SDL_getenv("BASE_BENCH") );
+
+    AppLifecycle.Register( &Effects.GetPool() );
+
+    if ( SDL_getenv("BASE_BACKGROUND_BUDGET") )
+        AppLifecycle.SetBudget( (size_t)atoi( SDL_getenv("BASE_BACKGROUND_BUDGET") ) * 1024 );
+
     CustomInitialize();
 }
 
 /** The main loop. **/
 void Base::Start()
 {
+    RunBenchmarks();
+
     lLastTickValue = SDL_GetTicks();
     bQuit = false;
+    iFrameIndex = 0;
+
+    Uint32 iStartTicks = lLastTickValue;
 
     // Main loop: loop forever.
     while ( !bQuit )
@@ -100,30 +153,141 @@ void Base::Start()
         } else {
             // Do some thinking
             UpdateFPSCounter();
+            Latency.OnUpdate();
 
             // Render stuff
             UpdateSurface();
+
+            ++iFrameIndex;
+
+            // Synthetic input and load of the benchmark modes
+            UpdateBenchmarks();
+
+            if ( iFrameLimit > 0 && iFrameIndex >= (Uint32)iFrameLimit )
+                bQuit = true;
+
+            if ( Replayer.IsOpen() && Replayer.IsFinished() )
+                bQuit = true;
         }
     }
 
+    Recorder.Close();
+
+    if ( ( iFrameLimit > 0 || Replayer.IsOpen() ) && iFrameIndex > 0 )
+    {
+        // Time in the background is not part of any frame.
+        Uint32 iElapsed = SDL_GetTicks() - iStartTicks - AppLifecycle.GetBackgroundMs();
+        printf( "frames: %u, elapsed: %u ms, average frame: %.3f ms\n",
+                iFrameIndex, iElapsed, (double)iElapsed / iFrameIndex );
+
+        ReportBenchmarks();
+    }
+
+    AppLifecycle.Report( stdout );
+
+    if ( Latency.IsEnabled() )
+        Latency.Report( stdout );
+
     End();
 }
 
 /** Handles all controller inputs.
     @remark This function is called once per frame.
+    @remark Events are pulled from SDL in batches. Runs of SDL_MOUSEMOTION are
+            coalesced into a single MousePointerPosition() call carrying the last
+            position and the summed relative motion.
 **/
 void Base::HandleInput()
 {
-    // Poll for events, and handle the ones we care about.
+    if ( Replayer.IsOpen() )
+    {
+        HandleReplayInput();
+        return;
+    }
+
+    Input.BeginFrame( SDL_GetTicks() );
+
+    // Fill the queue once, then drain it in batches.
+    SDL_PumpEvents();
+
+    SDL_Event events[INPUT_BATCH_SIZE];
+    SDL_Event motion;
+    bool bPendingMotion = false;
+    int iCount;
+
+    do
+    {
+        iCount = SDL_PeepEvents( events, INPUT_BATCH_SIZE, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT );
+
+        for ( int i = 0; i < iCount; ++i )
+        {
+            const SDL_Event& event = events[i];
+            Input.CountRaw(event);
+
+            if ( event.type == SDL_MOUSEMOTION )
+            {
+                if ( bPendingMotion )
+                {
+                    motion.motion.timestamp = event.motion.timestamp;
+                    motion.motion.state     = event.motion.state;
+                    motion.motion.x         = event.motion.x;
+                    motion.motion.y         = event.motion.y;
+                    motion.motion.xrel     += event.motion.xrel;
+                    motion.motion.yrel     += event.motion.yrel;
+                }
+                else
+                {
+                    motion = event;
+                    bPendingMotion = true;
+                }
+                continue;
+            }
+
+            // Keep the order: deliver the motion that happened before this event first.
+            if ( bPendingMotion )
+            {
+                HandleEvent(motion);
+                bPendingMotion = false;
+            }
+
+            HandleEvent(event);
+        }
+    } while ( iCount == INPUT_BATCH_SIZE );
+
+    if ( bPendingMotion )
+        HandleEvent(motion);
+}
+
+/** Feeds the recorded events of the current frame instead of the device input.
+    @remark Only a real SDL_QUIT interrupts a replay and only the lifecycle events
+            are followed; all other device input is dropped.
+**/
+void Base::HandleReplayInput()
+{
+    Input.BeginFrame( iFrameIndex * Replayer.GetStepMs() );
+
     SDL_Event event;
     while ( SDL_PollEvent( &event ) )
     {
-            HandleEvent(event);
+        if ( event.type == SDL_QUIT )
+            bQuit = true;
+        else
+            HandleLifecycleEvent( event );
     }
+
+    ReplayEvents.clear();
+    Replayer.ReadFrame( iFrameIndex, ReplayEvents );
+
+    for ( size_t i = 0; i < ReplayEvents.size(); ++i )
+        HandleEvent( ReplayEvents[i] );
 }
 
 void Base::HandleEvent(const SDL_Event &event)
 {
+    Input.Apply(event);
+    Latency.OnEvent(event);
+    Recorder.Record(iFrameIndex, event);
+
     switch ( event.type )
     {
         case SDL_KEYDOWN:
@@ -171,17 +335,93 @@ void Base::HandleEvent(const SDL_Event &event)
                     event.motion.xrel,
                     event.motion.yrel);
             break;
+
+        case SDL_APP_DIDENTERBACKGROUND:
+        case SDL_APP_DIDENTERFOREGROUND:
+        case SDL_WINDOWEVENT:
+            HandleLifecycleEvent( event );
+            break;
     } // switch
 }
 
+void Base::HandleLifecycleEvent(const SDL_Event &event)
+{
+    if ( event.type == SDL_APP_DIDENTERBACKGROUND )
+        EnterBackground();
+    else if ( event.type == SDL_APP_DIDENTERFOREGROUND )
+        EnterForeground();
+    else if ( event.type == SDL_WINDOWEVENT )
+    {
+        switch ( event.window.event )
+        {
+            case SDL_WINDOWEVENT_MINIMIZED:
+            case SDL_WINDOWEVENT_HIDDEN:
+                EnterBackground();
+                break;
+
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_SHOWN:
+                EnterForeground();
+                break;
+        }
+    }
+}
+
+/** Stops rendering and releases the registered resources down to the budget. **/
+void Base::EnterBackground()
+{
+    if ( bMinimized )
+        return;
+
+    bMinimized = true;
+    WindowInactive();
+    AppLifecycle.EnterBackground();
+}
+
+/** Resumes rendering; released resources are restored on their next use. **/
+void Base::EnterForeground()
+{
+    if ( !bMinimized )
+        return;
+
+    AppLifecycle.EnterForeground();
+    bMinimized = false;
+
+    // The time away is not one long frame.
+    lLastTickValue = SDL_GetTicks();
+    WindowActive();
+}
+
 /** Handles the updating routine. **/
 void Base::UpdateFPSCounter()
 {
-    long iElapsedTicks = SDL_GetTicks() - lLastTickValue;
-    lLastTickValue = SDL_GetTicks();
+    long iElapsedTicks;
+
+    if ( Replayer.IsOpen() )
+    {
+        // Replays advance a fixed step per frame so every run takes the same path.
+        iElapsedTicks = Replayer.GetStepMs();
+        lLastTickValue += iElapsedTicks;
+    }
+    else
+    {
+        iElapsedTicks = SDL_GetTicks() - lLastTickValue;
+        lLastTickValue = SDL_GetTicks();
+    }
 
     FPSCounter( iElapsedTicks );
 
+    for ( size_t i = 0; i < Systems.size(); ++i )
+        Systems[i]->Update( EntityRegistry, iElapsedTicks );
+
+    // Frames without live particles cost nothing; Spawn() restores a released pool.
+    if ( Effects.GetPool().GetCount() > 0 )
+    {
+        Uint64 iUpdate = SDL_GetPerformanceCounter();
+        Effects.Update( EntityRegistry, iElapsedTicks );
+        dParticleUpdateMs += ( SDL_GetPerformanceCounter() - iUpdate ) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
     iFPSTickCounter += iElapsedTicks;
 }
 
@@ -196,7 +436,7 @@ void Base::UpdateSurface()
         iFPSTickCounter = 0;
     }
 
-    SDL_FillRect( ScreenSurface, 0, SDL_MapRGB( ScreenSurface->format, 192, 192, 192 ) );
+    FillSurface32( ScreenSurface, 0, SDL_MapRGB( ScreenSurface->format, 192, 192, 192 ) );
     displayText("Start your Game Programming using this template!!!",
                     24, 150, 80,190, 0, 55, 0,0,0);
 
@@ -207,12 +447,27 @@ void Base::UpdateSurface()
 
     SurfaceRenderer( GetSurface() );
 
+    for ( size_t i = 0; i < Systems.size(); ++i )
+        Systems[i]->Render( EntityRegistry, GetSurface() );
+
+    if ( Effects.GetPool().GetCount() > 0 )
+    {
+        Uint64 iRender = SDL_GetPerformanceCounter();
+        lParticles += Effects.GetPool().GetCount();
+        Effects.Render( EntityRegistry, GetSurface() );
+        dParticleRenderMs += ( SDL_GetPerformanceCounter() - iRender ) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
     // Unlock if needed
     if ( SDL_MUSTLOCK( ScreenSurface ) )
         SDL_UnlockSurface( ScreenSurface );
 
+    Latency.OnRender();
+
     // Tell SDL to update the whole gScreen
     SDL_UpdateWindowSurface(window);
+
+    Latency.OnPresent();
 }
 
 /** Sets the provided text on to the screen at the defined position.
@@ -266,4 +521,97 @@ int Base::GetFPS()
     return iCurrentFPS;
 }
 
+/** Retrieve the registry holding the game objects.
+    @return A reference to the Registry owned by this instance.
+**/
+Registry& Base::GetRegistry()
+{
+    return EntityRegistry;
+}
+
+/** Adds a system to the per frame update and render passes.
+    @param pSystem The system to run. It is not deleted by Base.
+**/
+void Base::AddSystem(System* pSystem)
+{
+    if ( pSystem )
+        Systems.push_back(pSystem);
+}
 
+/** Retrieve the broadphase used for collision and picking queries.
+    @return A reference to the SpatialHash owned by this instance.
+**/
+SpatialHash& Base::GetSpatialHash()
+{
+    return Collision;
+}
+
+/** Retrieve the particles drawn after the systems. **/
+ParticlePool& Base::GetParticles()
+{
+    return Effects.GetPool();
+}
+
+/** Retrieve the background state and its resource budget. **/
+Lifecycle& Base::GetLifecycle()
+{
+    return AppLifecycle;
+}
+
+/** Retrieve the input seen during the current frame.
+    @return A reference to the snapshot, valid until the next HandleInput().
+**/
+const InputState& Base::GetInputState()
+{
+    return Input;
+}
+
+/** Turns the input latency instrumentation on or off.
+    @remark The report is printed when the main loop ends.
+**/
+void Base::EnableLatencyTracking(bool bEnable)
+{
+    Latency.Enable( bEnable );
+}
+
+/** Retrieve the input latency statistics. **/
+const LatencyTracker& Base::GetLatencyTracker()
+{
+    return Latency;
+}
+
+/** Ends the main loop after the given number of rendered frames.
+    @param iFrames Number of frames, 0 to run until quit.
+**/
+void Base::SetFrameLimit(int iFrames)
+{
+    iFrameLimit = iFrames > 0 ? iFrames : 0;
+}
+
+/** Queues a synthetic event as if it came from the device.
+    @remark SDL stamps the event with the current tick count.
+**/
+void Base::InjectEvent(const SDL_Event& event)
+{
+    SDL_Event copy = event;
+    SDL_PushEvent( &copy );
+}
+
+/** Records every dispatched event, with its frame index, to a file.
+    @return false if the file could not be created.
+**/
+bool Base::RecordInput(const char* czPath)
+{
+    return Recorder.Open( czPath, REPLAY_DEFAULT_STEP_MS );
+}
+
+/** Replays a recording instead of the device input.
+    @remark The loop runs unthrottled with a fixed time step and ends with the
+            recording, printing the frame throughput.
+    @return false if the recording could not be opened.
+**/
+bool Base::ReplayInput(const char* czPath)
+{
+    Recorder.Close();
+    return Replayer.Open( czPath );
+}
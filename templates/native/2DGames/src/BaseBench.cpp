@@ -0,0 +1,502 @@
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Base.h"
+#include "Components.h"
+#include "CpuDispatch.h"
+
+namespace {
+
+//Frame after which the lifecycle benchmark goes to the background.
+const Uint32 LIFECYCLE_BENCH_FRAME = 30;
+
+/** Timer of the lifecycle benchmark: brings the app back to the foreground. **/
+Uint32 ResumeApp(Uint32, void*)
+{
+    SDL_Event event;
+    memset( &event, 0, sizeof(event) );
+    event.type = SDL_APP_DIDENTERFOREGROUND;
+    SDL_PushEvent( &event );
+    return 0;
+}
+
+/** A game object as written without the registry: one allocation per object. **/
+class PointerObject
+{
+public:
+    Position    Pos;
+    Velocity    Vel;
+    Sprite      Image;
+
+    virtual ~PointerObject() {}
+
+    virtual void Update(float fSeconds)
+    {
+        Pos.x += Vel.dx * fSeconds;
+        Pos.y += Vel.dy * fSeconds;
+    }
+};
+
+}
+
+/** Reads the benchmark modes, a comma separated list of mode[=n].
+    @remark A mode without a value gets its default.
+**/
+void Base::ParseBenchmarks(const char* czModes)
+{
+    while ( *czModes )
+    {
+        char czMode[64];
+        size_t iLength = strcspn( czModes, "," );
+        size_t iCopy = iLength < sizeof(czMode) - 1 ? iLength : sizeof(czMode) - 1;
+
+        memcpy( czMode, czModes, iCopy );
+        czMode[iCopy] = '\0';
+        czModes += czModes[iLength] ? iLength + 1 : iLength;
+
+        int iValue = 0;
+        char* czValue = strchr( czMode, '=' );
+        if ( czValue )
+        {
+            *czValue = '\0';
+            iValue = atoi( czValue + 1 );
+        }
+
+        if ( strcmp( czMode, "ecs" ) == 0 )
+            iEntityBenchCount = iValue > 0 ? iValue : 100000;
+        else if ( strcmp( czMode, "broadphase" ) == 0 )
+            iBroadphaseBenchCount = iValue > 0 ? iValue : 50000;
+        else if ( strcmp( czMode, "input" ) == 0 )
+            iInputBenchRate = iValue > 0 ? iValue : 1000;
+        else if ( strcmp( czMode, "tilemap" ) == 0 )
+            iTilemapBenchFrames = iValue > 0 ? iValue : 300;
+        else if ( strcmp( czMode, "particles" ) == 0 )
+        {
+            iParticleBenchCount = iValue > 0 ? iValue : 10000;
+            Effects.GetPool().SetCapacity( iParticleBenchCount );
+        }
+        else if ( strcmp( czMode, "lifecycle" ) == 0 )
+        {
+            if ( SDL_InitSubSystem( SDL_INIT_TIMER ) == 0 )
+                iLifecycleBenchMs = iValue > 0 ? iValue : 2000;
+        }
+        else if ( czMode[0] )
+            fprintf( stderr, "Unknown benchmark %s\n", czMode );
+    }
+}
+
+/** Runs the start-up benchmarks of the selected modes. **/
+void Base::RunBenchmarks()
+{
+    if ( iEntityBenchCount > 0 )
+        BenchmarkEntities( iEntityBenchCount, 100 );
+
+    if ( iBroadphaseBenchCount > 0 )
+        BenchmarkBroadphase( iBroadphaseBenchCount, 60 );
+
+    if ( iInputBenchRate > 0 )
+        BenchmarkInput( iInputBenchRate, 600 );
+
+    if ( iTilemapBenchFrames > 0 )
+        BenchmarkTilemap( iTilemapBenchFrames );
+
+    if ( iParticleBenchCount > 0 )
+        BenchmarkParticles( iParticleBenchCount, 100 );
+
+    if ( iLifecycleBenchMs > 0 )
+        CheckLifecycle();
+}
+
+/** Adds the synthetic input and load of the selected modes after a frame. **/
+void Base::UpdateBenchmarks()
+{
+    // Synthetic key press for latency runs without a real input device.
+    if ( iInjectInterval > 0 && iFrameIndex % iInjectInterval == 0 )
+    {
+        SDL_Event event;
+        memset( &event, 0, sizeof(event) );
+        event.type = SDL_KEYDOWN;
+        InjectEvent( event );
+        event.type = SDL_KEYUP;
+        InjectEvent( event );
+    }
+
+    // A fountain that refills the pool to the benchmark count
+    if ( iParticleBenchCount > 0 )
+        Effects.GetPool().Emit( iParticleBenchCount - Effects.GetPool().GetCount(),
+                                iwindow_width * 0.5f, iwindow_height * 0.25f, 300.0f, 1.5f, 0xFF2080FFu );
+
+    // Lifecycle run: go to the background once, the timer brings the app back.
+    if ( iLifecycleBenchMs > 0 && iFrameIndex == LIFECYCLE_BENCH_FRAME )
+    {
+        SDL_Event event;
+        memset( &event, 0, sizeof(event) );
+        event.type = SDL_APP_DIDENTERBACKGROUND;
+        InjectEvent( event );
+        SDL_AddTimer( iLifecycleBenchMs, ResumeApp, 0 );
+    }
+}
+
+/** Prints the per frame averages of the selected modes. **/
+void Base::ReportBenchmarks()
+{
+    if ( lParticles > 0 )
+        printf( "particles: %.0f per frame, update %.3f ms, draw %.3f ms\n",
+                (double)lParticles / iFrameIndex, dParticleUpdateMs / iFrameIndex,
+                dParticleRenderMs / iFrameIndex );
+}
+
+/** Sends a particle pool through two background periods without a frame in
+    between, then checks that the pool comes back with its first particles.
+**/
+bool Base::CheckLifecycle()
+{
+    ParticlePool pool;
+    pool.SetCapacity( 64 );
+
+    Lifecycle lifecycle;
+    lifecycle.Register( &pool );
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        lifecycle.EnterBackground();
+        lifecycle.EnterForeground();
+    }
+
+    int iEmitted = pool.Emit( 64, 0.0f, 0.0f, 100.0f, 1.0f, 0xFFFFFFFFu );
+    lifecycle.Unregister( &pool );
+
+    if ( iEmitted != 64 )
+    {
+        fprintf( stderr, "lifecycle check: %d of 64 particles emitted after two background periods\n", iEmitted );
+        return false;
+    }
+
+    printf( "lifecycle check: particles emit after two background periods\n" );
+    return true;
+}
+
+/** Moves the same entities as registry components and as separately allocated objects. **/
+void Base::BenchmarkEntities(int iEntities, int iFrames)
+{
+    const int iElapsed = 16;
+
+    Registry registry;
+    std::vector<PointerObject*> Objects;
+    Objects.reserve( iEntities );
+
+    // Sprites spread over the window moving in random directions, the same in both.
+    srand( 1 );
+    for ( int i = 0; i < iEntities; ++i )
+    {
+        Position pos = { (float)( rand() % iwindow_width ), (float)( rand() % iwindow_height ) };
+        Velocity vel = { (float)( rand() % 200 - 100 ), (float)( rand() % 200 - 100 ) };
+        Sprite image = { 0, { 0, 0, 0, 0 } };
+
+        Entity e = registry.Create();
+        registry.Assign( e, pos );
+        registry.Assign( e, vel );
+        registry.Assign( e, image );
+
+        PointerObject* pObject = new PointerObject();
+        pObject->Pos = pos;
+        pObject->Vel = vel;
+        pObject->Image = image;
+        Objects.push_back( pObject );
+    }
+    registry.Align<Velocity, Position>();
+
+    // Objects created and destroyed over a game are not updated in allocation order.
+    for ( int i = iEntities - 1; i > 0; --i )
+        std::swap( Objects[i], Objects[rand() % ( i + 1 )] );
+
+    MovementSystem movement;
+    double dMs[2] = { 0.0, 0.0 };
+    double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    for ( int f = 0; f < iFrames; ++f )
+    {
+        Uint64 iStart = SDL_GetPerformanceCounter();
+        movement.Update( registry, iElapsed );
+        Uint64 iMiddle = SDL_GetPerformanceCounter();
+        for ( size_t i = 0; i < Objects.size(); ++i )
+            Objects[i]->Update( iElapsed * 0.001f );
+        Uint64 iEnd = SDL_GetPerformanceCounter();
+
+        dMs[0] += ( iMiddle - iStart ) * dToMs;
+        dMs[1] += ( iEnd - iMiddle ) * dToMs;
+    }
+
+    printf( "entities: %d with Position, Velocity and Sprite, %d frames\n", iEntities, iFrames );
+    printf( "  per frame: registry %.3f ms, per object %.3f ms\n", dMs[0] / iFrames, dMs[1] / iFrames );
+
+    for ( size_t i = 0; i < Objects.size(); ++i )
+        delete Objects[i];
+}
+
+/** Moves bodies through the spatial hash and finds their pairs, for growing body counts. **/
+void Base::BenchmarkBroadphase(int iMaxBodies, int iFrames)
+{
+    const int iCounts[] = { 100, 500, 1000, 5000, 10000, 50000 };
+    const int iBoxSize = 16;
+    const int iSpacing = 64;
+
+    // Naive checks grow with the square of the bodies and stop here.
+    const int iMaxNaive = 5000;
+
+    double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    printf( "broadphase: %dx%d bodies, one per %dx%d pixels, %d frames\n", iBoxSize, iBoxSize, iSpacing, iSpacing, iFrames );
+    printf( "   bodies   move ms  pairs ms    pairs  naive ms\n" );
+
+    for ( size_t c = 0; c < sizeof(iCounts) / sizeof(iCounts[0]); ++c )
+    {
+        int iBodies = iCounts[c] < iMaxBodies ? iCounts[c] : iMaxBodies;
+        if ( c > 0 && iCounts[c - 1] >= iMaxBodies )
+            break;
+
+        // The world grows with the bodies so the density stays the same.
+        int iWorld = (int)sqrt( (double)iBodies ) * iSpacing;
+
+        SpatialHash hash( iSpacing, iBodies > 4096 ? iBodies : 4096 );
+        std::vector<SDL_Rect> Boxes( iBodies );
+        std::vector<int> Ids( iBodies ), Steps( iBodies );
+        std::vector<BodyPair> Pairs;
+
+        srand( 1 );
+        for ( int i = 0; i < iBodies; ++i )
+        {
+            SDL_Rect box = { rand() % iWorld, rand() % iWorld, iBoxSize, iBoxSize };
+            Boxes[i] = box;
+            Ids[i] = hash.Insert( box, (Uint32)i );
+            Steps[i] = rand() % 5 - 2;
+        }
+
+        double dMoveMs = 0.0, dPairMs = 0.0, dNaiveMs = 0.0;
+        long lPairs = 0;
+
+        for ( int f = 0; f < iFrames; ++f )
+        {
+            Uint64 iStart = SDL_GetPerformanceCounter();
+            for ( int i = 0; i < iBodies; ++i )
+            {
+                SDL_Rect& box = Boxes[i];
+                box.x = ( box.x + Steps[i] + iWorld ) % iWorld;
+                box.y = ( box.y + Steps[( i + 1 ) % iBodies] + iWorld ) % iWorld;
+                hash.Move( Ids[i], box );
+            }
+            Uint64 iMoved = SDL_GetPerformanceCounter();
+            Pairs.clear();
+            lPairs += (long)hash.FindPairs( Pairs );
+            Uint64 iPaired = SDL_GetPerformanceCounter();
+
+            dMoveMs += ( iMoved - iStart ) * dToMs;
+            dPairMs += ( iPaired - iMoved ) * dToMs;
+
+            if ( iBodies > iMaxNaive )
+                continue;
+
+            // What games wrote in the update hook: every body against every other.
+            long lNaive = 0;
+            for ( int a = 0; a < iBodies; ++a )
+                for ( int b = a + 1; b < iBodies; ++b )
+                    if ( Boxes[a].x < Boxes[b].x + Boxes[b].w && Boxes[b].x < Boxes[a].x + Boxes[a].w
+                      && Boxes[a].y < Boxes[b].y + Boxes[b].h && Boxes[b].y < Boxes[a].y + Boxes[a].h )
+                        ++lNaive;
+            dNaiveMs += ( SDL_GetPerformanceCounter() - iPaired ) * dToMs;
+
+            if ( lNaive != (long)Pairs.size() )
+                fprintf( stderr, "broadphase: %ld pairs, naive checks found %ld\n", (long)Pairs.size(), lNaive );
+        }
+
+        if ( iBodies > iMaxNaive )
+            printf( "  %7d %9.3f %9.3f %8ld         -\n", iBodies, dMoveMs / iFrames, dPairMs / iFrames, lPairs / iFrames );
+        else
+            printf( "  %7d %9.3f %9.3f %8ld %9.3f\n", iBodies, dMoveMs / iFrames, dPairMs / iFrames, lPairs / iFrames,
+                    dNaiveMs / iFrames );
+    }
+}
+
+/** Runs the same fountain through the SIMD and the scalar kernel. **/
+void Base::BenchmarkParticles(int iParticles, int iFrames)
+{
+    const float fStep = 1.0f / 60.0f;
+
+    ParticlePool pool;
+    pool.SetCapacity( iParticles );
+
+    double dMs[2] = { 0.0, 0.0 };
+    double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    for ( int iKernel = 0; iKernel < 2; ++iKernel )
+    {
+        pool.Clear();
+
+        for ( int f = 0; f < iFrames; ++f )
+        {
+            pool.Emit( iParticles - pool.GetCount(), 0.0f, 0.0f, 300.0f, 1.0f, 0xFFFFFFFFu );
+
+            Uint64 iStart = SDL_GetPerformanceCounter();
+            if ( iKernel == 0 )
+                pool.Update( fStep );
+            else
+                pool.UpdateScalar( fStep );
+            dMs[iKernel] += ( SDL_GetPerformanceCounter() - iStart ) * dToMs;
+        }
+    }
+
+    printf( "particles: %d particles, %d frames\n", iParticles, iFrames );
+    printf( "  per frame: update %.3f ms (scalar %.3f ms)\n", dMs[0] / iFrames, dMs[1] / iFrames );
+}
+
+/** Scrolls a large generated map from cached chunks, then tile by tile with the bound and the scalar pixel kernels. **/
+void Base::BenchmarkTilemap(int iFrames)
+{
+    const int iMapSize = 1024;
+    const int iTileSize = 32;
+
+    // Off-screen target in the window format, 64 tiles in an 8x8 ARGB tileset.
+    const SDL_PixelFormat* pFormat = ScreenSurface->format;
+    SDL_Surface* pTarget = SDL_CreateRGBSurface( 0, iwindow_width, iwindow_height, pFormat->BitsPerPixel,
+                                                 pFormat->Rmask, pFormat->Gmask, pFormat->Bmask, 0 );
+    SDL_Surface* pTileset = SDL_CreateRGBSurface( 0, 8 * iTileSize, 8 * iTileSize, 32,
+                                                  0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0xFF000000u );
+    if ( !pTarget || !pTileset )
+    {
+        fprintf( stderr, "Unable to create the tilemap benchmark surfaces: %s\n", SDL_GetError() );
+        return;
+    }
+
+    for ( int i = 0; i < 64; ++i )
+    {
+        SDL_Rect cell = { ( i % 8 ) * iTileSize, ( i / 8 ) * iTileSize, iTileSize, iTileSize };
+        // Opaque ground, half transparent decorations blended over it.
+        Uint8 iAlpha = i < 32 ? 255 : 128;
+        SDL_FillRect( pTileset, &cell, SDL_MapRGBA( pTileset->format, (Uint8)( i * 37 ), (Uint8)( i * 91 ), (Uint8)( i * 13 ), iAlpha ) );
+    }
+
+    // Ground everywhere, a decoration layer on every tenth tile.
+    Tilemap map;
+    map.Create( iMapSize, iMapSize, 2, pTileset, iTileSize );
+
+    srand( 1 );
+    for ( int y = 0; y < iMapSize; ++y )
+    {
+        for ( int x = 0; x < iMapSize; ++x )
+        {
+            map.SetTile( 0, x, y, (Uint16)( 1 + rand() % 32 ) );
+            if ( rand() % 10 == 0 )
+                map.SetTile( 1, x, y, (Uint16)( 33 + rand() % 32 ) );
+        }
+    }
+
+    double dMs[3] = { 0.0, 0.0, 0.0 };
+    long lBlits[3] = { 0, 0, 0 };
+    long lBuilt = 0;
+    double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    // The last pass rebinds the scalar kernels, unless they are bound already.
+    const CpuKernels& kernels = GetCpuKernels();
+    int iPasses = kernels.iFeatures ? 3 : 2;
+
+    for ( int iPass = 0; iPass < iPasses; ++iPass )
+    {
+        if ( iPass == 2 )
+            InitCpuDispatch( 0 );
+
+        for ( int f = 0; f < iFrames; ++f )
+        {
+            int iScrollX = f * 7, iScrollY = f * 3;
+
+            // An animated tile in view every tenth frame rebuilds one chunk.
+            if ( f % 10 == 0 )
+                map.SetTile( 1, ( iScrollX + iwindow_width / 2 ) / iTileSize,
+                             ( iScrollY + iwindow_height / 2 ) / iTileSize, (Uint16)( 33 + f % 32 ) );
+
+            Uint64 iStart = SDL_GetPerformanceCounter();
+            if ( iPass == 0 )
+                map.Render( pTarget, iScrollX, iScrollY );
+            else
+                map.RenderUncached( pTarget, iScrollX, iScrollY );
+            dMs[iPass] += ( SDL_GetPerformanceCounter() - iStart ) * dToMs;
+
+            lBlits[iPass] += map.GetBlitCount();
+            lBuilt += map.GetChunksBuilt();
+        }
+    }
+    InitCpuDispatch( kernels.iFeatures );
+
+    printf( "tilemap: %dx%d tiles, %dx%d view, %d frames\n", iMapSize, iMapSize, iwindow_width, iwindow_height, iFrames );
+    printf( "  cached:   %.3f ms, %ld blits, %.2f chunks built per frame, %d chunks kept\n",
+            dMs[0] / iFrames, lBlits[0] / iFrames, (double)lBuilt / iFrames, map.GetCachedChunks() );
+    printf( "  per tile: %.3f ms, %ld blits per frame, %s kernels\n", dMs[1] / iFrames, lBlits[1] / iFrames, kernels.czName );
+    if ( iPasses == 3 )
+        printf( "  per tile: %.3f ms, scalar kernels\n", dMs[2] / iFrames );
+
+    map.Release();
+    SDL_FreeSurface( pTileset );
+    SDL_FreeSurface( pTarget );
+}
+
+/** Feeds the same synthetic pointer stream to HandleInput() and to one HandleEvent() per polled event.
+    @remark The events reach the game callbacks like real input; run it before the game starts.
+**/
+void Base::BenchmarkInput(int iRateHz, int iFrames)
+{
+    if ( Replayer.IsOpen() || Recorder.IsOpen() )
+    {
+        fprintf( stderr, "input: no benchmark while recording or replaying\n" );
+        return;
+    }
+
+    // Events queued during one 60 Hz frame.
+    int iPerFrame = iRateHz / 60 > 0 ? iRateHz / 60 : 1;
+
+    double dMs[2] = { 0.0, 0.0 };
+    long lCallbacks[2] = { 0, 0 };
+    double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    for ( int iPath = 0; iPath < 2; ++iPath )
+    {
+        for ( int f = 0; f < iFrames; ++f )
+        {
+            for ( int i = 0; i < iPerFrame; ++i )
+            {
+                SDL_Event event;
+                memset( &event, 0, sizeof(event) );
+                event.type = SDL_MOUSEMOTION;
+                event.motion.x = ( f * iPerFrame + i ) % iwindow_width;
+                event.motion.y = iwindow_height / 2;
+                event.motion.xrel = 1;
+                SDL_PushEvent( &event );
+            }
+
+            Uint64 iStart = SDL_GetPerformanceCounter();
+            if ( iPath == 0 )
+                HandleInput();
+            else
+            {
+                // Dispatch without batching: every event on its own.
+                Input.BeginFrame( SDL_GetTicks() );
+
+                SDL_Event event;
+                while ( SDL_PollEvent( &event ) )
+                {
+                    Input.CountRaw( event );
+                    HandleEvent( event );
+                }
+            }
+            dMs[iPath] += ( SDL_GetPerformanceCounter() - iStart ) * dToMs;
+            lCallbacks[iPath] += Input.GetDispatchedCount();
+        }
+    }
+
+    printf( "input: %d Hz pointer stream, %d events per frame, %d frames\n", iRateHz, iPerFrame, iFrames );
+    printf( "  per frame: batched %.3f ms, %.1f callbacks; per event %.3f ms, %.1f callbacks\n",
+            dMs[0] / iFrames, (double)lCallbacks[0] / iFrames, dMs[1] / iFrames, (double)lCallbacks[1] / iFrames );
+}
@@ -0,0 +1,401 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__)
+#include <immintrin.h>
+#define CPU_DISPATCH_X86 1
+#define CPU_TARGET_SSE2 __attribute__((target("sse2")))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CPU_DISPATCH_NEON 1
+#endif
+
+#include "CpuDispatch.h"
+
+namespace {
+
+// ---
+// Scalar reference kernels
+
+void FillRow32Scalar(Uint32* pDest, int n, Uint32 iColor)
+{
+    for ( int i = 0; i < n; ++i )
+        pDest[i] = iColor;
+}
+
+/** (s a + d (255 - a)) / 255, rounded; the SIMD variants compute the same in 16-bit lanes. **/
+inline Uint32 BlendChannel(Uint32 s, Uint32 d, Uint32 a)
+{
+    Uint32 t = s * a + d * ( 255 - a ) + 128;
+    return ( t + ( t >> 8 ) ) >> 8;
+}
+
+void BlendRowARGBScalar(Uint32* pDest, const Uint32* pSource, int n)
+{
+    for ( int i = 0; i < n; ++i ) {
+        Uint32 s = pSource[i], d = pDest[i], a = s >> 24;
+        Uint32 iResult = 0;
+
+        for ( int iShift = 0; iShift < 32; iShift += 8 )
+            iResult |= BlendChannel(( s >> iShift ) & 0xFF, ( d >> iShift ) & 0xFF, a) << iShift;
+
+        pDest[i] = iResult;
+    }
+}
+
+#if defined(CPU_DISPATCH_X86)
+
+// ---
+// SSE2
+
+CPU_TARGET_SSE2 void FillRow32SSE2(Uint32* pDest, int n, Uint32 iColor)
+{
+    __m128i c = _mm_set1_epi32((int)iColor);
+    int i = 0;
+
+    for ( ; i + 4 <= n; i += 4 )
+        _mm_storeu_si128((__m128i*)&pDest[i], c);
+
+    FillRow32Scalar(pDest + i, n - i, iColor);
+}
+
+CPU_TARGET_SSE2 inline __m128i BlendPixelsSSE2(__m128i s, __m128i d)
+{
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(c255, a))), c128);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+CPU_TARGET_SSE2 void BlendRowARGBSSE2(Uint32* pDest, const Uint32* pSource, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+
+    for ( ; i + 4 <= n; i += 4 ) {
+        __m128i s = _mm_loadu_si128((const __m128i*)&pSource[i]);
+        __m128i d = _mm_loadu_si128((const __m128i*)&pDest[i]);
+
+        __m128i lo = BlendPixelsSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = BlendPixelsSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i*)&pDest[i], _mm_packus_epi16(lo, hi));
+    }
+
+    BlendRowARGBScalar(pDest + i, pSource + i, n - i);
+}
+
+// ---
+// AVX2, the same operations on eight lanes
+
+CPU_TARGET_AVX2 void FillRow32AVX2(Uint32* pDest, int n, Uint32 iColor)
+{
+    __m256i c = _mm256_set1_epi32((int)iColor);
+    int i = 0;
+
+    for ( ; i + 8 <= n; i += 8 )
+        _mm256_storeu_si256((__m256i*)&pDest[i], c);
+
+    FillRow32Scalar(pDest + i, n - i, iColor);
+}
+
+CPU_TARGET_AVX2 inline __m256i BlendPixelsAVX2(__m256i s, __m256i d)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i c128 = _mm256_set1_epi16(128);
+
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m256i t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, a),
+                                                  _mm256_mullo_epi16(d, _mm256_sub_epi16(c255, a))), c128);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+CPU_TARGET_AVX2 void BlendRowARGBAVX2(Uint32* pDest, const Uint32* pSource, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+
+    // Unpack and pack both work within 128-bit halves, so the pixel order is kept.
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)&pSource[i]);
+        __m256i d = _mm256_loadu_si256((const __m256i*)&pDest[i]);
+
+        __m256i lo = BlendPixelsAVX2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+        __m256i hi = BlendPixelsAVX2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256((__m256i*)&pDest[i], _mm256_packus_epi16(lo, hi));
+    }
+
+    BlendRowARGBScalar(pDest + i, pSource + i, n - i);
+}
+
+#endif
+
+#if defined(CPU_DISPATCH_NEON)
+
+// ---
+// NEON
+
+void FillRow32NEON(Uint32* pDest, int n, Uint32 iColor)
+{
+    uint32x4_t c = vdupq_n_u32(iColor);
+    int i = 0;
+
+    for ( ; i + 4 <= n; i += 4 )
+        vst1q_u32(&pDest[i], c);
+
+    FillRow32Scalar(pDest + i, n - i, iColor);
+}
+
+void BlendRowARGBNEON(Uint32* pDest, const Uint32* pSource, int n)
+{
+    const uint16x8_t c128 = vdupq_n_u16(128);
+    int i = 0;
+
+    // Eight pixels, split into one register per byte of the pixel.
+    for ( ; i + 8 <= n; i += 8 ) {
+        uint8x8x4_t s = vld4_u8((const Uint8*)&pSource[i]);
+        uint8x8x4_t d = vld4_u8((const Uint8*)&pDest[i]);
+        uint8x8_t a = s.val[3], ia = vmvn_u8(a);
+
+        for ( int c = 0; c < 4; ++c ) {
+            uint16x8_t t = vaddq_u16(vmlal_u8(vmull_u8(s.val[c], a), d.val[c], ia), c128);
+            d.val[c] = vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+        }
+
+        vst4_u8((Uint8*)&pDest[i], d);
+    }
+
+    BlendRowARGBScalar(pDest + i, pSource + i, n - i);
+}
+
+#endif
+
+// Ordered from the reference to the fastest.
+const CpuKernels VARIANTS[] = {
+    { "scalar", 0,
+      FillRow32Scalar, BlendRowARGBScalar },
+#if defined(CPU_DISPATCH_X86)
+    { "sse2", CPU_FEATURE_SSE2,
+      FillRow32SSE2, BlendRowARGBSSE2 },
+    { "avx2", CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2,
+      FillRow32AVX2, BlendRowARGBAVX2 },
+#endif
+#if defined(CPU_DISPATCH_NEON)
+    { "neon", CPU_FEATURE_NEON,
+      FillRow32NEON, BlendRowARGBNEON },
+#endif
+};
+
+const int VARIANT_COUNT = (int)( sizeof(VARIANTS) / sizeof(VARIANTS[0]) );
+
+const CpuKernels* pBound = &VARIANTS[0];
+
+// xorshift32, so every run tests the same data.
+Uint32 NextRandom(Uint32& iState)
+{
+    iState ^= iState << 13;
+    iState ^= iState >> 17;
+    iState ^= iState << 5;
+    return iState;
+}
+
+int Report(FILE* pOut, const char* czVariant, const char* czKernel, int iMismatches)
+{
+    if ( pOut )
+        fprintf(pOut, "  %-6s %-16s %s\n", czVariant, czKernel, iMismatches ? "MISMATCH" : "ok");
+    return iMismatches ? 1 : 0;
+}
+
+}
+
+Uint32 DetectCpuFeatures()
+{
+    Uint32 iFeatures = 0;
+
+#if defined(CPU_DISPATCH_X86)
+    if ( SDL_HasSSE2() )
+        iFeatures |= CPU_FEATURE_SSE2;
+#if SDL_VERSION_ATLEAST(2, 0, 4)
+    if ( SDL_HasAVX2() )
+        iFeatures |= CPU_FEATURE_AVX2;
+#endif
+#endif
+
+#if defined(CPU_DISPATCH_NEON)
+#if SDL_VERSION_ATLEAST(2, 0, 6)
+    if ( SDL_HasNEON() )
+        iFeatures |= CPU_FEATURE_NEON;
+#else
+    // Built with NEON enabled, so the target is expected to have it.
+    iFeatures |= CPU_FEATURE_NEON;
+#endif
+#endif
+
+    return iFeatures;
+}
+
+Uint32 ParseCpuFeatures(const char* czList)
+{
+    Uint32 iFeatures = 0;
+
+    while ( czList && *czList ) {
+        const char* czEnd = strchr(czList, ',');
+        size_t iLength = czEnd ? (size_t)( czEnd - czList ) : strlen(czList);
+
+        if ( iLength == 4 && strncmp(czList, "sse2", 4) == 0 )
+            iFeatures |= CPU_FEATURE_SSE2;
+        else if ( iLength == 4 && strncmp(czList, "avx2", 4) == 0 )
+            iFeatures |= CPU_FEATURE_AVX2 | CPU_FEATURE_SSE2;
+        else if ( iLength == 4 && strncmp(czList, "neon", 4) == 0 )
+            iFeatures |= CPU_FEATURE_NEON;
+
+        czList = czEnd ? czEnd + 1 : 0;
+    }
+
+    return iFeatures;
+}
+
+void InitCpuDispatch(Uint32 iFeatures)
+{
+    pBound = &VARIANTS[0];
+
+    for ( int i = 1; i < VARIANT_COUNT; ++i )
+        if ( ( VARIANTS[i].iFeatures & iFeatures ) == VARIANTS[i].iFeatures )
+            pBound = &VARIANTS[i];
+}
+
+const CpuKernels& GetCpuKernels()
+{
+    return *pBound;
+}
+
+int GetCpuVariantCount()
+{
+    return VARIANT_COUNT;
+}
+
+const CpuKernels& GetCpuVariant(int iIndex)
+{
+    return VARIANTS[iIndex >= 0 && iIndex < VARIANT_COUNT ? iIndex : 0];
+}
+
+/** Fills row by row with the bound FillRow32; SDL_FillRect() covers the other surfaces. **/
+int FillSurface32(SDL_Surface* pDest, const SDL_Rect* pRect, Uint32 iColor)
+{
+    if ( pDest->format->BytesPerPixel != 4 || SDL_MUSTLOCK(pDest) || !pDest->pixels )
+        return SDL_FillRect(pDest, pRect, iColor);
+
+    SDL_Rect area = pDest->clip_rect;
+    if ( pRect && !SDL_IntersectRect(pRect, &pDest->clip_rect, &area) )
+        return 0;
+
+    Uint8* pRow = (Uint8*)pDest->pixels + area.y * pDest->pitch + area.x * 4;
+    for ( int y = 0; y < area.h; ++y, pRow += pDest->pitch )
+        pBound->FillRow32((Uint32*)pRow, area.w, iColor);
+
+    return 0;
+}
+
+/** Clips like SDL_BlitSurface() and blends row by row with the bound BlendRowARGB. **/
+int BlendSurfaceARGB(SDL_Surface* pSource, const SDL_Rect* pSourceRect, SDL_Surface* pDest, int x, int y)
+{
+    const SDL_PixelFormat* pFormat = pDest->format;
+
+    // The kernel blends all four bytes, so the destination must be xRGB without alpha.
+    if ( pSource->format->format != SDL_PIXELFORMAT_ARGB8888 || pFormat->BytesPerPixel != 4
+         || pFormat->Rmask != 0x00FF0000u || pFormat->Gmask != 0x0000FF00u || pFormat->Bmask != 0x000000FFu
+         || pFormat->Amask != 0 || SDL_MUSTLOCK(pSource) || SDL_MUSTLOCK(pDest) ) {
+        SDL_Rect dest = { x, y, 0, 0 };
+        return SDL_BlitSurface(pSource, pSourceRect, pDest, &dest);
+    }
+
+    SDL_Rect source = { 0, 0, pSource->w, pSource->h };
+    if ( pSourceRect )
+        source = *pSourceRect;
+
+    // Source edges first, moving the destination along, then the clip rectangle.
+    const SDL_Rect& clip = pDest->clip_rect;
+    int iLeft = source.x < 0 ? -source.x : 0;
+    int iTop = source.y < 0 ? -source.y : 0;
+
+    if ( x + iLeft < clip.x )
+        iLeft = clip.x - x;
+    if ( y + iTop < clip.y )
+        iTop = clip.y - y;
+
+    source.x += iLeft;  source.w -= iLeft;  x += iLeft;
+    source.y += iTop;   source.h -= iTop;   y += iTop;
+
+    if ( source.x + source.w > pSource->w )
+        source.w = pSource->w - source.x;
+    if ( source.y + source.h > pSource->h )
+        source.h = pSource->h - source.y;
+    if ( x + source.w > clip.x + clip.w )
+        source.w = clip.x + clip.w - x;
+    if ( y + source.h > clip.y + clip.h )
+        source.h = clip.y + clip.h - y;
+
+    if ( source.w <= 0 || source.h <= 0 )
+        return 0;
+
+    const Uint8* pFrom = (const Uint8*)pSource->pixels + source.y * pSource->pitch + source.x * 4;
+    Uint8* pTo = (Uint8*)pDest->pixels + y * pDest->pitch + x * 4;
+
+    for ( int i = 0; i < source.h; ++i, pFrom += pSource->pitch, pTo += pDest->pitch )
+        pBound->BlendRowARGB((Uint32*)pTo, (const Uint32*)pFrom, source.w);
+
+    return 0;
+}
+
+int CpuDispatchSelfTest(FILE* pOut)
+{
+    // Odd length, so the scalar tails run too.
+    const int n = 1027;
+
+    Uint32 iAvailable = DetectCpuFeatures();
+    Uint32 iState = 0x12345678u;
+    int iFailures = 0;
+
+    Uint32* pPixels = (Uint32*)malloc(n * sizeof(Uint32) * 4);
+    Uint32 *pSource = pPixels, *pDest = pPixels + n, *pExpected = pPixels + n * 2, *pResult = pPixels + n * 3;
+
+    for ( int i = 0; i < n; ++i ) {
+        pSource[i] = NextRandom(iState);
+        pDest[i] = NextRandom(iState);
+    }
+
+    // Full transparency and full opacity at the edges.
+    pSource[0] &= 0x00FFFFFFu;
+    pSource[1] |= 0xFF000000u;
+
+    const CpuKernels& reference = VARIANTS[0];
+
+    if ( pOut )
+        fprintf(pOut, "cpu dispatch self-test, bound variant: %s\n", pBound->czName);
+
+    for ( int v = 1; v < VARIANT_COUNT; ++v ) {
+        const CpuKernels& variant = VARIANTS[v];
+
+        if ( ( variant.iFeatures & iAvailable ) != variant.iFeatures ) {
+            if ( pOut )
+                fprintf(pOut, "  %-6s skipped, not supported by this CPU\n", variant.czName);
+            continue;
+        }
+
+        reference.FillRow32(pExpected, n, 0x80C0FFEEu);
+        variant.FillRow32(pResult, n, 0x80C0FFEEu);
+        iFailures += Report(pOut, variant.czName, "FillRow32", memcmp(pExpected, pResult, n * sizeof(Uint32)));
+
+        memcpy(pExpected, pDest, n * sizeof(Uint32));
+        memcpy(pResult, pDest, n * sizeof(Uint32));
+        reference.BlendRowARGB(pExpected, pSource, n);
+        variant.BlendRowARGB(pResult, pSource, n);
+        iFailures += Report(pOut, variant.czName, "BlendRowARGB", memcmp(pExpected, pResult, n * sizeof(Uint32)));
+    }
+
+    free(pPixels);
+    return iFailures;
+}
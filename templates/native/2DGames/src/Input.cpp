@@ -0,0 +1,114 @@
+
+#include <algorithm>
+
+#include "Input.h"
+
+namespace {
+
+inline bool Contains(const std::vector<int>& keys, int iKeyEnum)
+{
+    return std::find(keys.begin(), keys.end(), iKeyEnum) != keys.end();
+}
+
+}
+
+/** Default constructor. **/
+InputState::InputState()
+{
+    iFrameTicks         = 0;
+    iLastEventTimestamp = 0;
+
+    iMouseX             = 0;
+    iMouseY             = 0;
+    iMouseRelX          = 0;
+    iMouseRelY          = 0;
+    iButtons            = 0;
+
+    iRawEvents          = 0;
+    iRawMotionEvents    = 0;
+    iDispatchedEvents   = 0;
+}
+
+/** Starts a new frame. Held keys, buttons and the pointer position carry over. **/
+void InputState::BeginFrame(Uint32 iTicks)
+{
+    iFrameTicks         = iTicks;
+    iLastEventTimestamp = 0;
+
+    iMouseRelX          = 0;
+    iMouseRelY          = 0;
+
+    PressedKeys.clear();
+    ReleasedKeys.clear();
+
+    iRawEvents          = 0;
+    iRawMotionEvents    = 0;
+    iDispatchedEvents   = 0;
+}
+
+/** Counts an event as it comes off the SDL queue, before coalescing. **/
+void InputState::CountRaw(const SDL_Event& event)
+{
+    ++iRawEvents;
+
+    if ( event.type == SDL_MOUSEMOTION )
+        ++iRawMotionEvents;
+}
+
+/** Updates the snapshot with an event that is being dispatched. **/
+void InputState::Apply(const SDL_Event& event)
+{
+    ++iDispatchedEvents;
+    iLastEventTimestamp = event.common.timestamp;
+
+    switch ( event.type )
+    {
+        case SDL_KEYDOWN:
+            if ( !event.key.repeat )
+                PressedKeys.push_back(event.key.keysym.sym);
+            if ( !Contains(HeldKeys, event.key.keysym.sym) )
+                HeldKeys.push_back(event.key.keysym.sym);
+            break;
+
+        case SDL_KEYUP:
+            ReleasedKeys.push_back(event.key.keysym.sym);
+            HeldKeys.erase(std::remove(HeldKeys.begin(), HeldKeys.end(), (int)event.key.keysym.sym),
+                           HeldKeys.end());
+            break;
+
+        case SDL_MOUSEMOTION:
+            iMouseX     = event.motion.x;
+            iMouseY     = event.motion.y;
+            iMouseRelX += event.motion.xrel;
+            iMouseRelY += event.motion.yrel;
+            iButtons    = event.motion.state;
+            break;
+
+        case SDL_MOUSEBUTTONDOWN:
+            iMouseX     = event.button.x;
+            iMouseY     = event.button.y;
+            iButtons   |= SDL_BUTTON(event.button.button);
+            break;
+
+        case SDL_MOUSEBUTTONUP:
+            iMouseX     = event.button.x;
+            iMouseY     = event.button.y;
+            iButtons   &= ~SDL_BUTTON(event.button.button);
+            break;
+    }
+}
+
+bool InputState::WasKeyPressed(int iKeyEnum) const
+{
+    return Contains(PressedKeys, iKeyEnum);
+}
+
+bool InputState::WasKeyReleased(int iKeyEnum) const
+{
+    return Contains(ReleasedKeys, iKeyEnum);
+}
+
+bool InputState::IsKeyDown(int iKeyEnum) const
+{
+    return Contains(HeldKeys, iKeyEnum);
+}
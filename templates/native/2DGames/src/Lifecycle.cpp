@@ -0,0 +1,168 @@
+
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#define LIFECYCLE_POSIX 1
+#endif
+
+#include "Lifecycle.h"
+
+namespace {
+
+/** Orders the largest resource first. **/
+struct LargerFirst
+{
+    bool operator()(const Releasable* a, const Releasable* b) const
+    {
+        return a->GetResidentBytes() > b->GetResidentBytes();
+    }
+};
+
+}
+
+bool Releasable::EnsureResident()
+{
+    if ( bReleased && OnRestore() )
+        bReleased = false;
+
+    return !bReleased;
+}
+
+Lifecycle::Lifecycle()
+{
+    iBudget             = 0;
+    bBackground         = false;
+
+    iBackgroundCount    = 0;
+    iBackgroundStart    = 0;
+    dCpuStartMs         = 0.0;
+
+    iBackgroundMs       = 0;
+    dBackgroundCpuMs    = 0.0;
+    iHeldBytes          = 0;
+    iReleasedBytes      = 0;
+    iForegroundRss      = 0;
+    iBackgroundRss      = 0;
+}
+
+void Lifecycle::Register(Releasable* pResource)
+{
+    if ( pResource && std::find(Resources.begin(), Resources.end(), pResource) == Resources.end() )
+        Resources.push_back(pResource);
+}
+
+void Lifecycle::Unregister(Releasable* pResource)
+{
+    Resources.erase(std::remove(Resources.begin(), Resources.end(), pResource), Resources.end());
+}
+
+void Lifecycle::SetBudget(size_t iBytes)
+{
+    iBudget = iBytes;
+}
+
+size_t Lifecycle::GetResidentBytes() const
+{
+    size_t iBytes = 0;
+
+    for ( size_t i = 0; i < Resources.size(); ++i )
+        iBytes += Resources[i]->GetResidentBytes();
+
+    return iBytes;
+}
+
+void Lifecycle::EnterBackground()
+{
+    if ( bBackground )
+        return;
+
+    bBackground = true;
+    ++iBackgroundCount;
+    iForegroundRss = GetProcessResidentBytes();
+
+    // Resources still released from the last period have nothing to give back.
+    std::vector<Releasable*> sorted;
+    for ( size_t i = 0; i < Resources.size(); ++i )
+        if ( !Resources[i]->IsReleased() )
+            sorted.push_back( Resources[i] );
+
+    std::sort(sorted.begin(), sorted.end(), LargerFirst());
+
+    iHeldBytes = 0;
+    for ( size_t i = 0; i < sorted.size(); ++i )
+        iHeldBytes += sorted[i]->GetResidentBytes();
+    iReleasedBytes = 0;
+
+    for ( size_t i = 0; i < sorted.size() && iHeldBytes - iReleasedBytes > iBudget; ++i ) {
+        size_t iBytes = sorted[i]->GetResidentBytes();
+        if ( iBytes == 0 )
+            break;
+
+        sorted[i]->OnRelease();
+        sorted[i]->bReleased = true;
+        iReleasedBytes += iBytes;
+    }
+
+    iBackgroundRss = GetProcessResidentBytes();
+
+    // Sampled last, so the release itself is not billed to the idle time.
+    iBackgroundStart = SDL_GetTicks();
+    dCpuStartMs = GetProcessCpuMs();
+}
+
+void Lifecycle::EnterForeground()
+{
+    if ( !bBackground )
+        return;
+
+    bBackground = false;
+    iBackgroundMs += SDL_GetTicks() - iBackgroundStart;
+    dBackgroundCpuMs += GetProcessCpuMs() - dCpuStartMs;
+}
+
+void Lifecycle::Report(FILE* pFile) const
+{
+    if ( iBackgroundCount == 0 )
+        return;
+
+    fprintf(pFile, "background: %u ms over %d periods, cpu %.2f %%\n",
+            iBackgroundMs, iBackgroundCount,
+            iBackgroundMs > 0 ? dBackgroundCpuMs * 100.0 / iBackgroundMs : 0.0);
+    fprintf(pFile, "background: released %u of %u kB (budget %u kB), rss %u kB -> %u kB, %u kB resident again\n",
+            (unsigned)(iReleasedBytes / 1024), (unsigned)(iHeldBytes / 1024), (unsigned)(iBudget / 1024),
+            (unsigned)(iForegroundRss / 1024), (unsigned)(iBackgroundRss / 1024),
+            (unsigned)(GetResidentBytes() / 1024));
+}
+
+size_t GetProcessResidentBytes()
+{
+#if defined(__linux__)
+    FILE* pFile = fopen("/proc/self/statm", "r");
+    if ( !pFile )
+        return 0;
+
+    unsigned long lSize = 0, lResident = 0;
+    int iRead = fscanf(pFile, "%lu %lu", &lSize, &lResident);
+    fclose(pFile);
+
+    return iRead == 2 ? (size_t)lResident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+double GetProcessCpuMs()
+{
+#if defined(LIFECYCLE_POSIX)
+    struct rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) != 0 )
+        return 0.0;
+
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000.0
+         + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1000.0;
+#else
+    return 0.0;
+#endif
+}
@@ -0,0 +1,261 @@
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PARTICLES_SSE 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PARTICLES_NEON 1
+#endif
+
+#include "Particles.h"
+
+namespace {
+
+/** Resizes to n zeroed elements, giving the old memory back. **/
+template <class T>
+void Reallocate(std::vector<T>& values, size_t n)
+{
+    std::vector<T>(n, T()).swap(values);
+}
+
+}
+
+ParticlePool::ParticlePool()
+    : iCount(0), iCapacity(0), iReleasedCapacity(0), iSeed(0x2545F491u)
+{
+    Gravity[0] = 0.0f;
+    Gravity[1] = 200.0f;
+    SetCapacity(0);
+}
+
+void ParticlePool::SetCapacity(int iMax)
+{
+    // Room for whole groups of four, the kernels never run past the arrays.
+    size_t iPadded = (size_t)((iMax + 3) & ~3);
+    if ( iPadded == 0 )
+        iPadded = 4;
+
+    Reallocate(X, iPadded);    Reallocate(Y, iPadded);
+    Reallocate(VX, iPadded);   Reallocate(VY, iPadded);
+    Reallocate(Life, iPadded);
+    Reallocate(InvLifetime, iPadded);
+    Reallocate(Fade, iPadded);
+    Reallocate(Color, iPadded);
+
+    iCapacity = iMax;
+    iCount = 0;
+}
+
+void ParticlePool::Clear()
+{
+    iCount = 0;
+}
+
+size_t ParticlePool::GetResidentBytes() const
+{
+    // The padding group left by SetCapacity(0) is not worth releasing again.
+    if ( IsReleased() )
+        return 0;
+
+    return X.size() * 8 * sizeof(float);
+}
+
+void ParticlePool::OnRelease()
+{
+    // A second release would lose the capacity to restore.
+    if ( IsReleased() )
+        return;
+
+    int iMax = iCapacity;
+    SetCapacity(0);
+    iReleasedCapacity = iMax;
+}
+
+bool ParticlePool::OnRestore()
+{
+    SetCapacity(iReleasedCapacity);
+    return true;
+}
+
+void ParticlePool::SetGravity(float x, float y)
+{
+    Gravity[0] = x;
+    Gravity[1] = y;
+}
+
+bool ParticlePool::Spawn(float x, float y, float fVelocityX, float fVelocityY, float fLifetime, Uint32 iColor)
+{
+    // A pool released in the background comes back with its first new particle.
+    if ( iCount >= iCapacity && IsReleased() )
+        EnsureResident();
+
+    if ( iCount >= iCapacity || fLifetime <= 0.0f )
+        return false;
+
+    int i = iCount++;
+    X[i] = x;               Y[i] = y;
+    VX[i] = fVelocityX;     VY[i] = fVelocityY;
+    Life[i]         = fLifetime;
+    InvLifetime[i]  = 1.0f / fLifetime;
+    Fade[i]         = 1.0f;
+    Color[i]        = iColor;
+    return true;
+}
+
+/** xorshift32 mapped to [-1, 1]. **/
+float ParticlePool::Random()
+{
+    iSeed ^= iSeed << 13;
+    iSeed ^= iSeed >> 17;
+    iSeed ^= iSeed << 5;
+    return (float)(iSeed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+int ParticlePool::Emit(int iParticles, float x, float y, float fSpeed, float fLifetime, Uint32 iColor)
+{
+    int iAdded = 0;
+
+    for ( ; iAdded < iParticles; ++iAdded ) {
+        float fVelocityX = Random() * fSpeed;
+        float fVelocityY = Random() * fSpeed;
+        float fLife = fLifetime * (0.75f + 0.25f * Random());
+
+        if ( !Spawn(x, y, fVelocityX, fVelocityY, fLife, iColor) )
+            break;
+    }
+    return iAdded;
+}
+
+void ParticlePool::Update(float fSeconds)
+{
+#if defined(PARTICLES_SSE)
+    const __m128 dt = _mm_set1_ps(fSeconds);
+    const __m128 gx = _mm_set1_ps(Gravity[0] * fSeconds);
+    const __m128 gy = _mm_set1_ps(Gravity[1] * fSeconds);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for ( int i = 0; i < iCount; i += 4 ) {
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(&VX[i]), gx);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(&VY[i]), gy);
+        _mm_storeu_ps(&VX[i], vx);
+        _mm_storeu_ps(&VY[i], vy);
+
+        _mm_storeu_ps(&X[i], _mm_add_ps(_mm_loadu_ps(&X[i]), _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(&Y[i], _mm_add_ps(_mm_loadu_ps(&Y[i]), _mm_mul_ps(vy, dt)));
+
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(&Life[i]), dt);
+        _mm_storeu_ps(&Life[i], life);
+        __m128 fade = _mm_mul_ps(life, _mm_loadu_ps(&InvLifetime[i]));
+        _mm_storeu_ps(&Fade[i], _mm_min_ps(_mm_max_ps(fade, zero), one));
+    }
+
+    Compact();
+#elif defined(PARTICLES_NEON)
+    const float32x4_t dt = vdupq_n_f32(fSeconds);
+    const float32x4_t gx = vdupq_n_f32(Gravity[0] * fSeconds);
+    const float32x4_t gy = vdupq_n_f32(Gravity[1] * fSeconds);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    for ( int i = 0; i < iCount; i += 4 ) {
+        float32x4_t vx = vaddq_f32(vld1q_f32(&VX[i]), gx);
+        float32x4_t vy = vaddq_f32(vld1q_f32(&VY[i]), gy);
+        vst1q_f32(&VX[i], vx);
+        vst1q_f32(&VY[i], vy);
+
+        vst1q_f32(&X[i], vmlaq_f32(vld1q_f32(&X[i]), vx, dt));
+        vst1q_f32(&Y[i], vmlaq_f32(vld1q_f32(&Y[i]), vy, dt));
+
+        float32x4_t life = vsubq_f32(vld1q_f32(&Life[i]), dt);
+        vst1q_f32(&Life[i], life);
+        float32x4_t fade = vmulq_f32(life, vld1q_f32(&InvLifetime[i]));
+        vst1q_f32(&Fade[i], vminq_f32(vmaxq_f32(fade, zero), one));
+    }
+
+    Compact();
+#else
+    UpdateScalar(fSeconds);
+#endif
+}
+
+void ParticlePool::UpdateScalar(float fSeconds)
+{
+    float gx = Gravity[0] * fSeconds, gy = Gravity[1] * fSeconds;
+
+    for ( int i = 0; i < iCount; ++i ) {
+        VX[i] += gx;
+        VY[i] += gy;
+        X[i] += VX[i] * fSeconds;
+        Y[i] += VY[i] * fSeconds;
+
+        Life[i] -= fSeconds;
+        float fFade = Life[i] * InvLifetime[i];
+        Fade[i] = fFade < 0.0f ? 0.0f : (fFade > 1.0f ? 1.0f : fFade);
+    }
+
+    Compact();
+}
+
+/** Swap-remove: the last live particle fills the slot of each dead one. **/
+void ParticlePool::Compact()
+{
+    int i = 0;
+
+    while ( i < iCount ) {
+        if ( Life[i] > 0.0f ) {
+            ++i;
+            continue;
+        }
+
+        int iLast = --iCount;
+        X[i] = X[iLast];    Y[i] = Y[iLast];
+        VX[i] = VX[iLast];  VY[i] = VY[iLast];
+        Life[i]         = Life[iLast];
+        InvLifetime[i]  = InvLifetime[iLast];
+        Fade[i]         = Fade[iLast];
+        Color[i]        = Color[iLast];
+    }
+}
+
+void ParticleSystem::Update(Registry&, const int& iElapsedTime)
+{
+    Pool.EnsureResident();
+    Pool.Update(iElapsedTime * 0.001f);
+}
+
+/** Blends one pixel per particle; other than 32-bit surfaces are skipped. **/
+void ParticleSystem::Render(Registry&, SDL_Surface* pDestSurface)
+{
+    const SDL_PixelFormat* pFormat = pDestSurface->format;
+    if ( pFormat->BytesPerPixel != 4 )
+        return;
+
+    const float* pX = Pool.GetX();
+    const float* pY = Pool.GetY();
+    const float* pFade = Pool.GetFade();
+    const Uint32* pColor = Pool.GetColor();
+
+    for ( int i = 0; i < Pool.GetCount(); ++i ) {
+        int x = (int)pX[i], y = (int)pY[i];
+        if ( x < 0 || y < 0 || x >= pDestSurface->w || y >= pDestSurface->h )
+            continue;
+
+        const Uint8* pRGBA = (const Uint8*)&pColor[i];
+        int iAlpha = (int)(pRGBA[3] * pFade[i]) + 1;
+
+        Uint32* pPixel = (Uint32*)((Uint8*)pDestSurface->pixels + y * pDestSurface->pitch) + x;
+        Uint32 iDest = *pPixel;
+
+        int r = (iDest & pFormat->Rmask) >> pFormat->Rshift;
+        int g = (iDest & pFormat->Gmask) >> pFormat->Gshift;
+        int b = (iDest & pFormat->Bmask) >> pFormat->Bshift;
+
+        r += ((pRGBA[0] - r) * iAlpha) >> 8;
+        g += ((pRGBA[1] - g) * iAlpha) >> 8;
+        b += ((pRGBA[2] - b) * iAlpha) >> 8;
+
+        *pPixel = (iDest & pFormat->Amask) | ((Uint32)r << pFormat->Rshift)
+                | ((Uint32)g << pFormat->Gshift) | ((Uint32)b << pFormat->Bshift);
+    }
+}
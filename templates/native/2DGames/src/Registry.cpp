@@ -0,0 +1,91 @@
+
+#include "Registry.h"
+
+/** Hands out one id per component type, in order of first use. **/
+int NextComponentTypeId()
+{
+    static int iNextId = 0;
+    return iNextId++;
+}
+
+/** Default constructor. **/
+Registry::Registry()
+{
+    iAliveCount = 0;
+}
+
+/**
+ * Destructor
+ */
+Registry::~Registry()
+{
+    for ( size_t i = 0; i < Pools.size(); ++i )
+        delete Pools[i];
+}
+
+/** Creates a new entity, recycling a free slot when one is available.
+    @return The handle of the new entity, or NULL_ENTITY if all slots are in use.
+**/
+Entity Registry::Create()
+{
+    Uint32 iIndex;
+
+    if ( !FreeSlots.empty() ) {
+        iIndex = FreeSlots.back();
+        FreeSlots.pop_back();
+    } else {
+        if ( Generations.size() > ENTITY_INDEX_MASK )
+            return NULL_ENTITY;
+
+        iIndex = (Uint32)Generations.size();
+        Generations.push_back(0);
+    }
+
+    ++iAliveCount;
+    return (Generations[iIndex] << ENTITY_INDEX_BITS) | iIndex;
+}
+
+/** Destroys an entity and all of its components.
+    @remark Handles to the entity become stale; IsAlive() returns false for them.
+**/
+void Registry::Destroy(Entity e)
+{
+    if ( !IsAlive(e) )
+        return;
+
+    Uint32 iIndex = EntityIndex(e);
+
+    for ( size_t i = 0; i < Pools.size(); ++i )
+        if ( Pools[i] )
+            Pools[i]->Remove(iIndex);
+
+    Generations[iIndex] = (Generations[iIndex] + 1) & ENTITY_GEN_MASK;
+    FreeSlots.push_back(iIndex);
+    --iAliveCount;
+}
+
+/** Checks if the handle refers to a live entity. **/
+bool Registry::IsAlive(Entity e) const
+{
+    Uint32 iIndex = EntityIndex(e);
+
+    return e != NULL_ENTITY
+        && iIndex < Generations.size()
+        && Generations[iIndex] == EntityGeneration(e);
+}
+
+/** Destroys every entity. Existing handles become stale. **/
+void Registry::Clear()
+{
+    for ( size_t i = 0; i < Pools.size(); ++i )
+        if ( Pools[i] )
+            Pools[i]->Clear();
+
+    FreeSlots.clear();
+    for ( size_t i = 0; i < Generations.size(); ++i ) {
+        Generations[i] = (Generations[i] + 1) & ENTITY_GEN_MASK;
+        FreeSlots.push_back((Uint32)(Generations.size() - 1 - i));
+    }
+
+    iAliveCount = 0;
+}
@@ -0,0 +1,278 @@
+
+#include <algorithm>
+
+#include "SpatialHash.h"
+
+namespace {
+
+inline bool Overlaps(const SDL_Rect& a, const SDL_Rect& b)
+{
+    return a.x < b.x + b.w && b.x < a.x + a.w
+        && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+inline bool Contains(const SDL_Rect& r, int iX, int iY)
+{
+    return iX >= r.x && iX < r.x + r.w && iY >= r.y && iY < r.y + r.h;
+}
+
+}
+
+/** Default constructor. **/
+SpatialHash::SpatialHash(int iCellSize, int iBucketCount)
+{
+    int iBuckets = 1;
+    while ( iBuckets < iBucketCount )
+        iBuckets <<= 1;
+
+    this->iCellSize = iCellSize > 0 ? iCellSize : 64;
+    iBucketMask     = iBuckets - 1;
+    iQueryStamp     = 0;
+
+    Buckets.resize(iBuckets);
+}
+
+/** Grid cell of a coordinate, rounding towards negative infinity. **/
+int SpatialHash::CellOf(int iCoord) const
+{
+    return iCoord >= 0 ? iCoord / iCellSize : -((-iCoord - 1) / iCellSize) - 1;
+}
+
+int SpatialHash::BucketOf(int iCellX, int iCellY) const
+{
+    Uint32 h = (Uint32)iCellX * 73856093u ^ (Uint32)iCellY * 19349663u;
+    return (int)(h & (Uint32)iBucketMask);
+}
+
+/** Adds a body to the buckets of all cells its box touches. **/
+void SpatialHash::Link(int iBody)
+{
+    Body& b = Bodies[iBody];
+
+    b.iCellX0 = CellOf(b.box.x);
+    b.iCellY0 = CellOf(b.box.y);
+    b.iCellX1 = CellOf(b.box.x + (b.box.w > 0 ? b.box.w - 1 : 0));
+    b.iCellY1 = CellOf(b.box.y + (b.box.h > 0 ? b.box.h - 1 : 0));
+
+    for ( int cy = b.iCellY0; cy <= b.iCellY1; ++cy ) {
+        for ( int cx = b.iCellX0; cx <= b.iCellX1; ++cx ) {
+            std::vector<int>& bucket = Buckets[BucketOf(cx, cy)];
+
+            //Two cells of a large body may hash to the same bucket.
+            if ( std::find(bucket.begin(), bucket.end(), iBody) == bucket.end() )
+                bucket.push_back(iBody);
+        }
+    }
+}
+
+/** Removes a body from the buckets it was linked into. **/
+void SpatialHash::Unlink(int iBody)
+{
+    const Body& b = Bodies[iBody];
+
+    for ( int cy = b.iCellY0; cy <= b.iCellY1; ++cy ) {
+        for ( int cx = b.iCellX0; cx <= b.iCellX1; ++cx ) {
+            std::vector<int>& bucket = Buckets[BucketOf(cx, cy)];
+
+            //Swap remove; a body is linked at most once per bucket.
+            for ( size_t i = 0; i < bucket.size(); ++i ) {
+                if ( bucket[i] == iBody ) {
+                    bucket[i] = bucket.back();
+                    bucket.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+Uint32 SpatialHash::NextStamp()
+{
+    if ( ++iQueryStamp == 0 ) {
+        for ( size_t i = 0; i < Bodies.size(); ++i )
+            Bodies[i].iStamp = 0;
+        iQueryStamp = 1;
+    }
+    return iQueryStamp;
+}
+
+/** Adds a body.
+    @param box The bounding box in screen coordinates.
+    @param iUserData A value handed back by GetUserData(), e.g. an Entity.
+    @return The id of the new body.
+**/
+int SpatialHash::Insert(const SDL_Rect& box, Uint32 iUserData)
+{
+    int iBody;
+
+    if ( !FreeBodies.empty() ) {
+        iBody = FreeBodies.back();
+        FreeBodies.pop_back();
+    } else {
+        iBody = (int)Bodies.size();
+        Bodies.push_back(Body());
+    }
+
+    Body& b     = Bodies[iBody];
+    b.box       = box;
+    b.iUserData = iUserData;
+    b.iStamp    = 0;
+    b.bAlive    = true;
+
+    Link(iBody);
+    return iBody;
+}
+
+/** Moves or resizes a body.
+    @remark Only relinks the body when the set of touched cells changes.
+**/
+void SpatialHash::Move(int iBody, const SDL_Rect& box)
+{
+    if ( !IsValid(iBody) )
+        return;
+
+    Body& b = Bodies[iBody];
+
+    if ( CellOf(box.x) == b.iCellX0 && CellOf(box.y) == b.iCellY0
+      && CellOf(box.x + (box.w > 0 ? box.w - 1 : 0)) == b.iCellX1
+      && CellOf(box.y + (box.h > 0 ? box.h - 1 : 0)) == b.iCellY1 ) {
+        b.box = box;
+        return;
+    }
+
+    Unlink(iBody);
+    b.box = box;
+    Link(iBody);
+}
+
+/** Removes a body. Its id may be reused by a later Insert(). **/
+void SpatialHash::Remove(int iBody)
+{
+    if ( !IsValid(iBody) )
+        return;
+
+    Unlink(iBody);
+    Bodies[iBody].bAlive = false;
+    FreeBodies.push_back(iBody);
+}
+
+/** Removes all bodies. **/
+void SpatialHash::Clear()
+{
+    for ( size_t i = 0; i < Buckets.size(); ++i )
+        Buckets[i].clear();
+
+    Bodies.clear();
+    FreeBodies.clear();
+}
+
+bool SpatialHash::IsValid(int iBody) const
+{
+    return iBody >= 0 && iBody < (int)Bodies.size() && Bodies[iBody].bAlive;
+}
+
+SDL_Rect SpatialHash::GetBox(int iBody) const
+{
+    return Bodies[iBody].box;
+}
+
+Uint32 SpatialHash::GetUserData(int iBody) const
+{
+    return Bodies[iBody].iUserData;
+}
+
+/** Finds the bodies containing a point, e.g. the mouse position.
+    @param out Receives the body ids; it is not cleared first.
+    @return The number of bodies found.
+**/
+size_t SpatialHash::QueryPoint(int iX, int iY, std::vector<int>& out)
+{
+    const std::vector<int>& bucket = Buckets[BucketOf(CellOf(iX), CellOf(iY))];
+    size_t iFound = 0;
+
+    for ( size_t i = 0; i < bucket.size(); ++i ) {
+        if ( Contains(Bodies[bucket[i]].box, iX, iY) ) {
+            out.push_back(bucket[i]);
+            ++iFound;
+        }
+    }
+
+    return iFound;
+}
+
+/** Finds the bodies overlapping a rectangle.
+    @param out Receives the body ids; it is not cleared first.
+    @return The number of bodies found.
+**/
+size_t SpatialHash::QueryRect(const SDL_Rect& rect, std::vector<int>& out)
+{
+    Uint32 iStamp = NextStamp();
+    size_t iFound = 0;
+
+    int iCellX0 = CellOf(rect.x);
+    int iCellY0 = CellOf(rect.y);
+    int iCellX1 = CellOf(rect.x + (rect.w > 0 ? rect.w - 1 : 0));
+    int iCellY1 = CellOf(rect.y + (rect.h > 0 ? rect.h - 1 : 0));
+
+    for ( int cy = iCellY0; cy <= iCellY1; ++cy ) {
+        for ( int cx = iCellX0; cx <= iCellX1; ++cx ) {
+            const std::vector<int>& bucket = Buckets[BucketOf(cx, cy)];
+
+            for ( size_t i = 0; i < bucket.size(); ++i ) {
+                Body& b = Bodies[bucket[i]];
+                if ( b.iStamp == iStamp || !Overlaps(b.box, rect) )
+                    continue;
+
+                b.iStamp = iStamp;
+                out.push_back(bucket[i]);
+                ++iFound;
+            }
+        }
+    }
+
+    return iFound;
+}
+
+/** Enumerates every pair of overlapping bodies exactly once.
+    @param out Receives the pairs; it is not cleared first.
+    @return The number of pairs found.
+    @remark A pair sharing several cells is reported only from the cell that
+            holds the top left corner of the overlap, so no pair set is needed.
+**/
+size_t SpatialHash::FindPairs(std::vector<BodyPair>& out)
+{
+    size_t iFound = 0;
+
+    for ( int a = 0; a < (int)Bodies.size(); ++a ) {
+        const Body& ba = Bodies[a];
+        if ( !ba.bAlive )
+            continue;
+
+        for ( int cy = ba.iCellY0; cy <= ba.iCellY1; ++cy ) {
+            for ( int cx = ba.iCellX0; cx <= ba.iCellX1; ++cx ) {
+                const std::vector<int>& bucket = Buckets[BucketOf(cx, cy)];
+
+                for ( size_t i = 0; i < bucket.size(); ++i ) {
+                    int b = bucket[i];
+                    if ( b <= a )
+                        continue;
+
+                    const Body& bb = Bodies[b];
+                    if ( !Overlaps(ba.box, bb.box) )
+                        continue;
+
+                    int iLeft = ba.box.x > bb.box.x ? ba.box.x : bb.box.x;
+                    int iTop  = ba.box.y > bb.box.y ? ba.box.y : bb.box.y;
+                    if ( CellOf(iLeft) != cx || CellOf(iTop) != cy )
+                        continue;
+
+                    BodyPair pair = { a, b };
+                    out.push_back(pair);
+                    ++iFound;
+                }
+            }
+        }
+    }
+
+    return iFound;
+}
@@ -0,0 +1,86 @@
+
+#include "System.h"
+#include "Components.h"
+
+namespace {
+
+struct Integrate
+{
+    float fSeconds;
+
+    void operator()(Entity, Velocity& v, Position& p)
+    {
+        p.x += v.dx * fSeconds;
+        p.y += v.dy * fSeconds;
+    }
+};
+
+struct Blit
+{
+    SDL_Surface* pDest;
+
+    void operator()(Entity, Sprite& s, Position& p)
+    {
+        if ( !s.pSurface )
+            return;
+
+        SDL_Rect dest = { (int)p.x, (int)p.y, 0, 0 };
+        const SDL_Rect* pClip = ( s.clip.w > 0 && s.clip.h > 0 ) ? &s.clip : 0;
+
+        SDL_BlitSurface(s.pSurface, pClip, pDest, &dest);
+    }
+};
+
+struct SyncBodies
+{
+    SpatialHash* pHash;
+
+    void operator()(Entity e, Collider& c, Position& p)
+    {
+        SDL_Rect box = { (int)p.x, (int)p.y, c.w, c.h };
+
+        if ( pHash->IsValid(c.iBody) && pHash->GetUserData(c.iBody) == e )
+            pHash->Move(c.iBody, box);
+        else
+            c.iBody = pHash->Insert(box, e);
+    }
+};
+
+}
+
+/** Moves every entity that has both a Velocity and a Position. **/
+void MovementSystem::Update(Registry& registry, const int& iElapsedTime)
+{
+    Integrate fn = { iElapsedTime * 0.001f };
+
+    registry.Each<Velocity, Position>(fn);
+}
+
+/** Draws every entity that has both a Sprite and a Position. **/
+void SpriteSystem::Render(Registry& registry, SDL_Surface* pDestSurface)
+{
+    Blit fn = { pDestSurface };
+
+    registry.Each<Sprite, Position>(fn);
+}
+
+/** Links new colliders, moves existing ones and removes stale bodies. **/
+void CollisionSystem::Update(Registry& registry, const int& iElapsedTime)
+{
+    ComponentPool<Collider>& colliders = registry.Pool<Collider>();
+
+    for ( int i = 0; i < Hash.Capacity(); ++i ) {
+        if ( !Hash.IsValid(i) )
+            continue;
+
+        Entity e = Hash.GetUserData(i);
+        Collider* pCollider = registry.IsAlive(e) ? colliders.Get(EntityIndex(e)) : 0;
+
+        if ( !pCollider || pCollider->iBody != i )
+            Hash.Remove(i);
+    }
+
+    SyncBodies fn = { &Hash };
+
+    registry.Each<Collider, Position>(fn);
+}
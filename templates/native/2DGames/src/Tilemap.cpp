@@ -0,0 +1,338 @@
+
+#include "Tilemap.h"
+#include "CpuDispatch.h"
+
+namespace {
+
+/** Division rounding towards negative infinity. **/
+inline int FloorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a - 1) / b) - 1;
+}
+
+}
+
+/** Default constructor. **/
+Tilemap::Tilemap()
+{
+    iWidth = iHeight = iLayers = 0;
+    iTileSize       = 0;
+    iChunkTiles     = 1;
+    iChunksX        = iChunksY = 0;
+    iChunkBudget    = TILEMAP_CHUNK_BUDGET;
+    iBackground     = 0;
+
+    pTileset        = 0;
+    pConverted      = 0;
+    pBlended        = 0;
+
+    iFrame          = 0;
+    iChunksBuilt    = 0;
+    iBlits          = 0;
+}
+
+Tilemap::~Tilemap()
+{
+    Release();
+}
+
+bool Tilemap::Create(int iWidth, int iHeight, int iLayers, SDL_Surface* pTileset, int iTileSize)
+{
+    Release();
+
+    if ( iWidth <= 0 || iHeight <= 0 || iLayers <= 0 || !pTileset || iTileSize <= 0 )
+        return false;
+
+    this->iWidth    = iWidth;
+    this->iHeight   = iHeight;
+    this->iLayers   = iLayers;
+    this->pTileset  = pTileset;
+    this->iTileSize = iTileSize;
+
+    iChunkTiles = TILEMAP_CHUNK_PIXELS / iTileSize > 0 ? TILEMAP_CHUNK_PIXELS / iTileSize : 1;
+    iChunksX    = ( iWidth + iChunkTiles - 1 ) / iChunkTiles;
+    iChunksY    = ( iHeight + iChunkTiles - 1 ) / iChunkTiles;
+
+    Tiles.assign((size_t)iWidth * iHeight * iLayers, 0);
+    Slots.assign((size_t)iChunksX * iChunksY, -1);
+    return true;
+}
+
+void Tilemap::Release()
+{
+    OnRelease();
+    pTileset = 0;
+
+    Tiles.clear();
+    Slots.clear();
+    iWidth = iHeight = iLayers = 0;
+}
+
+void Tilemap::FreeCache()
+{
+    for ( size_t i = 0; i < Cache.size(); ++i ) {
+        SDL_FreeSurface(Cache[i].pSurface);
+        Slots[Cache[i].iChunk] = -1;
+    }
+    Cache.clear();
+}
+
+size_t Tilemap::GetResidentBytes() const
+{
+    size_t iBytes = pConverted ? (size_t)pConverted->pitch * pConverted->h : 0;
+    if ( pBlended )
+        iBytes += (size_t)pBlended->pitch * pBlended->h;
+
+    for ( size_t i = 0; i < Cache.size(); ++i )
+        iBytes += (size_t)Cache[i].pSurface->pitch * Cache[i].pSurface->h;
+
+    return iBytes;
+}
+
+/** Frees what Render() can rebuild; the tiles themselves are kept. **/
+void Tilemap::OnRelease()
+{
+    FreeCache();
+
+    if ( pConverted )
+        SDL_FreeSurface(pConverted);
+    pConverted = 0;
+
+    if ( pBlended )
+        SDL_FreeSurface(pBlended);
+    pBlended = 0;
+}
+
+bool Tilemap::OnRestore()
+{
+    return true;
+}
+
+void Tilemap::SetTile(int iLayer, int iX, int iY, Uint16 iTile)
+{
+    if ( iLayer < 0 || iLayer >= iLayers || iX < 0 || iY < 0 || iX >= iWidth || iY >= iHeight )
+        return;
+
+    Uint16& iOld = Tiles[((size_t)iLayer * iHeight + iY) * iWidth + iX];
+    if ( iOld == iTile )
+        return;
+    iOld = iTile;
+
+    int iSlot = Slots[( iY / iChunkTiles ) * iChunksX + iX / iChunkTiles];
+    if ( iSlot >= 0 )
+        Cache[iSlot].bDirty = true;
+}
+
+Uint16 Tilemap::GetTile(int iLayer, int iX, int iY) const
+{
+    if ( iLayer < 0 || iLayer >= iLayers || iX < 0 || iY < 0 || iX >= iWidth || iY >= iHeight )
+        return 0;
+
+    return Tiles[((size_t)iLayer * iHeight + iY) * iWidth + iX];
+}
+
+void Tilemap::SetBackground(Uint32 iColor)
+{
+    iBackground = iColor;
+
+    for ( size_t i = 0; i < Cache.size(); ++i )
+        Cache[i].bDirty = true;
+}
+
+void Tilemap::SetChunkBudget(int iChunks)
+{
+    iChunkBudget = iChunks > 0 ? iChunks : 1;
+
+    if ( (int)Cache.size() > iChunkBudget )
+        FreeCache();
+}
+
+/** Converts the tileset once to the format of the target, so tile blits are plain copies.
+    @remark The target format has no alpha; a tileset with alpha is also kept as ARGB8888 for the upper layers.
+**/
+void Tilemap::Prepare(SDL_Surface* pDestSurface)
+{
+    if ( pConverted && pConverted->format->format == pDestSurface->format->format )
+        return;
+
+    // Chunks made for another format would need a conversion on every blit.
+    OnRelease();
+
+    pConverted = SDL_ConvertSurface(pTileset, pDestSurface->format, 0);
+
+    if ( pConverted && pTileset->format->Amask ) {
+        pBlended = SDL_ConvertSurfaceFormat(pTileset, SDL_PIXELFORMAT_ARGB8888, 0);
+        if ( pBlended )
+            SDL_SetSurfaceBlendMode(pBlended, SDL_BLENDMODE_BLEND);
+    }
+}
+
+/** Cache slot of a map chunk, recycling the least recently drawn one when the budget is used up. **/
+int Tilemap::Acquire(int iChunk, SDL_Surface* pDestSurface)
+{
+    int iSlot = Slots[iChunk];
+
+    if ( iSlot < 0 ) {
+        for ( size_t i = 0; i < Cache.size(); ++i ) {
+            if ( (int)Cache.size() < iChunkBudget )
+                break;
+            if ( Cache[i].iLastUsed != iFrame && ( iSlot < 0 || Cache[i].iLastUsed < Cache[iSlot].iLastUsed ) )
+                iSlot = (int)i;
+        }
+
+        if ( iSlot >= 0 ) {
+            Slots[Cache[iSlot].iChunk] = -1;
+        } else {
+            // Below the budget, or every chunk is on screen this frame.
+            const SDL_PixelFormat* pFormat = pDestSurface->format;
+            int iSize = iChunkTiles * iTileSize;
+
+            Chunk chunk;
+            chunk.pSurface = SDL_CreateRGBSurface(0, iSize, iSize, pFormat->BitsPerPixel,
+                                                  pFormat->Rmask, pFormat->Gmask, pFormat->Bmask, 0);
+            if ( !chunk.pSurface )
+                return -1;
+
+            Cache.push_back(chunk);
+            iSlot = (int)Cache.size() - 1;
+        }
+
+        Cache[iSlot].iChunk = iChunk;
+        Cache[iSlot].bDirty = true;
+        Slots[iChunk] = iSlot;
+    }
+
+    Cache[iSlot].iLastUsed = iFrame;
+    return iSlot;
+}
+
+void Tilemap::BuildChunk(Chunk& chunk)
+{
+    int iX0 = ( chunk.iChunk % iChunksX ) * iChunkTiles;
+    int iY0 = ( chunk.iChunk / iChunksX ) * iChunkTiles;
+    int iX1 = iX0 + iChunkTiles < iWidth ? iX0 + iChunkTiles : iWidth;
+    int iY1 = iY0 + iChunkTiles < iHeight ? iY0 + iChunkTiles : iHeight;
+
+    FillSurface32(chunk.pSurface, 0, iBackground);
+
+    for ( int iLayer = 0; iLayer < iLayers; ++iLayer ) {
+        const Uint16* pLayer = &Tiles[(size_t)iLayer * iHeight * iWidth];
+        SDL_Surface* pTiles = GetLayerTiles(iLayer);
+
+        for ( int y = iY0; y < iY1; ++y )
+            for ( int x = iX0; x < iX1; ++x )
+                DrawTile(pTiles, pLayer[(size_t)y * iWidth + x], chunk.pSurface, ( x - iX0 ) * iTileSize, ( y - iY0 ) * iTileSize);
+    }
+
+    chunk.bDirty = false;
+    ++iChunksBuilt;
+}
+
+/** Tiles of a layer: copied on the bottom layer, blended by their alpha above it. **/
+SDL_Surface* Tilemap::GetLayerTiles(int iLayer) const
+{
+    return iLayer > 0 && pBlended ? pBlended : pConverted;
+}
+
+void Tilemap::DrawTile(SDL_Surface* pTiles, Uint16 iTile, SDL_Surface* pDestSurface, int iX, int iY)
+{
+    int iColumns = pTiles->w / iTileSize;
+    int iIndex = iTile - 1;
+
+    if ( iTile == 0 || iColumns == 0 || iIndex >= iColumns * ( pTiles->h / iTileSize ) )
+        return;
+
+    SDL_Rect source = { ( iIndex % iColumns ) * iTileSize, ( iIndex / iColumns ) * iTileSize, iTileSize, iTileSize };
+    SDL_Rect dest = { iX, iY, 0, 0 };
+
+    if ( pTiles == pBlended )
+        BlendSurfaceARGB(pTiles, &source, pDestSurface, iX, iY);
+    else
+        SDL_BlitSurface(pTiles, &source, pDestSurface, &dest);
+    ++iBlits;
+}
+
+void Tilemap::Render(SDL_Surface* pDestSurface, int iScrollX, int iScrollY)
+{
+    if ( Tiles.empty() || !pDestSurface )
+        return;
+
+    EnsureResident();
+    Prepare(pDestSurface);
+    if ( !pConverted )
+        return;
+
+    ++iFrame;
+    iChunksBuilt = 0;
+    iBlits = 0;
+
+    int iChunkSize = iChunkTiles * iTileSize;
+    int iCX0 = FloorDiv(iScrollX, iChunkSize), iCX1 = FloorDiv(iScrollX + pDestSurface->w - 1, iChunkSize);
+    int iCY0 = FloorDiv(iScrollY, iChunkSize), iCY1 = FloorDiv(iScrollY + pDestSurface->h - 1, iChunkSize);
+
+    iCX0 = iCX0 > 0 ? iCX0 : 0;
+    iCY0 = iCY0 > 0 ? iCY0 : 0;
+    iCX1 = iCX1 < iChunksX ? iCX1 : iChunksX - 1;
+    iCY1 = iCY1 < iChunksY ? iCY1 : iChunksY - 1;
+
+    for ( int cy = iCY0; cy <= iCY1; ++cy ) {
+        for ( int cx = iCX0; cx <= iCX1; ++cx ) {
+            int iSlot = Acquire(cy * iChunksX + cx, pDestSurface);
+            if ( iSlot < 0 )
+                continue;
+
+            Chunk& chunk = Cache[iSlot];
+            if ( chunk.bDirty )
+                BuildChunk(chunk);
+
+            // Edge chunks are only partly covered by the map.
+            SDL_Rect source = { 0, 0, iChunkSize, iChunkSize };
+            if ( ( cx + 1 ) * iChunkTiles > iWidth )
+                source.w = ( iWidth - cx * iChunkTiles ) * iTileSize;
+            if ( ( cy + 1 ) * iChunkTiles > iHeight )
+                source.h = ( iHeight - cy * iChunkTiles ) * iTileSize;
+
+            SDL_Rect dest = { cx * iChunkSize - iScrollX, cy * iChunkSize - iScrollY, 0, 0 };
+            SDL_BlitSurface(chunk.pSurface, &source, pDestSurface, &dest);
+            ++iBlits;
+        }
+    }
+}
+
+void Tilemap::RenderUncached(SDL_Surface* pDestSurface, int iScrollX, int iScrollY)
+{
+    if ( Tiles.empty() || !pDestSurface )
+        return;
+
+    EnsureResident();
+    Prepare(pDestSurface);
+    if ( !pConverted )
+        return;
+
+    iChunksBuilt = 0;
+    iBlits = 0;
+
+    int iX0 = FloorDiv(iScrollX, iTileSize), iX1 = FloorDiv(iScrollX + pDestSurface->w - 1, iTileSize);
+    int iY0 = FloorDiv(iScrollY, iTileSize), iY1 = FloorDiv(iScrollY + pDestSurface->h - 1, iTileSize);
+
+    iX0 = iX0 > 0 ? iX0 : 0;
+    iY0 = iY0 > 0 ? iY0 : 0;
+    iX1 = iX1 < iWidth ? iX1 : iWidth - 1;
+    iY1 = iY1 < iHeight ? iY1 : iHeight - 1;
+
+    if ( iX0 > iX1 || iY0 > iY1 )
+        return;
+
+    SDL_Rect area = { iX0 * iTileSize - iScrollX, iY0 * iTileSize - iScrollY,
+                      ( iX1 - iX0 + 1 ) * iTileSize, ( iY1 - iY0 + 1 ) * iTileSize };
+    FillSurface32(pDestSurface, &area, iBackground);
+
+    for ( int iLayer = 0; iLayer < iLayers; ++iLayer ) {
+        const Uint16* pLayer = &Tiles[(size_t)iLayer * iHeight * iWidth];
+        SDL_Surface* pTiles = GetLayerTiles(iLayer);
+
+        for ( int y = iY0; y <= iY1; ++y )
+            for ( int x = iX0; x <= iX1; ++x )
+                DrawTile(pTiles, pLayer[(size_t)y * iWidth + x], pDestSurface, x * iTileSize - iScrollX, y * iTileSize - iScrollY);
+    }
+}
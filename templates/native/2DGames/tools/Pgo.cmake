@@ -0,0 +1,69 @@
+# ---
+# Profile guided and link time optimized builds (GCC).
+#
+# pgo_configure(<target>) applies the flags of the current PGO_PHASE:
+#   GENERATE    instrumented build, writes profiles to PGO_PROFILE_DIR
+#   USE         -fprofile-use from PGO_PROFILE_DIR, plus -flto
+#   BASELINE    the normal flags, for comparison
+# Include it after CMAKE_RUNTIME_OUTPUT_DIRECTORY is set: phase builds
+# redirect the package directory to <build dir>/bin, so the binary and its
+# resources stay inside the build tree.
+#
+# With -DPGO_LTO=ON it also adds the "pgo" target, which runs
+# tools/PgoBuild.cmake: build the baseline, build the instrumented binary,
+# train it for PGO_TRAINING_FRAMES frames with SDL_VIDEODRIVER=offscreen,
+# rebuild with the profile and LTO, time both builds on the same workload,
+# print the frame time delta and copy the optimized binary to the package
+# directory.
+
+option(PGO_LTO "Add the pgo target for a profile guided, link time optimized build" OFF)
+
+set(PGO_PHASE "" CACHE STRING "Phase of a profile guided build: GENERATE, USE, BASELINE or empty")
+set(PGO_PROFILE_DIR "${CMAKE_BINARY_DIR}/profile" CACHE PATH "Directory of the training profiles")
+set(PGO_TRAINING_FRAMES 600 CACHE STRING "Frames rendered by each training and timing run")
+set(PGO_TRAINING_ENV "${PGO_DEFAULT_TRAINING_ENV}" CACHE STRING "Extra VAR=value environment of the training runs, separated by spaces")
+set(PGO_RUNNER "" CACHE STRING "Command prefix that runs the binary on the target, e.g. an emulator; empty runs it here")
+
+set(PGO_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/PgoBuild.cmake")
+set(PGO_INSTALL_DIR "${CMAKE_RUNTIME_OUTPUT_DIRECTORY}")
+
+if(PGO_PHASE)
+    set(CMAKE_RUNTIME_OUTPUT_DIRECTORY "${CMAKE_BINARY_DIR}/bin")
+endif()
+
+function(pgo_configure TARGET)
+    if(PGO_PHASE STREQUAL "GENERATE")
+        set(FLAGS "-fprofile-generate -fprofile-dir=${PGO_PROFILE_DIR}")
+    elseif(PGO_PHASE STREQUAL "USE")
+        set(FLAGS "-fprofile-use -fprofile-dir=${PGO_PROFILE_DIR} -fprofile-correction -flto")
+    else()
+        set(FLAGS "")
+    endif()
+
+    if(PGO_PHASE AND NOT CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        MESSAGE( WARNING "Profile guided builds need GCC, ${CMAKE_CXX_COMPILER_ID} is not supported" )
+        set(FLAGS "")
+    endif()
+
+    if(FLAGS)
+        set_property(TARGET ${TARGET} APPEND_STRING PROPERTY COMPILE_FLAGS " ${FLAGS}")
+        set_property(TARGET ${TARGET} APPEND_STRING PROPERTY LINK_FLAGS " ${FLAGS}")
+    endif()
+
+    if(PGO_LTO AND NOT PGO_PHASE)
+        add_custom_target(pgo
+            COMMAND ${CMAKE_COMMAND}
+                -DPGO_SOURCE_DIR=${CMAKE_SOURCE_DIR}
+                -DPGO_WORK_DIR=${CMAKE_BINARY_DIR}/pgo
+                -DPGO_EXECUTABLE=${TARGET}
+                -DPGO_INSTALL_DIR=${PGO_INSTALL_DIR}
+                -DPGO_TRAINING_FRAMES=${PGO_TRAINING_FRAMES}
+                "-DPGO_TRAINING_ENV=${PGO_TRAINING_ENV}"
+                "-DPGO_RUNNER=${PGO_RUNNER}"
+                -DPGO_TOOLCHAIN_FILE=${CMAKE_TOOLCHAIN_FILE}
+                -P ${PGO_SCRIPT}
+            COMMENT "Building with profile guided and link time optimization"
+            VERBATIM
+        )
+    endif()
+endfunction()
@@ -0,0 +1,114 @@
+# ---
+# Driver of the "pgo" target (see Pgo.cmake), run with cmake -P.
+#
+# Builds <work dir>/baseline with the normal flags, then <work dir>/build
+# instrumented, trains it, and rebuilds that same tree with the profile and
+# LTO; GCC finds the profiles by object path, so both passes share a tree.
+# Both the baseline and the optimized binary then render the same fixed
+# number of frames, and the best average frame time of three runs is
+# compared.
+
+cmake_minimum_required(VERSION 3.1)
+
+foreach(VAR PGO_SOURCE_DIR PGO_WORK_DIR PGO_EXECUTABLE PGO_INSTALL_DIR PGO_TRAINING_FRAMES)
+    if(NOT DEFINED ${VAR})
+        message(FATAL_ERROR "PgoBuild.cmake needs -D${VAR}=...")
+    endif()
+endforeach()
+
+set(PGO_RUNS 3)
+set(PGO_PROFILE_DIR "${PGO_WORK_DIR}/profile")
+
+separate_arguments(TRAINING_ENV UNIX_COMMAND "${PGO_TRAINING_ENV}")
+separate_arguments(RUNNER UNIX_COMMAND "${PGO_RUNNER}")
+
+function(pgo_build DIR PHASE)
+    set(ARGS -DPGO_PHASE=${PHASE} -DPGO_PROFILE_DIR=${PGO_PROFILE_DIR} -DCMAKE_BUILD_TYPE=Release)
+    if(PGO_TOOLCHAIN_FILE)
+        list(APPEND ARGS -DCMAKE_TOOLCHAIN_FILE=${PGO_TOOLCHAIN_FILE})
+    endif()
+
+    file(MAKE_DIRECTORY ${DIR})
+    execute_process(COMMAND ${CMAKE_COMMAND} ${ARGS} ${PGO_SOURCE_DIR}
+                    WORKING_DIRECTORY ${DIR} RESULT_VARIABLE RESULT OUTPUT_QUIET)
+    if(RESULT EQUAL 0)
+        execute_process(COMMAND ${CMAKE_COMMAND} --build ${DIR} RESULT_VARIABLE RESULT OUTPUT_QUIET)
+    endif()
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "pgo: the ${PHASE} build in ${DIR} failed")
+    endif()
+endfunction()
+
+# Runs the binary headless for the training frame count; returns the best
+# "average frame" Base::Start() printed, in ms.
+function(pgo_run DIR RUNS RESULT_VAR)
+    set(BEST "")
+
+    foreach(RUN RANGE 1 ${RUNS})
+        execute_process(
+            COMMAND ${CMAKE_COMMAND} -E env SDL_VIDEODRIVER=offscreen BASE_FRAME_LIMIT=${PGO_TRAINING_FRAMES}
+                    ${TRAINING_ENV} ${RUNNER} ${DIR}/bin/${PGO_EXECUTABLE}
+            WORKING_DIRECTORY ${DIR}/bin
+            RESULT_VARIABLE RESULT
+            OUTPUT_VARIABLE OUTPUT
+            ERROR_VARIABLE ERRORS)
+
+        string(REGEX MATCH "average frame: ([0-9.]+) ms" MATCHED "${OUTPUT}")
+        if(NOT RESULT EQUAL 0 OR NOT MATCHED)
+            message(FATAL_ERROR "pgo: ${DIR}/bin/${PGO_EXECUTABLE} did not report its frames\n${OUTPUT}${ERRORS}")
+        endif()
+
+        set(MS ${CMAKE_MATCH_1})
+        if(BEST STREQUAL "" OR MS LESS BEST)
+            set(BEST ${MS})
+        endif()
+    endforeach()
+
+    set(${RESULT_VAR} ${BEST} PARENT_SCOPE)
+endfunction()
+
+message(STATUS "pgo: baseline build")
+pgo_build(${PGO_WORK_DIR}/baseline BASELINE)
+pgo_run(${PGO_WORK_DIR}/baseline ${PGO_RUNS} BASELINE_MS)
+
+message(STATUS "pgo: instrumented build and training run")
+file(REMOVE_RECURSE ${PGO_PROFILE_DIR})
+pgo_build(${PGO_WORK_DIR}/build GENERATE)
+pgo_run(${PGO_WORK_DIR}/build 1 TRAINING_MS)
+
+message(STATUS "pgo: optimized build")
+pgo_build(${PGO_WORK_DIR}/build USE)
+pgo_run(${PGO_WORK_DIR}/build ${PGO_RUNS} OPTIMIZED_MS)
+
+# CMake has no floating point math; scale to integer microseconds.
+foreach(VAR BASELINE_MS OPTIMIZED_MS)
+    string(REGEX MATCH "^([0-9]*)\\.?([0-9]*)$" MATCHED "${${VAR}}")
+    set(WHOLE "${CMAKE_MATCH_1}")
+    string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 FRACTION)
+    math(EXPR ${VAR}_US "0${WHOLE} * 1000 + 1${FRACTION} - 1000")
+endforeach()
+
+set(DELTA "n/a")
+if(BASELINE_MS_US GREATER 0)
+    math(EXPR PERMILLE "(${OPTIMIZED_MS_US} - ${BASELINE_MS_US}) * 1000 / ${BASELINE_MS_US}")
+    set(SIGN "+")
+    if(PERMILLE LESS 0)
+        set(SIGN "-")
+        math(EXPR PERMILLE "0 - ${PERMILLE}")
+    endif()
+    math(EXPR WHOLE "${PERMILLE} / 10")
+    math(EXPR FRACTION "${PERMILLE} % 10")
+    set(DELTA "${SIGN}${WHOLE}.${FRACTION} %")
+endif()
+
+set(REPORT "pgo: ${PGO_TRAINING_FRAMES} frames, best of ${PGO_RUNS} runs\n")
+set(REPORT "${REPORT}  baseline:      ${BASELINE_MS} ms per frame\n")
+set(REPORT "${REPORT}  pgo + lto:     ${OPTIMIZED_MS} ms per frame\n")
+set(REPORT "${REPORT}  delta:         ${DELTA} (instrumented training ran at ${TRAINING_MS} ms)\n")
+
+file(WRITE ${PGO_WORK_DIR}/report.txt "${REPORT}")
+message("${REPORT}")
+
+file(MAKE_DIRECTORY ${PGO_INSTALL_DIR})
+file(COPY ${PGO_WORK_DIR}/build/bin/${PGO_EXECUTABLE} DESTINATION ${PGO_INSTALL_DIR})
+message(STATUS "pgo: installed ${PGO_INSTALL_DIR}/${PGO_EXECUTABLE}")
@@ -4,9 +4,23 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <vector>
 
 #include "GLES2/gl2.h"
 #include "SDL.h"
+#include "FramePacer.h"
+#include "GpuTimer.h"
+#include "Input.h"
+#include "Latency.h"
+#include "Lifecycle.h"
+#include "Mesh.h"
+#include "Particles.h"
+#include "RenderQueue.h"
+#include "Replay.h"
+#include "SceneGraph.h"
+#include "SdfText.h"
+#include "Texture.h"
+#include "VertexLayout.h"
 
 /**
  *  The base class.
@@ -35,12 +49,132 @@ private:
     //Surface Area global variables.
     SDL_Surface* ScreenSurface;
     SDL_Window * window;
+    SDL_GLContext GLContext;
+
+    //Swap interval and frame pacing.
+    FramePacer  Pacer;
+
+    //GPU time of the scene, particle and text passes.
+    GpuTimer    GpuTime;
+
+    //Input seen during the current frame.
+    InputState Input;
+
+    //Input-to-present instrumentation.
+    LatencyTracker Latency;
+
+    //Frames rendered by the main loop, and the optional limit.
+    Uint32  iFrameIndex;
+    int     iFrameLimit;
+
+    //Inject a synthetic key press every this many frames, 0 to disable.
+    int     iInjectInterval;
+
+    //Deterministic input record and replay.
+    InputRecorder           Recorder;
+    InputReplayer           Replayer;
+    std::vector<SDL_Event>  ReplayEvents;
 
     int         Shader[2];              // We have a vertex & a fragment shader
     int         Program;                // Totalling one program
     float       Angle;                    // Rotation angle of our object
     float       Proj[4][4];             // Projection matrix
     int         iProj, iModel;          // Our 2 uniforms
+    int         iPositionScale, iPositionBias;
+
+    //Vertex format of the model and its buffers.
+    VertexLayout Layout;
+    GLuint      iVertexBuffer, iIndexBuffer;
+    int         iIndexCount;
+    float       PositionScale[3], PositionBias[3];
+
+    //Cooked model drawn instead of the built-in one when loaded.
+    Mesh        ModelMesh;
+
+    //Objects drawn by Display(), and the camera looking at them.
+    SceneGraph  Scene;
+    float       View[4][4];
+    std::vector<int> VisibleNodes;
+
+    //Draws of the frame, sorted to save state changes.
+    RenderQueue Queue;
+    long        lQueuedPackets;
+    long        lStateChanges;
+    long        lRedundantChanges;
+
+    //Distance field font and the strings queued by displayText() this frame.
+    SdfFont     Font;
+    TextBatch   Text;
+    bool        bFontTried;
+
+    //Sprites cooked into res/sprites.atlas and the ones queued by DrawSprite() this frame.
+    TextureAtlas Sprites;
+    SpriteBatch SpriteDraw;
+    bool        bSpritesTried;
+
+    //Text timings of frame limited runs.
+    long        lTextGlyphs;
+    double      dTextBuildMs, dTextFlushMs;
+
+    //Effects, updated with the frame time and drawn after the scene.
+    ParticlePool        Particles;
+    ParticleRenderer    ParticleDraw;
+
+    //Particle timings of frame limited runs.
+    long        lParticles;
+    double      dParticleUpdateMs, dParticleDrawMs;
+
+    //Background state and the resources released there.
+    Lifecycle   AppLifecycle;
+
+    //Benchmark modes selected by BASE_BENCH, 0 to skip each: draws per vertex
+    //layout, scene graph frames, pointer events per second, particles kept
+    //alive, HUD glyphs and time spent in the background.
+    int         iVertexBenchDraws;
+    int         iSceneBenchFrames;
+    int         iInputBenchRate;
+    int         iParticleBenchCount;
+    int         iTextBenchGlyphs;
+    int         iLifecycleBenchMs;
+
+    /**
+     * Benchmark modes, all in BaseBench.cpp. BASE_BENCH is a comma separated
+     * list of mode[=n], e.g. BASE_BENCH=particles=20000,text=500:
+     *     vertex[=draws]       BenchmarkVertexLayouts() at start-up, default 100
+     *     scene[=frames]       BenchmarkSceneGraph() of 10000 nodes at start-up,
+     *                          default 100
+     *     input[=Hz]           BenchmarkInput(n, 600) at start-up, default 1000
+     *     particles[=n]        BenchmarkParticles(n, 100) at start-up, then
+     *                          n particles kept alive, default 10000
+     *     text[=glyphs]        a HUD of that many glyphs every frame, default 2000
+     *     lifecycle[=ms]       CheckLifecycle() at start-up, then the background
+     *                          for ms after 30 frames, default 2000
+     * Frame limited and replay runs print the per frame averages.
+     */
+    void        ParseBenchmarks     (const char* czModes);
+    void        RunBenchmarks       ();
+    void        UpdateBenchmarks    ();
+    void        ReportBenchmarks    ();
+
+    //Sends a particle pool through two background periods in a row and
+    //checks that it still emits; false and a message on stderr if not.
+    bool        CheckLifecycle      ();
+
+    //Loads the font on the first displayText(); false if it is unavailable.
+    bool        LoadFont();
+
+    //Loads the sprite atlas on the first DrawSprite(); false if there is none.
+    bool        LoadSprites();
+
+    //Queues the benchmark HUD of iGlyphs characters, changing every frame.
+    void        AddTextBench(int iGlyphs);
+
+    //Rotation around the Y axis, pushed back along Z.
+    static void RotateModel(float Model[4][4], float Angle);
+
+    //Packs the model, subdivided iLevels times, into new buffers; returns the index count.
+    int         UploadModel(const VertexLayout& layout, int iLevels, GLuint& iVertices, GLuint& iIndices,
+                            float pScale[3], float pBias[3]);
 
 protected:
 
@@ -56,11 +190,21 @@ protected:
     //Handle the key events from keyboard.
     void HandleInput();
 
+    //Feed the recorded events of the current frame.
+    void HandleReplayInput();
+
     void HandleEvent(const SDL_Event &event);
 
+    //Follow the app and window events that move the app to or from the background.
+    void HandleLifecycleEvent(const SDL_Event &event);
+
+    //Pause the loop and release resources, or resume it.
+    void EnterBackground();
+    void EnterForeground();
+
 public:
     Base();
-    ~Base();
+    virtual ~Base();
 
     void Init();
     void Start();
@@ -74,6 +218,12 @@ public:
 
     /**
      * Displays the custom message on screen based on the defined font and size.
+     * Text is drawn from a distance field atlas of res/arial.ttf, generated on
+     * the first call and cached in the preference path, and every string of a
+     * frame goes into one draw after GLRenderer(). The strings are dropped
+     * after that draw, so queue them every frame, e.g. from FPSCounter().
+     * BASE_BENCH=text=n adds a HUD of n glyphs to every frame and prints the
+     * build and draw times.
      */
     void        displayText    (const char* czText,
                             int size,
@@ -81,40 +231,194 @@ public:
                             int fR, int fG, int fB,
                             int bR, int bG, int bB);
 
+    /**
+     * Queues a sprite of res/sprites, by its file name without extension, at
+     * x, y in window pixels and fScale times its size. The sprites are cooked
+     * into res/sprites.atlas at build time, loaded on the first call, and
+     * every sprite of a frame goes into one draw after GLRenderer(), under
+     * the text. Like the text they are dropped after that draw.
+     * @return false if there is no atlas or no such sprite.
+     */
+    bool        DrawSprite     (const char* czName, int x, int y, float fScale = 1.0f);
+
+    //The cooked sprite atlas, empty until the first DrawSprite().
+    TextureAtlas& GetSprites   ();
+
+    //Always NULL: the window is drawn with OpenGL ES, draw in GLRenderer() instead.
     SDL_Surface* GetSurface    ();
 
     int             GetFPS        ();
 
+    /**
+     * Present policy: vsync (the default), adaptive vsync, uncapped or a
+     * cap in Hz, also set by BASE_PRESENT_MODE=vsync|adaptive|uncapped|<Hz>.
+     * A frame that would miss its refresh is skipped and started again just
+     * in time for the next one, except in replays.
+     * @return false if the mode is not supported; adaptive falls back to vsync.
+     */
+    bool            SetPresentMode    (PresentMode eMode, int iCapHz = 0);
+
+    //Frames shown more than half a refresh late, and frames skipped, since Init().
+    Uint32          GetMissedFrames   ();
+    Uint32          GetSkippedFrames  ();
+
+    /**
+     * Measures the GPU time of the scene, particle and text passes, also
+     * enabled by BASE_GPU_TIMER. Frame limited and replay runs print the
+     * average of each pass. Needs GL_EXT_disjoint_timer_query; debug builds
+     * without it time the passes with glFinish(), which stalls every pass.
+     * @return false if GPU time cannot be measured in this build.
+     */
+    bool            EnableGpuTimer    ();
+    const GpuTimer& GetGpuTimer       ();
+
+    /**
+     * Input state of the current frame: pointer position, summed relative
+     * motion, buttons and keys, plus the raw and dispatched event counts.
+     */
+    const InputState& GetInputState ();
+
+    /**
+     * Queues a synthetic pointer stream of iRateHz motion events per second,
+     * a 60th of it per frame, for iFrames frames, and prints the dispatch
+     * time and callbacks per frame of HandleInput() next to one HandleEvent()
+     * per polled event. Also run at start-up when BASE_BENCH=input=Hz is set.
+     */
+    void        BenchmarkInput  (int iRateHz, int iFrames);
+
+    /**
+     * Input-to-present latency measurement. Also enabled by setting the
+     * BASE_LATENCY environment variable; BASE_LATENCY_INJECT=n injects a key
+     * press every n frames and BASE_FRAME_LIMIT=n ends the loop after n frames,
+     * so the mode can run headless with SDL_VIDEODRIVER=dummy.
+     */
+    void        EnableLatencyTracking   (bool bEnable);
+    const LatencyTracker& GetLatencyTracker ();
+
+    void        SetFrameLimit   (int iFrames);
+    void        InjectEvent     (const SDL_Event& event);
+
+    /**
+     * Input record and replay for reproducible performance runs. Replays
+     * advance the frame time and the model rotation by the recorded step
+     * per frame. Also set by the BASE_RECORD and BASE_REPLAY environment
+     * variables.
+     */
+    bool        RecordInput     (const char* czPath);
+    bool        ReplayInput     (const char* czPath);
+
+    /**
+     * Vertex format used for the model, e.g. VertexLayout(VERTEX_POSITION_HALF,
+     * VERTEX_NORMAL_PACKED). Set it before InitializeShader(); formats the GPU
+     * cannot fetch fall back to the nearest supported one. Also set by the
+     * BASE_VERTEX_LAYOUT environment variable, e.g. "short,packed,ubyte".
+     */
+    void        SetVertexLayout (const VertexLayout& layout);
+    const VertexLayout& GetVertexLayout ();
+
+    /**
+     * Loads a mesh cooked by tools/meshcook as the model Display() spins
+     * when the scene is empty; scene nodes keep the built-in model.
+     * InitializeShader() loads res/models/model.mesh when the template has
+     * res/models/model.obj. Needs a current GL context.
+     * @return false if the mesh could not be loaded; the built-in model stays.
+     */
+    bool        LoadMesh        (const char* czPath);
+
+    /**
+     * Prints the bytes per vertex and the draw throughput of every layout,
+     * drawing a subdivided model iDraws times each. Also run at start-up when
+     * BASE_BENCH=vertex=n is set.
+     */
+    void        BenchmarkVertexLayouts  (int iDraws);
+
+    /**
+     * Objects drawn by Display(). Each node is drawn with the model at its
+     * world matrix when its bounding sphere is inside the view frustum; an
+     * empty scene shows the spinning model.
+     */
+    SceneGraph& GetScene        ();
+    void        SetView         (const float V[4][4]);
+
+    /**
+     * Draw packets added here are sorted with the scene nodes and submitted
+     * by the next Display(). Frame limited and replay runs print the average
+     * state changes made and avoided per frame.
+     */
+    RenderQueue& GetRenderQueue ();
+
+    /**
+     * Runs a scene of iNodes nodes with moving subtrees and an orbiting
+     * camera for iFrames frames and prints the nodes updated and culled and
+     * the CPU time per frame. Also run at start-up when BASE_BENCH=scene=n
+     * is set, with 10000 nodes.
+     */
+    void        BenchmarkSceneGraph     (int iNodes, int iFrames);
+
+    /**
+     * Particles updated every frame and drawn as points in one draw call;
+     * frames without live particles skip both. The pool holds no particles
+     * until its capacity is set with SetCapacity(). BASE_BENCH=particles=n
+     * keeps n particles alive, prints the update and draw time per frame in
+     * frame limited runs, and first runs BenchmarkParticles(n, 100).
+     */
+    ParticlePool& GetParticles  ();
+
+    /**
+     * Background handling. When the app is minimized or sent to the
+     * background the loop sleeps in SDL_WaitEvent() and the registered
+     * resources are released down to the budget, set in bytes with
+     * SetBudget() or in kB by BASE_BACKGROUND_BUDGET; they come back on
+     * their next use. The font atlas, the sprite atlas and the particle pool
+     * are registered; register other textures and sounds of the game too.
+     * BASE_BENCH=lifecycle=ms sends the app to the background after 30
+     * frames for that long and reports its CPU use and memory.
+     */
+    Lifecycle&  GetLifecycle  ();
+
+    /**
+     * Prints the update time per frame of iParticles particles with the
+     * SIMD kernel and with the scalar one.
+     */
+    void        BenchmarkParticles      (int iParticles, int iFrames);
+
     //Addition data initialized during the application launch can be implemented here.
-    void CustomInitialize    () {}
+    virtual void CustomInitialize    () {}
 
     //Updates the frame rate counter
-    void FPSCounter        ( const int& iElapsedTime ) {}
+    virtual void FPSCounter        ( const int& iElapsedTime ) {}
+
+    // Handles rendering with OpenGL ES, after the scene and the particles and before the text
+    virtual void GLRenderer        () {}
 
-    // Handles rendering
-    void SurfaceRenderer        ( SDL_Surface* pDestSurface ) {}
+    /**
+     * Deprecated: override GLRenderer() instead. Still called just before
+     * GLRenderer() so older games keep building, but pDestSurface is always
+     * NULL since the window is drawn with OpenGL ES.
+     */
+    virtual void SurfaceRenderer        ( SDL_Surface* pDestSurface ) {}
 
     /**
      * Additional allocated data that should be cleaned up.
      */
-    void End        () {}
+    virtual void End        () {}
 
     /**
      * Window is active again.
      */
-    void WindowActive    () {}
+    virtual void WindowActive    () {}
 
     /**
      * Window is inactive.
      */
-    void WindowInactive    () {}
+    virtual void WindowInactive    () {}
 
 
     //Key released from keyboard
-    void KeyReleased (const int& iKeyEnum) {}
+    virtual void KeyReleased (const int& iKeyEnum) {}
 
     //Key pressed from keyboard
-    void KeyPressed    (const int& iKeyEnum) {}
+    virtual void KeyPressed    (const int& iKeyEnum) {}
 
     void Persp(float Proj[4][4], const float FOV, const float ZNear, const float ZFar);
 
@@ -134,7 +438,7 @@ public:
      *
      */
 
-    void OnMouseButtonReleased    (const int& iButton,
+    virtual void OnMouseButtonReleased    (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
@@ -149,7 +453,7 @@ public:
      * @param iRelY    The mouse position on the Y-axis relative to the last position, in pixels.
      *
     **/
-    void OnMouseButtonPressed    (const int& iButton,
+    virtual void OnMouseButtonPressed    (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
@@ -166,7 +470,7 @@ public:
      *
      * @bug The iButton variable is always NULL.
      */
-    void MousePointerPosition        (const int& iButton,
+    virtual void MousePointerPosition        (const int& iButton,
                      const int& iX,
                      const int& iY,
                      const int& iRelX,
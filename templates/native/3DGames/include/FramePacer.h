@@ -0,0 +1,107 @@
+
+#ifndef FRAMEPACER_H_
+#define FRAMEPACER_H_
+
+#include "SDL.h"
+
+/**
+ * How finished frames are shown.
+ */
+enum PresentMode
+{
+    PRESENT_VSYNC = 0,      // wait for the vertical blank, never tear
+    PRESENT_ADAPTIVE,       // wait for the blank, but tear instead of waiting a whole extra one when late
+    PRESENT_UNCAPPED,       // show at once, as fast as the frames are drawn
+    PRESENT_CAPPED          // show at once, but no more often than the cap rate
+};
+
+/**
+ * Sets the swap interval of a GL window and paces its frames.
+ *
+ * Frames are due on a grid of slots, one per refresh (or per cap period),
+ * following the time the last frame was shown. BeginFrame() predicts the
+ * end of the frame from the running average of the previous ones; when it
+ * lands after the next slot the frame would be shown late anyway, so it is
+ * skipped and the pacer waits until the frame can start just in time for
+ * the slot after, with fresher input. Frames shown more than half a slot
+ * after their slot count as missed.
+ */
+class FramePacer
+{
+private:
+    SDL_Window*     pWindow;
+    PresentMode     eMode;
+    int             iRateHz;
+    bool            bSkipLate;
+
+    //Performance counter ticks per slot, and per ms.
+    Uint64          iSlotTicks;
+    double          dTicksPerMs;
+
+    //Time of the last present, the slot it aimed at and the start of the current frame.
+    Uint64          iLastPresent;
+    Uint64          iTargetSlot;
+    Uint64          iFrameStart;
+
+    //Running average of the ticks from BeginFrame() to the swap.
+    double          dFrameTicks;
+
+    Uint32          iPresented;
+    Uint32          iMissed;
+    Uint32          iSkipped;
+
+    Uint64          NextSlot    (Uint64 iTime) const;
+    void            WaitUntil   (Uint64 iTime) const;
+
+public:
+    FramePacer();
+
+    /**
+     * Sets the swap interval for eMode on the current GL context of pWindow.
+     * iCapHz is the rate of PRESENT_CAPPED; the other modes pace at the
+     * refresh rate of the display.
+     * @return false if the mode is not supported; PRESENT_ADAPTIVE then
+     *         falls back to PRESENT_VSYNC.
+     */
+    bool            SetMode     (SDL_Window* pWindow, PresentMode eMode, int iCapHz = 0);
+
+    /**
+     * Skipping late frames is on by default. Turn it off for runs that must
+     * render every frame, e.g. input replays.
+     */
+    void            SetSkipLateFrames (bool bSkip) { bSkipLate = bSkip; }
+
+    /**
+     * Call before drawing a frame.
+     * @return false if the frame would miss its slot; do not draw it, handle
+     *         input and call BeginFrame() again.
+     */
+    bool            BeginFrame  ();
+
+    /**
+     * Swaps the window, after waiting for the slot in PRESENT_CAPPED.
+     */
+    void            Present     ();
+
+    PresentMode     GetMode     () const { return eMode; }
+
+    //Slots per second, 0 when uncapped.
+    int             GetRate     () const { return iRateHz; }
+
+    Uint32          GetPresentedFrames  () const { return iPresented; }
+    Uint32          GetMissedFrames     () const { return iMissed; }
+    Uint32          GetSkippedFrames    () const { return iSkipped; }
+
+    //Average time from BeginFrame() to the swap in ms.
+    double          GetFrameEstimateMs  () const { return dFrameTicks / dTicksPerMs; }
+};
+
+/**
+ * Reads "vsync", "adaptive", "uncapped" or a cap rate in Hz such as "30".
+ * @return false if czText is none of these.
+ */
+bool ParsePresentMode(const char* czText, PresentMode& eMode, int& iCapHz);
+
+const char* GetPresentModeName(PresentMode eMode);
+
+#endif /* FRAMEPACER_H_ */
@@ -0,0 +1,122 @@
+
+#ifndef GPUTIMER_H_
+#define GPUTIMER_H_
+
+#include <stdio.h>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+
+//Frames a result may take to come back before its queries are reused.
+const int GPU_TIMER_FRAMES      = 4;
+
+//Named passes per frame.
+const int GPU_TIMER_MAX_PASSES  = 16;
+
+/**
+ * How the GPU time of a pass is taken.
+ */
+enum GpuTimerSource
+{
+    GPU_TIMER_OFF = 0,      // not measured
+    GPU_TIMER_QUERY,        // GL_EXT_disjoint_timer_query, without stalls
+    GPU_TIMER_FINISH        // glFinish() around each pass, debug builds only
+};
+
+/**
+ * GPU time per named pass of a frame.
+ *
+ * With GL_EXT_disjoint_timer_query every Begin()/End() pair becomes a
+ * GL_TIME_ELAPSED_EXT query. The queries of a frame are read back
+ * GPU_TIMER_FRAMES frames later, from a ring of query sets, and only when
+ * the results are already available, so measuring never waits on the GPU.
+ * Results of frames during which the GPU reported a disjoint event (power
+ * state or context change) are dropped, as is the first frame.
+ *
+ * Without the extension, debug builds bracket each pass with glFinish().
+ * That stalls the pipeline and adds the CPU cost of the pass, so it only
+ * shows where the time goes; release builds then measure nothing.
+ *
+ * Passes must not nest and take a string literal as name.
+ */
+class GpuTimer
+{
+private:
+    struct Pass
+    {
+        const char* czName;
+        double      dTotalMs;
+        double      dLastMs;
+        Uint32      iSamples;
+    };
+
+    //The queries of one frame, and the pass each of them measured.
+    struct FrameQueries
+    {
+        GLuint  Queries[GPU_TIMER_MAX_PASSES];
+        int     Passes[GPU_TIMER_MAX_PASSES];
+        int     iCount;
+    };
+
+    GpuTimerSource  eSource;
+
+    Pass            Passes[GPU_TIMER_MAX_PASSES];
+    int             iPassCount;
+
+    FrameQueries    Ring[GPU_TIMER_FRAMES];
+    int             iRingIndex;
+
+    //Pass measured by the open Begin(), -1 if none, and its start for glFinish() timing.
+    int             iOpenPass;
+    Uint64          iFinishStart;
+
+    Uint32          iFrames;
+    Uint32          iDropped;
+    Uint32          iDisjoint;
+
+    int             FindPass    (const char* czName);
+    void            Collect     (FrameQueries& frame);
+    void            AddSample   (int iPass, double dMs);
+
+    GpuTimer(const GpuTimer&);
+    GpuTimer& operator=(const GpuTimer&);
+
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    /**
+     * Picks the timing source for the current GL context.
+     * @return false if GPU time cannot be measured in this build.
+     */
+    bool            Init        ();
+    void            Release     ();
+
+    /**
+     * Reads back the oldest frame of the ring and starts a new one.
+     */
+    void            BeginFrame  ();
+    void            EndFrame    ();
+
+    void            Begin       (const char* czPass);
+    void            End         ();
+
+    GpuTimerSource  GetSource   () const { return eSource; }
+
+    int             GetPassCount () const { return iPassCount; }
+    const char*     GetPassName  (int i) const { return Passes[i].czName; }
+
+    //Mean and latest GPU time of a pass in ms; the latest lags GPU_TIMER_FRAMES frames behind.
+    double          GetPassMs    (int i) const;
+    double          GetLastPassMs (int i) const { return Passes[i].dLastMs; }
+
+    /**
+     * Prints the mean time of every pass, and the frames whose results
+     * were dropped because they were late or disjoint.
+     */
+    void            Report      (FILE* pFile) const;
+};
+
+const char* GetGpuTimerSourceName(GpuTimerSource eSource);
+
+#endif /* GPUTIMER_H_ */
@@ -0,0 +1,71 @@
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+//Number of events pulled from the SDL queue per SDL_PeepEvents call.
+const int INPUT_BATCH_SIZE = 64;
+
+/**
+ * Snapshot of the input seen during one frame.
+ *
+ * Base::HandleInput() resets it at the start of every frame and feeds it
+ * every dispatched event, so games can poll it from the update hooks instead
+ * of (or in addition to) handling the callbacks.
+ */
+class InputState
+{
+private:
+
+    //SDL_GetTicks() when the frame started.
+    Uint32 iFrameTicks;
+
+    //SDL timestamp of the newest event in the frame, 0 if there was none.
+    Uint32 iLastEventTimestamp;
+
+    //Pointer state.
+    int     iMouseX;
+    int     iMouseY;
+    int     iMouseRelX;
+    int     iMouseRelY;
+    Uint32  iButtons;
+
+    //Key codes pressed / released during the frame and currently held.
+    std::vector<int> PressedKeys;
+    std::vector<int> ReleasedKeys;
+    std::vector<int> HeldKeys;
+
+    //Raw events pulled from SDL and events handed to the callbacks.
+    int iRawEvents;
+    int iRawMotionEvents;
+    int iDispatchedEvents;
+
+public:
+    InputState();
+
+    void    BeginFrame          (Uint32 iTicks);
+    void    CountRaw            (const SDL_Event& event);
+    void    Apply               (const SDL_Event& event);
+
+    Uint32  GetFrameTicks       () const { return iFrameTicks; }
+    Uint32  GetLastEventTime    () const { return iLastEventTimestamp; }
+
+    int     GetMouseX           () const { return iMouseX; }
+    int     GetMouseY           () const { return iMouseY; }
+    int     GetMouseRelX        () const { return iMouseRelX; }
+    int     GetMouseRelY        () const { return iMouseRelY; }
+    bool    IsButtonDown        (int iButton) const { return ( iButtons & SDL_BUTTON(iButton) ) != 0; }
+
+    bool    WasKeyPressed       (int iKeyEnum) const;
+    bool    WasKeyReleased      (int iKeyEnum) const;
+    bool    IsKeyDown           (int iKeyEnum) const;
+
+    int     GetRawEventCount    () const { return iRawEvents; }
+    int     GetRawMotionCount   () const { return iRawMotionEvents; }
+    int     GetDispatchedCount  () const { return iDispatchedEvents; }
+};
+
+#endif /* INPUT_H_ */
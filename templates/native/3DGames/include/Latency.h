@@ -0,0 +1,86 @@
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Millisecond histogram with 1 ms bins and one overflow bin.
+ */
+class LatencyHistogram
+{
+private:
+    static const int BIN_COUNT = 256;
+
+    Uint32  Bins[BIN_COUNT + 1];
+    Uint32  iCount;
+    Uint64  iSum;
+    Uint32  iMax;
+
+public:
+    LatencyHistogram();
+
+    void    Add         (Uint32 iMs);
+    void    Reset       ();
+
+    Uint32  Count       () const { return iCount; }
+    Uint32  Max         () const { return iMax; }
+    double  Mean        () const { return iCount ? (double)iSum / iCount : 0.0; }
+    Uint32  Percentile  (double dFraction) const;
+
+    void    Print       (FILE* pOut, const char* czLabel) const;
+    void    PrintBins   (FILE* pOut) const;
+};
+
+/**
+ * Follows input events from their SDL timestamp through dispatch, update,
+ * render and present, and collects the delay of each stage.
+ *
+ * Only events that start an action are tracked: key presses and mouse
+ * button presses. Base calls the On...() hooks; they do nothing unless the
+ * tracker is enabled.
+ */
+class LatencyTracker
+{
+private:
+
+    struct Sample
+    {
+        Uint32 iEventTime;
+        Uint32 iDispatchTime;
+    };
+
+    bool bEnabled;
+
+    //Events dispatched during the current frame.
+    std::vector<Sample> Pending;
+
+    Uint32 iUpdateTime;
+    Uint32 iRenderTime;
+
+    LatencyHistogram Dispatch;
+    LatencyHistogram Update;
+    LatencyHistogram Render;
+    LatencyHistogram Present;
+
+public:
+    LatencyTracker();
+
+    void    Enable      (bool bEnable);
+    bool    IsEnabled   () const { return bEnabled; }
+
+    void    OnEvent     (const SDL_Event& event);
+    void    OnUpdate    ();
+    void    OnRender    ();
+    void    OnPresent   ();
+
+    //Input-to-present latency of every tracked event.
+    const LatencyHistogram& GetPresentHistogram () const { return Present; }
+
+    void    Report      (FILE* pOut) const;
+};
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,117 @@
+
+#ifndef LIFECYCLE_H_
+#define LIFECYCLE_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * A resource that can be dropped while the app is in the background and
+ * rebuilt from its source afterwards, e.g. a GPU texture loaded from a file.
+ *
+ * The Lifecycle releases it; the owner calls EnsureResident() before using
+ * it, which restores it on the first use after the app came back.
+ */
+class Releasable
+{
+private:
+    friend class Lifecycle;
+
+    bool    bReleased;
+
+protected:
+
+    //Frees the resident copy; the source stays known for OnRestore().
+    virtual void    OnRelease   () = 0;
+
+    //Rebuilds the resident copy; false if that failed.
+    virtual bool    OnRestore   () = 0;
+
+public:
+    Releasable() : bReleased(false) {}
+    virtual ~Releasable() {}
+
+    //Bytes of memory the resource holds now, 0 when released.
+    virtual size_t  GetResidentBytes () const = 0;
+
+    /**
+     * Restores the resource if the Lifecycle released it.
+     * @return false if it is released and could not be restored.
+     */
+    bool    EnsureResident  ();
+
+    bool    IsReleased      () const { return bReleased; }
+};
+
+/**
+ * Foreground and background state of the app.
+ *
+ * Going to the background releases the registered resources, largest first,
+ * until the ones left fit into the memory budget. Nothing is restored when
+ * the app returns; every resource comes back on its next EnsureResident().
+ * The time, CPU time and resident set size of the process are sampled on
+ * both transitions for Report().
+ */
+class Lifecycle
+{
+private:
+    std::vector<Releasable*> Resources;
+
+    size_t  iBudget;
+    bool    bBackground;
+
+    int     iBackgroundCount;
+    Uint32  iBackgroundStart;
+    double  dCpuStartMs;
+
+    Uint32  iBackgroundMs;
+    double  dBackgroundCpuMs;
+    size_t  iHeldBytes, iReleasedBytes;
+    size_t  iForegroundRss, iBackgroundRss;
+
+public:
+    Lifecycle();
+
+    /**
+     * Adds a resource the background may release. The resource is not
+     * owned and must be unregistered before it is destroyed.
+     */
+    void    Register        (Releasable* pResource);
+    void    Unregister      (Releasable* pResource);
+
+    //Bytes the resources may keep in the background, 0 to release all of them.
+    void    SetBudget       (size_t iBytes);
+    size_t  GetBudget       () const { return iBudget; }
+
+    void    EnterBackground ();
+    void    EnterForeground ();
+
+    bool    IsBackground    () const { return bBackground; }
+
+    //Bytes held by the registered resources now.
+    size_t  GetResidentBytes () const;
+
+    //Time spent in the background so far, in ms.
+    Uint32  GetBackgroundMs () const { return iBackgroundMs; }
+
+    /**
+     * Prints the background time, its CPU use in percent of one core, the
+     * bytes released, the resident set size before and after the release and
+     * the bytes restored since, if the app has been in the background.
+     */
+    void    Report          (FILE* pFile) const;
+};
+
+/**
+ * Resident set size of this process in bytes, 0 where unknown.
+ */
+size_t  GetProcessResidentBytes ();
+
+/**
+ * User plus system CPU time of this process in ms, 0 where unknown.
+ */
+double  GetProcessCpuMs ();
+
+#endif /* LIFECYCLE_H_ */
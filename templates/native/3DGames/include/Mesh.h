@@ -0,0 +1,103 @@
+
+#ifndef MESH_H_
+#define MESH_H_
+
+#include <string>
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+
+/**
+ * Binary mesh blob written by tools/meshcook, little endian:
+ *
+ *   header      MESH_HEADER_SIZE bytes, see the MESH_HEADER_* word offsets
+ *   submeshes   submesh count x MESH_SUBMESH_SIZE bytes
+ *   vertices    16 byte aligned, vertex count x MESH_VERTEX_STRIDE bytes
+ *   indices     index count x 16-bit, local to their submesh
+ *
+ * A vertex is a normalized int16 position (x, y, z, unused), a normalized
+ * int8 normal (x, y, z, unused) and a normalized uint16 texture coordinate.
+ * Positions decode to [-1, 1] and texture coordinates to [0, 1]; the header
+ * holds the scale and bias that restore the model units.
+ */
+const Uint32 MESH_VERSION           = 1;
+const Uint32 MESH_VERTEX_STRIDE     = 16;
+const Uint32 MESH_HEADER_SIZE       = 76;
+const Uint32 MESH_SUBMESH_SIZE      = 48;
+const Uint32 MESH_NAME_SIZE         = 32;
+
+/**
+ * One material range. Its indices start at vertex iFirstVertex, which lets
+ * a mesh hold more than 65535 vertices without 32-bit indices.
+ */
+struct MeshSubmesh
+{
+    Uint32      iFirstIndex;
+    Uint32      iIndexCount;
+    Uint32      iFirstVertex;
+    Uint32      iVertexCount;
+    std::string material;
+};
+
+/**
+ * A cooked mesh in GL buffers.
+ *
+ * Load() maps the blob and hands the vertex and index sections straight to
+ * glBufferData; there is no parsing beyond the header.
+ */
+class Mesh
+{
+private:
+    GLuint  iVertexBuffer;
+    GLuint  iIndexBuffer;
+
+    Uint32  iVertexCount;
+    Uint32  iIndexCount;
+
+    //Restore model units: p = p' * scale + bias.
+    float   PositionScale[3];
+    float   PositionBias[3];
+    float   TexCoordScale[2];
+    float   TexCoordBias[2];
+
+    std::vector<MeshSubmesh> Submeshes;
+
+    Mesh(const Mesh&);
+    Mesh& operator=(const Mesh&);
+
+public:
+    Mesh();
+    ~Mesh();
+
+    /**
+     * Maps the blob and uploads its vertex and index sections.
+     * @return false if the file is missing, is not a version MESH_VERSION
+     *         blob, or has a submesh range past its vertices or indices.
+     */
+    bool    Load        (const char* czPath);
+    void    Release     ();
+
+    /**
+     * Binds the buffers and draws one submesh, or all of them with -1.
+     * Attribute locations below 0 are left alone.
+     */
+    void    Draw        (int iSubmesh, GLint iPosition, GLint iNormal, GLint iTexCoord) const;
+
+    /**
+     * Column-major matrix that restores model units from the quantized
+     * positions; multiply it into the model matrix.
+     */
+    void    GetDequantizeMatrix (float M[4][4]) const;
+
+    int                 GetSubmeshCount () const        { return (int)Submeshes.size(); }
+    const MeshSubmesh&  GetSubmesh      (int i) const   { return Submeshes[i]; }
+    Uint32              GetVertexCount  () const        { return iVertexCount; }
+    Uint32              GetIndexCount   () const        { return iIndexCount; }
+    const float*        GetPositionScale() const        { return PositionScale; }
+    const float*        GetPositionBias () const        { return PositionBias; }
+    const float*        GetTexCoordScale() const        { return TexCoordScale; }
+    const float*        GetTexCoordBias () const        { return TexCoordBias; }
+};
+
+#endif /* MESH_H_ */
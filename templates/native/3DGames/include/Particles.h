@@ -0,0 +1,122 @@
+
+#ifndef PARTICLES_H_
+#define PARTICLES_H_
+
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+#include "Lifecycle.h"
+
+/**
+ * Particles stored as a structure of arrays: one array per field, so the
+ * update kernel streams through memory four particles at a time with SSE or
+ * NEON. Dead particles are removed by moving the last one into their slot,
+ * which keeps the live particles packed at the front of every array.
+ * In the background the arrays are freed with the live particles; the
+ * capacity comes back on EnsureResident() or the next Spawn().
+ */
+class ParticlePool : public Releasable
+{
+private:
+    std::vector<float>  X, Y, Z;
+    std::vector<float>  VX, VY, VZ;
+
+    //Seconds left to live, and one over the lifetime for the fade.
+    std::vector<float>  Life, InvLifetime;
+
+    //Life left from 1 down to 0, scales the alpha of Color.
+    std::vector<float>  Fade;
+
+    //RGBA bytes in memory order.
+    std::vector<Uint32> Color;
+
+    int     iCount;
+    int     iCapacity;
+    int     iReleasedCapacity;
+    float   Gravity[3];
+    Uint32  iSeed;
+
+    float   Random      ();
+    void    Compact     ();
+
+protected:
+    void    OnRelease   ();
+    bool    OnRestore   ();
+
+public:
+    ParticlePool();
+
+    /**
+     * Sets the maximum number of live particles; drops the current ones.
+     */
+    void    SetCapacity (int iMax);
+    void    Clear       ();
+
+    void    SetGravity  (float x, float y, float z);
+
+    /**
+     * Adds a particle; false when the pool is full.
+     */
+    bool    Spawn       (const float Position[3], const float Velocity[3], float fLifetime, Uint32 iColor);
+
+    /**
+     * Adds up to iParticles particles at Origin flying in random directions
+     * at up to fSpeed. The random sequence is seeded, so replays match.
+     * @return The number of particles added.
+     */
+    int     Emit        (int iParticles, const float Origin[3], float fSpeed, float fLifetime, Uint32 iColor);
+
+    /**
+     * Integrates, ages and fades every particle, then removes the dead ones.
+     */
+    void    Update      (float fSeconds);
+    void    UpdateScalar(float fSeconds);
+
+    int     GetCount    () const { return iCount; }
+    int     GetCapacity () const { return iCapacity; }
+
+    size_t  GetResidentBytes () const;
+
+    const float*  GetX      () const { return &X[0]; }
+    const float*  GetY      () const { return &Y[0]; }
+    const float*  GetZ      () const { return &Z[0]; }
+    const float*  GetFade   () const { return &Fade[0]; }
+    const Uint32* GetColor  () const { return &Color[0]; }
+};
+
+/**
+ * Draws a ParticlePool as soft round points with one draw call.
+ *
+ * Every frame the vertex buffer is orphaned with glBufferData(NULL) before
+ * the arrays are copied in, so the driver hands out fresh storage instead of
+ * waiting for the GPU to finish reading the previous frame. The arrays go
+ * in unchanged, one attribute stream each, with no interleaving pass.
+ */
+class ParticleRenderer
+{
+private:
+    GLuint  iProgram;
+    GLuint  iBuffer;
+    GLint   iViewProj;
+    GLint   iPointSize;
+
+    ParticleRenderer(const ParticleRenderer&);
+    ParticleRenderer& operator=(const ParticleRenderer&);
+
+public:
+    ParticleRenderer();
+    ~ParticleRenderer();
+
+    //Needs a current GL context.
+    bool    Init        ();
+    void    Release     ();
+
+    /**
+     * Draws the live particles with additive blending.
+     * @param fPointSize    Diameter in pixels of a particle one unit in front of the camera.
+     */
+    void    Draw        (const ParticlePool& pool, const float ViewProj[4][4], float fPointSize);
+};
+
+#endif /* PARTICLES_H_ */
@@ -0,0 +1,113 @@
+
+#ifndef RENDERQUEUE_H_
+#define RENDERQUEUE_H_
+
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+#include "VertexLayout.h"
+
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE = 0,         // front to back, no blending
+    RENDER_PASS_BLENDED,            // back to front, alpha blending
+    RENDER_PASS_OVERLAY             // submission order, alpha blending, drawn last
+};
+
+/**
+ * One draw call with the state it needs. Buffers hold 16-bit indices laid
+ * out by pLayout; pPositionScale and pPositionBias feed the uniforms of the
+ * VERTEX_LAYOUT_SHADER_PRELUDE and may be NULL for float positions, which
+ * get a scale of 1 and a bias of 0.
+ */
+struct DrawPacket
+{
+    RenderPass          Pass;
+    GLuint              iProgram;
+    Uint16              iMaterial;      // caller defined, sorts packets sharing textures and colours
+    GLuint              iTexture;       // bound to unit 0, 0 for none
+
+    GLuint              iVertexBuffer;
+    GLuint              iIndexBuffer;
+    const VertexLayout* pLayout;
+    const float*        pPositionScale;
+    const float*        pPositionBias;
+
+    int                 iFirstIndex;
+    int                 iIndexCount;
+
+    float               fDepth;         // view space distance, positive in front of the camera
+    float               Model[4][4];    // column-major, loaded into the "Model" uniform
+};
+
+/**
+ * Counters of the last Submit(). Redundant changes are the binds a naive
+ * renderer setting every piece of state per packet would have made on top.
+ */
+struct RenderQueueStats
+{
+    int iPackets;
+    int iProgramChanges;
+    int iBufferChanges;
+    int iTextureChanges;
+    int iBlendChanges;
+    int iRedundantChanges;
+};
+
+/**
+ * Collects the draws of a frame, orders them by a 64-bit key and submits
+ * them with as few state changes as possible.
+ *
+ * Key, most significant first:
+ *   opaque   pass:2 | program:8 | material:16 | depth:24, near first
+ *   blended  pass:2 | depth:24, far first | program:8 | material:16
+ *   overlay  pass:2 | sequence:24
+ * The low bits of every key are the submission order, so equal keys keep it.
+ */
+class RenderQueue
+{
+private:
+    struct ProgramSlot
+    {
+        GLuint  iProgram;
+        GLint   iModel;
+        GLint   iPositionScale;
+        GLint   iPositionBias;
+    };
+
+    std::vector<DrawPacket>     Packets;
+    std::vector<Uint64>         Keys, SortedKeys;
+    std::vector<ProgramSlot>    Programs;
+
+    float               fFarDepth;
+    RenderQueueStats    Stats;
+
+    int     ProgramIndex    (GLuint iProgram);
+    void    Sort            ();
+
+public:
+    RenderQueue();
+
+    /**
+     * Depth that maps to the far end of the 24-bit key range, usually the
+     * far plane of the projection.
+     */
+    void    SetFarDepth     (float fFar) { fFarDepth = fFar; }
+
+    //Copies the packet into the queue.
+    void    Add             (const DrawPacket& packet);
+    void    Clear           ();
+
+    /**
+     * Sorts and draws every packet, then empties the queue. Uniforms other
+     * than Model, PositionScale and PositionBias must already be set on the
+     * programs.
+     */
+    void    Submit          ();
+
+    int                     GetCount    () const { return (int)Packets.size(); }
+    const RenderQueueStats& GetStats    () const { return Stats; }
+};
+
+#endif /* RENDERQUEUE_H_ */
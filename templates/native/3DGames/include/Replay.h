@@ -0,0 +1,86 @@
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Input recordings.
+ *
+ * A recording is a small header followed by one record per dispatched
+ * event. Each record stores the frame delta to the previous record as a
+ * variable length integer, a one byte event kind and a kind specific
+ * payload, all little endian. Only the fields the Base callbacks use are
+ * kept, so a minute of pointer input is a few kilobytes.
+ */
+
+const Uint32 REPLAY_MAGIC   = 0x43455242;   // "BREC"
+const Uint16 REPLAY_VERSION = 1;
+
+//Frame duration stored in new recordings: 60 frames per second.
+const Uint16 REPLAY_DEFAULT_STEP_MS = 16;
+
+/**
+ * Writes the dispatched events of every frame to a file.
+ */
+class InputRecorder
+{
+private:
+    SDL_RWops*  pFile;
+    Uint32      iLastFrame;
+
+    void        WriteVarint (Uint32 iValue);
+
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool        Open        (const char* czPath, Uint16 iStepMs);
+    void        Close       ();
+    bool        IsOpen      () const { return pFile != 0; }
+
+    void        Record      (Uint32 iFrame, const SDL_Event& event);
+};
+
+/**
+ * Reads a recording back frame by frame.
+ */
+class InputReplayer
+{
+private:
+    SDL_RWops*  pFile;
+    Uint16      iStepMs;
+
+    //The next record, read ahead so frames without events cost nothing.
+    bool        bHasNext;
+    Uint32      iNextFrame;
+    SDL_Event   Next;
+
+    bool        ReadVarint  (Uint32& iValue);
+    bool        ReadNext    ();
+
+public:
+    InputReplayer();
+    ~InputReplayer();
+
+    bool        Open        (const char* czPath);
+    void        Close       ();
+    bool        IsOpen      () const { return pFile != 0; }
+
+    //Fixed frame duration the recording was made for, in milliseconds.
+    Uint16      GetStepMs   () const { return iStepMs; }
+
+    //True once every record has been handed out.
+    bool        IsFinished  () const { return !bHasNext; }
+
+    /**
+     * Appends the events recorded for a frame.
+     * @param iFrame    The frame index; must not go backwards.
+     * @param events    Receives the events, stamped with the virtual time of the frame.
+     */
+    void        ReadFrame   (Uint32 iFrame, std::vector<SDL_Event>& events);
+};
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,99 @@
+
+#ifndef SCENEGRAPH_H_
+#define SCENEGRAPH_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Clip planes extracted from a projection (or projection * view) matrix,
+ * with the Gribb-Hartmann method. Plane i is a[i] x + b[i] y + c[i] z + d[i],
+ * normalized, positive inside.
+ */
+struct Frustum
+{
+    float a[6], b[6], c[6], d[6];
+
+    void FromMatrix(const float M[4][4]);
+};
+
+/**
+ * Flat scene graph.
+ *
+ * Nodes live in arrays and a parent is always stored before its children,
+ * so one front to back pass updates every world matrix. Only nodes that are
+ * dirty, or have a dirty ancestor, are recomputed. World bounding spheres
+ * are kept as separate x, y, z, radius arrays so Cull() tests four of them
+ * per plane with SSE or NEON.
+ *
+ * Matrices are column-major float[4][4], as used by Base::Persp().
+ */
+class SceneGraph
+{
+private:
+    struct Matrix
+    {
+        float m[4][4];
+    };
+
+    std::vector<int>    Parents;
+    std::vector<Matrix> Locals;
+    std::vector<Matrix> Worlds;
+    std::vector<Uint8>  Dirty;
+    std::vector<Uint8>  Visible;
+    std::vector<void*>  UserData;
+
+    //Bounding sphere in node space.
+    std::vector<float>  LocalBounds;
+
+    //World bounding spheres, padded to a multiple of four.
+    std::vector<float>  SphereX, SphereY, SphereZ, SphereR;
+
+    int iUpdated;
+    int iCulled;
+
+public:
+    SceneGraph();
+
+    /**
+     * Adds a node under iParent, or a root with -1.
+     * @return The node index, stable until Clear().
+     */
+    int     AddNode     (int iParent, void* pUserData = 0);
+    void    Clear       ();
+
+    void    SetLocal    (int iNode, const float M[4][4]);
+    void    SetBounds   (int iNode, float x, float y, float z, float fRadius);
+
+    /**
+     * Recomputes the world matrices and spheres of dirty subtrees.
+     */
+    void    Update      ();
+
+    /**
+     * Marks the nodes whose world sphere touches the frustum of ViewProj
+     * and appends them to pVisible when given.
+     * @return The number of visible nodes.
+     */
+    int     Cull        (const float ViewProj[4][4], std::vector<int>* pVisible = 0);
+
+    //Same test without SIMD, for comparison.
+    int     CullScalar  (const float ViewProj[4][4], std::vector<int>* pVisible = 0);
+
+    int             GetNodeCount    () const            { return (int)Parents.size(); }
+    int             GetParent       (int iNode) const   { return Parents[iNode]; }
+    const float*    GetWorld        (int iNode) const   { return &Worlds[iNode].m[0][0]; }
+    bool            IsVisible       (int iNode) const   { return Visible[iNode] != 0; }
+    void*           GetUserData     (int iNode) const   { return UserData[iNode]; }
+
+    //Nodes recomputed by the last Update() and rejected by the last Cull().
+    int             GetUpdatedCount () const            { return iUpdated; }
+    int             GetCulledCount  () const            { return iCulled; }
+
+    //R = A * B
+    static void     Multiply        (float R[4][4], const float A[4][4], const float B[4][4]);
+    static void     Identity        (float M[4][4]);
+};
+
+#endif /* SCENEGRAPH_H_ */
@@ -0,0 +1,147 @@
+
+#ifndef SDFTEXT_H_
+#define SDFTEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+#include "Lifecycle.h"
+
+const int SDF_FIRST_CHAR    = 32;
+const int SDF_LAST_CHAR     = 126;
+const int SDF_GLYPH_COUNT   = SDF_LAST_CHAR - SDF_FIRST_CHAR + 1;
+
+//Quads one TextBatch can draw per frame, bound by 16-bit indices.
+const int SDF_MAX_GLYPHS    = 16383;
+
+/**
+ * One glyph in the atlas, in atlas pixels at the base size. The offsets
+ * place the top left corner of the cell relative to the pen position at
+ * the top of the line.
+ */
+struct SdfGlyph
+{
+    int x, y, w, h;
+    int iOffsetX, iOffsetY;
+    int iAdvance;
+};
+
+/**
+ * Signed distance field atlas of the printable ASCII glyphs of a TTF font.
+ *
+ * The atlas is rendered once with SDL_ttf at a base size and cached to
+ * disk; later runs only read the cache. Each texel stores the distance to
+ * the glyph outline, 128 on the edge, so the glyphs stay sharp at any size.
+ * In the background only the texture is dropped; it is read back from the
+ * cache on EnsureResident().
+ */
+class SdfFont : public Releasable
+{
+private:
+    GLuint  iTexture;
+    int     iAtlasSize;
+    int     iBaseSize;
+    int     iSpread;
+    int     iLineSkip;
+
+    //Texel that is inside everywhere, used for solid rectangles.
+    int     iSolidX, iSolidY;
+
+    SdfGlyph Glyphs[SDF_GLYPH_COUNT];
+
+    //Arguments of the last Load(), to restore the texture.
+    std::string FontPath, CachePath;
+
+    bool    Generate    (const char* czFontPath, std::vector<Uint8>& atlas);
+    bool    ReadCache   (const char* czCachePath, Uint32 iFontSize, std::vector<Uint8>& atlas);
+    void    WriteCache  (const char* czCachePath, Uint32 iFontSize, const std::vector<Uint8>& atlas) const;
+
+    SdfFont(const SdfFont&);
+    SdfFont& operator=(const SdfFont&);
+
+protected:
+    void    OnRelease   ();
+    bool    OnRestore   ();
+
+public:
+    SdfFont();
+    ~SdfFont();
+
+    /**
+     * Loads the atlas from czCachePath, or renders it from czFontPath and
+     * writes the cache when the cache is missing or was made from another
+     * font file or size.
+     * @remark Needs TTF_Init() and a current GL context.
+     */
+    bool    Load        (const char* czFontPath, const char* czCachePath, int iBaseSize = 48);
+    void    Release     ();
+
+    const SdfGlyph* GetGlyph(char c) const;
+
+    GLuint  GetTexture  () const { return iTexture; }
+    int     GetAtlasSize() const { return iAtlasSize; }
+    int     GetBaseSize () const { return iBaseSize; }
+    int     GetSpread   () const { return iSpread; }
+    int     GetLineSkip () const { return iLineSkip; }
+    int     GetSolidX   () const { return iSolidX; }
+    int     GetSolidY   () const { return iSolidY; }
+
+    size_t  GetResidentBytes () const;
+};
+
+/**
+ * Batches every string of a frame into one vertex buffer and draws it with
+ * one call. Coordinates are window pixels, origin at the top left.
+ */
+class TextBatch
+{
+private:
+    struct Vertex
+    {
+        float   x, y;
+        Uint16  u, v;
+        Uint8   color[4];
+        float   fSoftness;
+    };
+
+    const SdfFont*  pFont;
+
+    GLuint  iProgram;
+    GLuint  iVertexBuffer;
+    GLuint  iIndexBuffer;
+    GLint   iScreen;
+
+    std::vector<Vertex> Vertices;
+
+    void    AddQuad     (float x0, float y0, float x1, float y1, int u0, int v0, int u1, int v1,
+                         const SDL_Color& color, float fSoftness);
+
+    TextBatch(const TextBatch&);
+    TextBatch& operator=(const TextBatch&);
+
+public:
+    TextBatch();
+    ~TextBatch();
+
+    bool    Init        (const SdfFont& font);
+    void    Release     ();
+
+    /**
+     * Queues a string at pixel size fSize, with a background rectangle when
+     * pBackground is not NULL.
+     * @return The width of the string in pixels.
+     */
+    float   Add         (const char* czText, float x, float y, float fSize,
+                         const SDL_Color& color, const SDL_Color* pBackground = 0);
+
+    /**
+     * Uploads the queued glyphs and draws them, then empties the batch.
+     */
+    void    Flush       (int iWidth, int iHeight);
+
+    int     GetGlyphCount () const { return (int)Vertices.size() / 4; }
+};
+
+#endif /* SDFTEXT_H_ */
@@ -0,0 +1,126 @@
+
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include <string>
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+#include "Lifecycle.h"
+
+/**
+ * Loads a KTX file into a new GL texture, uploading every stored mip level
+ * as is. ETC1 levels are passed to glCompressedTexImage2D; when the driver
+ * lacks GL_OES_compressed_ETC1_RGB8_texture they are decoded to RGB first.
+ *
+ * @param czPath    The .ktx file, as written by tools/assetcook.
+ * @param pWidth, pHeight    Receive the size of the base level, may be NULL.
+ * @return The texture name, or 0 on failure.
+ */
+GLuint LoadKTX(const char* czPath, int* pWidth, int* pHeight);
+
+/**
+ * Decodes ETC1 blocks into tightly packed RGB pixels.
+ */
+void DecodeETC1(const Uint8* pBlocks, int iWidth, int iHeight, Uint8* pRGB);
+
+/**
+ * One sprite inside an atlas.
+ */
+struct AtlasRegion
+{
+    std::string name;
+    int         x, y, w, h;     // pixels
+    float       u0, v0, u1, v1; // texture coordinates
+};
+
+/**
+ * A cooked sprite atlas: the texture plus the UV manifest written next to it.
+ * In the background only the texture is dropped; the regions stay valid and
+ * the texture is loaded again on EnsureResident().
+ */
+class TextureAtlas : public Releasable
+{
+private:
+    GLuint  iTexture;
+    int     iWidth;
+    int     iHeight;
+
+    std::vector<AtlasRegion> Regions;
+
+    //The manifest of the last Load(), to restore the texture.
+    std::string ManifestPath;
+
+    TextureAtlas(const TextureAtlas&);
+    TextureAtlas& operator=(const TextureAtlas&);
+
+protected:
+    void    OnRelease   ();
+    bool    OnRestore   ();
+
+public:
+    TextureAtlas();
+    ~TextureAtlas();
+
+    bool    Load        (const char* czManifestPath);
+    void    Release     ();
+
+    const AtlasRegion* Find (const char* czName) const;
+
+    GLuint  GetTexture  () const { return iTexture; }
+    int     GetWidth    () const { return iWidth; }
+    int     GetHeight   () const { return iHeight; }
+
+    //Bytes of the texture at 32 bits per texel; ETC1 atlases hold less.
+    size_t  GetResidentBytes () const;
+};
+
+//Sprites one SpriteBatch can draw per frame, bound by 16-bit indices.
+const int SPRITE_MAX_QUADS = 16383;
+
+/**
+ * Batches every sprite of a frame from one atlas into one vertex buffer and
+ * draws it with one call. Coordinates are window pixels, origin at the top
+ * left.
+ */
+class SpriteBatch
+{
+private:
+    struct Vertex
+    {
+        float   x, y;
+        float   u, v;
+    };
+
+    const TextureAtlas* pAtlas;
+
+    GLuint  iProgram;
+    GLuint  iVertexBuffer;
+    GLuint  iIndexBuffer;
+    GLint   iScreen;
+
+    std::vector<Vertex> Vertices;
+
+    SpriteBatch(const SpriteBatch&);
+    SpriteBatch& operator=(const SpriteBatch&);
+
+public:
+    SpriteBatch();
+    ~SpriteBatch();
+
+    bool    Init        (const TextureAtlas& atlas);
+    void    Release     ();
+
+    //Queues a region of the atlas at x, y, fScale times its size in pixels.
+    void    Add         (const AtlasRegion& region, float x, float y, float fScale = 1.0f);
+
+    /**
+     * Uploads the queued sprites and draws them, then empties the batch.
+     */
+    void    Flush       (int iWidth, int iHeight);
+
+    int     GetSpriteCount () const { return (int)Vertices.size() / 4; }
+};
+
+#endif /* TEXTURE_H_ */
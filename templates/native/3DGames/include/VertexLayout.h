@@ -0,0 +1,108 @@
+
+#ifndef VERTEXLAYOUT_H_
+#define VERTEXLAYOUT_H_
+
+#include <string>
+#include <vector>
+
+#include "GLES2/gl2.h"
+#include "SDL.h"
+
+enum VertexPositionFormat
+{
+    VERTEX_POSITION_FLOAT = 0,      // 3 x float, 12 bytes
+    VERTEX_POSITION_HALF,           // 4 x half float, 8 bytes, GL_OES_vertex_half_float
+    VERTEX_POSITION_SHORT           // 4 x normalized short with scale and bias, 8 bytes
+};
+
+enum VertexNormalFormat
+{
+    VERTEX_NORMAL_FLOAT = 0,        // 3 x float, 12 bytes
+    VERTEX_NORMAL_BYTE,             // 4 x normalized byte, 4 bytes
+    VERTEX_NORMAL_PACKED            // 10-10-10-2 normalized, 4 bytes, GL_OES_vertex_type_10_10_10_2
+};
+
+enum VertexColorFormat
+{
+    VERTEX_COLOR_NONE = 0,          // constant attribute
+    VERTEX_COLOR_FLOAT,             // 4 x float, 16 bytes
+    VERTEX_COLOR_UBYTE              // 4 x normalized unsigned byte, 4 bytes
+};
+
+//Attribute locations bound by shaders built on VERTEX_LAYOUT_SHADER_PRELUDE.
+const GLuint VERTEX_ATTRIB_POSITION = 0;
+const GLuint VERTEX_ATTRIB_NORMAL   = 1;
+const GLuint VERTEX_ATTRIB_COLOR    = 2;
+
+/**
+ * Vertex shader prelude shared by every layout. It declares the Position,
+ * Normal and Color attributes and DecodePosition(), which undoes the scale
+ * and bias of VERTEX_POSITION_SHORT; the other formats need no decoding
+ * because GL normalizes them while fetching.
+ */
+extern const char VERTEX_LAYOUT_SHADER_PRELUDE[];
+
+/**
+ * Describes how position, normal and colour are interleaved in a vertex
+ * buffer, packs float data into that layout and sets the attribute pointers.
+ */
+class VertexLayout
+{
+private:
+    VertexPositionFormat    Position;
+    VertexNormalFormat      Normal;
+    VertexColorFormat       Color;
+
+    int iStride;
+    int iNormalOffset;
+    int iColorOffset;
+
+    void Update();
+
+public:
+    VertexLayout(VertexPositionFormat position = VERTEX_POSITION_FLOAT,
+                 VertexNormalFormat normal = VERTEX_NORMAL_FLOAT,
+                 VertexColorFormat color = VERTEX_COLOR_NONE);
+
+    /**
+     * Parses "position,normal[,color]", e.g. "half,packed,ubyte".
+     * @return false if a name is unknown; the layout is left unchanged.
+     */
+    bool        Parse       (const char* czText);
+    std::string GetName     () const;
+
+    /**
+     * Whether the current GL context can fetch this layout, and the nearest
+     * layout it can: half floats become shorts and packed normals bytes.
+     */
+    bool            IsSupported () const;
+    VertexLayout    Supported   () const;
+
+    /**
+     * Interleaves iCount vertices into out. pNormals and pColors (RGBA) may
+     * be NULL. Short positions are stored relative to pScale and pBias, see
+     * ComputeBounds().
+     */
+    void        Pack        (int iCount, const float* pPositions, const float* pNormals, const float* pColors,
+                             const float pScale[3], const float pBias[3], std::vector<Uint8>& out) const;
+
+    /**
+     * Scale and bias that map the positions into the [-1, 1] cube, to pass
+     * to Pack() and to the PositionScale and PositionBias uniforms.
+     */
+    static void ComputeBounds(int iCount, const float* pPositions, float pScale[3], float pBias[3]);
+
+    /**
+     * Sets the attribute pointers for vertices starting at pBase (a pointer,
+     * or an offset into the bound GL_ARRAY_BUFFER). Layouts without colours
+     * disable the Color array so the constant attribute value is used.
+     */
+    void        Bind        (const void* pBase) const;
+
+    VertexPositionFormat    GetPositionFormat   () const { return Position; }
+    VertexNormalFormat      GetNormalFormat     () const { return Normal; }
+    VertexColorFormat       GetColorFormat      () const { return Color; }
+    int                     GetStride           () const { return iStride; }
+};
+
+#endif /* VERTEXLAYOUT_H_ */
@@ -1,4 +1,9 @@
 
+#include <map>
+#include <vector>
+
+#include "SDL_ttf.h"
+
 #include "Base.h"
 
 /** Default constructor. **/
@@ -10,6 +15,7 @@ Base::Base() {
 	cwindow_title 		= 0;
 
 	ScreenSurface 		= 0;
+	GLContext 			= 0;
 
 	iFPSTickCounter 	= 0;
 	iFPSCounter 		= 0;
@@ -19,11 +25,46 @@ Base::Base() {
 	bQuit 				= false;
 	window 				= 0;
 
+	iFrameIndex		= 0;
+	iFrameLimit		= 0;
+	iInjectInterval	= 0;
+
 	//OpenGL
 	Angle 		= 0.0;
 	iModel 		= 0;
 	Program 	= 0;
 	iProj 		= 0;
+	iPositionScale	= -1;
+	iPositionBias	= -1;
+	iVertexBuffer	= 0;
+	iIndexBuffer	= 0;
+	iIndexCount		= 0;
+	iVertexBenchDraws = 0;
+	iSceneBenchFrames = 0;
+	iInputBenchRate = 0;
+	lQueuedPackets	= 0;
+	lStateChanges	= 0;
+	lRedundantChanges = 0;
+	bFontTried		= false;
+	bSpritesTried	= false;
+	iParticleBenchCount = 0;
+	lParticles		= 0;
+	dParticleUpdateMs = 0.0;
+	dParticleDrawMs	= 0.0;
+	iTextBenchGlyphs = 0;
+	lTextGlyphs		= 0;
+	dTextBuildMs	= 0.0;
+	dTextFlushMs	= 0.0;
+	iLifecycleBenchMs = 0;
+
+	SceneGraph::Identity( View );
+	Layout		= VertexLayout( VERTEX_POSITION_SHORT, VERTEX_NORMAL_PACKED );
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		PositionScale[i]	= 1.0f;
+		PositionBias[i]		= 0.0f;
+	}
 }
 
 /**
@@ -31,6 +72,20 @@ Base::Base() {
  */
 Base::~Base() {
 
+	if ( GLContext )
+	{
+		Text.Release();
+		Font.Release();
+		SpriteDraw.Release();
+		Sprites.Release();
+		ModelMesh.Release();
+		ParticleDraw.Release();
+		GpuTime.Release();
+		glDeleteBuffers( 1, &iVertexBuffer );
+		glDeleteBuffers( 1, &iIndexBuffer );
+		SDL_GL_DeleteContext( GLContext );
+	}
+
 	//Closes the SDL before destruction.
 	SDL_Quit();
 }
@@ -62,27 +117,87 @@ void Base::Init()
 		exit( 1 );
 	}
 
+	// Initialize SDL_ttf library
+	TTF_Init();
+
+	// Close the SDL_ttf while application closes.
+	atexit( TTF_Quit );
+
 	//Create a window with the specified height and width.
 	ConfigureWindow( iwindow_width, iwindow_height );
 
-	window = SDL_CreateWindow("3D Game Framework!", 0, 0, iwindow_width, iwindow_height, SDL_WINDOWEVENT_SHOWN | SDL_WINDOW_FULLSCREEN);
-	ScreenSurface = SDL_GetWindowSurface(window);
+	// The window is drawn with OpenGL ES 2.0, it has no SDL surface.
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES );
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 2 );
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 0 );
+
+	window = SDL_CreateWindow("3D Game Framework!", 0, 0, iwindow_width, iwindow_height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN);
+	if ( window )
+		GLContext = SDL_GL_CreateContext(window);
 
 	// If we fail, return error.
-	if ( ScreenSurface == NULL )
+	if ( GLContext == NULL )
 	{
 		fprintf( stderr, "Unable to set up video: %s\n", SDL_GetError() );
 		exit( 1 );
 	}
 
+	SDL_GetWindowSize( window, &iwindow_width, &iwindow_height );
+	glViewport( 0, 0, iwindow_width, iwindow_height );
+
+	PresentMode eMode = PRESENT_VSYNC;
+	int iCapHz = 0;
+	if ( SDL_getenv("BASE_PRESENT_MODE") && !ParsePresentMode( SDL_getenv("BASE_PRESENT_MODE"), eMode, iCapHz ) )
+		fprintf( stderr, "Unknown present mode %s\n", SDL_getenv("BASE_PRESENT_MODE") );
+	SetPresentMode( eMode, iCapHz );
+
+	// Headless measurement switches, e.g. with SDL_VIDEODRIVER=dummy on CI.
+	if ( SDL_getenv("BASE_FRAME_LIMIT") )
+		SetFrameLimit( atoi( SDL_getenv("BASE_FRAME_LIMIT") ) );
+
+	if ( SDL_getenv("BASE_LATENCY") )
+		EnableLatencyTracking( true );
+
+	if ( SDL_getenv("BASE_LATENCY_INJECT") )
+		iInjectInterval = atoi( SDL_getenv("BASE_LATENCY_INJECT") );
+
+	if ( SDL_getenv("BASE_REPLAY") )
+		ReplayInput( SDL_getenv("BASE_REPLAY") );
+	else if ( SDL_getenv("BASE_RECORD") )
+		RecordInput( SDL_getenv("BASE_RECORD") );
+
+	if ( SDL_getenv("BASE_VERTEX_LAYOUT") && !Layout.Parse( SDL_getenv("BASE_VERTEX_LAYOUT") ) )
+		fprintf( stderr, "Unknown vertex layout %s\n", SDL_getenv("BASE_VERTEX_LAYOUT") );
+
+	if ( SDL_getenv("BASE_BENCH") )
+		ParseBenchmarks( SDL_getenv("BASE_BENCH") );
+
+	AppLifecycle.Register( &Font );
+	AppLifecycle.Register( &Sprites );
+	AppLifecycle.Register( &Particles );
+
+	if ( SDL_getenv("BASE_BACKGROUND_BUDGET") )
+		AppLifecycle.SetBudget( (size_t)atoi( SDL_getenv("BASE_BACKGROUND_BUDGET") ) * 1024 );
+
+	if ( SDL_getenv("BASE_GPU_TIMER") )
+		EnableGpuTimer();
+
 	CustomInitialize();
 }
 
 /** The main loop. **/
 void Base::Start()
 {
+	RunBenchmarks();
+
 	lLastTickValue = SDL_GetTicks();
 	bQuit = false;
+	iFrameIndex = 0;
+
+	// Replays render every frame, so runs stay comparable.
+	Pacer.SetSkipLateFrames( !Replayer.IsOpen() );
+
+	Uint32 iStartTicks = lLastTickValue;
 
 	// Main loop: loop forever.
 	while ( !bQuit )
@@ -96,33 +211,155 @@ void Base::Start()
 			SDL_Event event;
 			SDL_WaitEvent(&event);
 			HandleEvent(event);
-		} else {
+		} else if ( Pacer.BeginFrame() ) {
 			// Do some thinking
 			UpdateFPSCounter();
+			Latency.OnUpdate();
 
 			// Render stuff
 			UpdateSurface();
+
+			++iFrameIndex;
+
+			// Synthetic input and load of the benchmark modes
+			UpdateBenchmarks();
+
+			if ( iFrameLimit > 0 && iFrameIndex >= (Uint32)iFrameLimit )
+				bQuit = true;
+
+			if ( Replayer.IsOpen() && Replayer.IsFinished() )
+				bQuit = true;
 		}
 	}
 
+	Recorder.Close();
+
+	if ( ( iFrameLimit > 0 || Replayer.IsOpen() ) && iFrameIndex > 0 )
+	{
+		// Time in the background is not part of any frame.
+		Uint32 iElapsed = SDL_GetTicks() - iStartTicks - AppLifecycle.GetBackgroundMs();
+		printf( "frames: %u, elapsed: %u ms, average frame: %.3f ms\n",
+				iFrameIndex, iElapsed, (double)iElapsed / iFrameIndex );
+
+		printf( "present: %s at %d Hz, missed %u, skipped %u\n",
+				GetPresentModeName( Pacer.GetMode() ), Pacer.GetRate(),
+				Pacer.GetMissedFrames(), Pacer.GetSkippedFrames() );
+
+		if ( lQueuedPackets > 0 )
+			printf( "render queue: %.1f packets, %.1f state changes, %.1f avoided per frame\n",
+					(double)lQueuedPackets / iFrameIndex, (double)lStateChanges / iFrameIndex,
+					(double)lRedundantChanges / iFrameIndex );
+
+		ReportBenchmarks();
+
+		GpuTime.Report( stdout );
+	}
+
+	AppLifecycle.Report( stdout );
+
+	if ( Latency.IsEnabled() )
+		Latency.Report( stdout );
+
 	End();
 }
 
 /** Handles all controller inputs.
 	@remark This function is called once per frame.
+	@remark Events are pulled from SDL in batches. Runs of SDL_MOUSEMOTION are
+	        coalesced into a single MousePointerPosition() call carrying the last
+	        position and the summed relative motion.
 **/
 void Base::HandleInput()
 {
-	// Poll for events, and handle the ones we care about.
+	if ( Replayer.IsOpen() )
+	{
+		HandleReplayInput();
+		return;
+	}
+
+	Input.BeginFrame( SDL_GetTicks() );
+
+	// Fill the queue once, then drain it in batches.
+	SDL_PumpEvents();
+
+	SDL_Event events[INPUT_BATCH_SIZE];
+	SDL_Event motion;
+	bool bPendingMotion = false;
+	int iCount;
+
+	do
+	{
+		iCount = SDL_PeepEvents( events, INPUT_BATCH_SIZE, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT );
+
+		for ( int i = 0; i < iCount; ++i )
+		{
+			const SDL_Event& event = events[i];
+			Input.CountRaw(event);
+
+			if ( event.type == SDL_MOUSEMOTION )
+			{
+				if ( bPendingMotion )
+				{
+					motion.motion.timestamp = event.motion.timestamp;
+					motion.motion.state     = event.motion.state;
+					motion.motion.x         = event.motion.x;
+					motion.motion.y         = event.motion.y;
+					motion.motion.xrel     += event.motion.xrel;
+					motion.motion.yrel     += event.motion.yrel;
+				}
+				else
+				{
+					motion = event;
+					bPendingMotion = true;
+				}
+				continue;
+			}
+
+			// Keep the order: deliver the motion that happened before this event first.
+			if ( bPendingMotion )
+			{
+				HandleEvent(motion);
+				bPendingMotion = false;
+			}
+
+			HandleEvent(event);
+		}
+	} while ( iCount == INPUT_BATCH_SIZE );
+
+	if ( bPendingMotion )
+		HandleEvent(motion);
+}
+
+/** Feeds the recorded events of the current frame instead of the device input.
+	@remark Only a real SDL_QUIT interrupts a replay and only the lifecycle events
+	        are followed; all other device input is dropped.
+**/
+void Base::HandleReplayInput()
+{
+	Input.BeginFrame( iFrameIndex * Replayer.GetStepMs() );
+
 	SDL_Event event;
 	while ( SDL_PollEvent( &event ) )
 	{
-            HandleEvent(event);
-        }
+		if ( event.type == SDL_QUIT )
+			bQuit = true;
+		else
+			HandleLifecycleEvent( event );
+	}
+
+	ReplayEvents.clear();
+	Replayer.ReadFrame( iFrameIndex, ReplayEvents );
+
+	for ( size_t i = 0; i < ReplayEvents.size(); ++i )
+		HandleEvent( ReplayEvents[i] );
 }
 
 void Base::HandleEvent(const SDL_Event &event)
 {
+		Input.Apply(event);
+		Latency.OnEvent(event);
+		Recorder.Record(iFrameIndex, event);
+
 		switch ( event.type )
 		{
 		case SDL_KEYDOWN:
@@ -170,17 +407,90 @@ void Base::HandleEvent(const SDL_Event &event)
 				event.motion.xrel,
 				event.motion.yrel);
 			break;
+
+		case SDL_APP_DIDENTERBACKGROUND:
+		case SDL_APP_DIDENTERFOREGROUND:
+		case SDL_WINDOWEVENT:
+			HandleLifecycleEvent( event );
+			break;
 		} // switch
 }
 
+void Base::HandleLifecycleEvent(const SDL_Event &event)
+{
+	if ( event.type == SDL_APP_DIDENTERBACKGROUND )
+		EnterBackground();
+	else if ( event.type == SDL_APP_DIDENTERFOREGROUND )
+		EnterForeground();
+	else if ( event.type == SDL_WINDOWEVENT )
+	{
+		switch ( event.window.event )
+		{
+		case SDL_WINDOWEVENT_MINIMIZED:
+		case SDL_WINDOWEVENT_HIDDEN:
+			EnterBackground();
+			break;
+
+		case SDL_WINDOWEVENT_RESTORED:
+		case SDL_WINDOWEVENT_SHOWN:
+			EnterForeground();
+			break;
+		}
+	}
+}
+
+/** Stops rendering and releases the registered resources down to the budget. **/
+void Base::EnterBackground()
+{
+	if ( bMinimized )
+		return;
+
+	bMinimized = true;
+	WindowInactive();
+	AppLifecycle.EnterBackground();
+}
+
+/** Resumes rendering; released resources are restored on their next use. **/
+void Base::EnterForeground()
+{
+	if ( !bMinimized )
+		return;
+
+	AppLifecycle.EnterForeground();
+	bMinimized = false;
+
+	// The time away is not one long frame.
+	lLastTickValue = SDL_GetTicks();
+	WindowActive();
+}
+
 /** Handles the updating routine. **/
 void Base::UpdateFPSCounter()
 {
-	long iElapsedTicks = SDL_GetTicks() - lLastTickValue;
-	lLastTickValue = SDL_GetTicks();
+	long iElapsedTicks;
+
+	if ( Replayer.IsOpen() )
+	{
+		// Replays advance a fixed step per frame so every run takes the same path.
+		iElapsedTicks = Replayer.GetStepMs();
+		lLastTickValue += iElapsedTicks;
+	}
+	else
+	{
+		iElapsedTicks = SDL_GetTicks() - lLastTickValue;
+		lLastTickValue = SDL_GetTicks();
+	}
 
 	FPSCounter( iElapsedTicks );
 
+	// Frames without live particles cost nothing; Spawn() restores a released pool.
+	if ( Particles.GetCount() > 0 )
+	{
+		Uint64 iUpdate = SDL_GetPerformanceCounter();
+		Particles.Update( iElapsedTicks * 0.001f );
+		dParticleUpdateMs += ( SDL_GetPerformanceCounter() - iUpdate ) * 1000.0 / SDL_GetPerformanceFrequency();
+	}
+
 	iFPSTickCounter += iElapsedTicks;
 }
 
@@ -195,26 +505,154 @@ void Base::UpdateSurface()
 		iFPSTickCounter = 0;
 	}
 
-	SDL_FillRect( ScreenSurface, 0, SDL_MapRGB( ScreenSurface->format, 192, 192, 192 ) );
+	// Results of an older frame, if the GPU is done with it.
+	GpuTime.BeginFrame();
+
+	Display();
+
+	double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
 
-	// Lock surface if needed
-	if ( SDL_MUSTLOCK( ScreenSurface ) )
-		if ( SDL_LockSurface( ScreenSurface ) < 0 )
-			return;
+	if ( Particles.GetCount() > 0 )
+	{
+		float ViewProj[4][4];
+		SceneGraph::Multiply( ViewProj, Proj, View );
+
+		Uint64 iDraw = SDL_GetPerformanceCounter();
+		lParticles += Particles.GetCount();
+		GpuTime.Begin( "particles" );
+		ParticleDraw.Draw( Particles, ViewProj, 0.05f * iwindow_height );
+		GpuTime.End();
+		dParticleDrawMs += ( SDL_GetPerformanceCounter() - iDraw ) * dToMs;
+	}
 
+	// Game drawing goes to the GL back buffer; the window has no SDL surface.
 	SurfaceRenderer( GetSurface() );
+	GLRenderer();
+
+	// All sprites of the frame in one draw, under the text.
+	if ( SpriteDraw.GetSpriteCount() > 0 )
+	{
+		GpuTime.Begin( "sprites" );
+		SpriteDraw.Flush( iwindow_width, iwindow_height );
+		GpuTime.End();
+	}
+
+	// All text of the frame in one draw, over the scene.
+	Uint64 iFlush = SDL_GetPerformanceCounter();
+	lTextGlyphs += Text.GetGlyphCount();
+	GpuTime.Begin( "text" );
+	Text.Flush( iwindow_width, iwindow_height );
+	GpuTime.End();
+	dTextFlushMs += ( SDL_GetPerformanceCounter() - iFlush ) * dToMs;
+
+	Latency.OnRender();
+	GpuTime.EndFrame();
+
+	// Show the back buffer
+	Pacer.Present();
+
+	Latency.OnPresent();
+}
+
+/** Queues a string with a background rectangle for the end of the frame.
+	@param size The height of the text in pixels.
+**/
+void Base::displayText(const char* czText,
+		int size,
+		int x, int y,
+		int fR, int fG, int fB,
+		int bR, int bG, int bB)
+{
+	if ( !LoadFont() )
+		return;
+
+	SDL_Color foregroundColor = { (Uint8)fR, (Uint8)fG, (Uint8)fB, 255 };
+	SDL_Color backgroundColor = { (Uint8)bR, (Uint8)bG, (Uint8)bB, 255 };
+
+	Text.Add( czText, (float)x, (float)y, (float)size, foregroundColor, &backgroundColor );
+}
+
+/** Loads the distance field font, once.
+	@remark The atlas is cached in the preference path, or next to the font
+	        when there is none, and rebuilt when the font changes.
+**/
+bool Base::LoadFont()
+{
+	if ( bFontTried )
+		return Font.EnsureResident() && Font.GetTexture() != 0;
+
+	bFontTried = true;
+
+	const char* czFont = "res/arial.ttf";
+	char czCache[1024];
+
+	char* czPrefPath = SDL_GetPrefPath( "webOS", "3DGame" );
+	if ( czPrefPath )
+	{
+		SDL_snprintf( czCache, sizeof(czCache), "%sarial-48.sdf", czPrefPath );
+		SDL_free( czPrefPath );
+	}
+	else
+		SDL_snprintf( czCache, sizeof(czCache), "res/arial-48.sdf" );
+
+	if ( !Font.Load( czFont, czCache, 48 ) || !Text.Init( Font ) )
+	{
+		Text.Release();
+		Font.Release();
+		return false;
+	}
+	return true;
+}
+
+/** Queues a sprite of the cooked atlas for the end of the frame. **/
+bool Base::DrawSprite(const char* czName, int x, int y, float fScale)
+{
+	if ( !LoadSprites() )
+		return false;
 
-	// Unlock if needed
-	if ( SDL_MUSTLOCK( ScreenSurface ) )
-		SDL_UnlockSurface( ScreenSurface );
+	const AtlasRegion* pRegion = Sprites.Find( czName );
+	if ( !pRegion )
+		return false;
 
-	// Tell SDL to update the whole gScreen
-	SDL_UpdateWindowSurface(window);
+	SpriteDraw.Add( *pRegion, (float)x, (float)y, fScale );
+	return true;
+}
+
+/** Loads the sprite atlas cooked from res/sprites, once.
+	@remark A template without res/sprites has no atlas; that is not an error.
+**/
+bool Base::LoadSprites()
+{
+	if ( bSpritesTried )
+		return Sprites.EnsureResident() && Sprites.GetTexture() != 0;
+
+	bSpritesTried = true;
+
+	const char* czManifest = "res/sprites.atlas";
+
+	SDL_RWops* pFile = SDL_RWFromFile( czManifest, "rb" );
+	if ( !pFile )
+		return false;
+	SDL_RWclose( pFile );
+
+	if ( !Sprites.Load( czManifest ) || !SpriteDraw.Init( Sprites ) )
+	{
+		SpriteDraw.Release();
+		Sprites.Release();
+		return false;
+	}
+	return true;
+}
+
+/** Retrieve the cooked sprite atlas. **/
+TextureAtlas& Base::GetSprites()
+{
+	return Sprites;
 }
 
 /** Retrieve the main screen surface.
 	@return A pointer to the SDL_Surface surface
-	@remark The surface is not validated internally.
+	@remark The window is rendered with OpenGL ES, so this is NULL.
 **/
 SDL_Surface* Base::GetSurface()
 {
@@ -230,15 +668,58 @@ int Base::GetFPS()
 	return iCurrentFPS;
 }
 
+/** Sets the swap interval and frame pacing of the window.
+	@return false if the mode is not supported; adaptive vsync then falls back to vsync.
+**/
+bool Base::SetPresentMode(PresentMode eMode, int iCapHz)
+{
+	if ( Pacer.SetMode( window, eMode, iCapHz ) )
+		return true;
+
+	fprintf( stderr, "Present mode %s is not supported, using %s\n",
+			 GetPresentModeName( eMode ), GetPresentModeName( Pacer.GetMode() ) );
+	return false;
+}
+
+/** Get the number of frames shown more than half a refresh after their deadline. **/
+Uint32 Base::GetMissedFrames()
+{
+	return Pacer.GetMissedFrames();
+}
+
+/** Get the number of frames skipped because they would have missed their deadline. **/
+Uint32 Base::GetSkippedFrames()
+{
+	return Pacer.GetSkippedFrames();
+}
+
+/** Starts measuring the GPU time of each pass.
+	@return false if the driver has no timer queries and this is a release build.
+**/
+bool Base::EnableGpuTimer()
+{
+	if ( GpuTime.Init() )
+		return true;
+
+	fprintf( stderr, "GPU timer queries are not supported\n" );
+	return false;
+}
+
+/** Retrieve the GPU time of each pass. **/
+const GpuTimer& Base::GetGpuTimer()
+{
+	return GpuTime;
+}
+
 // Standard GL perspective matrix creation
 void Base::Persp(float Proj[4][4], const float FOV, const float ZNear, const float ZFar)
 {
     const float Delta   = ZFar - ZNear;
 
-    memset(Proj, 0, sizeof(Proj));
+    memset(Proj, 0, sizeof(float) * 16);
 
     Proj[0][0] = 1.0f / tanf(FOV * 3.1415926535f / 360.0f);
-    Proj[1][1] = Proj[0][0] / ((float)ScreenSurface->h / ScreenSurface->w);
+    Proj[1][1] = Proj[0][0] / ((float)iwindow_height / iwindow_width);
 
     Proj[2][2] = -(ZFar + ZNear) / Delta;
     Proj[2][3] = -1.0f;
@@ -269,38 +750,163 @@ void Base::LoadShader(char *Code, int ID)
     }
 }
 
+// Icosahedron, also the base of the subdivided benchmark model
+static const float PtData[][3] = {
+    {0.5f, 0.0380823f, 0.028521f},
+    {0.182754f, 0.285237f, 0.370816f},
+    {0.222318f, -0.2413f, 0.38028f},
+    {0.263663f, -0.410832f, -0.118163f},
+    {0.249651f, 0.0109279f, -0.435681f},
+    {0.199647f, 0.441122f, -0.133476f},
+    {-0.249651f, -0.0109279f, 0.435681f},
+    {-0.263663f, 0.410832f, 0.118163f},
+    {-0.199647f, -0.441122f, 0.133476f},
+    {-0.182754f, -0.285237f, -0.370816f},
+    {-0.222318f, 0.2413f, -0.38028f},
+    {-0.5f, -0.0380823f, -0.028521f},
+};
+
+// Face information
+static const unsigned short FaceData[][3] = {
+    {0,1,2,},
+    {0,2,3,},
+    {0,3,4,},
+    {0,4,5,},
+    {0,5,1,},
+    {1,5,7,},
+    {1,7,6,},
+    {1,6,2,},
+    {2,6,8,},
+    {2,8,3,},
+    {3,8,9,},
+    {3,9,4,},
+    {4,9,10,},
+    {4,10,5,},
+    {5,10,7,},
+    {6,7,11,},
+    {6,11,8,},
+    {7,10,11,},
+    {8,11,9,},
+    {9,11,10,},
+};
+
+// Splits every triangle into four, pushing the new vertices onto the sphere
+static void Subdivide(std::vector<float>& Points, std::vector<unsigned short>& Faces)
+{
+    std::vector<unsigned short> Split;
+    std::map<std::pair<int, int>, int> Midpoints;
+
+    for (size_t i = 0; i < Faces.size(); i += 3) {
+        unsigned short Mid[3];
+
+        for (int e = 0; e < 3; ++e) {
+            int A = Faces[i + e], B = Faces[i + (e + 1) % 3];
+            if (A > B) { int T = A; A = B; B = T; }
+
+            std::map<std::pair<int, int>, int>::iterator Edge = Midpoints.find(std::make_pair(A, B));
+            int Found = Edge != Midpoints.end() ? Edge->second : -1;
+
+            if (Found < 0) {
+                float P[3], Length = 0.0f;
+                for (int c = 0; c < 3; ++c) {
+                    P[c] = (Points[A * 3 + c] + Points[B * 3 + c]) * 0.5f;
+                    Length += P[c] * P[c];
+                }
+                Length = 0.5f / sqrtf(Length);
+
+                Found = (int)Points.size() / 3;
+                for (int c = 0; c < 3; ++c)
+                    Points.push_back(P[c] * Length);
+
+                Midpoints[std::make_pair(A, B)] = Found;
+            }
+            Mid[e] = (unsigned short)Found;
+        }
+
+        unsigned short Tri[4][3] = {
+            {Faces[i], Mid[0], Mid[2]},
+            {Mid[0], Faces[i + 1], Mid[1]},
+            {Mid[2], Mid[1], Faces[i + 2]},
+            {Mid[0], Mid[1], Mid[2]},
+        };
+        Split.insert(Split.end(), &Tri[0][0], &Tri[0][0] + 12);
+    }
+
+    Faces.swap(Split);
+}
+
+int Base::UploadModel(const VertexLayout& layout, int iLevels, GLuint& iVertices, GLuint& iIndices,
+                      float pScale[3], float pBias[3])
+{
+    std::vector<float> Points(&PtData[0][0], &PtData[0][0] + sizeof(PtData) / sizeof(float));
+    std::vector<unsigned short> Faces(&FaceData[0][0], &FaceData[0][0] + sizeof(FaceData) / sizeof(unsigned short));
+
+    for (int i = 0; i < iLevels; ++i)
+        Subdivide(Points, Faces);
+
+    // The points lie on a sphere around the origin, so they are their own normals.
+    int Count = (int)Points.size() / 3;
+    std::vector<float> Colors(Count * 4);
+    for (int i = 0; i < Count; ++i) {
+        for (int c = 0; c < 3; ++c)
+            Colors[i * 4 + c] = Points[i * 3 + c] + 0.5f;
+        Colors[i * 4 + 3] = 1.0f;
+    }
+
+    VertexLayout::ComputeBounds(Count, &Points[0], pScale, pBias);
+    if (layout.GetPositionFormat() != VERTEX_POSITION_SHORT) {
+        for (int c = 0; c < 3; ++c) {
+            pScale[c]   = 1.0f;
+            pBias[c]    = 0.0f;
+        }
+    }
+
+    std::vector<Uint8> Vertices;
+    layout.Pack(Count, &Points[0], &Points[0], &Colors[0], pScale, pBias, Vertices);
+
+    glGenBuffers(1, &iVertices);
+    glBindBuffer(GL_ARRAY_BUFFER, iVertices);
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size(), &Vertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &iIndices);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Faces.size() * sizeof(unsigned short), &Faces[0], GL_STATIC_DRAW);
+
+    return (int)Faces.size();
+}
+
 // Initializes the shader application data
 int Base::InitializeShader(void)
 {
-    // Very basic ambient+diffusion model
+    // Very basic ambient+diffusion model, fed by any VertexLayout
     const char VertexShader[] = "                   \
-        attribute vec3 Position;                    \
-        attribute vec3 Normal;                      \
-                                                    \
         uniform mat4 Proj;                          \
         uniform mat4 Model;                         \
                                                     \
         varying vec3 NormVec;                       \
         varying vec3 LighVec;                       \
+        varying vec4 VertColor;                     \
                                                     \
         void main(void)                             \
         {                                           \
-            vec4 Pos = Model * vec4(Position, 1.0); \
+            vec4 Pos = Model * DecodePosition();    \
                                                     \
             gl_Position = Proj * Pos;               \
                                                     \
             NormVec     = (Model * vec4(Normal,0.0)).xyz;     \
             LighVec     = -Pos.xyz;                 \
+            VertColor   = Color;                    \
         }                                           \
     ";
 
     const char FragmentShader[] = "                                             \
         varying highp vec3 NormVec;                                             \
         varying highp vec3 LighVec;                                             \
+        varying lowp vec4 VertColor;                                            \
                                                                                 \
         void main(void)                                                         \
         {                                                                       \
-            lowp vec3 Color = vec3(1.0, 0.0, 0.0);                              \
+            lowp vec3 Color = VertColor.rgb;                                    \
                                                                                 \
             mediump vec3 Norm  = normalize(NormVec);                            \
             mediump vec3 Light = normalize(LighVec);                            \
@@ -311,11 +917,13 @@ int Base::InitializeShader(void)
         }                                                                       \
     ";
 
+    std::string VertexSource = std::string(VERTEX_LAYOUT_SHADER_PRELUDE) + VertexShader;
+
     // Create 2 shader programs
     Shader[0] = glCreateShader(GL_VERTEX_SHADER);
     Shader[1] = glCreateShader(GL_FRAGMENT_SHADER);
 
-    LoadShader((char *)VertexShader, Shader[0]);
+    LoadShader((char *)VertexSource.c_str(), Shader[0]);
     LoadShader((char *)FragmentShader, Shader[1]);
 
     // Create the prorgam and attach the shaders & attributes
@@ -324,8 +932,9 @@ int Base::InitializeShader(void)
     glAttachShader(Program, Shader[0]);
     glAttachShader(Program, Shader[1]);
 
-    glBindAttribLocation(Program, 0, "Position");
-    glBindAttribLocation(Program, 1, "Normal");
+    glBindAttribLocation(Program, VERTEX_ATTRIB_POSITION, "Position");
+    glBindAttribLocation(Program, VERTEX_ATTRIB_NORMAL, "Normal");
+    glBindAttribLocation(Program, VERTEX_ATTRIB_COLOR, "Color");
 
     // Link
     glLinkProgram(Program);
@@ -354,15 +963,35 @@ int Base::InitializeShader(void)
 
     // Enable the program
     glUseProgram                (Program);
-    glEnableVertexAttribArray   (0);
-    glEnableVertexAttribArray   (1);
 
     // Setup the Projection matrix
     Persp(Proj, 70.0f, 0.1f, 200.0f);
 
     // Retrieve our uniforms
-    iProj   = glGetUniformLocation(Program, "Proj");
-    iModel  = glGetUniformLocation(Program, "Model");
+    iProj           = glGetUniformLocation(Program, "Proj");
+    iModel          = glGetUniformLocation(Program, "Model");
+    iPositionScale  = glGetUniformLocation(Program, "PositionScale");
+    iPositionBias   = glGetUniformLocation(Program, "PositionBias");
+
+    // Pick the nearest vertex format the GPU can fetch and build the model
+    VertexLayout Wanted = Layout;
+    Layout = Wanted.Supported();
+    if (Layout.GetName() != Wanted.GetName())
+        printf("Vertex layout %s is not supported, using %s\n", Wanted.GetName().c_str(), Layout.GetName().c_str());
+
+    iIndexCount = UploadModel(Layout, 0, iVertexBuffer, iIndexBuffer, PositionScale, PositionBias);
+
+    // Without per vertex colours the object is red
+    glVertexAttrib4f(VERTEX_ATTRIB_COLOR, 1.0f, 0.0f, 0.0f, 1.0f);
+
+    ParticleDraw.Init();
+
+    // The cooked model, when the template has one.
+    SDL_RWops* pModel = SDL_RWFromFile("res/models/model.mesh", "rb");
+    if (pModel) {
+        SDL_RWclose(pModel);
+        LoadMesh("res/models/model.mesh");
+    }
 
     // Basic GL setup
     glClearColor    (0.0, 0.0, 0.0, 1.0);
@@ -372,18 +1001,11 @@ int Base::InitializeShader(void)
     return GL_TRUE;
 }
 
-// Main-loop workhorse function for displaying the object
-void Base::Display(void)
+// Rotation around the Y axis, pushed back along Z
+void Base::RotateModel(float Model[4][4], float Angle)
 {
-    // Clear the screen
-    glClear (GL_COLOR_BUFFER_BIT);
-
-    float Model[4][4];
+    memset(Model, 0, sizeof(float) * 16);
 
-    memset(Model, 0, sizeof(Model));
-
-    // Setup the Proj so that the object rotates around the Y axis
-    // We'll also translate it appropriately to Display
     Model[0][0] = cosf(Angle);
     Model[1][1] = 1.0f;
     Model[2][0] = sinf(Angle);
@@ -391,62 +1013,199 @@ void Base::Display(void)
     Model[2][2] = cos(Angle);
     Model[3][2] = -1.0f;
     Model[3][3] = 1.0f;
+}
 
-    // Constantly rotate the object as a function of time
-    Angle = SDL_GetTicks() * 0.001f;
-
-    // Vertex information
-    float PtData[][3] = {
-        {0.5f, 0.0380823f, 0.028521f},
-        {0.182754f, 0.285237f, 0.370816f},
-        {0.222318f, -0.2413f, 0.38028f},
-        {0.263663f, -0.410832f, -0.118163f},
-        {0.249651f, 0.0109279f, -0.435681f},
-        {0.199647f, 0.441122f, -0.133476f},
-        {-0.249651f, -0.0109279f, 0.435681f},
-        {-0.263663f, 0.410832f, 0.118163f},
-        {-0.199647f, -0.441122f, 0.133476f},
-        {-0.182754f, -0.285237f, -0.370816f},
-        {-0.222318f, 0.2413f, -0.38028f},
-        {-0.5f, -0.0380823f, -0.028521f},
-    };
-
-    // Face information
-    unsigned short FaceData[][3] = {
-        {0,1,2,},
-        {0,2,3,},
-        {0,3,4,},
-        {0,4,5,},
-        {0,5,1,},
-        {1,5,7,},
-        {1,7,6,},
-        {1,6,2,},
-        {2,6,8,},
-        {2,8,3,},
-        {3,8,9,},
-        {3,9,4,},
-        {4,9,10,},
-        {4,10,5,},
-        {5,10,7,},
-        {6,7,11,},
-        {6,11,8,},
-        {7,10,11,},
-        {8,11,9,},
-        {9,11,10,},
-    };
+void Base::Display(void)
+{
+    GpuTime.Begin("scene");
+
+    // Clear the screen
+    glClear (GL_COLOR_BUFFER_BIT);
 
+    float Model[4][4];
+
+    // Setup the Proj so that the object rotates around the Y axis
+    // We'll also translate it appropriately to Display
+    RotateModel(Model, Angle);
+
+    // Constantly rotate the object as a function of time; replays use their
+    // fixed step so every run draws the same angles
+    if (Replayer.IsOpen())
+        Angle = iFrameIndex * Replayer.GetStepMs() * 0.001f;
+    else
+        Angle = SDL_GetTicks() * 0.001f;
 
     // Draw the icosahedron
     glUseProgram            (Program);
     glUniformMatrix4fv      (iProj, 1, false, (const float *)&Proj[0][0]);
-    glUniformMatrix4fv      (iModel, 1, false, (const float *)&Model[0][0]);
+    glUniform3fv            (iPositionScale, 1, PositionScale);
+    glUniform3fv            (iPositionBias, 1, PositionBias);
+
+    glBindBuffer            (GL_ARRAY_BUFFER, iVertexBuffer);
+    glBindBuffer            (GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+    Layout.Bind             (0);
+
+    if (Scene.GetNodeCount() == 0 && Queue.GetCount() == 0) {
+        glUniformMatrix4fv  (iModel, 1, false, (const float *)&Model[0][0]);
+
+        if (ModelMesh.GetIndexCount() > 0) {
+            // Mesh vertices hold a position and a normal; the colour stays constant
+            glUniform3fv                (iPositionScale, 1, ModelMesh.GetPositionScale());
+            glUniform3fv                (iPositionBias, 1, ModelMesh.GetPositionBias());
+            glDisableVertexAttribArray  (VERTEX_ATTRIB_COLOR);
+            ModelMesh.Draw              (-1, VERTEX_ATTRIB_POSITION, VERTEX_ATTRIB_NORMAL, -1);
+        } else {
+            glDrawElements          (GL_TRIANGLES, iIndexCount, GL_UNSIGNED_SHORT, 0);
+        }
+
+        GpuTime.End();
+        return;
+    }
+
+    // Queue one packet per node inside the frustum, the shader only sees View * World
+    float ViewProj[4][4];
+    SceneGraph::Multiply(ViewProj, Proj, View);
+
+    Scene.Update();
+    VisibleNodes.clear();
+    Scene.Cull(ViewProj, &VisibleNodes);
+
+    DrawPacket Packet;
+    memset(&Packet, 0, sizeof(Packet));
+    Packet.Pass             = RENDER_PASS_OPAQUE;
+    Packet.iProgram         = Program;
+    Packet.iVertexBuffer    = iVertexBuffer;
+    Packet.iIndexBuffer     = iIndexBuffer;
+    Packet.pLayout          = &Layout;
+    Packet.pPositionScale   = PositionScale;
+    Packet.pPositionBias    = PositionBias;
+    Packet.iIndexCount      = iIndexCount;
+
+    for (size_t i = 0; i < VisibleNodes.size(); ++i) {
+        SceneGraph::Multiply(Packet.Model, View, (const float (*)[4])Scene.GetWorld(VisibleNodes[i]));
+        Packet.fDepth = -Packet.Model[3][2];
+        Queue.Add(Packet);
+    }
+
+    Queue.Submit();
+    GpuTime.End();
+
+    const RenderQueueStats& Stats = Queue.GetStats();
+    lQueuedPackets      += Stats.iPackets;
+    lStateChanges       += Stats.iBlendChanges + Stats.iProgramChanges + Stats.iBufferChanges + Stats.iTextureChanges;
+    lRedundantChanges   += Stats.iRedundantChanges;
+}
 
-    glVertexAttribPointer   (0, 3, GL_FLOAT, 0, 0, &PtData[0][0]);
-    glVertexAttribPointer   (1, 3, GL_FLOAT, GL_TRUE, 0, &PtData[0][0]);
+/** Retrieve the input seen during the current frame.
+	@return A reference to the snapshot, valid until the next HandleInput().
+**/
+const InputState& Base::GetInputState()
+{
+	return Input;
+}
 
-    glDrawElements          (GL_TRIANGLES, sizeof(FaceData) / sizeof(unsigned short),
-                             GL_UNSIGNED_SHORT, &FaceData[0][0]);
+/** Turns the input latency instrumentation on or off.
+	@remark The report is printed when the main loop ends.
+**/
+void Base::EnableLatencyTracking(bool bEnable)
+{
+	Latency.Enable( bEnable );
 }
 
+/** Retrieve the input latency statistics. **/
+const LatencyTracker& Base::GetLatencyTracker()
+{
+	return Latency;
+}
 
+/** Ends the main loop after the given number of rendered frames.
+	@param iFrames Number of frames, 0 to run until quit.
+**/
+void Base::SetFrameLimit(int iFrames)
+{
+	iFrameLimit = iFrames > 0 ? iFrames : 0;
+}
+
+/** Queues a synthetic event as if it came from the device.
+	@remark SDL stamps the event with the current tick count.
+**/
+void Base::InjectEvent(const SDL_Event& event)
+{
+	SDL_Event copy = event;
+	SDL_PushEvent( &copy );
+}
 
+/** Records every dispatched event, with its frame index, to a file.
+	@return false if the file could not be created.
+**/
+bool Base::RecordInput(const char* czPath)
+{
+	return Recorder.Open( czPath, REPLAY_DEFAULT_STEP_MS );
+}
+
+/** Replays a recording instead of the device input.
+	@remark The loop runs unthrottled with a fixed time step and ends with the
+	        recording, printing the frame throughput.
+	@return false if the recording could not be opened.
+**/
+bool Base::ReplayInput(const char* czPath)
+{
+	Recorder.Close();
+	return Replayer.Open( czPath );
+}
+
+/** Loads a cooked mesh as the spinning model.
+	@remark A mesh that fails to load leaves the built-in model in place.
+**/
+bool Base::LoadMesh(const char* czPath)
+{
+	return ModelMesh.Load( czPath );
+}
+
+/** Sets the vertex format of the model.
+	@remark Takes effect in InitializeShader().
+**/
+void Base::SetVertexLayout(const VertexLayout& layout)
+{
+	Layout = layout;
+}
+
+/** Retrieve the vertex format in use.
+	@remark After InitializeShader() this is the format the GPU actually fetches.
+**/
+const VertexLayout& Base::GetVertexLayout()
+{
+	return Layout;
+}
+
+/** Retrieve the scene drawn by Display(). **/
+SceneGraph& Base::GetScene()
+{
+	return Scene;
+}
+
+/** Sets the camera of the scene.
+	@param V Column-major view matrix.
+**/
+void Base::SetView(const float V[4][4])
+{
+	memcpy( View, V, sizeof(View) );
+}
+
+/** Retrieve the particles drawn by UpdateSurface(). **/
+ParticlePool& Base::GetParticles()
+{
+	return Particles;
+}
+
+/** Retrieve the background state and its resource budget. **/
+Lifecycle& Base::GetLifecycle()
+{
+	return AppLifecycle;
+}
+
+/** Retrieve the queue submitted by Display(). **/
+RenderQueue& Base::GetRenderQueue()
+{
+	return Queue;
+}
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Base.h"
+
+namespace {
+
+//Frame after which the lifecycle benchmark goes to the background.
+const Uint32 LIFECYCLE_BENCH_FRAME = 30;
+
+/** Timer of the lifecycle benchmark: brings the app back to the foreground. **/
+Uint32 ResumeApp(Uint32, void*)
+{
+	SDL_Event event;
+	memset( &event, 0, sizeof(event) );
+	event.type = SDL_APP_DIDENTERFOREGROUND;
+	SDL_PushEvent( &event );
+	return 0;
+}
+
+}
+
+/** Reads the benchmark modes, a comma separated list of mode[=n].
+	@remark A mode without a value gets its default.
+**/
+void Base::ParseBenchmarks(const char* czModes)
+{
+	while ( *czModes )
+	{
+		char czMode[64];
+		size_t iLength = strcspn( czModes, "," );
+		size_t iCopy = iLength < sizeof(czMode) - 1 ? iLength : sizeof(czMode) - 1;
+
+		memcpy( czMode, czModes, iCopy );
+		czMode[iCopy] = '\0';
+		czModes += czModes[iLength] ? iLength + 1 : iLength;
+
+		int iValue = 0;
+		char* czValue = strchr( czMode, '=' );
+		if ( czValue )
+		{
+			*czValue = '\0';
+			iValue = atoi( czValue + 1 );
+		}
+
+		if ( strcmp( czMode, "vertex" ) == 0 )
+			iVertexBenchDraws = iValue > 0 ? iValue : 100;
+		else if ( strcmp( czMode, "input" ) == 0 )
+			iInputBenchRate = iValue > 0 ? iValue : 1000;
+		else if ( strcmp( czMode, "scene" ) == 0 )
+			iSceneBenchFrames = iValue > 0 ? iValue : 100;
+		else if ( strcmp( czMode, "particles" ) == 0 )
+		{
+			iParticleBenchCount = iValue > 0 ? iValue : 10000;
+			Particles.SetCapacity( iParticleBenchCount );
+		}
+		else if ( strcmp( czMode, "text" ) == 0 )
+			iTextBenchGlyphs = iValue > 0 ? iValue : 2000;
+		else if ( strcmp( czMode, "lifecycle" ) == 0 )
+		{
+			if ( SDL_InitSubSystem( SDL_INIT_TIMER ) == 0 )
+				iLifecycleBenchMs = iValue > 0 ? iValue : 2000;
+		}
+		else if ( czMode[0] )
+			fprintf( stderr, "Unknown benchmark %s\n", czMode );
+	}
+}
+
+/** Runs the start-up benchmarks of the selected modes. **/
+void Base::RunBenchmarks()
+{
+	if ( iVertexBenchDraws > 0 )
+		BenchmarkVertexLayouts( iVertexBenchDraws );
+
+	if ( iSceneBenchFrames > 0 )
+		BenchmarkSceneGraph( 10000, iSceneBenchFrames );
+
+	if ( iInputBenchRate > 0 )
+		BenchmarkInput( iInputBenchRate, 600 );
+
+	if ( iParticleBenchCount > 0 )
+		BenchmarkParticles( iParticleBenchCount, 100 );
+
+	if ( iLifecycleBenchMs > 0 )
+		CheckLifecycle();
+}
+
+/** Adds the synthetic input and load of the selected modes after a frame.
+	@remark The particles and the text HUD queued here show in the next frame.
+**/
+void Base::UpdateBenchmarks()
+{
+	// Synthetic key press for latency runs without a real input device.
+	if ( iInjectInterval > 0 && iFrameIndex % iInjectInterval == 0 )
+	{
+		SDL_Event event;
+		memset( &event, 0, sizeof(event) );
+		event.type = SDL_KEYDOWN;
+		InjectEvent( event );
+		event.type = SDL_KEYUP;
+		InjectEvent( event );
+	}
+
+	// A fountain that refills the pool to the benchmark count
+	if ( iParticleBenchCount > 0 )
+	{
+		float Origin[3] = { 0.0f, -1.0f, -4.0f };
+		Particles.Emit( iParticleBenchCount - Particles.GetCount(), Origin, 2.0f, 1.5f, 0xFF2080FFu );
+	}
+
+	if ( iTextBenchGlyphs > 0 )
+	{
+		Uint64 iBuild = SDL_GetPerformanceCounter();
+		AddTextBench( iTextBenchGlyphs );
+		dTextBuildMs += ( SDL_GetPerformanceCounter() - iBuild ) * 1000.0 / SDL_GetPerformanceFrequency();
+	}
+
+	// Lifecycle run: go to the background once, the timer brings the app back.
+	if ( iLifecycleBenchMs > 0 && iFrameIndex == LIFECYCLE_BENCH_FRAME )
+	{
+		SDL_Event event;
+		memset( &event, 0, sizeof(event) );
+		event.type = SDL_APP_DIDENTERBACKGROUND;
+		InjectEvent( event );
+		SDL_AddTimer( iLifecycleBenchMs, ResumeApp, 0 );
+	}
+}
+
+/** Prints the per frame averages of the selected modes. **/
+void Base::ReportBenchmarks()
+{
+	if ( lParticles > 0 )
+		printf( "particles: %.0f per frame, update %.3f ms, upload and draw %.3f ms\n",
+				(double)lParticles / iFrameIndex, dParticleUpdateMs / iFrameIndex,
+				dParticleDrawMs / iFrameIndex );
+
+	if ( lTextGlyphs > 0 )
+		printf( "text: %.0f glyphs per frame, build %.3f ms, draw %.3f ms\n",
+				(double)lTextGlyphs / iFrameIndex, dTextBuildMs / iFrameIndex,
+				dTextFlushMs / iFrameIndex );
+}
+
+/** Sends a particle pool through two background periods without a frame in
+	between, then checks that the pool comes back with its first particles.
+**/
+bool Base::CheckLifecycle()
+{
+	ParticlePool pool;
+	pool.SetCapacity( 64 );
+
+	Lifecycle lifecycle;
+	lifecycle.Register( &pool );
+
+	for ( int i = 0; i < 2; ++i )
+	{
+		lifecycle.EnterBackground();
+		lifecycle.EnterForeground();
+	}
+
+	const float Origin[3] = { 0.0f, 0.0f, 0.0f };
+	int iEmitted = pool.Emit( 64, Origin, 1.0f, 1.0f, 0xFFFFFFFFu );
+	lifecycle.Unregister( &pool );
+
+	if ( iEmitted != 64 )
+	{
+		fprintf( stderr, "lifecycle check: %d of 64 particles emitted after two background periods\n", iEmitted );
+		return false;
+	}
+
+	printf( "lifecycle check: particles emit after two background periods\n" );
+	return true;
+}
+
+/** Builds a HUD of counters that changes each frame, 50 glyphs per line. **/
+void Base::AddTextBench(int iGlyphs)
+{
+	const int iColumns = 50;
+	const float fSize = 16.0f;
+
+	SDL_Color color = { 255, 255, 255, 255 };
+	char line[iColumns + 1];
+
+	if ( !LoadFont() )
+		return;
+
+	for ( int iLine = 0; iGlyphs > 0; ++iLine, iGlyphs -= iColumns )
+	{
+		int iLength = iGlyphs < iColumns ? iGlyphs : iColumns;
+
+		SDL_snprintf( line, sizeof(line), "%04d:frame=%08u:fps=%04d:abcdefghijklmnopqrstuvwxyz",
+				iLine, iFrameIndex, iCurrentFPS );
+		line[iLength] = '\0';
+
+		Text.Add( line, 8.0f, 8.0f + iLine * fSize, fSize, color );
+	}
+}
+
+// Draws a subdivided model in every layout and prints the cost of each
+void Base::BenchmarkVertexLayouts(int iDraws)
+{
+    const VertexLayout Layouts[] = {
+        VertexLayout(VERTEX_POSITION_FLOAT, VERTEX_NORMAL_FLOAT, VERTEX_COLOR_FLOAT),
+        VertexLayout(VERTEX_POSITION_FLOAT, VERTEX_NORMAL_FLOAT, VERTEX_COLOR_UBYTE),
+        VertexLayout(VERTEX_POSITION_HALF,  VERTEX_NORMAL_BYTE,  VERTEX_COLOR_UBYTE),
+        VertexLayout(VERTEX_POSITION_HALF,  VERTEX_NORMAL_PACKED, VERTEX_COLOR_UBYTE),
+        VertexLayout(VERTEX_POSITION_SHORT, VERTEX_NORMAL_BYTE,  VERTEX_COLOR_UBYTE),
+        VertexLayout(VERTEX_POSITION_SHORT, VERTEX_NORMAL_PACKED, VERTEX_COLOR_UBYTE),
+    };
+    const int Levels = 6;
+
+    float Model[4][4];
+    RotateModel(Model, 0.5f);
+
+    glUseProgram        (Program);
+    glUniformMatrix4fv  (iProj, 1, false, (const float *)&Proj[0][0]);
+    glUniformMatrix4fv  (iModel, 1, false, (const float *)&Model[0][0]);
+
+    printf("vertex layouts: %d draws each\n", iDraws);
+
+    for (size_t i = 0; i < sizeof(Layouts) / sizeof(Layouts[0]); ++i) {
+        const VertexLayout& layout = Layouts[i];
+
+        if (!layout.IsSupported()) {
+            printf("  %-20s unsupported\n", layout.GetName().c_str());
+            continue;
+        }
+
+        GLuint Vertices, Indices;
+        float Scale[3], Bias[3];
+        int Count = UploadModel(layout, Levels, Vertices, Indices, Scale, Bias);
+
+        glUniform3fv(iPositionScale, 1, Scale);
+        glUniform3fv(iPositionBias, 1, Bias);
+        layout.Bind(0);
+
+        // Warm up, then time the draws up to their completion
+        glDrawElements(GL_TRIANGLES, Count, GL_UNSIGNED_SHORT, 0);
+        glFinish();
+
+        Uint64 Start = SDL_GetPerformanceCounter();
+        for (int d = 0; d < iDraws; ++d)
+            glDrawElements(GL_TRIANGLES, Count, GL_UNSIGNED_SHORT, 0);
+        glFinish();
+        double Ms = (SDL_GetPerformanceCounter() - Start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        printf("  %-20s %2d bytes/vertex  %8.2f ms  %8.1f Mtri/s\n", layout.GetName().c_str(),
+               layout.GetStride(), Ms, Ms > 0.0 ? (double)iDraws * Count / 3 / Ms / 1000.0 : 0.0);
+
+        glDeleteBuffers(1, &Vertices);
+        glDeleteBuffers(1, &Indices);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+// Clusters of nodes, some spinning each frame, seen by a camera circling the scene
+void Base::BenchmarkSceneGraph(int iNodes, int iFrames)
+{
+    const int Clusters  = iNodes / 100 > 0 ? iNodes / 100 : 1;
+    const int Moving    = Clusters / 10 > 0 ? Clusters / 10 : 1;
+
+    SceneGraph Graph;
+    std::vector<int> Visible;
+    float M[4][4];
+
+    srand(1);
+    for (int i = 0; i < iNodes; ++i) {
+        int Parent = i < Clusters ? -1 : rand() % Clusters;
+        float Spread = Parent < 0 ? 200.0f : 10.0f;
+
+        SceneGraph::Identity(M);
+        M[3][0] = (rand() / (float)RAND_MAX - 0.5f) * Spread;
+        M[3][1] = (rand() / (float)RAND_MAX - 0.5f) * Spread * 0.1f;
+        M[3][2] = (rand() / (float)RAND_MAX - 0.5f) * Spread;
+
+        int Node = Graph.AddNode(Parent);
+        Graph.SetLocal(Node, M);
+        Graph.SetBounds(Node, 0.0f, 0.0f, 0.0f, 0.5f);
+    }
+    Graph.Update();
+
+    double UpdateMs = 0.0, CullMs = 0.0, ScalarMs = 0.0;
+    long Updated = 0, Culled = 0;
+    double ToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    for (int f = 0; f < iFrames; ++f) {
+        // Spin a tenth of the clusters, their whole subtree becomes dirty
+        for (int c = 0; c < Moving; ++c) {
+            int Node = (f * Moving + c) % Clusters;
+            memcpy(M, Graph.GetWorld(Node), sizeof(M));
+            float Angle = 0.05f, X = M[0][0], Z = M[0][2];
+            M[0][0] = X * cosf(Angle) - Z * sinf(Angle);
+            M[0][2] = X * sinf(Angle) + Z * cosf(Angle);
+            M[2][0] = -M[0][2];
+            M[2][2] = M[0][0];
+            Graph.SetLocal(Node, M);
+        }
+
+        float Orbit = f * 0.01f, Eye[4][4], ViewProj[4][4];
+        RotateModel(Eye, Orbit);
+        Eye[3][2] = -20.0f;
+        SceneGraph::Multiply(ViewProj, Proj, Eye);
+
+        Uint64 Start = SDL_GetPerformanceCounter();
+        Graph.Update();
+        Uint64 Updates = SDL_GetPerformanceCounter();
+        Visible.clear();
+        Graph.Cull(ViewProj, &Visible);
+        Uint64 Culls = SDL_GetPerformanceCounter();
+        Visible.clear();
+        Graph.CullScalar(ViewProj, &Visible);
+        Uint64 End = SDL_GetPerformanceCounter();
+
+        UpdateMs    += (Updates - Start) * ToMs;
+        CullMs      += (Culls - Updates) * ToMs;
+        ScalarMs    += (End - Culls) * ToMs;
+        Updated     += Graph.GetUpdatedCount();
+        Culled      += Graph.GetCulledCount();
+    }
+
+    printf("scene graph: %d nodes, %d frames\n", iNodes, iFrames);
+    printf("  per frame: %ld updated, %ld culled, update %.3f ms, cull %.3f ms (scalar %.3f ms), total %.3f ms\n",
+           Updated / iFrames, Culled / iFrames, UpdateMs / iFrames, CullMs / iFrames, ScalarMs / iFrames,
+           (UpdateMs + CullMs) / iFrames);
+}
+
+// Runs the same fountain through the SIMD and the scalar kernel
+void Base::BenchmarkParticles(int iParticles, int iFrames)
+{
+    const float Origin[3] = { 0.0f, 0.0f, 0.0f };
+    const float Step = 1.0f / 60.0f;
+
+    ParticlePool Pool;
+    Pool.SetCapacity(iParticles);
+
+    double Ms[2] = { 0.0, 0.0 };
+    double ToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    for (int Kernel = 0; Kernel < 2; ++Kernel) {
+        Pool.Clear();
+        Pool.Emit(iParticles, Origin, 5.0f, 1.0f, 0xFFFFFFFFu);
+
+        for (int f = 0; f < iFrames; ++f) {
+            Pool.Emit(iParticles - Pool.GetCount(), Origin, 5.0f, 1.0f, 0xFFFFFFFFu);
+
+            Uint64 Start = SDL_GetPerformanceCounter();
+            if (Kernel == 0)
+                Pool.Update(Step);
+            else
+                Pool.UpdateScalar(Step);
+            Ms[Kernel] += (SDL_GetPerformanceCounter() - Start) * ToMs;
+        }
+    }
+
+    printf("particles: %d particles, %d frames\n", iParticles, iFrames);
+    printf("  per frame: update %.3f ms (scalar %.3f ms)\n", Ms[0] / iFrames, Ms[1] / iFrames);
+}
+
+/** Feeds the same synthetic pointer stream to HandleInput() and to one HandleEvent() per polled event.
+	@remark The events reach the game callbacks like real input; run it before the game starts.
+**/
+void Base::BenchmarkInput(int iRateHz, int iFrames)
+{
+	if ( Replayer.IsOpen() || Recorder.IsOpen() )
+	{
+		fprintf( stderr, "input: no benchmark while recording or replaying\n" );
+		return;
+	}
+
+	// Events queued during one 60 Hz frame.
+	int iPerFrame = iRateHz / 60 > 0 ? iRateHz / 60 : 1;
+
+	double dMs[2] = { 0.0, 0.0 };
+	long lCallbacks[2] = { 0, 0 };
+	double dToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+	for ( int iPath = 0; iPath < 2; ++iPath )
+	{
+		for ( int f = 0; f < iFrames; ++f )
+		{
+			for ( int i = 0; i < iPerFrame; ++i )
+			{
+				SDL_Event event;
+				memset( &event, 0, sizeof(event) );
+				event.type = SDL_MOUSEMOTION;
+				event.motion.x = ( f * iPerFrame + i ) % iwindow_width;
+				event.motion.y = iwindow_height / 2;
+				event.motion.xrel = 1;
+				SDL_PushEvent( &event );
+			}
+
+			Uint64 iStart = SDL_GetPerformanceCounter();
+			if ( iPath == 0 )
+				HandleInput();
+			else
+			{
+				// Dispatch without batching: every event on its own.
+				Input.BeginFrame( SDL_GetTicks() );
+
+				SDL_Event event;
+				while ( SDL_PollEvent( &event ) )
+				{
+					Input.CountRaw( event );
+					HandleEvent( event );
+				}
+			}
+			dMs[iPath] += ( SDL_GetPerformanceCounter() - iStart ) * dToMs;
+			lCallbacks[iPath] += Input.GetDispatchedCount();
+		}
+	}
+
+	printf( "input: %d Hz pointer stream, %d events per frame, %d frames\n", iRateHz, iPerFrame, iFrames );
+	printf( "  per frame: batched %.3f ms, %.1f callbacks; per event %.3f ms, %.1f callbacks\n",
+			dMs[0] / iFrames, (double)lCallbacks[0] / iFrames, dMs[1] / iFrames, (double)lCallbacks[1] / iFrames );
+}
@@ -0,0 +1,257 @@
+
+#include <string.h>
+
+#include "GpuTimer.h"
+
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT             0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT   0x8867
+#endif
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT             0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT             0x8FBB
+#endif
+
+namespace {
+
+typedef void (GL_APIENTRYP GenQueriesFn)            (GLsizei n, GLuint* pIds);
+typedef void (GL_APIENTRYP DeleteQueriesFn)         (GLsizei n, const GLuint* pIds);
+typedef void (GL_APIENTRYP BeginQueryFn)            (GLenum target, GLuint id);
+typedef void (GL_APIENTRYP EndQueryFn)              (GLenum target);
+typedef void (GL_APIENTRYP GetQueryObjectuivFn)     (GLuint id, GLenum pname, GLuint* pParams);
+typedef void (GL_APIENTRYP GetQueryObjectui64vFn)   (GLuint id, GLenum pname, Uint64* pParams);
+
+//Entry points of GL_EXT_disjoint_timer_query; shared, they only depend on the driver.
+GenQueriesFn            pGenQueries             = 0;
+DeleteQueriesFn         pDeleteQueries          = 0;
+BeginQueryFn            pBeginQuery             = 0;
+EndQueryFn              pEndQuery               = 0;
+GetQueryObjectuivFn     pGetQueryObjectuiv      = 0;
+GetQueryObjectui64vFn   pGetQueryObjectui64v    = 0;
+
+bool LoadTimerQuery()
+{
+    if ( !SDL_GL_ExtensionSupported("GL_EXT_disjoint_timer_query") )
+        return false;
+
+    pGenQueries             = (GenQueriesFn)SDL_GL_GetProcAddress("glGenQueriesEXT");
+    pDeleteQueries          = (DeleteQueriesFn)SDL_GL_GetProcAddress("glDeleteQueriesEXT");
+    pBeginQuery             = (BeginQueryFn)SDL_GL_GetProcAddress("glBeginQueryEXT");
+    pEndQuery               = (EndQueryFn)SDL_GL_GetProcAddress("glEndQueryEXT");
+    pGetQueryObjectuiv      = (GetQueryObjectuivFn)SDL_GL_GetProcAddress("glGetQueryObjectuivEXT");
+    pGetQueryObjectui64v    = (GetQueryObjectui64vFn)SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
+
+    return pGenQueries && pDeleteQueries && pBeginQuery && pEndQuery && pGetQueryObjectuiv && pGetQueryObjectui64v;
+}
+
+}
+
+GpuTimer::GpuTimer()
+{
+    eSource         = GPU_TIMER_OFF;
+    iPassCount      = 0;
+    iRingIndex      = 0;
+    iOpenPass       = -1;
+    iFinishStart    = 0;
+    iFrames         = 0;
+    iDropped        = 0;
+    iDisjoint       = 0;
+
+    memset(Passes, 0, sizeof(Passes));
+    memset(Ring, 0, sizeof(Ring));
+}
+
+GpuTimer::~GpuTimer()
+{
+    Release();
+}
+
+bool GpuTimer::Init()
+{
+    Release();
+
+    iPassCount  = 0;
+    iFrames     = 0;
+    iDropped    = 0;
+    iDisjoint   = 0;
+    memset(Passes, 0, sizeof(Passes));
+
+    if ( LoadTimerQuery() ) {
+        for ( int i = 0; i < GPU_TIMER_FRAMES; ++i )
+            pGenQueries(GPU_TIMER_MAX_PASSES, Ring[i].Queries);
+
+        // Clear a disjoint flag left from before.
+        GLint iDisjointFlag = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &iDisjointFlag);
+
+        eSource = GPU_TIMER_QUERY;
+        return true;
+    }
+
+#ifndef NDEBUG
+    eSource = GPU_TIMER_FINISH;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void GpuTimer::Release()
+{
+    if ( eSource == GPU_TIMER_QUERY )
+        for ( int i = 0; i < GPU_TIMER_FRAMES; ++i )
+            pDeleteQueries(GPU_TIMER_MAX_PASSES, Ring[i].Queries);
+
+    eSource = GPU_TIMER_OFF;
+    memset(Ring, 0, sizeof(Ring));
+    iOpenPass = -1;
+}
+
+int GpuTimer::FindPass(const char* czName)
+{
+    for ( int i = 0; i < iPassCount; ++i )
+        if ( Passes[i].czName == czName || strcmp(Passes[i].czName, czName) == 0 )
+            return i;
+
+    if ( iPassCount == GPU_TIMER_MAX_PASSES )
+        return -1;
+
+    Passes[iPassCount].czName = czName;
+    return iPassCount++;
+}
+
+void GpuTimer::AddSample(int iPass, double dMs)
+{
+    Passes[iPass].dLastMs   = dMs;
+    Passes[iPass].dTotalMs += dMs;
+    ++Passes[iPass].iSamples;
+}
+
+/** Reads the results of a frame if the GPU has finished all of it; never waits. **/
+void GpuTimer::Collect(FrameQueries& frame)
+{
+    if ( frame.iCount == 0 )
+        return;
+
+    // Queries complete in order, the last one tells for the whole frame.
+    GLuint iAvailable = 0;
+    pGetQueryObjectuiv(frame.Queries[frame.iCount - 1], GL_QUERY_RESULT_AVAILABLE_EXT, &iAvailable);
+
+    GLint iDisjointFlag = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &iDisjointFlag);
+
+    // The first frame also times driver start-up work, e.g. deferred
+    // shader compilation; some drivers report a bogus start for it.
+    if ( iFrames == GPU_TIMER_FRAMES )
+        ;
+    else if ( iDisjointFlag )
+        ++iDisjoint;
+    else if ( !iAvailable )
+        ++iDropped;
+    else {
+        for ( int i = 0; i < frame.iCount; ++i ) {
+            Uint64 iNanoseconds = 0;
+            pGetQueryObjectui64v(frame.Queries[i], GL_QUERY_RESULT_EXT, &iNanoseconds);
+            AddSample(frame.Passes[i], iNanoseconds / 1000000.0);
+        }
+    }
+
+    frame.iCount = 0;
+}
+
+void GpuTimer::BeginFrame()
+{
+    if ( eSource != GPU_TIMER_QUERY )
+        return;
+
+    // The slot about to be reused was issued GPU_TIMER_FRAMES frames ago.
+    Collect(Ring[iRingIndex]);
+}
+
+void GpuTimer::EndFrame()
+{
+    if ( eSource == GPU_TIMER_OFF )
+        return;
+
+    if ( iOpenPass >= 0 )
+        End();
+
+    iRingIndex = ( iRingIndex + 1 ) % GPU_TIMER_FRAMES;
+    ++iFrames;
+}
+
+void GpuTimer::Begin(const char* czPass)
+{
+    if ( eSource == GPU_TIMER_OFF )
+        return;
+
+    if ( iOpenPass >= 0 )
+        End();
+
+    iOpenPass = FindPass(czPass);
+    if ( iOpenPass < 0 )
+        return;
+
+    if ( eSource == GPU_TIMER_QUERY ) {
+        FrameQueries& frame = Ring[iRingIndex];
+        if ( frame.iCount == GPU_TIMER_MAX_PASSES ) {
+            iOpenPass = -1;
+            return;
+        }
+        frame.Passes[frame.iCount] = iOpenPass;
+        pBeginQuery(GL_TIME_ELAPSED_EXT, frame.Queries[frame.iCount]);
+    } else {
+        glFinish();
+        iFinishStart = SDL_GetPerformanceCounter();
+    }
+}
+
+void GpuTimer::End()
+{
+    if ( iOpenPass < 0 )
+        return;
+
+    if ( eSource == GPU_TIMER_QUERY ) {
+        pEndQuery(GL_TIME_ELAPSED_EXT);
+        ++Ring[iRingIndex].iCount;
+    } else {
+        glFinish();
+        AddSample(iOpenPass, ( SDL_GetPerformanceCounter() - iFinishStart ) * 1000.0 / SDL_GetPerformanceFrequency());
+    }
+
+    iOpenPass = -1;
+}
+
+double GpuTimer::GetPassMs(int i) const
+{
+    return Passes[i].iSamples > 0 ? Passes[i].dTotalMs / Passes[i].iSamples : 0.0;
+}
+
+void GpuTimer::Report(FILE* pFile) const
+{
+    if ( eSource == GPU_TIMER_OFF )
+        return;
+
+    fprintf(pFile, "gpu (%s):", GetGpuTimerSourceName(eSource));
+    for ( int i = 0; i < iPassCount; ++i )
+        fprintf(pFile, " %s %.3f ms%s", Passes[i].czName, GetPassMs(i), i + 1 < iPassCount ? "," : "");
+    fprintf(pFile, "\n");
+
+    if ( eSource == GPU_TIMER_QUERY )
+        fprintf(pFile, "gpu: %u frames, %u late and %u disjoint dropped\n", iFrames, iDropped, iDisjoint);
+}
+
+const char* GetGpuTimerSourceName(GpuTimerSource eSource)
+{
+    switch ( eSource )
+    {
+        case GPU_TIMER_OFF:     return "off";
+        case GPU_TIMER_QUERY:   return "timer query";
+        case GPU_TIMER_FINISH:  return "glFinish";
+    }
+    return "unknown";
+}
@@ -0,0 +1,146 @@
+
+#include "Latency.h"
+
+/** Default constructor. **/
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+    for ( int i = 0; i <= BIN_COUNT; ++i )
+        Bins[i] = 0;
+
+    iCount  = 0;
+    iSum    = 0;
+    iMax    = 0;
+}
+
+void LatencyHistogram::Add(Uint32 iMs)
+{
+    ++Bins[iMs < (Uint32)BIN_COUNT ? iMs : BIN_COUNT];
+    ++iCount;
+    iSum += iMs;
+
+    if ( iMs > iMax )
+        iMax = iMs;
+}
+
+/** Smallest latency that covers the given fraction of the samples.
+    @remark Samples in the overflow bin report the maximum seen.
+**/
+Uint32 LatencyHistogram::Percentile(double dFraction) const
+{
+    if ( iCount == 0 )
+        return 0;
+
+    Uint32 iTarget = (Uint32)(dFraction * iCount + 0.5);
+    if ( iTarget < 1 )
+        iTarget = 1;
+
+    Uint32 iSeen = 0;
+    for ( int i = 0; i < BIN_COUNT; ++i ) {
+        iSeen += Bins[i];
+        if ( iSeen >= iTarget )
+            return (Uint32)i;
+    }
+
+    return iMax;
+}
+
+/** Prints count, mean, percentiles and maximum on one line. **/
+void LatencyHistogram::Print(FILE* pOut, const char* czLabel) const
+{
+    fprintf(pOut, "%-10s n=%u mean=%.1f p50=%u p90=%u p99=%u max=%u (ms)\n",
+            czLabel, iCount, Mean(),
+            Percentile(0.50), Percentile(0.90), Percentile(0.99), iMax);
+}
+
+/** Prints one line per non empty bin. **/
+void LatencyHistogram::PrintBins(FILE* pOut) const
+{
+    for ( int i = 0; i < BIN_COUNT; ++i )
+        if ( Bins[i] )
+            fprintf(pOut, "%5d ms %8u\n", i, Bins[i]);
+
+    if ( Bins[BIN_COUNT] )
+        fprintf(pOut, ">=%3d ms %8u\n", BIN_COUNT, Bins[BIN_COUNT]);
+}
+
+/** Default constructor. **/
+LatencyTracker::LatencyTracker()
+{
+    bEnabled    = false;
+    iUpdateTime = 0;
+    iRenderTime = 0;
+}
+
+void LatencyTracker::Enable(bool bEnable)
+{
+    bEnabled = bEnable;
+    Pending.clear();
+}
+
+/** Tags a dispatched event with its SDL timestamp. **/
+void LatencyTracker::OnEvent(const SDL_Event& event)
+{
+    if ( !bEnabled )
+        return;
+
+    if ( event.type != SDL_KEYDOWN && event.type != SDL_MOUSEBUTTONDOWN )
+        return;
+
+    Sample sample = { event.common.timestamp, SDL_GetTicks() };
+    Pending.push_back(sample);
+}
+
+/** The update of the frame that consumes the pending events is done. **/
+void LatencyTracker::OnUpdate()
+{
+    if ( bEnabled )
+        iUpdateTime = SDL_GetTicks();
+}
+
+/** The frame that reflects the pending events has been drawn. **/
+void LatencyTracker::OnRender()
+{
+    if ( bEnabled )
+        iRenderTime = SDL_GetTicks();
+}
+
+/** The frame has been handed to the display; closes the pending events. **/
+void LatencyTracker::OnPresent()
+{
+    if ( !bEnabled || Pending.empty() )
+        return;
+
+    Uint32 iPresentTime = SDL_GetTicks();
+
+    for ( size_t i = 0; i < Pending.size(); ++i ) {
+        Uint32 iEventTime = Pending[i].iEventTime;
+
+        Dispatch.Add(Pending[i].iDispatchTime - iEventTime);
+        Update.Add(iUpdateTime - iEventTime);
+        Render.Add(iRenderTime - iEventTime);
+        Present.Add(iPresentTime - iEventTime);
+    }
+
+    Pending.clear();
+}
+
+/** Prints the per stage summary and the input-to-present histogram. **/
+void LatencyTracker::Report(FILE* pOut) const
+{
+    fprintf(pOut, "Input latency, measured from the SDL event timestamp:\n");
+    Dispatch.Print(pOut, "dispatch");
+    Update.Print(pOut, "update");
+    Render.Print(pOut, "render");
+    Present.Print(pOut, "present");
+
+    if ( Present.Count() == 0 )
+        return;
+
+    fprintf(pOut, "Input-to-present histogram:\n");
+    Present.PrintBins(pOut);
+}
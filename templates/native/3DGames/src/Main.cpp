@@ -7,6 +7,20 @@
 class ThreeDGame: public Base
 {
 	//TODO: Write the override and additional methods here...
+
+	// Text is drawn and dropped at the end of every frame, so the HUD is queued every frame.
+	void FPSCounter( const int& iElapsedTime )
+	{
+		char czFPS[32];
+		SDL_snprintf( czFPS, sizeof(czFPS), "FPS: %d", GetFPS() );
+		displayText( czFPS, 24, 8, 8, 255, 255, 255, 0, 0, 0 );
+	}
+
+	// Sprites come from res/sprites, here res/sprites/logo.bmp; without it nothing is drawn.
+	void GLRenderer()
+	{
+		DrawSprite( "logo", 8, 40 );
+	}
 };
 
 
@@ -21,8 +35,6 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	game.Display();
-
 	game.Start();
 
 	return 0;
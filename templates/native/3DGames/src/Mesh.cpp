@@ -0,0 +1,216 @@
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Mesh.h"
+
+namespace {
+
+const char MESH_MAGIC[4] = { 'B', 'M', 'S', 'H' };
+
+//Header words following the magic, in file order.
+enum
+{
+    MESH_HEADER_VERSION = 0,
+    MESH_HEADER_VERTEX_COUNT,
+    MESH_HEADER_INDEX_COUNT,
+    MESH_HEADER_SUBMESH_COUNT,
+    MESH_HEADER_VERTEX_STRIDE,
+    MESH_HEADER_POSITION_SCALE,
+    MESH_HEADER_POSITION_BIAS       = MESH_HEADER_POSITION_SCALE + 3,
+    MESH_HEADER_TEXCOORD_SCALE      = MESH_HEADER_POSITION_BIAS + 3,
+    MESH_HEADER_TEXCOORD_BIAS       = MESH_HEADER_TEXCOORD_SCALE + 2,
+    MESH_HEADER_SUBMESH_OFFSET      = MESH_HEADER_TEXCOORD_BIAS + 2,
+    MESH_HEADER_VERTEX_OFFSET,
+    MESH_HEADER_INDEX_OFFSET,
+    MESH_HEADER_WORDS
+};
+
+//Vertex attribute offsets inside a MESH_VERTEX_STRIDE vertex.
+const size_t MESH_POSITION_OFFSET   = 0;
+const size_t MESH_NORMAL_OFFSET     = 8;
+const size_t MESH_TEXCOORD_OFFSET   = 12;
+
+}
+
+Mesh::Mesh()
+    : iVertexBuffer(0), iIndexBuffer(0), iVertexCount(0), iIndexCount(0)
+{
+    for ( int i = 0; i < 3; ++i ) {
+        PositionScale[i] = 1.0f;
+        PositionBias[i]  = 0.0f;
+    }
+    for ( int i = 0; i < 2; ++i ) {
+        TexCoordScale[i] = 1.0f;
+        TexCoordBias[i]  = 0.0f;
+    }
+}
+
+Mesh::~Mesh()
+{
+    Release();
+}
+
+/** Loads a mesh blob written by tools/meshcook.
+    @param czPath The .mesh file.
+    @return false if the file is missing or not a valid blob.
+    @remark Needs a current GL context.
+**/
+bool Mesh::Load(const char* czPath)
+{
+    Release();
+
+    int fd = open(czPath, O_RDONLY);
+    if ( fd < 0 ) {
+        printf("Error: Unable to open %s\n", czPath);
+        return false;
+    }
+
+    struct stat st;
+    void* pMap = MAP_FAILED;
+    if ( fstat(fd, &st) == 0 && st.st_size > 0 )
+        pMap = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if ( pMap == MAP_FAILED ) {
+        printf("Error: Unable to map %s\n", czPath);
+        return false;
+    }
+
+    const Uint8* pData = (const Uint8*)pMap;
+    size_t iSize = (size_t)st.st_size;
+
+    Uint32 header[MESH_HEADER_WORDS];
+    bool bValid = iSize >= MESH_HEADER_SIZE && memcmp(pData, MESH_MAGIC, sizeof(MESH_MAGIC)) == 0;
+
+    if ( bValid ) {
+        memcpy(header, pData + sizeof(MESH_MAGIC), sizeof(header));
+
+        Uint64 iSubmeshEnd  = (Uint64)header[MESH_HEADER_SUBMESH_OFFSET] + (Uint64)header[MESH_HEADER_SUBMESH_COUNT] * MESH_SUBMESH_SIZE;
+        Uint64 iVertexEnd   = (Uint64)header[MESH_HEADER_VERTEX_OFFSET] + (Uint64)header[MESH_HEADER_VERTEX_COUNT] * MESH_VERTEX_STRIDE;
+        Uint64 iIndexEnd    = (Uint64)header[MESH_HEADER_INDEX_OFFSET] + (Uint64)header[MESH_HEADER_INDEX_COUNT] * sizeof(Uint16);
+
+        bValid = header[MESH_HEADER_VERSION] == MESH_VERSION
+              && header[MESH_HEADER_VERTEX_STRIDE] == MESH_VERTEX_STRIDE
+              && iSubmeshEnd <= iSize && iVertexEnd <= iSize && iIndexEnd <= iSize;
+    }
+
+    if ( !bValid ) {
+        printf("Error: %s is not a version %u mesh\n", czPath, MESH_VERSION);
+        munmap(pMap, iSize);
+        return false;
+    }
+
+    iVertexCount = header[MESH_HEADER_VERTEX_COUNT];
+    iIndexCount  = header[MESH_HEADER_INDEX_COUNT];
+
+    memcpy(PositionScale, &header[MESH_HEADER_POSITION_SCALE], sizeof(PositionScale));
+    memcpy(PositionBias,  &header[MESH_HEADER_POSITION_BIAS],  sizeof(PositionBias));
+    memcpy(TexCoordScale, &header[MESH_HEADER_TEXCOORD_SCALE], sizeof(TexCoordScale));
+    memcpy(TexCoordBias,  &header[MESH_HEADER_TEXCOORD_BIAS],  sizeof(TexCoordBias));
+
+    const Uint8* pSubmesh = pData + header[MESH_HEADER_SUBMESH_OFFSET];
+    Submeshes.resize(header[MESH_HEADER_SUBMESH_COUNT]);
+
+    for ( size_t i = 0; i < Submeshes.size(); ++i, pSubmesh += MESH_SUBMESH_SIZE ) {
+        MeshSubmesh& sub = Submeshes[i];
+        memcpy(&sub.iFirstIndex,  pSubmesh,      4);
+        memcpy(&sub.iIndexCount,  pSubmesh + 4,  4);
+        memcpy(&sub.iFirstVertex, pSubmesh + 8,  4);
+        memcpy(&sub.iVertexCount, pSubmesh + 12, 4);
+        sub.material.assign((const char*)pSubmesh + 16, strnlen((const char*)pSubmesh + 16, MESH_NAME_SIZE));
+
+        // Draw() trusts the ranges, so each one has to fit the sections.
+        if ( (Uint64)sub.iFirstIndex + sub.iIndexCount > iIndexCount
+          || (Uint64)sub.iFirstVertex + sub.iVertexCount > iVertexCount )
+            bValid = false;
+    }
+
+    if ( !bValid ) {
+        printf("Error: %s has a submesh outside its vertices or indices\n", czPath);
+        munmap(pMap, iSize);
+        Release();
+        return false;
+    }
+
+    // The mapped pages go to the driver as is.
+    glGenBuffers(1, &iVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, iVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, iVertexCount * MESH_VERTEX_STRIDE,
+                 pData + header[MESH_HEADER_VERTEX_OFFSET], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &iIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, iIndexCount * sizeof(Uint16),
+                 pData + header[MESH_HEADER_INDEX_OFFSET], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    munmap(pMap, iSize);
+    return true;
+}
+
+/** Deletes the GL buffers. **/
+void Mesh::Release()
+{
+    if ( iVertexBuffer )
+        glDeleteBuffers(1, &iVertexBuffer);
+    if ( iIndexBuffer )
+        glDeleteBuffers(1, &iIndexBuffer);
+
+    iVertexBuffer = iIndexBuffer = 0;
+    iVertexCount = iIndexCount = 0;
+    Submeshes.clear();
+}
+
+/** Draws one submesh, or every submesh when iSubmesh is -1. **/
+void Mesh::Draw(int iSubmesh, GLint iPosition, GLint iNormal, GLint iTexCoord) const
+{
+    if ( !iVertexBuffer )
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, iVertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+
+    int iFirst  = iSubmesh < 0 ? 0 : iSubmesh;
+    int iLast   = iSubmesh < 0 ? (int)Submeshes.size() : iSubmesh + 1;
+
+    for ( int i = iFirst; i < iLast && i < (int)Submeshes.size(); ++i ) {
+        const MeshSubmesh& sub = Submeshes[i];
+        size_t iBase = (size_t)sub.iFirstVertex * MESH_VERTEX_STRIDE;
+
+        // GLES2 has no base vertex, so each range rebases the attribute pointers.
+        if ( iPosition >= 0 )
+            glVertexAttribPointer(iPosition, 3, GL_SHORT, GL_TRUE, MESH_VERTEX_STRIDE,
+                                  (const void*)(iBase + MESH_POSITION_OFFSET));
+        if ( iNormal >= 0 )
+            glVertexAttribPointer(iNormal, 3, GL_BYTE, GL_TRUE, MESH_VERTEX_STRIDE,
+                                  (const void*)(iBase + MESH_NORMAL_OFFSET));
+        if ( iTexCoord >= 0 )
+            glVertexAttribPointer(iTexCoord, 2, GL_UNSIGNED_SHORT, GL_TRUE, MESH_VERTEX_STRIDE,
+                                  (const void*)(iBase + MESH_TEXCOORD_OFFSET));
+
+        glDrawElements(GL_TRIANGLES, sub.iIndexCount, GL_UNSIGNED_SHORT,
+                       (const void*)((size_t)sub.iFirstIndex * sizeof(Uint16)));
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/** Scale and translation from the quantized [-1, 1] cube to model units. **/
+void Mesh::GetDequantizeMatrix(float M[4][4]) const
+{
+    memset(M, 0, sizeof(float) * 16);
+
+    for ( int i = 0; i < 3; ++i ) {
+        M[i][i] = PositionScale[i];
+        M[3][i] = PositionBias[i];
+    }
+    M[3][3] = 1.0f;
+}
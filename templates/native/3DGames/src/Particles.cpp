@@ -0,0 +1,376 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PARTICLES_SSE 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PARTICLES_NEON 1
+#endif
+
+#include "Particles.h"
+
+namespace {
+
+/** Resizes to n zeroed elements, giving the old memory back. **/
+template <class T>
+void Reallocate(std::vector<T>& values, size_t n)
+{
+    std::vector<T>(n, T()).swap(values);
+}
+
+const char* PARTICLE_VERTEX_SHADER =
+    "attribute float X;                                         \n"
+    "attribute float Y;                                         \n"
+    "attribute float Z;                                         \n"
+    "attribute float Fade;                                      \n"
+    "attribute vec4 Color;                                      \n"
+    "                                                           \n"
+    "uniform mat4 ViewProj;                                     \n"
+    "uniform float PointSize;                                   \n"
+    "                                                           \n"
+    "varying vec4 Tint;                                         \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    gl_Position  = ViewProj * vec4(X, Y, Z, 1.0);          \n"
+    "    gl_PointSize = PointSize / max(gl_Position.w, 0.01);   \n"
+    "    Tint = vec4(Color.rgb, Color.a * Fade);                \n"
+    "}                                                          \n";
+
+const char* PARTICLE_FRAGMENT_SHADER =
+    "precision mediump float;                                   \n"
+    "                                                           \n"
+    "varying vec4 Tint;                                         \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    float Edge = 1.0 - 2.0 * length(gl_PointCoord - vec2(0.5)); \n"
+    "    gl_FragColor = vec4(Tint.rgb, Tint.a * clamp(Edge, 0.0, 1.0)); \n"
+    "}                                                          \n";
+
+enum
+{
+    PARTICLE_ATTRIB_X = 0,
+    PARTICLE_ATTRIB_Y,
+    PARTICLE_ATTRIB_Z,
+    PARTICLE_ATTRIB_FADE,
+    PARTICLE_ATTRIB_COLOR,
+    PARTICLE_ATTRIB_COUNT
+};
+
+GLuint CompileShader(GLenum type, const char* czSource)
+{
+    GLuint iShader = glCreateShader(type);
+    glShaderSource(iShader, 1, &czSource, NULL);
+    glCompileShader(iShader);
+
+    GLint iStatus;
+    glGetShaderiv(iShader, GL_COMPILE_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        char error[1024];
+        glGetShaderInfoLog(iShader, sizeof(error), NULL, error);
+        printf("Error: Failed to compile particle shader\n%s", error);
+    }
+    return iShader;
+}
+
+}
+
+ParticlePool::ParticlePool()
+    : iCount(0), iCapacity(0), iReleasedCapacity(0), iSeed(0x2545F491u)
+{
+    Gravity[0] = Gravity[2] = 0.0f;
+    Gravity[1] = -9.81f;
+    SetCapacity(0);
+}
+
+void ParticlePool::SetCapacity(int iMax)
+{
+    // Room for whole groups of four, the kernels never run past the arrays.
+    size_t iPadded = (size_t)((iMax + 3) & ~3);
+    if ( iPadded == 0 )
+        iPadded = 4;
+
+    Reallocate(X, iPadded);    Reallocate(Y, iPadded);    Reallocate(Z, iPadded);
+    Reallocate(VX, iPadded);   Reallocate(VY, iPadded);   Reallocate(VZ, iPadded);
+    Reallocate(Life, iPadded);
+    Reallocate(InvLifetime, iPadded);
+    Reallocate(Fade, iPadded);
+    Reallocate(Color, iPadded);
+
+    iCapacity = iMax;
+    iCount = 0;
+}
+
+void ParticlePool::Clear()
+{
+    iCount = 0;
+}
+
+size_t ParticlePool::GetResidentBytes() const
+{
+    // The padding group left by SetCapacity(0) is not worth releasing again.
+    if ( IsReleased() )
+        return 0;
+
+    return X.size() * 10 * sizeof(float);
+}
+
+void ParticlePool::OnRelease()
+{
+    // A second release would lose the capacity to restore.
+    if ( IsReleased() )
+        return;
+
+    int iMax = iCapacity;
+    SetCapacity(0);
+    iReleasedCapacity = iMax;
+}
+
+bool ParticlePool::OnRestore()
+{
+    SetCapacity(iReleasedCapacity);
+    return true;
+}
+
+void ParticlePool::SetGravity(float x, float y, float z)
+{
+    Gravity[0] = x;
+    Gravity[1] = y;
+    Gravity[2] = z;
+}
+
+bool ParticlePool::Spawn(const float Position[3], const float Velocity[3], float fLifetime, Uint32 iColor)
+{
+    // A pool released in the background comes back with its first new particle.
+    if ( iCount >= iCapacity && IsReleased() )
+        EnsureResident();
+
+    if ( iCount >= iCapacity || fLifetime <= 0.0f )
+        return false;
+
+    int i = iCount++;
+    X[i] = Position[0];     Y[i] = Position[1];     Z[i] = Position[2];
+    VX[i] = Velocity[0];    VY[i] = Velocity[1];    VZ[i] = Velocity[2];
+    Life[i]         = fLifetime;
+    InvLifetime[i]  = 1.0f / fLifetime;
+    Fade[i]         = 1.0f;
+    Color[i]        = iColor;
+    return true;
+}
+
+/** xorshift32 mapped to [-1, 1]. **/
+float ParticlePool::Random()
+{
+    iSeed ^= iSeed << 13;
+    iSeed ^= iSeed >> 17;
+    iSeed ^= iSeed << 5;
+    return (float)(iSeed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+int ParticlePool::Emit(int iParticles, const float Origin[3], float fSpeed, float fLifetime, Uint32 iColor)
+{
+    int iAdded = 0;
+
+    for ( ; iAdded < iParticles; ++iAdded ) {
+        float Velocity[3] = { Random() * fSpeed, Random() * fSpeed, Random() * fSpeed };
+        float fLife = fLifetime * (0.75f + 0.25f * Random());
+
+        if ( !Spawn(Origin, Velocity, fLife, iColor) )
+            break;
+    }
+    return iAdded;
+}
+
+void ParticlePool::Update(float fSeconds)
+{
+#if defined(PARTICLES_SSE)
+    const __m128 dt = _mm_set1_ps(fSeconds);
+    const __m128 gx = _mm_set1_ps(Gravity[0] * fSeconds);
+    const __m128 gy = _mm_set1_ps(Gravity[1] * fSeconds);
+    const __m128 gz = _mm_set1_ps(Gravity[2] * fSeconds);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for ( int i = 0; i < iCount; i += 4 ) {
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(&VX[i]), gx);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(&VY[i]), gy);
+        __m128 vz = _mm_add_ps(_mm_loadu_ps(&VZ[i]), gz);
+        _mm_storeu_ps(&VX[i], vx);
+        _mm_storeu_ps(&VY[i], vy);
+        _mm_storeu_ps(&VZ[i], vz);
+
+        _mm_storeu_ps(&X[i], _mm_add_ps(_mm_loadu_ps(&X[i]), _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(&Y[i], _mm_add_ps(_mm_loadu_ps(&Y[i]), _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(&Z[i], _mm_add_ps(_mm_loadu_ps(&Z[i]), _mm_mul_ps(vz, dt)));
+
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(&Life[i]), dt);
+        _mm_storeu_ps(&Life[i], life);
+        __m128 fade = _mm_mul_ps(life, _mm_loadu_ps(&InvLifetime[i]));
+        _mm_storeu_ps(&Fade[i], _mm_min_ps(_mm_max_ps(fade, zero), one));
+    }
+
+    Compact();
+#elif defined(PARTICLES_NEON)
+    const float32x4_t dt = vdupq_n_f32(fSeconds);
+    const float32x4_t gx = vdupq_n_f32(Gravity[0] * fSeconds);
+    const float32x4_t gy = vdupq_n_f32(Gravity[1] * fSeconds);
+    const float32x4_t gz = vdupq_n_f32(Gravity[2] * fSeconds);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    for ( int i = 0; i < iCount; i += 4 ) {
+        float32x4_t vx = vaddq_f32(vld1q_f32(&VX[i]), gx);
+        float32x4_t vy = vaddq_f32(vld1q_f32(&VY[i]), gy);
+        float32x4_t vz = vaddq_f32(vld1q_f32(&VZ[i]), gz);
+        vst1q_f32(&VX[i], vx);
+        vst1q_f32(&VY[i], vy);
+        vst1q_f32(&VZ[i], vz);
+
+        vst1q_f32(&X[i], vmlaq_f32(vld1q_f32(&X[i]), vx, dt));
+        vst1q_f32(&Y[i], vmlaq_f32(vld1q_f32(&Y[i]), vy, dt));
+        vst1q_f32(&Z[i], vmlaq_f32(vld1q_f32(&Z[i]), vz, dt));
+
+        float32x4_t life = vsubq_f32(vld1q_f32(&Life[i]), dt);
+        vst1q_f32(&Life[i], life);
+        float32x4_t fade = vmulq_f32(life, vld1q_f32(&InvLifetime[i]));
+        vst1q_f32(&Fade[i], vminq_f32(vmaxq_f32(fade, zero), one));
+    }
+
+    Compact();
+#else
+    UpdateScalar(fSeconds);
+#endif
+}
+
+void ParticlePool::UpdateScalar(float fSeconds)
+{
+    float gx = Gravity[0] * fSeconds, gy = Gravity[1] * fSeconds, gz = Gravity[2] * fSeconds;
+
+    for ( int i = 0; i < iCount; ++i ) {
+        VX[i] += gx;
+        VY[i] += gy;
+        VZ[i] += gz;
+        X[i] += VX[i] * fSeconds;
+        Y[i] += VY[i] * fSeconds;
+        Z[i] += VZ[i] * fSeconds;
+
+        Life[i] -= fSeconds;
+        float fFade = Life[i] * InvLifetime[i];
+        Fade[i] = fFade < 0.0f ? 0.0f : (fFade > 1.0f ? 1.0f : fFade);
+    }
+
+    Compact();
+}
+
+/** Swap-remove: the last live particle fills the slot of each dead one. **/
+void ParticlePool::Compact()
+{
+    int i = 0;
+
+    while ( i < iCount ) {
+        if ( Life[i] > 0.0f ) {
+            ++i;
+            continue;
+        }
+
+        int iLast = --iCount;
+        X[i] = X[iLast];    Y[i] = Y[iLast];    Z[i] = Z[iLast];
+        VX[i] = VX[iLast];  VY[i] = VY[iLast];  VZ[i] = VZ[iLast];
+        Life[i]         = Life[iLast];
+        InvLifetime[i]  = InvLifetime[iLast];
+        Fade[i]         = Fade[iLast];
+        Color[i]        = Color[iLast];
+    }
+}
+
+ParticleRenderer::ParticleRenderer()
+    : iProgram(0), iBuffer(0), iViewProj(-1), iPointSize(-1)
+{
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+    Release();
+}
+
+bool ParticleRenderer::Init()
+{
+    Release();
+
+    iProgram = glCreateProgram();
+    glAttachShader(iProgram, CompileShader(GL_VERTEX_SHADER, PARTICLE_VERTEX_SHADER));
+    glAttachShader(iProgram, CompileShader(GL_FRAGMENT_SHADER, PARTICLE_FRAGMENT_SHADER));
+
+    glBindAttribLocation(iProgram, PARTICLE_ATTRIB_X, "X");
+    glBindAttribLocation(iProgram, PARTICLE_ATTRIB_Y, "Y");
+    glBindAttribLocation(iProgram, PARTICLE_ATTRIB_Z, "Z");
+    glBindAttribLocation(iProgram, PARTICLE_ATTRIB_FADE, "Fade");
+    glBindAttribLocation(iProgram, PARTICLE_ATTRIB_COLOR, "Color");
+    glLinkProgram(iProgram);
+
+    GLint iStatus;
+    glGetProgramiv(iProgram, GL_LINK_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        printf("Error: Failed to link the particle shader\n");
+        return false;
+    }
+
+    iViewProj  = glGetUniformLocation(iProgram, "ViewProj");
+    iPointSize = glGetUniformLocation(iProgram, "PointSize");
+
+    glGenBuffers(1, &iBuffer);
+    return true;
+}
+
+void ParticleRenderer::Release()
+{
+    if ( iProgram )
+        glDeleteProgram(iProgram);
+    if ( iBuffer )
+        glDeleteBuffers(1, &iBuffer);
+
+    iProgram = iBuffer = 0;
+}
+
+void ParticleRenderer::Draw(const ParticlePool& pool, const float ViewProj[4][4], float fPointSize)
+{
+    GLsizei n = pool.GetCount();
+    if ( n == 0 || !iProgram )
+        return;
+
+    GLsizeiptr iStream = n * sizeof(float);
+
+    // Orphan the old storage, then fill the five streams back to back.
+    glBindBuffer(GL_ARRAY_BUFFER, iBuffer);
+    glBufferData(GL_ARRAY_BUFFER, iStream * 5, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,           iStream, pool.GetX());
+    glBufferSubData(GL_ARRAY_BUFFER, iStream,     iStream, pool.GetY());
+    glBufferSubData(GL_ARRAY_BUFFER, iStream * 2, iStream, pool.GetZ());
+    glBufferSubData(GL_ARRAY_BUFFER, iStream * 3, iStream, pool.GetFade());
+    glBufferSubData(GL_ARRAY_BUFFER, iStream * 4, iStream, pool.GetColor());
+
+    glUseProgram(iProgram);
+    glUniformMatrix4fv(iViewProj, 1, GL_FALSE, &ViewProj[0][0]);
+    glUniform1f(iPointSize, fPointSize);
+
+    glVertexAttribPointer(PARTICLE_ATTRIB_X,     1, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+    glVertexAttribPointer(PARTICLE_ATTRIB_Y,     1, GL_FLOAT, GL_FALSE, 0, (const void*)iStream);
+    glVertexAttribPointer(PARTICLE_ATTRIB_Z,     1, GL_FLOAT, GL_FALSE, 0, (const void*)(iStream * 2));
+    glVertexAttribPointer(PARTICLE_ATTRIB_FADE,  1, GL_FLOAT, GL_FALSE, 0, (const void*)(iStream * 3));
+    glVertexAttribPointer(PARTICLE_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const void*)(iStream * 4));
+    for ( GLuint i = 0; i < PARTICLE_ATTRIB_COUNT; ++i )
+        glEnableVertexAttribArray(i);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glDrawArrays(GL_POINTS, 0, n);
+    glDisable(GL_BLEND);
+
+    // The model shaders set up attributes 0 and 1 themselves and read the rest as constants.
+    for ( GLuint i = 2; i < PARTICLE_ATTRIB_COUNT; ++i )
+        glDisableVertexAttribArray(i);
+}
@@ -0,0 +1,213 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RenderQueue.h"
+
+namespace {
+
+const int       KEY_SEQUENCE_BITS   = 14;
+const Uint32    KEY_DEPTH_MAX       = (1u << 24) - 1;
+
+//Scale and bias of packets with float positions.
+const float     IDENTITY_SCALE[3]   = { 1.0f, 1.0f, 1.0f };
+const float     IDENTITY_BIAS[3]    = { 0.0f, 0.0f, 0.0f };
+
+inline Uint64 Bits(Uint64 iValue, int iShift)
+{
+    return iValue << iShift;
+}
+
+}
+
+RenderQueue::RenderQueue()
+    : fFarDepth(200.0f)
+{
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+int RenderQueue::ProgramIndex(GLuint iProgram)
+{
+    for ( size_t i = 0; i < Programs.size(); ++i )
+        if ( Programs[i].iProgram == iProgram )
+            return (int)i;
+
+    ProgramSlot slot;
+    slot.iProgram       = iProgram;
+    slot.iModel         = glGetUniformLocation(iProgram, "Model");
+    slot.iPositionScale = glGetUniformLocation(iProgram, "PositionScale");
+    slot.iPositionBias  = glGetUniformLocation(iProgram, "PositionBias");
+    Programs.push_back(slot);
+
+    return (int)Programs.size() - 1;
+}
+
+void RenderQueue::Add(const DrawPacket& packet)
+{
+    float fDepth = packet.fDepth / fFarDepth;
+    fDepth = fDepth < 0.0f ? 0.0f : (fDepth > 1.0f ? 1.0f : fDepth);
+
+    Uint64 iDepth       = (Uint64)(fDepth * KEY_DEPTH_MAX);
+    Uint64 iProgram     = (Uint64)(ProgramIndex(packet.iProgram) & 0xFF);
+    Uint64 iSequence    = (Uint64)Packets.size();
+    Uint64 iKey         = Bits((Uint64)packet.Pass, 62);
+
+    switch ( packet.Pass ) {
+    case RENDER_PASS_OPAQUE:
+        iKey |= Bits(iProgram, 54) | Bits(packet.iMaterial, 38) | Bits(iDepth, 14);
+        break;
+    case RENDER_PASS_BLENDED:
+        iKey |= Bits(KEY_DEPTH_MAX - iDepth, 38) | Bits(iProgram, 30) | Bits(packet.iMaterial, 14);
+        break;
+    default:
+        iKey |= Bits(iSequence & KEY_DEPTH_MAX, 38);
+        break;
+    }
+
+    // The packet index rides along in the low bits, it also keeps the sort stable.
+    Keys.push_back(iKey | (iSequence & ((1u << KEY_SEQUENCE_BITS) - 1)));
+    Packets.push_back(packet);
+}
+
+void RenderQueue::Clear()
+{
+    Packets.clear();
+    Keys.clear();
+}
+
+/** LSD radix sort, 8 bits per pass; passes where every key has the same digit are skipped. **/
+void RenderQueue::Sort()
+{
+    size_t iCount = Keys.size();
+    SortedKeys.resize(iCount);
+
+    Uint64* pFrom   = &Keys[0];
+    Uint64* pTo     = &SortedKeys[0];
+
+    for ( int iShift = 0; iShift < 64; iShift += 8 ) {
+        size_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+
+        for ( size_t i = 0; i < iCount; ++i )
+            ++histogram[(pFrom[i] >> iShift) & 0xFF];
+
+        if ( histogram[(pFrom[0] >> iShift) & 0xFF] == iCount )
+            continue;
+
+        size_t iOffset = 0;
+        for ( int d = 0; d < 256; ++d ) {
+            size_t iDigit = histogram[d];
+            histogram[d] = iOffset;
+            iOffset += iDigit;
+        }
+
+        for ( size_t i = 0; i < iCount; ++i )
+            pTo[histogram[(pFrom[i] >> iShift) & 0xFF]++] = pFrom[i];
+
+        Uint64* pSwap = pFrom;
+        pFrom = pTo;
+        pTo = pSwap;
+    }
+
+    if ( pFrom != &Keys[0] )
+        Keys.swap(SortedKeys);
+}
+
+void RenderQueue::Submit()
+{
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.iPackets = (int)Packets.size();
+
+    if ( Packets.empty() )
+        return;
+
+    // More packets than sequence bits would lose their index.
+    if ( Packets.size() > (1u << KEY_SEQUENCE_BITS) ) {
+        fprintf(stderr, "RenderQueue holds %d packets, drawing the first %d\n", (int)Packets.size(), 1 << KEY_SEQUENCE_BITS);
+        Packets.resize(1u << KEY_SEQUENCE_BITS);
+        Keys.resize(Packets.size());
+    }
+
+    Sort();
+
+    GLuint  iProgram = 0, iVertexBuffer = 0, iIndexBuffer = 0, iTexture = 0;
+    const VertexLayout* pLayout = 0;
+    const float* pScale = 0;
+    const float* pBias = 0;
+    int     iPass = -1;
+    const ProgramSlot* pSlot = 0;
+
+    // Packet textures go to unit 0, whichever unit the last pass left active.
+    glActiveTexture(GL_TEXTURE0);
+
+    for ( size_t i = 0; i < Keys.size(); ++i ) {
+        const DrawPacket& packet = Packets[Keys[i] & ((1u << KEY_SEQUENCE_BITS) - 1)];
+
+        if ( packet.Pass != iPass ) {
+            iPass = packet.Pass;
+            if ( packet.Pass == RENDER_PASS_OPAQUE ) {
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+            } else {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glDepthMask(GL_FALSE);
+            }
+            ++Stats.iBlendChanges;
+        }
+
+        if ( packet.iProgram != iProgram ) {
+            iProgram = packet.iProgram;
+            pSlot = &Programs[ProgramIndex(iProgram)];
+            glUseProgram(iProgram);
+            ++Stats.iProgramChanges;
+
+            // Uniform values belong to the program, reload them for the new one.
+            pScale = pBias = 0;
+        }
+
+        if ( packet.iVertexBuffer != iVertexBuffer || packet.pLayout != pLayout ) {
+            iVertexBuffer = packet.iVertexBuffer;
+            pLayout = packet.pLayout;
+            glBindBuffer(GL_ARRAY_BUFFER, iVertexBuffer);
+            pLayout->Bind(0);
+            ++Stats.iBufferChanges;
+        }
+
+        if ( packet.iIndexBuffer != iIndexBuffer ) {
+            iIndexBuffer = packet.iIndexBuffer;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+            ++Stats.iBufferChanges;
+        }
+
+        if ( packet.iTexture != iTexture ) {
+            iTexture = packet.iTexture;
+            glBindTexture(GL_TEXTURE_2D, iTexture);
+            ++Stats.iTextureChanges;
+        }
+
+        // Float positions still need the uniforms reset from a quantized packet or Display().
+        const float* pPacketScale = packet.pPositionScale ? packet.pPositionScale : IDENTITY_SCALE;
+        const float* pPacketBias = packet.pPositionBias ? packet.pPositionBias : IDENTITY_BIAS;
+
+        if ( pPacketScale != pScale || pPacketBias != pBias ) {
+            pScale = pPacketScale;
+            pBias = pPacketBias;
+            glUniform3fv(pSlot->iPositionScale, 1, pScale);
+            glUniform3fv(pSlot->iPositionBias, 1, pBias);
+        }
+
+        glUniformMatrix4fv(pSlot->iModel, 1, GL_FALSE, &packet.Model[0][0]);
+        glDrawElements(GL_TRIANGLES, packet.iIndexCount, GL_UNSIGNED_SHORT,
+                       (const void*)((size_t)packet.iFirstIndex * sizeof(Uint16)));
+    }
+
+    // Per packet: blend state, program, two buffers and a texture.
+    Stats.iRedundantChanges = Stats.iPackets * 5
+                            - Stats.iBlendChanges - Stats.iProgramChanges - Stats.iBufferChanges - Stats.iTextureChanges;
+
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+
+    Clear();
+}
@@ -0,0 +1,259 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Replay.h"
+
+namespace {
+
+//Event kinds stored in a recording.
+enum
+{
+    KIND_QUIT = 0,
+    KIND_KEYDOWN,
+    KIND_KEYUP,
+    KIND_MOTION,
+    KIND_BUTTONDOWN,
+    KIND_BUTTONUP
+};
+
+}
+
+/** Default constructor. **/
+InputRecorder::InputRecorder()
+{
+    pFile       = 0;
+    iLastFrame  = 0;
+}
+
+/**
+ * Destructor
+ */
+InputRecorder::~InputRecorder()
+{
+    Close();
+}
+
+/** Creates the recording file.
+    @param iStepMs Frame duration used when the recording is replayed.
+    @return false if the file could not be created.
+**/
+bool InputRecorder::Open(const char* czPath, Uint16 iStepMs)
+{
+    Close();
+
+    pFile = SDL_RWFromFile(czPath, "wb");
+    if ( !pFile ) {
+        fprintf( stderr, "Unable to record input to %s: %s\n", czPath, SDL_GetError() );
+        return false;
+    }
+
+    SDL_WriteLE32(pFile, REPLAY_MAGIC);
+    SDL_WriteLE16(pFile, REPLAY_VERSION);
+    SDL_WriteLE16(pFile, iStepMs);
+
+    iLastFrame = 0;
+    return true;
+}
+
+void InputRecorder::Close()
+{
+    if ( pFile ) {
+        SDL_RWclose(pFile);
+        pFile = 0;
+    }
+}
+
+void InputRecorder::WriteVarint(Uint32 iValue)
+{
+    while ( iValue >= 0x80 ) {
+        SDL_WriteU8(pFile, (Uint8)(iValue | 0x80));
+        iValue >>= 7;
+    }
+    SDL_WriteU8(pFile, (Uint8)iValue);
+}
+
+/** Appends an event dispatched during the given frame. Unknown events are skipped. **/
+void InputRecorder::Record(Uint32 iFrame, const SDL_Event& event)
+{
+    if ( !pFile )
+        return;
+
+    Uint8 iKind;
+
+    switch ( event.type )
+    {
+        case SDL_QUIT:              iKind = KIND_QUIT;          break;
+        case SDL_KEYDOWN:           iKind = KIND_KEYDOWN;       break;
+        case SDL_KEYUP:             iKind = KIND_KEYUP;         break;
+        case SDL_MOUSEMOTION:       iKind = KIND_MOTION;        break;
+        case SDL_MOUSEBUTTONDOWN:   iKind = KIND_BUTTONDOWN;    break;
+        case SDL_MOUSEBUTTONUP:     iKind = KIND_BUTTONUP;      break;
+        default:
+            return;
+    }
+
+    WriteVarint(iFrame - iLastFrame);
+    iLastFrame = iFrame;
+
+    SDL_WriteU8(pFile, iKind);
+
+    switch ( iKind )
+    {
+        case KIND_KEYDOWN:
+        case KIND_KEYUP:
+            SDL_WriteLE32(pFile, (Uint32)event.key.keysym.sym);
+            SDL_WriteU8(pFile, event.key.repeat);
+            break;
+
+        case KIND_MOTION:
+            SDL_WriteLE16(pFile, (Uint16)event.motion.x);
+            SDL_WriteLE16(pFile, (Uint16)event.motion.y);
+            SDL_WriteLE16(pFile, (Uint16)event.motion.xrel);
+            SDL_WriteLE16(pFile, (Uint16)event.motion.yrel);
+            SDL_WriteU8(pFile, (Uint8)event.motion.state);
+            break;
+
+        case KIND_BUTTONDOWN:
+        case KIND_BUTTONUP:
+            SDL_WriteU8(pFile, event.button.button);
+            SDL_WriteLE16(pFile, (Uint16)event.button.x);
+            SDL_WriteLE16(pFile, (Uint16)event.button.y);
+            break;
+    }
+}
+
+/** Default constructor. **/
+InputReplayer::InputReplayer()
+{
+    pFile       = 0;
+    iStepMs     = 16;
+    bHasNext    = false;
+    iNextFrame  = 0;
+}
+
+/**
+ * Destructor
+ */
+InputReplayer::~InputReplayer()
+{
+    Close();
+}
+
+/** Opens a recording and validates its header.
+    @return false if the file is missing or not a recording.
+**/
+bool InputReplayer::Open(const char* czPath)
+{
+    Close();
+
+    pFile = SDL_RWFromFile(czPath, "rb");
+    if ( !pFile ) {
+        fprintf( stderr, "Unable to replay input from %s: %s\n", czPath, SDL_GetError() );
+        return false;
+    }
+
+    Uint32 iMagic   = SDL_ReadLE32(pFile);
+    Uint16 iVersion = SDL_ReadLE16(pFile);
+    iStepMs         = SDL_ReadLE16(pFile);
+
+    if ( iMagic != REPLAY_MAGIC || iVersion != REPLAY_VERSION || iStepMs == 0 ) {
+        fprintf( stderr, "%s is not an input recording\n", czPath );
+        Close();
+        return false;
+    }
+
+    iNextFrame = 0;
+    ReadNext();
+    return true;
+}
+
+void InputReplayer::Close()
+{
+    if ( pFile ) {
+        SDL_RWclose(pFile);
+        pFile = 0;
+    }
+    bHasNext = false;
+}
+
+bool InputReplayer::ReadVarint(Uint32& iValue)
+{
+    iValue = 0;
+
+    for ( int iShift = 0; iShift < 35; iShift += 7 ) {
+        Uint8 iByte;
+        if ( SDL_RWread(pFile, &iByte, 1, 1) != 1 )
+            return false;
+
+        iValue |= (Uint32)(iByte & 0x7F) << iShift;
+        if ( !(iByte & 0x80) )
+            return true;
+    }
+
+    return false;
+}
+
+/** Decodes the next record into Next. **/
+bool InputReplayer::ReadNext()
+{
+    Uint32 iDelta;
+    Uint8 iKind;
+
+    bHasNext = false;
+
+    if ( !pFile || !ReadVarint(iDelta) || SDL_RWread(pFile, &iKind, 1, 1) != 1 )
+        return false;
+
+    iNextFrame += iDelta;
+    memset(&Next, 0, sizeof(Next));
+
+    switch ( iKind )
+    {
+        case KIND_QUIT:
+            Next.type = SDL_QUIT;
+            break;
+
+        case KIND_KEYDOWN:
+        case KIND_KEYUP:
+            Next.type               = iKind == KIND_KEYDOWN ? SDL_KEYDOWN : SDL_KEYUP;
+            Next.key.keysym.sym     = (SDL_Keycode)SDL_ReadLE32(pFile);
+            Next.key.repeat         = SDL_ReadU8(pFile);
+            Next.key.state          = iKind == KIND_KEYDOWN ? 1 : 0;
+            break;
+
+        case KIND_MOTION:
+            Next.type               = SDL_MOUSEMOTION;
+            Next.motion.x           = (Sint16)SDL_ReadLE16(pFile);
+            Next.motion.y           = (Sint16)SDL_ReadLE16(pFile);
+            Next.motion.xrel        = (Sint16)SDL_ReadLE16(pFile);
+            Next.motion.yrel        = (Sint16)SDL_ReadLE16(pFile);
+            Next.motion.state       = SDL_ReadU8(pFile);
+            break;
+
+        case KIND_BUTTONDOWN:
+        case KIND_BUTTONUP:
+            Next.type               = iKind == KIND_BUTTONDOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+            Next.button.button      = SDL_ReadU8(pFile);
+            Next.button.x           = (Sint16)SDL_ReadLE16(pFile);
+            Next.button.y           = (Sint16)SDL_ReadLE16(pFile);
+            Next.button.state       = iKind == KIND_BUTTONDOWN ? 1 : 0;
+            break;
+
+        default:
+            fprintf( stderr, "Corrupt input recording, unknown event kind %d\n", iKind );
+            return false;
+    }
+
+    bHasNext = true;
+    return true;
+}
+
+void InputReplayer::ReadFrame(Uint32 iFrame, std::vector<SDL_Event>& events)
+{
+    while ( bHasNext && iNextFrame <= iFrame ) {
+        Next.common.timestamp = iNextFrame * iStepMs;
+        events.push_back(Next);
+        ReadNext();
+    }
+}
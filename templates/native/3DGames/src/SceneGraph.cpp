@@ -0,0 +1,252 @@
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SCENEGRAPH_SSE 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCENEGRAPH_NEON 1
+#endif
+
+#include "SceneGraph.h"
+
+/** Gribb-Hartmann: each plane is the last row of M plus or minus another row. **/
+void Frustum::FromMatrix(const float M[4][4])
+{
+    for ( int i = 0; i < 6; ++i ) {
+        int iRow = i / 2;
+        float fSign = ( i & 1 ) ? -1.0f : 1.0f;
+
+        a[i] = M[0][3] + fSign * M[0][iRow];
+        b[i] = M[1][3] + fSign * M[1][iRow];
+        c[i] = M[2][3] + fSign * M[2][iRow];
+        d[i] = M[3][3] + fSign * M[3][iRow];
+
+        float fLength = sqrtf(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]);
+        if ( fLength > 0.0f ) {
+            a[i] /= fLength;
+            b[i] /= fLength;
+            c[i] /= fLength;
+            d[i] /= fLength;
+        }
+    }
+}
+
+SceneGraph::SceneGraph()
+    : iUpdated(0), iCulled(0)
+{
+}
+
+void SceneGraph::Multiply(float R[4][4], const float A[4][4], const float B[4][4])
+{
+    float T[4][4];
+
+    for ( int c = 0; c < 4; ++c )
+        for ( int r = 0; r < 4; ++r )
+            T[c][r] = A[0][r] * B[c][0] + A[1][r] * B[c][1] + A[2][r] * B[c][2] + A[3][r] * B[c][3];
+
+    memcpy(R, T, sizeof(T));
+}
+
+void SceneGraph::Identity(float M[4][4])
+{
+    memset(M, 0, sizeof(float) * 16);
+    M[0][0] = M[1][1] = M[2][2] = M[3][3] = 1.0f;
+}
+
+int SceneGraph::AddNode(int iParent, void* pUserData)
+{
+    int iNode = (int)Parents.size();
+
+    Matrix identity;
+    Identity(identity.m);
+
+    Parents.push_back(iParent < iNode ? iParent : -1);
+    Locals.push_back(identity);
+    Worlds.push_back(identity);
+    Dirty.push_back(1);
+    Visible.push_back(1);
+    UserData.push_back(pUserData);
+
+    LocalBounds.push_back(0.0f);
+    LocalBounds.push_back(0.0f);
+    LocalBounds.push_back(0.0f);
+    LocalBounds.push_back(0.0f);
+
+    // Padding spheres have a negative radius and are never visible.
+    size_t iPadded = (Parents.size() + 3) & ~(size_t)3;
+    SphereX.resize(iPadded, 0.0f);
+    SphereY.resize(iPadded, 0.0f);
+    SphereZ.resize(iPadded, 0.0f);
+    SphereR.resize(iPadded, -1e30f);
+    SphereR[iNode] = 0.0f;
+
+    return iNode;
+}
+
+void SceneGraph::Clear()
+{
+    Parents.clear();
+    Locals.clear();
+    Worlds.clear();
+    Dirty.clear();
+    Visible.clear();
+    UserData.clear();
+    LocalBounds.clear();
+    SphereX.clear();
+    SphereY.clear();
+    SphereZ.clear();
+    SphereR.clear();
+}
+
+void SceneGraph::SetLocal(int iNode, const float M[4][4])
+{
+    memcpy(Locals[iNode].m, M, sizeof(float) * 16);
+    Dirty[iNode] = 1;
+}
+
+void SceneGraph::SetBounds(int iNode, float x, float y, float z, float fRadius)
+{
+    float* p = &LocalBounds[iNode * 4];
+    p[0] = x;
+    p[1] = y;
+    p[2] = z;
+    p[3] = fRadius;
+    Dirty[iNode] = 1;
+}
+
+void SceneGraph::Update()
+{
+    iUpdated = 0;
+
+    for ( size_t i = 0; i < Parents.size(); ++i ) {
+        int iParent = Parents[i];
+
+        // The parent was visited first, so its flag already covers its ancestors.
+        if ( iParent >= 0 && Dirty[iParent] )
+            Dirty[i] = 1;
+
+        if ( !Dirty[i] )
+            continue;
+
+        float (*W)[4] = Worlds[i].m;
+        if ( iParent >= 0 )
+            Multiply(W, Worlds[iParent].m, Locals[i].m);
+        else
+            memcpy(W, Locals[i].m, sizeof(float) * 16);
+
+        // The radius follows the largest axis scale.
+        const float* b = &LocalBounds[i * 4];
+        float fScale = 0.0f;
+        for ( int c = 0; c < 3; ++c ) {
+            float s = W[c][0] * W[c][0] + W[c][1] * W[c][1] + W[c][2] * W[c][2];
+            if ( s > fScale )
+                fScale = s;
+        }
+
+        SphereX[i] = W[0][0] * b[0] + W[1][0] * b[1] + W[2][0] * b[2] + W[3][0];
+        SphereY[i] = W[0][1] * b[0] + W[1][1] * b[1] + W[2][1] * b[2] + W[3][1];
+        SphereZ[i] = W[0][2] * b[0] + W[1][2] * b[1] + W[2][2] * b[2] + W[3][2];
+        SphereR[i] = b[3] * sqrtf(fScale);
+
+        ++iUpdated;
+    }
+
+    // Cleared after the pass, children read their parent's flag during it.
+    if ( !Dirty.empty() )
+        memset(&Dirty[0], 0, Dirty.size());
+}
+
+int SceneGraph::Cull(const float ViewProj[4][4], std::vector<int>* pVisible)
+{
+#if defined(SCENEGRAPH_SSE) || defined(SCENEGRAPH_NEON)
+    Frustum frustum;
+    frustum.FromMatrix(ViewProj);
+
+    int iCount = (int)Parents.size();
+    int iVisible = 0;
+
+    for ( int i = 0; i < iCount; i += 4 ) {
+        int iMask;
+
+#if defined(SCENEGRAPH_SSE)
+        __m128 x = _mm_loadu_ps(&SphereX[i]);
+        __m128 y = _mm_loadu_ps(&SphereY[i]);
+        __m128 z = _mm_loadu_ps(&SphereZ[i]);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&SphereR[i]));
+        __m128 inside = _mm_cmpeq_ps(x, x);
+
+        for ( int p = 0; p < 6; ++p ) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(frustum.a[p])),
+                                                _mm_mul_ps(y, _mm_set1_ps(frustum.b[p]))),
+                                     _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(frustum.c[p])),
+                                                _mm_set1_ps(frustum.d[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, r));
+        }
+        iMask = _mm_movemask_ps(inside);
+#else
+        float32x4_t x = vld1q_f32(&SphereX[i]);
+        float32x4_t y = vld1q_f32(&SphereY[i]);
+        float32x4_t z = vld1q_f32(&SphereZ[i]);
+        float32x4_t r = vnegq_f32(vld1q_f32(&SphereR[i]));
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+
+        for ( int p = 0; p < 6; ++p ) {
+            float32x4_t dist = vdupq_n_f32(frustum.d[p]);
+            dist = vmlaq_n_f32(dist, x, frustum.a[p]);
+            dist = vmlaq_n_f32(dist, y, frustum.b[p]);
+            dist = vmlaq_n_f32(dist, z, frustum.c[p]);
+            inside = vandq_u32(inside, vcgeq_f32(dist, r));
+        }
+        iMask = (vgetq_lane_u32(inside, 0) & 1) | (vgetq_lane_u32(inside, 1) & 2)
+              | (vgetq_lane_u32(inside, 2) & 4) | (vgetq_lane_u32(inside, 3) & 8);
+#endif
+
+        for ( int k = 0; k < 4 && i + k < iCount; ++k ) {
+            Uint8 bVisible = (Uint8)((iMask >> k) & 1);
+            Visible[i + k] = bVisible;
+            if ( bVisible ) {
+                ++iVisible;
+                if ( pVisible )
+                    pVisible->push_back(i + k);
+            }
+        }
+    }
+
+    iCulled = iCount - iVisible;
+    return iVisible;
+#else
+    return CullScalar(ViewProj, pVisible);
+#endif
+}
+
+int SceneGraph::CullScalar(const float ViewProj[4][4], std::vector<int>* pVisible)
+{
+    Frustum frustum;
+    frustum.FromMatrix(ViewProj);
+
+    int iCount = (int)Parents.size();
+    int iVisible = 0;
+
+    for ( int i = 0; i < iCount; ++i ) {
+        Uint8 bVisible = 1;
+
+        for ( int p = 0; p < 6 && bVisible; ++p ) {
+            float fDist = frustum.a[p] * SphereX[i] + frustum.b[p] * SphereY[i]
+                        + frustum.c[p] * SphereZ[i] + frustum.d[p];
+            bVisible = fDist >= -SphereR[i];
+        }
+
+        Visible[i] = bVisible;
+        if ( bVisible ) {
+            ++iVisible;
+            if ( pVisible )
+                pVisible->push_back(i);
+        }
+    }
+
+    iCulled = iCount - iVisible;
+    return iVisible;
+}
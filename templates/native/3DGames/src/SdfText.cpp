@@ -0,0 +1,547 @@
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "SDL_ttf.h"
+#include "SdfText.h"
+
+namespace {
+
+const char      SDF_MAGIC[4]    = { 'S', 'D', 'F', '1' };
+const int       SDF_SOLID_SIZE  = 4;
+const Uint32    SDF_FAR         = 0x3FFF;
+
+struct Offset
+{
+    int dx, dy;
+
+    int Length2() const { return dx * dx + dy * dy; }
+};
+
+inline void Compare(std::vector<Offset>& grid, int w, int h, int x, int y, int ox, int oy)
+{
+    if ( x + ox < 0 || y + oy < 0 || x + ox >= w || y + oy >= h )
+        return;
+
+    Offset& p = grid[y * w + x];
+    Offset other = grid[(y + oy) * w + x + ox];
+    other.dx += ox;
+    other.dy += oy;
+
+    if ( other.Length2() < p.Length2() )
+        p = other;
+}
+
+/** 8SSEDT: two raster passes give every cell the offset to the nearest seed. **/
+void Propagate(std::vector<Offset>& grid, int w, int h)
+{
+    for ( int y = 0; y < h; ++y ) {
+        for ( int x = 0; x < w; ++x ) {
+            Compare(grid, w, h, x, y, -1,  0);
+            Compare(grid, w, h, x, y,  0, -1);
+            Compare(grid, w, h, x, y, -1, -1);
+            Compare(grid, w, h, x, y,  1, -1);
+        }
+        for ( int x = w - 1; x >= 0; --x )
+            Compare(grid, w, h, x, y, 1, 0);
+    }
+
+    for ( int y = h - 1; y >= 0; --y ) {
+        for ( int x = w - 1; x >= 0; --x ) {
+            Compare(grid, w, h, x, y,  1,  0);
+            Compare(grid, w, h, x, y,  0,  1);
+            Compare(grid, w, h, x, y, -1,  1);
+            Compare(grid, w, h, x, y,  1,  1);
+        }
+        for ( int x = 0; x < w; ++x )
+            Compare(grid, w, h, x, y, -1, 0);
+    }
+}
+
+/**
+ * Converts a coverage mask into a distance field, 128 on the outline and
+ * +-127 at iSpread pixels inside or outside.
+ */
+void DistanceField(const std::vector<Uint8>& mask, int w, int h, int iSpread, Uint8* pOut, int iPitch)
+{
+    Offset seed = { 0, 0 }, distant = { (int)SDF_FAR, (int)SDF_FAR };
+    std::vector<Offset> outside(w * h), inside(w * h);
+
+    for ( int i = 0; i < w * h; ++i ) {
+        bool bInside = mask[i] >= 128;
+        outside[i] = bInside ? seed : distant;
+        inside[i]  = bInside ? distant : seed;
+    }
+
+    Propagate(outside, w, h);
+    Propagate(inside, w, h);
+
+    for ( int y = 0; y < h; ++y ) {
+        for ( int x = 0; x < w; ++x ) {
+            int i = y * w + x;
+            float fDist = sqrtf((float)outside[i].Length2()) - sqrtf((float)inside[i].Length2());
+            int v = 128 - (int)(fDist * 127.0f / iSpread);
+            pOut[y * iPitch + x] = (Uint8)(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+    }
+}
+
+Uint32 FileSize(const char* czPath)
+{
+    SDL_RWops* pFile = SDL_RWFromFile(czPath, "rb");
+    if ( !pFile )
+        return 0;
+
+    Sint64 iSize = SDL_RWsize(pFile);
+    SDL_RWclose(pFile);
+    return iSize > 0 ? (Uint32)iSize : 0;
+}
+
+const char* TEXT_VERTEX_SHADER =
+    "attribute vec2 Position;                                   \n"
+    "attribute vec2 TexCoord;                                   \n"
+    "attribute vec4 Color;                                      \n"
+    "attribute float Softness;                                  \n"
+    "                                                           \n"
+    "uniform vec2 Screen;                                       \n"
+    "                                                           \n"
+    "varying vec2 Uv;                                           \n"
+    "varying vec4 Tint;                                         \n"
+    "varying float Soft;                                        \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    gl_Position = vec4(Position * Screen + vec2(-1.0, 1.0), 0.0, 1.0); \n"
+    "    Uv   = TexCoord;                                       \n"
+    "    Tint = Color;                                          \n"
+    "    Soft = Softness;                                       \n"
+    "}                                                          \n";
+
+const char* TEXT_FRAGMENT_SHADER =
+    "precision mediump float;                                   \n"
+    "                                                           \n"
+    "uniform sampler2D Atlas;                                   \n"
+    "                                                           \n"
+    "varying vec2 Uv;                                           \n"
+    "varying vec4 Tint;                                         \n"
+    "varying float Soft;                                        \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    float Distance = texture2D(Atlas, Uv).a;               \n"
+    "    float Alpha = smoothstep(0.5 - Soft, 0.5 + Soft, Distance); \n"
+    "    gl_FragColor = vec4(Tint.rgb, Tint.a * Alpha);         \n"
+    "}                                                          \n";
+
+GLuint CompileShader(GLenum type, const char* czSource)
+{
+    GLuint iShader = glCreateShader(type);
+    glShaderSource(iShader, 1, &czSource, NULL);
+    glCompileShader(iShader);
+
+    GLint iStatus;
+    glGetShaderiv(iShader, GL_COMPILE_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        char error[1024];
+        glGetShaderInfoLog(iShader, sizeof(error), NULL, error);
+        printf("Error: Failed to compile text shader\n%s", error);
+    }
+    return iShader;
+}
+
+}
+
+SdfFont::SdfFont()
+    : iTexture(0), iAtlasSize(0), iBaseSize(0), iSpread(0), iLineSkip(0), iSolidX(0), iSolidY(0)
+{
+    memset(Glyphs, 0, sizeof(Glyphs));
+}
+
+SdfFont::~SdfFont()
+{
+    Release();
+}
+
+bool SdfFont::Load(const char* czFontPath, const char* czCachePath, int iSize)
+{
+    Release();
+
+    FontPath    = czFontPath;
+    CachePath   = czCachePath ? czCachePath : "";
+
+    Uint32 iFontSize = FileSize(czFontPath);
+    std::vector<Uint8> atlas;
+
+    iBaseSize   = iSize;
+    iSpread     = iSize / 8 > 2 ? iSize / 8 : 2;
+
+    if ( !czCachePath || !ReadCache(czCachePath, iFontSize, atlas) ) {
+        if ( !Generate(czFontPath, atlas) )
+            return false;
+        if ( czCachePath )
+            WriteCache(czCachePath, iFontSize, atlas);
+    }
+
+    glGenTextures(1, &iTexture);
+    glBindTexture(GL_TEXTURE_2D, iTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, iAtlasSize, iAtlasSize, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &atlas[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return true;
+}
+
+void SdfFont::Release()
+{
+    if ( iTexture )
+        glDeleteTextures(1, &iTexture);
+    iTexture = 0;
+}
+
+size_t SdfFont::GetResidentBytes() const
+{
+    return iTexture ? (size_t)iAtlasSize * iAtlasSize : 0;
+}
+
+void SdfFont::OnRelease()
+{
+    Release();
+}
+
+bool SdfFont::OnRestore()
+{
+    std::string font(FontPath), cache(CachePath);
+
+    return Load(font.c_str(), cache.empty() ? 0 : cache.c_str(), iBaseSize);
+}
+
+const SdfGlyph* SdfFont::GetGlyph(char c) const
+{
+    int i = (unsigned char)c - SDF_FIRST_CHAR;
+    return i >= 0 && i < SDF_GLYPH_COUNT ? &Glyphs[i] : 0;
+}
+
+/** Renders every glyph with SDL_ttf and packs the distance fields into rows. **/
+bool SdfFont::Generate(const char* czFontPath, std::vector<Uint8>& atlas)
+{
+    TTF_Font* pFont = TTF_OpenFont(czFontPath, iBaseSize);
+    if ( !pFont ) {
+        printf("TTF_OpenFont: %s\n", TTF_GetError());
+        return false;
+    }
+
+    Uint32 iStart = SDL_GetTicks();
+    iLineSkip = TTF_FontLineSkip(pFont);
+
+    std::vector<SDL_Surface*> surfaces(SDF_GLYPH_COUNT, (SDL_Surface*)0);
+    SDL_Color white = { 255, 255, 255, 255 };
+
+    for ( int i = 0; i < SDF_GLYPH_COUNT; ++i ) {
+        SDL_Surface* pGlyph = TTF_RenderGlyph_Blended(pFont, (Uint16)(SDF_FIRST_CHAR + i), white);
+        surfaces[i] = pGlyph ? SDL_ConvertSurfaceFormat(pGlyph, SDL_PIXELFORMAT_ARGB8888, 0) : 0;
+        if ( pGlyph )
+            SDL_FreeSurface(pGlyph);
+
+        int iMinX, iMaxX, iMinY, iMaxY, iAdvance = 0;
+        TTF_GlyphMetrics(pFont, (Uint16)(SDF_FIRST_CHAR + i), &iMinX, &iMaxX, &iMinY, &iMaxY, &iAdvance);
+        Glyphs[i].iAdvance = iAdvance;
+    }
+    TTF_CloseFont(pFont);
+
+    // Shelf packing, growing the atlas until everything fits.
+    for ( iAtlasSize = 256; iAtlasSize <= 4096; iAtlasSize *= 2 ) {
+        int x = SDF_SOLID_SIZE + 1, y = 0, iRow = SDF_SOLID_SIZE + 1;
+        bool bFits = true;
+
+        for ( int i = 0; i < SDF_GLYPH_COUNT && bFits; ++i ) {
+            SdfGlyph& g = Glyphs[i];
+            g.w = surfaces[i] ? surfaces[i]->w + iSpread * 2 : 0;
+            g.h = surfaces[i] ? surfaces[i]->h + iSpread * 2 : 0;
+            g.iOffsetX = g.iOffsetY = -iSpread;
+
+            if ( x + g.w > iAtlasSize ) {
+                x = 0;
+                y += iRow + 1;
+                iRow = 0;
+            }
+            bFits = y + g.h <= iAtlasSize;
+
+            g.x = x;
+            g.y = y;
+            x += g.w + 1;
+            iRow = g.h > iRow ? g.h : iRow;
+        }
+
+        if ( bFits )
+            break;
+    }
+
+    bool bOk = iAtlasSize <= 4096;
+    if ( bOk ) {
+        atlas.assign((size_t)iAtlasSize * iAtlasSize, 0);
+
+        iSolidX = iSolidY = SDF_SOLID_SIZE / 2;
+        for ( int y = 0; y < SDF_SOLID_SIZE; ++y )
+            memset(&atlas[(size_t)y * iAtlasSize], 255, SDF_SOLID_SIZE);
+    } else {
+        printf("Error: glyphs of %s do not fit into a 4096 atlas\n", czFontPath);
+    }
+
+    for ( int i = 0; i < SDF_GLYPH_COUNT; ++i ) {
+        SDL_Surface* pSurface = surfaces[i];
+        if ( !pSurface )
+            continue;
+
+        if ( bOk ) {
+            const SdfGlyph& g = Glyphs[i];
+            std::vector<Uint8> mask((size_t)g.w * g.h, 0);
+
+            SDL_LockSurface(pSurface);
+            for ( int y = 0; y < pSurface->h; ++y ) {
+                const Uint32* pRow = (const Uint32*)((const Uint8*)pSurface->pixels + y * pSurface->pitch);
+                for ( int x = 0; x < pSurface->w; ++x )
+                    mask[(size_t)(y + iSpread) * g.w + x + iSpread] = (Uint8)(pRow[x] >> 24);
+            }
+            SDL_UnlockSurface(pSurface);
+
+            DistanceField(mask, g.w, g.h, iSpread, &atlas[(size_t)g.y * iAtlasSize + g.x], iAtlasSize);
+        }
+        SDL_FreeSurface(pSurface);
+    }
+
+    if ( bOk )
+        printf("sdf: %s at %d px into a %dx%d atlas in %u ms\n", czFontPath, iBaseSize,
+               iAtlasSize, iAtlasSize, SDL_GetTicks() - iStart);
+    return bOk;
+}
+
+bool SdfFont::ReadCache(const char* czCachePath, Uint32 iFontSize, std::vector<Uint8>& atlas)
+{
+    SDL_RWops* pFile = SDL_RWFromFile(czCachePath, "rb");
+    if ( !pFile )
+        return false;
+
+    char magic[4];
+    Sint32 header[7];
+    Sint32 glyphs[SDF_GLYPH_COUNT][7];
+
+    bool bOk = SDL_RWread(pFile, magic, 4, 1) == 1 && memcmp(magic, SDF_MAGIC, 4) == 0
+            && SDL_RWread(pFile, header, sizeof(header), 1) == 1
+            && (Uint32)header[0] == iFontSize && header[1] == iBaseSize
+            && header[2] >= 256 && header[2] <= 4096
+            && SDL_RWread(pFile, glyphs, sizeof(glyphs), 1) == 1;
+
+    if ( bOk ) {
+        iAtlasSize  = header[2];
+        iSpread     = header[3];
+        iLineSkip   = header[4];
+        iSolidX     = header[5];
+        iSolidY     = header[6];
+
+        for ( int i = 0; i < SDF_GLYPH_COUNT; ++i ) {
+            SdfGlyph& g = Glyphs[i];
+            g.x = glyphs[i][0];         g.y = glyphs[i][1];
+            g.w = glyphs[i][2];         g.h = glyphs[i][3];
+            g.iOffsetX = glyphs[i][4];  g.iOffsetY = glyphs[i][5];
+            g.iAdvance = glyphs[i][6];
+        }
+
+        atlas.resize((size_t)iAtlasSize * iAtlasSize);
+        bOk = SDL_RWread(pFile, &atlas[0], atlas.size(), 1) == 1;
+    }
+
+    SDL_RWclose(pFile);
+    return bOk;
+}
+
+void SdfFont::WriteCache(const char* czCachePath, Uint32 iFontSize, const std::vector<Uint8>& atlas) const
+{
+    SDL_RWops* pFile = SDL_RWFromFile(czCachePath, "wb");
+    if ( !pFile ) {
+        printf("sdf: cannot write the cache %s\n", czCachePath);
+        return;
+    }
+
+    Sint32 header[7] = { (Sint32)iFontSize, iBaseSize, iAtlasSize, iSpread, iLineSkip, iSolidX, iSolidY };
+    Sint32 glyphs[SDF_GLYPH_COUNT][7];
+
+    for ( int i = 0; i < SDF_GLYPH_COUNT; ++i ) {
+        const SdfGlyph& g = Glyphs[i];
+        Sint32 row[7] = { g.x, g.y, g.w, g.h, g.iOffsetX, g.iOffsetY, g.iAdvance };
+        memcpy(glyphs[i], row, sizeof(row));
+    }
+
+    SDL_RWwrite(pFile, SDF_MAGIC, 4, 1);
+    SDL_RWwrite(pFile, header, sizeof(header), 1);
+    SDL_RWwrite(pFile, glyphs, sizeof(glyphs), 1);
+    SDL_RWwrite(pFile, &atlas[0], atlas.size(), 1);
+    SDL_RWclose(pFile);
+}
+
+TextBatch::TextBatch()
+    : pFont(0), iProgram(0), iVertexBuffer(0), iIndexBuffer(0), iScreen(-1)
+{
+}
+
+TextBatch::~TextBatch()
+{
+    Release();
+}
+
+/** Builds the shader and the shared quad index buffer.
+    @remark Needs a current GL context.
+**/
+bool TextBatch::Init(const SdfFont& font)
+{
+    Release();
+    pFont = &font;
+
+    iProgram = glCreateProgram();
+    glAttachShader(iProgram, CompileShader(GL_VERTEX_SHADER, TEXT_VERTEX_SHADER));
+    glAttachShader(iProgram, CompileShader(GL_FRAGMENT_SHADER, TEXT_FRAGMENT_SHADER));
+
+    glBindAttribLocation(iProgram, 0, "Position");
+    glBindAttribLocation(iProgram, 1, "TexCoord");
+    glBindAttribLocation(iProgram, 2, "Color");
+    glBindAttribLocation(iProgram, 3, "Softness");
+    glLinkProgram(iProgram);
+
+    GLint iStatus;
+    glGetProgramiv(iProgram, GL_LINK_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        printf("Error: Failed to link the text shader\n");
+        return false;
+    }
+
+    iScreen = glGetUniformLocation(iProgram, "Screen");
+
+    std::vector<Uint16> indices(SDF_MAX_GLYPHS * 6);
+    for ( int i = 0; i < SDF_MAX_GLYPHS; ++i ) {
+        Uint16 iBase = (Uint16)(i * 4);
+        Uint16 quad[6] = { iBase, (Uint16)(iBase + 1), (Uint16)(iBase + 2),
+                           iBase, (Uint16)(iBase + 2), (Uint16)(iBase + 3) };
+        memcpy(&indices[i * 6], quad, sizeof(quad));
+    }
+
+    glGenBuffers(1, &iIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Uint16), &indices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &iVertexBuffer);
+    Vertices.reserve(1024 * 4);
+    return true;
+}
+
+void TextBatch::Release()
+{
+    if ( iProgram )
+        glDeleteProgram(iProgram);
+    if ( iVertexBuffer )
+        glDeleteBuffers(1, &iVertexBuffer);
+    if ( iIndexBuffer )
+        glDeleteBuffers(1, &iIndexBuffer);
+
+    iProgram = iVertexBuffer = iIndexBuffer = 0;
+    Vertices.clear();
+}
+
+void TextBatch::AddQuad(float x0, float y0, float x1, float y1, int u0, int v0, int u1, int v1,
+                        const SDL_Color& color, float fSoftness)
+{
+    if ( GetGlyphCount() >= SDF_MAX_GLYPHS )
+        return;
+
+    // Texel units to normalized 16-bit texture coordinates.
+    float fScale = 65535.0f / pFont->GetAtlasSize();
+    Vertex corners[4] = {
+        { x0, y0, (Uint16)(u0 * fScale), (Uint16)(v0 * fScale), { color.r, color.g, color.b, color.a }, fSoftness },
+        { x0, y1, (Uint16)(u0 * fScale), (Uint16)(v1 * fScale), { color.r, color.g, color.b, color.a }, fSoftness },
+        { x1, y1, (Uint16)(u1 * fScale), (Uint16)(v1 * fScale), { color.r, color.g, color.b, color.a }, fSoftness },
+        { x1, y0, (Uint16)(u1 * fScale), (Uint16)(v0 * fScale), { color.r, color.g, color.b, color.a }, fSoftness },
+    };
+
+    Vertices.insert(Vertices.end(), corners, corners + 4);
+}
+
+float TextBatch::Add(const char* czText, float x, float y, float fSize,
+                     const SDL_Color& color, const SDL_Color* pBackground)
+{
+    if ( !pFont || !czText )
+        return 0.0f;
+
+    float fScale = fSize / pFont->GetBaseSize();
+
+    // Half the width of the edge ramp, about one screen pixel in distance units.
+    float fSoftness = 0.5f / (pFont->GetSpread() * fScale * 2.0f);
+    if ( fSoftness > 0.25f )
+        fSoftness = 0.25f;
+
+    float fWidth = 0.0f;
+    for ( const char* p = czText; *p; ++p ) {
+        const SdfGlyph* pGlyph = pFont->GetGlyph(*p);
+        if ( pGlyph )
+            fWidth += pGlyph->iAdvance * fScale;
+    }
+
+    if ( pBackground ) {
+        int sx = pFont->GetSolidX(), sy = pFont->GetSolidY();
+        AddQuad(x, y, x + fWidth, y + pFont->GetLineSkip() * fScale, sx, sy, sx, sy, *pBackground, 0.01f);
+    }
+
+    float fPen = x;
+    for ( const char* p = czText; *p; ++p ) {
+        const SdfGlyph* pGlyph = pFont->GetGlyph(*p);
+        if ( !pGlyph )
+            continue;
+
+        if ( pGlyph->w > 0 && *p != ' ' ) {
+            float x0 = fPen + pGlyph->iOffsetX * fScale;
+            float y0 = y + pGlyph->iOffsetY * fScale;
+            AddQuad(x0, y0, x0 + pGlyph->w * fScale, y0 + pGlyph->h * fScale,
+                    pGlyph->x, pGlyph->y, pGlyph->x + pGlyph->w, pGlyph->y + pGlyph->h, color, fSoftness);
+        }
+        fPen += pGlyph->iAdvance * fScale;
+    }
+
+    return fWidth;
+}
+
+void TextBatch::Flush(int iWidth, int iHeight)
+{
+    if ( Vertices.empty() || !iProgram )
+        return;
+
+    glUseProgram(iProgram);
+    glUniform2f(iScreen, 2.0f / iWidth, -2.0f / iHeight);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pFont->GetTexture());
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // A new data store each frame, the driver does not wait for the previous draw.
+    glBindBuffer(GL_ARRAY_BUFFER, iVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(Vertex), &Vertices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)0);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), (const void*)8);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const void*)12);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)16);
+    for ( GLuint i = 0; i < 4; ++i )
+        glEnableVertexAttribArray(i);
+
+    glDrawElements(GL_TRIANGLES, GetGlyphCount() * 6, GL_UNSIGNED_SHORT, 0);
+
+    // Leave the arrays the 3D shaders do not use switched off.
+    glDisableVertexAttribArray(2);
+    glDisableVertexAttribArray(3);
+    glDisable(GL_BLEND);
+
+    Vertices.clear();
+}
@@ -0,0 +1,471 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Texture.h"
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+namespace {
+
+const Uint8 KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+//Header words following the identifier, in file order.
+enum
+{
+    KTX_ENDIANNESS = 0,
+    KTX_GL_TYPE,
+    KTX_GL_TYPE_SIZE,
+    KTX_GL_FORMAT,
+    KTX_GL_INTERNAL_FORMAT,
+    KTX_GL_BASE_INTERNAL_FORMAT,
+    KTX_PIXEL_WIDTH,
+    KTX_PIXEL_HEIGHT,
+    KTX_PIXEL_DEPTH,
+    KTX_ARRAY_ELEMENTS,
+    KTX_FACES,
+    KTX_MIP_LEVELS,
+    KTX_KEY_VALUE_BYTES,
+    KTX_HEADER_WORDS
+};
+
+const int ETC1_MODIFIERS[8][2] =
+{
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+inline Uint8 Clamp255(int v)
+{
+    return (Uint8)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+bool HasExtension(const char* czName)
+{
+    const char* czExtensions = (const char*)glGetString(GL_EXTENSIONS);
+    return czExtensions && strstr(czExtensions, czName) != 0;
+}
+
+/** Reads a whole file through SDL so it also works on packaged resources. **/
+bool ReadFile(const char* czPath, std::vector<Uint8>& data)
+{
+    SDL_RWops* pFile = SDL_RWFromFile(czPath, "rb");
+    if ( !pFile )
+        return false;
+
+    Sint64 iSize = SDL_RWsize(pFile);
+    data.resize(iSize > 0 ? (size_t)iSize : 0);
+
+    bool bOk = iSize > 0 && SDL_RWread(pFile, &data[0], 1, data.size()) == data.size();
+    SDL_RWclose(pFile);
+    return bOk;
+}
+
+const char* SPRITE_VERTEX_SHADER =
+    "attribute vec2 Position;                                   \n"
+    "attribute vec2 TexCoord;                                   \n"
+    "                                                           \n"
+    "uniform vec2 Screen;                                       \n"
+    "                                                           \n"
+    "varying vec2 Uv;                                           \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    gl_Position = vec4(Position * Screen + vec2(-1.0, 1.0), 0.0, 1.0); \n"
+    "    Uv = TexCoord;                                         \n"
+    "}                                                          \n";
+
+const char* SPRITE_FRAGMENT_SHADER =
+    "precision mediump float;                                   \n"
+    "                                                           \n"
+    "uniform sampler2D Atlas;                                   \n"
+    "                                                           \n"
+    "varying vec2 Uv;                                           \n"
+    "                                                           \n"
+    "void main(void)                                            \n"
+    "{                                                          \n"
+    "    gl_FragColor = texture2D(Atlas, Uv);                   \n"
+    "}                                                          \n";
+
+GLuint CompileShader(GLenum type, const char* czSource)
+{
+    GLuint iShader = glCreateShader(type);
+    glShaderSource(iShader, 1, &czSource, NULL);
+    glCompileShader(iShader);
+
+    GLint iStatus;
+    glGetShaderiv(iShader, GL_COMPILE_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        char error[1024];
+        glGetShaderInfoLog(iShader, sizeof(error), NULL, error);
+        printf("Error: Failed to compile sprite shader\n%s", error);
+    }
+    return iShader;
+}
+
+}
+
+/** Decodes ETC1 blocks into tightly packed RGB pixels.
+    @param pBlocks The compressed level, (w + 3) / 4 * (h + 3) / 4 blocks of 8 bytes.
+    @param pRGB Receives w * h * 3 bytes.
+**/
+void DecodeETC1(const Uint8* pBlocks, int iWidth, int iHeight, Uint8* pRGB)
+{
+    int iBlocksX = (iWidth + 3) / 4;
+    int iBlocksY = (iHeight + 3) / 4;
+
+    for ( int by = 0; by < iBlocksY; ++by ) {
+        for ( int bx = 0; bx < iBlocksX; ++bx, pBlocks += 8 ) {
+            Uint32 iHigh = (pBlocks[0] << 24) | (pBlocks[1] << 16) | (pBlocks[2] << 8) | pBlocks[3];
+            Uint32 iLow  = (pBlocks[4] << 24) | (pBlocks[5] << 16) | (pBlocks[6] << 8) | pBlocks[7];
+
+            bool bDiff = ( iHigh & 2 ) != 0;
+            bool bFlip = ( iHigh & 1 ) != 0;
+            int table[2] = { (int)(iHigh >> 5) & 7, (int)(iHigh >> 2) & 7 };
+            int base[2][3];
+
+            for ( int c = 0; c < 3; ++c ) {
+                int iShift = 24 - c * 8;
+                if ( bDiff ) {
+                    int a = (iHigh >> (iShift + 3)) & 31;
+                    int d = (iHigh >> iShift) & 7;
+                    int b = a + (d >= 4 ? d - 8 : d);
+                    base[0][c] = (a << 3) | (a >> 2);
+                    base[1][c] = ((b & 31) << 3) | ((b & 31) >> 2);
+                } else {
+                    int a = (iHigh >> (iShift + 4)) & 15;
+                    int b = (iHigh >> iShift) & 15;
+                    base[0][c] = (a << 4) | a;
+                    base[1][c] = (b << 4) | b;
+                }
+            }
+
+            for ( int p = 0; p < 16; ++p ) {
+                int x = p / 4, y = p % 4;
+                int px = bx * 4 + x, py = by * 4 + y;
+                if ( px >= iWidth || py >= iHeight )
+                    continue;
+
+                int iSub = bFlip ? (y >= 2) : (x >= 2);
+                int iSelector = (((iLow >> (p + 16)) & 1) << 1) | ((iLow >> p) & 1);
+                int iModifier = ETC1_MODIFIERS[table[iSub]][iSelector & 1];
+                if ( iSelector & 2 )
+                    iModifier = -iModifier;
+
+                Uint8* pOut = pRGB + ((size_t)py * iWidth + px) * 3;
+                for ( int c = 0; c < 3; ++c )
+                    pOut[c] = Clamp255(base[iSub][c] + iModifier);
+            }
+        }
+    }
+}
+
+/** Loads a KTX file into a new texture. **/
+GLuint LoadKTX(const char* czPath, int* pWidth, int* pHeight)
+{
+    std::vector<Uint8> data;
+    if ( !ReadFile(czPath, data) ) {
+        printf("Error: Unable to read %s\n", czPath);
+        return 0;
+    }
+
+    Uint32 header[KTX_HEADER_WORDS];
+    if ( data.size() < sizeof(KTX_IDENTIFIER) + sizeof(header)
+      || memcmp(&data[0], KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 ) {
+        printf("Error: %s is not a KTX file\n", czPath);
+        return 0;
+    }
+
+    memcpy(header, &data[sizeof(KTX_IDENTIFIER)], sizeof(header));
+    if ( header[KTX_ENDIANNESS] != 0x04030201 || header[KTX_FACES] != 1 || header[KTX_PIXEL_DEPTH] > 1 ) {
+        printf("Error: %s is not a little endian 2D KTX texture\n", czPath);
+        return 0;
+    }
+
+    bool bCompressed    = header[KTX_GL_TYPE] == 0;
+    bool bETC1          = header[KTX_GL_INTERNAL_FORMAT] == GL_ETC1_RGB8_OES;
+    bool bDecode        = bETC1 && !HasExtension("GL_OES_compressed_ETC1_RGB8_texture");
+
+    if ( bCompressed && !bETC1 ) {
+        printf("Error: %s uses an unsupported compressed format 0x%x\n", czPath, header[KTX_GL_INTERNAL_FORMAT]);
+        return 0;
+    }
+
+    int iWidth  = (int)header[KTX_PIXEL_WIDTH];
+    int iHeight = (int)header[KTX_PIXEL_HEIGHT];
+    int iLevels = header[KTX_MIP_LEVELS] ? (int)header[KTX_MIP_LEVELS] : 1;
+
+    GLuint iTexture = 0;
+    glGenTextures(1, &iTexture);
+    glBindTexture(GL_TEXTURE_2D, iTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    std::vector<Uint8> decoded;
+    size_t iOffset = sizeof(KTX_IDENTIFIER) + sizeof(header) + header[KTX_KEY_VALUE_BYTES];
+
+    for ( int iLevel = 0; iLevel < iLevels; ++iLevel ) {
+        int w = iWidth >> iLevel, h = iHeight >> iLevel;
+        if ( w < 1 ) w = 1;
+        if ( h < 1 ) h = 1;
+
+        if ( iOffset + 4 > data.size() )
+            break;
+
+        Uint32 iImageSize;
+        memcpy(&iImageSize, &data[iOffset], 4);
+        iOffset += 4;
+
+        if ( iOffset + iImageSize > data.size() )
+            break;
+
+        const Uint8* pLevel = &data[iOffset];
+
+        if ( bDecode ) {
+            decoded.resize((size_t)w * h * 3);
+            DecodeETC1(pLevel, w, h, &decoded[0]);
+            glTexImage2D(GL_TEXTURE_2D, iLevel, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, &decoded[0]);
+        } else if ( bCompressed ) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, iLevel, GL_ETC1_RGB8_OES, w, h, 0, iImageSize, pLevel);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, iLevel, header[KTX_GL_BASE_INTERNAL_FORMAT], w, h, 0,
+                         header[KTX_GL_FORMAT], header[KTX_GL_TYPE], pLevel);
+        }
+
+        iOffset += (iImageSize + 3) & ~3u;
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, iLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if ( pWidth )
+        *pWidth = iWidth;
+    if ( pHeight )
+        *pHeight = iHeight;
+
+    return iTexture;
+}
+
+/** Default constructor. **/
+TextureAtlas::TextureAtlas()
+{
+    iTexture    = 0;
+    iWidth      = 0;
+    iHeight     = 0;
+}
+
+/**
+ * Destructor
+ */
+TextureAtlas::~TextureAtlas()
+{
+    Release();
+}
+
+/** Loads a manifest written by tools/assetcook and the texture it names.
+    @param czManifestPath The .atlas file; the texture is looked up in the same directory.
+    @return false if either file could not be loaded.
+**/
+bool TextureAtlas::Load(const char* czManifestPath)
+{
+    Release();
+
+    ManifestPath = czManifestPath;
+
+    std::vector<Uint8> data;
+    if ( !ReadFile(czManifestPath, data) ) {
+        printf("Error: Unable to read %s\n", czManifestPath);
+        return false;
+    }
+    data.push_back(0);
+
+    std::string manifest((const char*)&data[0]);
+    std::string dir(czManifestPath);
+    size_t iSlash = dir.find_last_of('/');
+    dir = iSlash == std::string::npos ? std::string() : dir.substr(0, iSlash + 1);
+
+    size_t iPos = 0;
+    while ( iPos < manifest.size() ) {
+        size_t iEnd = manifest.find('\n', iPos);
+        if ( iEnd == std::string::npos )
+            iEnd = manifest.size();
+        std::string line = manifest.substr(iPos, iEnd - iPos);
+        iPos = iEnd + 1;
+
+        char name[256];
+        AtlasRegion region;
+
+        if ( line.compare(0, 6, "atlas ") == 0 ) {
+            if ( sscanf(line.c_str(), "atlas %255s", name) == 1 )
+                iTexture = LoadKTX((dir + name).c_str(), &iWidth, &iHeight);
+        } else if ( sscanf(line.c_str(), "%255s %d %d %d %d %f %f %f %f", name,
+                           &region.x, &region.y, &region.w, &region.h,
+                           &region.u0, &region.v0, &region.u1, &region.v1) == 9 ) {
+            region.name = name;
+            Regions.push_back(region);
+        }
+    }
+
+    return iTexture != 0;
+}
+
+/** Deletes the texture and forgets the regions. **/
+void TextureAtlas::Release()
+{
+    if ( iTexture )
+        glDeleteTextures(1, &iTexture);
+
+    iTexture = 0;
+    Regions.clear();
+}
+
+size_t TextureAtlas::GetResidentBytes() const
+{
+    return iTexture ? (size_t)iWidth * iHeight * 4 : 0;
+}
+
+/** Deletes the texture but keeps the regions. **/
+void TextureAtlas::OnRelease()
+{
+    if ( iTexture )
+        glDeleteTextures(1, &iTexture);
+
+    iTexture = 0;
+}
+
+bool TextureAtlas::OnRestore()
+{
+    std::string path(ManifestPath);
+
+    return Load(path.c_str());
+}
+
+/** Looks up a sprite by its file name without extension.
+    @return The region, or NULL if the atlas has no such sprite.
+**/
+const AtlasRegion* TextureAtlas::Find(const char* czName) const
+{
+    for ( size_t i = 0; i < Regions.size(); ++i )
+        if ( Regions[i].name == czName )
+            return &Regions[i];
+
+    return 0;
+}
+
+SpriteBatch::SpriteBatch()
+    : pAtlas(0), iProgram(0), iVertexBuffer(0), iIndexBuffer(0), iScreen(-1)
+{
+}
+
+SpriteBatch::~SpriteBatch()
+{
+    Release();
+}
+
+/** Builds the shader and the shared quad index buffer.
+    @remark Needs a current GL context. The atlas may be released and restored
+            later; the texture is looked up on every Flush().
+**/
+bool SpriteBatch::Init(const TextureAtlas& atlas)
+{
+    Release();
+    pAtlas = &atlas;
+
+    iProgram = glCreateProgram();
+    glAttachShader(iProgram, CompileShader(GL_VERTEX_SHADER, SPRITE_VERTEX_SHADER));
+    glAttachShader(iProgram, CompileShader(GL_FRAGMENT_SHADER, SPRITE_FRAGMENT_SHADER));
+
+    glBindAttribLocation(iProgram, 0, "Position");
+    glBindAttribLocation(iProgram, 1, "TexCoord");
+    glLinkProgram(iProgram);
+
+    GLint iStatus;
+    glGetProgramiv(iProgram, GL_LINK_STATUS, &iStatus);
+    if ( iStatus != GL_TRUE ) {
+        printf("Error: Failed to link the sprite shader\n");
+        return false;
+    }
+
+    iScreen = glGetUniformLocation(iProgram, "Screen");
+
+    std::vector<Uint16> indices(SPRITE_MAX_QUADS * 6);
+    for ( int i = 0; i < SPRITE_MAX_QUADS; ++i ) {
+        Uint16 iBase = (Uint16)(i * 4);
+        Uint16 quad[6] = { iBase, (Uint16)(iBase + 1), (Uint16)(iBase + 2),
+                           iBase, (Uint16)(iBase + 2), (Uint16)(iBase + 3) };
+        memcpy(&indices[i * 6], quad, sizeof(quad));
+    }
+
+    glGenBuffers(1, &iIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Uint16), &indices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &iVertexBuffer);
+    Vertices.reserve(256 * 4);
+    return true;
+}
+
+void SpriteBatch::Release()
+{
+    if ( iProgram )
+        glDeleteProgram(iProgram);
+    if ( iVertexBuffer )
+        glDeleteBuffers(1, &iVertexBuffer);
+    if ( iIndexBuffer )
+        glDeleteBuffers(1, &iIndexBuffer);
+
+    iProgram = iVertexBuffer = iIndexBuffer = 0;
+    Vertices.clear();
+}
+
+void SpriteBatch::Add(const AtlasRegion& region, float x, float y, float fScale)
+{
+    if ( GetSpriteCount() >= SPRITE_MAX_QUADS )
+        return;
+
+    float x1 = x + region.w * fScale;
+    float y1 = y + region.h * fScale;
+    Vertex corners[4] = {
+        { x,  y,  region.u0, region.v0 },
+        { x,  y1, region.u0, region.v1 },
+        { x1, y1, region.u1, region.v1 },
+        { x1, y,  region.u1, region.v0 },
+    };
+
+    Vertices.insert(Vertices.end(), corners, corners + 4);
+}
+
+void SpriteBatch::Flush(int iWidth, int iHeight)
+{
+    if ( Vertices.empty() || !iProgram || !pAtlas->GetTexture() ) {
+        Vertices.clear();
+        return;
+    }
+
+    glUseProgram(iProgram);
+    glUniform2f(iScreen, 2.0f / iWidth, -2.0f / iHeight);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pAtlas->GetTexture());
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // A new data store each frame, the driver does not wait for the previous draw.
+    glBindBuffer(GL_ARRAY_BUFFER, iVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(Vertex), &Vertices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iIndexBuffer);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)8);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glDrawElements(GL_TRIANGLES, GetSpriteCount() * 6, GL_UNSIGNED_SHORT, 0);
+
+    glDisable(GL_BLEND);
+
+    Vertices.clear();
+}
@@ -0,0 +1,285 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "VertexLayout.h"
+
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
+#ifndef GL_INT_10_10_10_2_OES
+#define GL_INT_10_10_10_2_OES 0x8DF7
+#endif
+
+const char VERTEX_LAYOUT_SHADER_PRELUDE[] =
+    "attribute vec3 Position;                                   \n"
+    "attribute vec3 Normal;                                     \n"
+    "attribute vec4 Color;                                      \n"
+    "                                                           \n"
+    "uniform vec3 PositionScale;                                \n"
+    "uniform vec3 PositionBias;                                 \n"
+    "                                                           \n"
+    "vec4 DecodePosition(void)                                  \n"
+    "{                                                          \n"
+    "    return vec4(Position * PositionScale + PositionBias, 1.0); \n"
+    "}                                                          \n";
+
+namespace {
+
+const char* POSITION_NAMES[]    = { "float", "half", "short" };
+const char* NORMAL_NAMES[]      = { "float", "byte", "packed" };
+const char* COLOR_NAMES[]       = { "none", "float", "ubyte" };
+
+const int POSITION_SIZES[]      = { 12, 8, 8 };
+const int NORMAL_SIZES[]        = { 12, 4, 4 };
+const int COLOR_SIZES[]         = { 0, 16, 4 };
+
+bool HasExtension(const char* czName)
+{
+    const char* czExtensions = (const char*)glGetString(GL_EXTENSIONS);
+    return czExtensions && strstr(czExtensions, czName) != 0;
+}
+
+int FindName(const char* const* pNames, int iCount, const std::string& name)
+{
+    for ( int i = 0; i < iCount; ++i )
+        if ( name == pNames[i] )
+            return i;
+    return -1;
+}
+
+/** Round to nearest even; overflow saturates to infinity, tiny values flush to zero. **/
+Uint16 FloatToHalf(float f)
+{
+    Uint32 x;
+    memcpy(&x, &f, 4);
+
+    Uint16 iSign = (Uint16)((x >> 16) & 0x8000);
+    int iExponent = (int)((x >> 23) & 0xFF) - 127 + 15;
+    Uint32 iMantissa = x & 0x7FFFFF;
+
+    if ( iExponent <= 0 )
+        return iSign;
+    if ( iExponent >= 31 )
+        return (Uint16)(iSign | 0x7C00);
+
+    Uint32 iHalf = ((Uint32)iExponent << 10) | (iMantissa >> 13);
+    Uint32 iRest = iMantissa & 0x1FFF;
+    if ( iRest > 0x1000 || ( iRest == 0x1000 && ( iHalf & 1 ) ) )
+        ++iHalf;
+
+    return (Uint16)(iSign | iHalf);
+}
+
+/** Inverse of the GLES2 signed normalized decode f = (2c + 1) / (2^b - 1). **/
+int QuantizeSigned(float f, int iBits)
+{
+    float fMax = (float)((1 << iBits) - 1);
+    int c = (int)floorf((f * fMax - 1.0f) * 0.5f + 0.5f);
+    int iHigh = (1 << (iBits - 1)) - 1;
+    return c < -iHigh - 1 ? -iHigh - 1 : (c > iHigh ? iHigh : c);
+}
+
+template <class T>
+void Put(std::vector<Uint8>& out, size_t iOffset, T value)
+{
+    memcpy(&out[iOffset], &value, sizeof(T));
+}
+
+}
+
+VertexLayout::VertexLayout(VertexPositionFormat position, VertexNormalFormat normal, VertexColorFormat color)
+    : Position(position), Normal(normal), Color(color)
+{
+    Update();
+}
+
+void VertexLayout::Update()
+{
+    iNormalOffset   = POSITION_SIZES[Position];
+    iColorOffset    = iNormalOffset + NORMAL_SIZES[Normal];
+    iStride         = iColorOffset + COLOR_SIZES[Color];
+}
+
+bool VertexLayout::Parse(const char* czText)
+{
+    std::string parts[3];
+    int iParts = 0;
+
+    for ( const char* p = czText; *p && iParts < 3; ++p ) {
+        if ( *p == ',' )
+            ++iParts;
+        else
+            parts[iParts] += *p;
+    }
+
+    int iPosition   = FindName(POSITION_NAMES, 3, parts[0]);
+    int iNormal     = FindName(NORMAL_NAMES, 3, parts[1]);
+    int iColor      = parts[2].empty() ? VERTEX_COLOR_NONE : FindName(COLOR_NAMES, 3, parts[2]);
+
+    if ( iPosition < 0 || iNormal < 0 || iColor < 0 )
+        return false;
+
+    Position    = (VertexPositionFormat)iPosition;
+    Normal      = (VertexNormalFormat)iNormal;
+    Color       = (VertexColorFormat)iColor;
+    Update();
+    return true;
+}
+
+std::string VertexLayout::GetName() const
+{
+    std::string name = std::string(POSITION_NAMES[Position]) + "," + NORMAL_NAMES[Normal];
+    if ( Color != VERTEX_COLOR_NONE )
+        name += std::string(",") + COLOR_NAMES[Color];
+    return name;
+}
+
+bool VertexLayout::IsSupported() const
+{
+    if ( Position == VERTEX_POSITION_HALF && !HasExtension("GL_OES_vertex_half_float") )
+        return false;
+    if ( Normal == VERTEX_NORMAL_PACKED && !HasExtension("GL_OES_vertex_type_10_10_10_2") )
+        return false;
+    return true;
+}
+
+VertexLayout VertexLayout::Supported() const
+{
+    VertexLayout layout = *this;
+
+    if ( Position == VERTEX_POSITION_HALF && !HasExtension("GL_OES_vertex_half_float") )
+        layout.Position = VERTEX_POSITION_SHORT;
+    if ( Normal == VERTEX_NORMAL_PACKED && !HasExtension("GL_OES_vertex_type_10_10_10_2") )
+        layout.Normal = VERTEX_NORMAL_BYTE;
+
+    layout.Update();
+    return layout;
+}
+
+void VertexLayout::ComputeBounds(int iCount, const float* pPositions, float pScale[3], float pBias[3])
+{
+    for ( int c = 0; c < 3; ++c ) {
+        float fMin = iCount > 0 ? pPositions[c] : 0.0f;
+        float fMax = fMin;
+        for ( int i = 1; i < iCount; ++i ) {
+            float v = pPositions[i * 3 + c];
+            if ( v < fMin ) fMin = v;
+            if ( v > fMax ) fMax = v;
+        }
+        pScale[c]   = fMax > fMin ? (fMax - fMin) * 0.5f : 1.0f;
+        pBias[c]    = (fMax + fMin) * 0.5f;
+    }
+}
+
+void VertexLayout::Pack(int iCount, const float* pPositions, const float* pNormals, const float* pColors,
+                        const float pScale[3], const float pBias[3], std::vector<Uint8>& out) const
+{
+    size_t iBase = out.size();
+    out.resize(iBase + (size_t)iCount * iStride, 0);
+
+    for ( int i = 0; i < iCount; ++i ) {
+        size_t iVertex = iBase + (size_t)i * iStride;
+        const float* p = pPositions + i * 3;
+
+        for ( int c = 0; c < 3; ++c ) {
+            switch ( Position ) {
+            case VERTEX_POSITION_FLOAT:
+                Put<float>(out, iVertex + c * 4, p[c]);
+                break;
+            case VERTEX_POSITION_HALF:
+                Put<Uint16>(out, iVertex + c * 2, FloatToHalf(p[c]));
+                break;
+            case VERTEX_POSITION_SHORT:
+                Put<Sint16>(out, iVertex + c * 2, (Sint16)QuantizeSigned((p[c] - pBias[c]) / pScale[c], 16));
+                break;
+            }
+        }
+
+        float n[3] = { 0.0f, 0.0f, 1.0f };
+        if ( pNormals ) {
+            const float* pn = pNormals + i * 3;
+            float fLength = sqrtf(pn[0] * pn[0] + pn[1] * pn[1] + pn[2] * pn[2]);
+            if ( fLength > 0.0f )
+                for ( int c = 0; c < 3; ++c )
+                    n[c] = pn[c] / fLength;
+        }
+
+        size_t iNormal = iVertex + iNormalOffset;
+        if ( Normal == VERTEX_NORMAL_FLOAT ) {
+            for ( int c = 0; c < 3; ++c )
+                Put<float>(out, iNormal + c * 4, n[c]);
+        } else if ( Normal == VERTEX_NORMAL_BYTE ) {
+            for ( int c = 0; c < 3; ++c )
+                out[iNormal + c] = (Uint8)QuantizeSigned(n[c], 8);
+        } else {
+            // GL_INT_10_10_10_2_OES keeps x in the most significant bits.
+            Uint32 iPacked = ((Uint32)(QuantizeSigned(n[0], 10) & 0x3FF) << 22)
+                           | ((Uint32)(QuantizeSigned(n[1], 10) & 0x3FF) << 12)
+                           | ((Uint32)(QuantizeSigned(n[2], 10) & 0x3FF) << 2);
+            Put<Uint32>(out, iNormal, iPacked);
+        }
+
+        if ( Color == VERTEX_COLOR_NONE )
+            continue;
+
+        const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        const float* pc = pColors ? pColors + i * 4 : white;
+        size_t iColor = iVertex + iColorOffset;
+
+        for ( int c = 0; c < 4; ++c ) {
+            if ( Color == VERTEX_COLOR_FLOAT ) {
+                Put<float>(out, iColor + c * 4, pc[c]);
+            } else {
+                float v = pc[c] < 0.0f ? 0.0f : (pc[c] > 1.0f ? 1.0f : pc[c]);
+                out[iColor + c] = (Uint8)(v * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+void VertexLayout::Bind(const void* pBase) const
+{
+    const Uint8* p = (const Uint8*)pBase;
+
+    switch ( Position ) {
+    case VERTEX_POSITION_FLOAT:
+        glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, iStride, p);
+        break;
+    case VERTEX_POSITION_HALF:
+        glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 3, GL_HALF_FLOAT_OES, GL_FALSE, iStride, p);
+        break;
+    case VERTEX_POSITION_SHORT:
+        glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 3, GL_SHORT, GL_TRUE, iStride, p);
+        break;
+    }
+
+    switch ( Normal ) {
+    case VERTEX_NORMAL_FLOAT:
+        glVertexAttribPointer(VERTEX_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride, p + iNormalOffset);
+        break;
+    case VERTEX_NORMAL_BYTE:
+        glVertexAttribPointer(VERTEX_ATTRIB_NORMAL, 3, GL_BYTE, GL_TRUE, iStride, p + iNormalOffset);
+        break;
+    case VERTEX_NORMAL_PACKED:
+        glVertexAttribPointer(VERTEX_ATTRIB_NORMAL, 3, GL_INT_10_10_10_2_OES, GL_TRUE, iStride, p + iNormalOffset);
+        break;
+    }
+
+    glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
+    glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL);
+
+    if ( Color == VERTEX_COLOR_NONE ) {
+        glDisableVertexAttribArray(VERTEX_ATTRIB_COLOR);
+        return;
+    }
+
+    if ( Color == VERTEX_COLOR_FLOAT )
+        glVertexAttribPointer(VERTEX_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, iStride, p + iColorOffset);
+    else
+        glVertexAttribPointer(VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, iStride, p + iColorOffset);
+
+    glEnableVertexAttribArray(VERTEX_ATTRIB_COLOR);
+}
@@ -0,0 +1,39 @@
+# ---
+# Build time sprite cooking.
+#
+# cook_sprite_atlas(<target> <sprite dir> <output base>) packs every BMP in
+# <sprite dir> into <output base>.ktx plus the <output base>.atlas UV
+# manifest before <target> is built. The cooker is compiled for the build
+# machine; it keeps a content hash so unchanged sprites are not re-encoded.
+
+set(ASSETCOOK_HOST_CXX "c++" CACHE STRING "C++ compiler of the build machine, used for the asset cooker")
+set(ASSETCOOK_OPTIONS "" CACHE STRING "Extra assetcook options, e.g. --colorkey 00FFFF or --rgba")
+
+set(ASSETCOOK_SOURCE "${CMAKE_CURRENT_LIST_DIR}/assetcook/AssetCook.cpp")
+set(ASSETCOOK_EXE "${CMAKE_BINARY_DIR}/assetcook/assetcook")
+
+add_custom_command(
+    OUTPUT ${ASSETCOOK_EXE}
+    COMMAND ${CMAKE_COMMAND} -E make_directory "${CMAKE_BINARY_DIR}/assetcook"
+    COMMAND ${ASSETCOOK_HOST_CXX} -O2 -o ${ASSETCOOK_EXE} ${ASSETCOOK_SOURCE}
+    DEPENDS ${ASSETCOOK_SOURCE}
+    COMMENT "Building the asset cooker for the build machine"
+    VERBATIM
+)
+
+function(cook_sprite_atlas TARGET SPRITE_DIR OUTPUT_BASE)
+    file(GLOB SPRITES "${SPRITE_DIR}/*.bmp")
+    get_filename_component(OUTPUT_DIR ${OUTPUT_BASE} PATH)
+    get_filename_component(OUTPUT_NAME ${OUTPUT_BASE} NAME)
+    separate_arguments(COOK_OPTIONS UNIX_COMMAND "${ASSETCOOK_OPTIONS}")
+
+    add_custom_target(${TARGET}_${OUTPUT_NAME} ALL
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR}
+        COMMAND ${ASSETCOOK_EXE} ${COOK_OPTIONS} --stamp "${CMAKE_BINARY_DIR}/assetcook/${OUTPUT_NAME}.hash"
+                ${OUTPUT_BASE} ${SPRITES}
+        DEPENDS ${ASSETCOOK_EXE} ${SPRITES}
+        COMMENT "Cooking ${SPRITE_DIR}"
+        VERBATIM
+    )
+    add_dependencies(${TARGET} ${TARGET}_${OUTPUT_NAME})
+endfunction()
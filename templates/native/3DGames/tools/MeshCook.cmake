@@ -0,0 +1,43 @@
+# ---
+# Build time mesh cooking.
+#
+# cook_meshes(<target> <model dir> <output dir>) converts every OBJ in
+# <model dir> into <output dir>/<name>.mesh before <target> is built (see
+# include/Mesh.h). The cooker is compiled for the build machine.
+
+set(MESHCOOK_HOST_CXX "c++" CACHE STRING "C++ compiler of the build machine, used for the mesh cooker")
+
+set(MESHCOOK_SOURCE "${CMAKE_CURRENT_LIST_DIR}/meshcook/MeshCook.cpp")
+set(MESHCOOK_EXE "${CMAKE_BINARY_DIR}/meshcook/meshcook")
+
+add_custom_command(
+    OUTPUT ${MESHCOOK_EXE}
+    COMMAND ${CMAKE_COMMAND} -E make_directory "${CMAKE_BINARY_DIR}/meshcook"
+    COMMAND ${MESHCOOK_HOST_CXX} -O2 -o ${MESHCOOK_EXE} ${MESHCOOK_SOURCE}
+    DEPENDS ${MESHCOOK_SOURCE}
+    COMMENT "Building the mesh cooker for the build machine"
+    VERBATIM
+)
+
+function(cook_meshes TARGET MODEL_DIR OUTPUT_DIR)
+    file(GLOB MODELS "${MODEL_DIR}/*.obj")
+    set(MESHES)
+
+    foreach(MODEL ${MODELS})
+        get_filename_component(NAME ${MODEL} NAME_WE)
+        set(MESH "${OUTPUT_DIR}/${NAME}.mesh")
+
+        add_custom_command(
+            OUTPUT ${MESH}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR}
+            COMMAND ${MESHCOOK_EXE} ${MODEL} ${MESH}
+            DEPENDS ${MESHCOOK_EXE} ${MODEL}
+            COMMENT "Cooking ${NAME}.obj"
+            VERBATIM
+        )
+        list(APPEND MESHES ${MESH})
+    endforeach()
+
+    add_custom_target(${TARGET}_meshes ALL DEPENDS ${MESHES})
+    add_dependencies(${TARGET} ${TARGET}_meshes)
+endfunction()
@@ -0,0 +1,630 @@
+/**
+ * Offline sprite cooker.
+ *
+ * Packs BMP sprites into one texture atlas, writes a UV manifest and stores
+ * the atlas as a KTX file, ETC1 compressed (with its mip chain) unless a
+ * sprite has transparent pixels. A content hash of the inputs and options is
+ * kept next to the outputs so unchanged inputs are skipped.
+ *
+ * usage: assetcook [options] <output base path> <sprite.bmp>...
+ *   --max-size N      largest atlas edge, default 2048
+ *   --padding N       pixels between sprites, default 2
+ *   --colorkey RRGGBB colour treated as transparent
+ *   --rgba            never compress
+ *   --no-mips         only store the base level
+ *   --stamp PATH      where to keep the content hash, default <output>.hash
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+typedef unsigned char   u8;
+typedef unsigned short  u16;
+typedef unsigned int    u32;
+typedef unsigned long long u64;
+
+static const char* TOOL_VERSION = "assetcook 1";
+
+//GL enums used in the KTX header.
+static const u32 GL_UNSIGNED_BYTE_          = 0x1401;
+static const u32 GL_RGB_                    = 0x1907;
+static const u32 GL_RGBA_                   = 0x1908;
+static const u32 GL_ETC1_RGB8_OES_          = 0x8D64;
+
+struct Image
+{
+    int w, h;
+    std::vector<u8> rgba;
+};
+
+struct Sprite
+{
+    std::string name;
+    Image       image;
+    int         x, y;
+};
+
+struct Options
+{
+    int     iMaxSize;
+    int     iPadding;
+    bool    bColorKey;
+    u8      colorKey[3];
+    bool    bForceRGBA;
+    bool    bMips;
+};
+
+// ---
+// file helpers
+
+static bool ReadFile(const char* czPath, std::vector<u8>& data)
+{
+    FILE* f = fopen(czPath, "rb");
+    if ( !f )
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long iSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data.resize(iSize > 0 ? iSize : 0);
+    bool bOk = iSize <= 0 || fread(&data[0], 1, data.size(), f) == data.size();
+    fclose(f);
+    return bOk;
+}
+
+static u32 LE32(const u8* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24); }
+static u16 LE16(const u8* p) { return (u16)(p[0] | (p[1] << 8)); }
+
+static int MaskShift(u32 iMask)
+{
+    int iShift = 0;
+    while ( iMask && !(iMask & 1) ) {
+        iMask >>= 1;
+        ++iShift;
+    }
+    return iShift;
+}
+
+/** Reads an uncompressed 24 or 32 bit BMP (BI_RGB or BI_BITFIELDS). **/
+static bool LoadBMP(const char* czPath, Image& image)
+{
+    std::vector<u8> data;
+    if ( !ReadFile(czPath, data) || data.size() < 54 || data[0] != 'B' || data[1] != 'M' )
+        return false;
+
+    u32 iOffset     = LE32(&data[10]);
+    u32 iHeaderSize = LE32(&data[14]);
+    int iWidth      = (int)LE32(&data[18]);
+    int iHeight     = (int)LE32(&data[22]);
+    int iBpp        = LE16(&data[28]);
+    u32 iCompress   = LE32(&data[30]);
+
+    bool bTopDown = iHeight < 0;
+    if ( bTopDown )
+        iHeight = -iHeight;
+
+    if ( iWidth <= 0 || iHeight <= 0 || (iBpp != 24 && iBpp != 32) || (iCompress != 0 && iCompress != 3) )
+        return false;
+
+    u32 masks[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0 };
+    if ( iBpp == 32 && iCompress == 0 )
+        masks[3] = 0xFF000000;
+    if ( iCompress == 3 && data.size() >= 14 + 52 ) {
+        masks[0] = LE32(&data[54]);
+        masks[1] = LE32(&data[58]);
+        masks[2] = LE32(&data[62]);
+        masks[3] = iHeaderSize >= 56 ? LE32(&data[66]) : 0;
+    }
+
+    size_t iStride = ((size_t)iWidth * (iBpp / 8) + 3) & ~(size_t)3;
+    if ( iOffset + iStride * iHeight > data.size() )
+        return false;
+
+    image.w = iWidth;
+    image.h = iHeight;
+    image.rgba.resize((size_t)iWidth * iHeight * 4);
+
+    for ( int y = 0; y < iHeight; ++y ) {
+        const u8* pRow = &data[iOffset + iStride * (bTopDown ? y : iHeight - 1 - y)];
+        u8* pOut = &image.rgba[(size_t)y * iWidth * 4];
+
+        for ( int x = 0; x < iWidth; ++x, pOut += 4 ) {
+            if ( iBpp == 24 ) {
+                pOut[0] = pRow[x * 3 + 2];
+                pOut[1] = pRow[x * 3 + 1];
+                pOut[2] = pRow[x * 3 + 0];
+                pOut[3] = 255;
+            } else {
+                u32 p = LE32(pRow + x * 4);
+                for ( int c = 0; c < 4; ++c ) {
+                    if ( !masks[c] ) {
+                        pOut[c] = 255;
+                        continue;
+                    }
+                    u32 iMax = masks[c] >> MaskShift(masks[c]);
+                    pOut[c] = (u8)(((p & masks[c]) >> MaskShift(masks[c])) * 255 / iMax);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// ---
+// packing
+
+static bool TallerFirst(const Sprite* a, const Sprite* b)
+{
+    if ( a->image.h != b->image.h )
+        return a->image.h > b->image.h;
+    return a->name < b->name;
+}
+
+/** Shelf packs the sprites into a square power of two atlas. Returns the edge or 0. **/
+static int Pack(std::vector<Sprite>& sprites, const Options& options)
+{
+    std::vector<Sprite*> order;
+    for ( size_t i = 0; i < sprites.size(); ++i )
+        order.push_back(&sprites[i]);
+    std::sort(order.begin(), order.end(), TallerFirst);
+
+    for ( int iSize = 64; iSize <= options.iMaxSize; iSize *= 2 ) {
+        int x = 0, y = 0, iShelf = 0;
+        bool bFits = true;
+
+        for ( size_t i = 0; i < order.size() && bFits; ++i ) {
+            int w = order[i]->image.w + options.iPadding;
+            int h = order[i]->image.h + options.iPadding;
+
+            if ( x + w > iSize ) {
+                x = 0;
+                y += iShelf;
+                iShelf = 0;
+            }
+            if ( w > iSize || y + h > iSize ) {
+                bFits = false;
+                break;
+            }
+
+            order[i]->x = x;
+            order[i]->y = y;
+            x += w;
+            iShelf = std::max(iShelf, h);
+        }
+
+        if ( bFits )
+            return iSize;
+    }
+
+    return 0;
+}
+
+/** Mip level by 2x2 box filter. **/
+static Image Downsample(const Image& src)
+{
+    Image dst;
+    dst.w = std::max(1, src.w / 2);
+    dst.h = std::max(1, src.h / 2);
+    dst.rgba.resize((size_t)dst.w * dst.h * 4);
+
+    for ( int y = 0; y < dst.h; ++y ) {
+        for ( int x = 0; x < dst.w; ++x ) {
+            int x0 = std::min(x * 2, src.w - 1), x1 = std::min(x * 2 + 1, src.w - 1);
+            int y0 = std::min(y * 2, src.h - 1), y1 = std::min(y * 2 + 1, src.h - 1);
+
+            for ( int c = 0; c < 4; ++c ) {
+                int iSum = src.rgba[((size_t)y0 * src.w + x0) * 4 + c] + src.rgba[((size_t)y0 * src.w + x1) * 4 + c]
+                         + src.rgba[((size_t)y1 * src.w + x0) * 4 + c] + src.rgba[((size_t)y1 * src.w + x1) * 4 + c];
+                dst.rgba[((size_t)y * dst.w + x) * 4 + c] = (u8)((iSum + 2) / 4);
+            }
+        }
+    }
+
+    return dst;
+}
+
+// ---
+// ETC1
+
+static const int ETC1_MODIFIERS[8][2] =
+{
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static inline int Clamp255(int v) { return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+/**
+ * Picks the best table for a sub block with the given base colour.
+ * Writes the 2 bit pixel selectors into the index halves and returns the error.
+ */
+static u32 FitSubBlock(const u8 block[16][3], const int* pPixels, const int base[3],
+                       int& iBestTable, u32& iMsb, u32& iLsb)
+{
+    //Selector order of the ETC1 spec: +a, +b, -a, -b.
+    static const int SIGN[4]  = { 1, 1, -1, -1 };
+    static const int LARGE[4] = { 0, 1, 0, 1 };
+
+    u32 iBestError = 0xFFFFFFFFu;
+
+    for ( int t = 0; t < 8; ++t ) {
+        u32 iError = 0, iTableMsb = 0, iTableLsb = 0;
+
+        for ( int k = 0; k < 8; ++k ) {
+            int p = pPixels[k];
+            u32 iPixelBest = 0xFFFFFFFFu;
+            int iSelector = 0;
+
+            for ( int s = 0; s < 4; ++s ) {
+                int d = SIGN[s] * ETC1_MODIFIERS[t][LARGE[s]];
+                u32 e = 0;
+                for ( int c = 0; c < 3; ++c ) {
+                    int diff = Clamp255(base[c] + d) - block[p][c];
+                    e += diff * diff;
+                }
+                if ( e < iPixelBest ) {
+                    iPixelBest = e;
+                    iSelector = s;
+                }
+            }
+
+            iError += iPixelBest;
+            //Pixel p sits at x = p / 4, y = p % 4 and uses bit x * 4 + y.
+            iTableMsb |= (u32)(iSelector >> 1) << p;
+            iTableLsb |= (u32)(iSelector & 1) << p;
+        }
+
+        if ( iError < iBestError ) {
+            iBestError = iError;
+            iBestTable = t;
+            iMsb = iTableMsb;
+            iLsb = iTableLsb;
+        }
+    }
+
+    return iBestError;
+}
+
+/** Encodes one 4x4 block, given column major as block[x * 4 + y]. Returns 8 bytes. **/
+static void EncodeETC1Block(const u8 block[16][3], u8 out[8])
+{
+    u64 iBestBits = 0;
+    u32 iBestError = 0xFFFFFFFFu;
+
+    for ( int iFlip = 0; iFlip < 2; ++iFlip ) {
+        int pixels[2][8];
+        int n[2] = { 0, 0 };
+
+        for ( int p = 0; p < 16; ++p ) {
+            int x = p / 4, y = p % 4;
+            int iSub = iFlip ? (y >= 2) : (x >= 2);
+            pixels[iSub][n[iSub]++] = p;
+        }
+
+        int avg[2][3];
+        for ( int s = 0; s < 2; ++s ) {
+            for ( int c = 0; c < 3; ++c ) {
+                int iSum = 0;
+                for ( int k = 0; k < 8; ++k )
+                    iSum += block[pixels[s][k]][c];
+                avg[s][c] = (iSum + 4) / 8;
+            }
+        }
+
+        for ( int iDiff = 0; iDiff < 2; ++iDiff ) {
+            int q[2][3], base[2][3];
+            bool bValid = true;
+
+            for ( int s = 0; s < 2; ++s ) {
+                for ( int c = 0; c < 3; ++c ) {
+                    if ( iDiff ) {
+                        q[s][c]    = (avg[s][c] * 31 + 127) / 255;
+                        base[s][c] = (q[s][c] << 3) | (q[s][c] >> 2);
+                    } else {
+                        q[s][c]    = (avg[s][c] * 15 + 127) / 255;
+                        base[s][c] = (q[s][c] << 4) | q[s][c];
+                    }
+                }
+            }
+
+            if ( iDiff )
+                for ( int c = 0; c < 3; ++c )
+                    if ( q[1][c] - q[0][c] < -4 || q[1][c] - q[0][c] > 3 )
+                        bValid = false;
+            if ( !bValid )
+                continue;
+
+            int table[2];
+            u32 msb[2], lsb[2];
+            u32 iError = FitSubBlock(block, pixels[0], base[0], table[0], msb[0], lsb[0])
+                       + FitSubBlock(block, pixels[1], base[1], table[1], msb[1], lsb[1]);
+
+            if ( iError >= iBestError )
+                continue;
+
+            u64 bits = 0;
+            for ( int c = 0; c < 3; ++c ) {
+                int iShift = 56 - c * 8;
+                if ( iDiff ) {
+                    bits |= (u64)q[0][c] << (iShift + 3);
+                    bits |= (u64)((q[1][c] - q[0][c]) & 7) << iShift;
+                } else {
+                    bits |= (u64)q[0][c] << (iShift + 4);
+                    bits |= (u64)q[1][c] << iShift;
+                }
+            }
+            bits |= (u64)table[0] << 37;
+            bits |= (u64)table[1] << 34;
+            bits |= (u64)iDiff << 33;
+            bits |= (u64)iFlip << 32;
+            bits |= (u64)((msb[0] | msb[1]) & 0xFFFF) << 16;
+            bits |= (u64)((lsb[0] | lsb[1]) & 0xFFFF);
+
+            iBestError = iError;
+            iBestBits = bits;
+        }
+    }
+
+    for ( int i = 0; i < 8; ++i )
+        out[i] = (u8)(iBestBits >> (56 - i * 8));
+}
+
+static void EncodeETC1(const Image& image, std::vector<u8>& out)
+{
+    int iBlocksX = (image.w + 3) / 4;
+    int iBlocksY = (image.h + 3) / 4;
+    out.resize((size_t)iBlocksX * iBlocksY * 8);
+
+    for ( int by = 0; by < iBlocksY; ++by ) {
+        for ( int bx = 0; bx < iBlocksX; ++bx ) {
+            u8 block[16][3];
+            for ( int p = 0; p < 16; ++p ) {
+                int x = std::min(bx * 4 + p / 4, image.w - 1);
+                int y = std::min(by * 4 + p % 4, image.h - 1);
+                for ( int c = 0; c < 3; ++c )
+                    block[p][c] = image.rgba[((size_t)y * image.w + x) * 4 + c];
+            }
+            EncodeETC1Block(block, &out[((size_t)by * iBlocksX + bx) * 8]);
+        }
+    }
+}
+
+// ---
+// output
+
+static void Put32(std::vector<u8>& out, u32 v)
+{
+    for ( int i = 0; i < 4; ++i )
+        out.push_back((u8)(v >> (i * 8)));
+}
+
+static bool WriteKTX(const char* czPath, const std::vector<Image>& levels, bool bETC1)
+{
+    static const u8 IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    std::vector<u8> out(IDENTIFIER, IDENTIFIER + 12);
+    Put32(out, 0x04030201);
+    Put32(out, bETC1 ? 0 : GL_UNSIGNED_BYTE_);
+    Put32(out, 1);
+    Put32(out, bETC1 ? 0 : GL_RGBA_);
+    Put32(out, bETC1 ? GL_ETC1_RGB8_OES_ : GL_RGBA_);
+    Put32(out, bETC1 ? GL_RGB_ : GL_RGBA_);
+    Put32(out, levels[0].w);
+    Put32(out, levels[0].h);
+    Put32(out, 0);
+    Put32(out, 0);
+    Put32(out, 1);
+    Put32(out, (u32)levels.size());
+    Put32(out, 0);
+
+    for ( size_t i = 0; i < levels.size(); ++i ) {
+        std::vector<u8> data;
+        if ( bETC1 )
+            EncodeETC1(levels[i], data);
+        else
+            data = levels[i].rgba;
+
+        Put32(out, (u32)data.size());
+        out.insert(out.end(), data.begin(), data.end());
+        while ( out.size() % 4 )
+            out.push_back(0);
+    }
+
+    FILE* f = fopen(czPath, "wb");
+    if ( !f )
+        return false;
+    bool bOk = fwrite(&out[0], 1, out.size(), f) == out.size();
+    return fclose(f) == 0 && bOk;
+}
+
+static std::string BaseName(const std::string& path)
+{
+    size_t iSlash = path.find_last_of("/\\");
+    std::string name = iSlash == std::string::npos ? path : path.substr(iSlash + 1);
+    size_t iDot = name.rfind('.');
+    return iDot == std::string::npos ? name : name.substr(0, iDot);
+}
+
+static u64 Fnv1a(u64 h, const void* pData, size_t iSize)
+{
+    const u8* p = (const u8*)pData;
+    for ( size_t i = 0; i < iSize; ++i ) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static bool FileExists(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if ( f )
+        fclose(f);
+    return f != 0;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: assetcook [--max-size N] [--padding N] [--colorkey RRGGBB] [--rgba] [--no-mips] [--stamp PATH]"
+                    " <output base path> <sprite.bmp>...\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    options.iMaxSize    = 2048;
+    options.iPadding    = 2;
+    options.bColorKey   = false;
+    options.colorKey[0] = options.colorKey[1] = options.colorKey[2] = 0;
+    options.bForceRGBA  = false;
+    options.bMips       = true;
+
+    // Options that change the output are part of the content hash.
+    std::string optionText, hashPath;
+    int i = 1;
+    for ( ; i < argc && strncmp(argv[i], "--", 2) == 0; ++i ) {
+        std::string arg = argv[i];
+
+        if ( arg == "--rgba" ) {
+            options.bForceRGBA = true;
+        } else if ( arg == "--no-mips" ) {
+            options.bMips = false;
+        } else if ( i + 1 < argc && arg == "--stamp" ) {
+            hashPath = argv[++i];
+            continue;
+        } else if ( i + 1 < argc && arg == "--max-size" ) {
+            options.iMaxSize = atoi(argv[++i]);
+        } else if ( i + 1 < argc && arg == "--padding" ) {
+            options.iPadding = atoi(argv[++i]);
+        } else if ( i + 1 < argc && arg == "--colorkey" ) {
+            u32 iKey = (u32)strtoul(argv[++i], 0, 16);
+            options.bColorKey   = true;
+            options.colorKey[0] = (u8)(iKey >> 16);
+            options.colorKey[1] = (u8)(iKey >> 8);
+            options.colorKey[2] = (u8)iKey;
+        } else {
+            return Usage();
+        }
+
+        optionText += arg + " " + argv[i] + " ";
+    }
+
+    if ( argc - i < 2 )
+        return Usage();
+
+    std::string outBase = argv[i++];
+    std::vector<std::string> inputs(argv + i, argv + argc);
+    std::sort(inputs.begin(), inputs.end());
+
+    // Skip the work when neither the inputs nor the options changed.
+    u64 iHash = 14695981039346656037ull;
+    iHash = Fnv1a(iHash, TOOL_VERSION, strlen(TOOL_VERSION));
+    iHash = Fnv1a(iHash, optionText.data(), optionText.size());
+    for ( size_t k = 0; k < inputs.size(); ++k ) {
+        std::vector<u8> data;
+        if ( !ReadFile(inputs[k].c_str(), data) ) {
+            fprintf(stderr, "assetcook: cannot read %s\n", inputs[k].c_str());
+            return 1;
+        }
+        std::string name = BaseName(inputs[k]);
+        iHash = Fnv1a(iHash, name.data(), name.size() + 1);
+        if ( !data.empty() )
+            iHash = Fnv1a(iHash, &data[0], data.size());
+    }
+
+    char hashText[32];
+    sprintf(hashText, "%016llx", iHash);
+
+    std::string ktxPath = outBase + ".ktx", atlasPath = outBase + ".atlas";
+    if ( hashPath.empty() )
+        hashPath = outBase + ".hash";
+    std::vector<u8> oldHash;
+    if ( ReadFile(hashPath.c_str(), oldHash) && std::string(oldHash.begin(), oldHash.end()) == hashText
+      && FileExists(ktxPath) && FileExists(atlasPath) ) {
+        printf("assetcook: %s is up to date\n", ktxPath.c_str());
+        return 0;
+    }
+
+    std::vector<Sprite> sprites(inputs.size());
+    bool bOpaque = true;
+
+    for ( size_t k = 0; k < inputs.size(); ++k ) {
+        Sprite& sprite = sprites[k];
+        sprite.name = BaseName(inputs[k]);
+
+        if ( !LoadBMP(inputs[k].c_str(), sprite.image) ) {
+            fprintf(stderr, "assetcook: %s is not an uncompressed 24/32 bit BMP\n", inputs[k].c_str());
+            return 1;
+        }
+
+        std::vector<u8>& px = sprite.image.rgba;
+        for ( size_t p = 0; p < px.size(); p += 4 ) {
+            if ( options.bColorKey && px[p] == options.colorKey[0] && px[p + 1] == options.colorKey[1]
+              && px[p + 2] == options.colorKey[2] )
+                px[p + 3] = 0;
+            if ( px[p + 3] != 255 )
+                bOpaque = false;
+        }
+    }
+
+    int iSize = Pack(sprites, options);
+    if ( iSize == 0 ) {
+        fprintf(stderr, "assetcook: sprites do not fit into a %dx%d atlas\n", options.iMaxSize, options.iMaxSize);
+        return 1;
+    }
+
+    std::vector<Image> levels(1);
+    levels[0].w = levels[0].h = iSize;
+    levels[0].rgba.assign((size_t)iSize * iSize * 4, 0);
+
+    for ( size_t k = 0; k < sprites.size(); ++k ) {
+        const Image& img = sprites[k].image;
+        for ( int y = 0; y < img.h; ++y )
+            memcpy(&levels[0].rgba[(((size_t)sprites[k].y + y) * iSize + sprites[k].x) * 4],
+                   &img.rgba[(size_t)y * img.w * 4], (size_t)img.w * 4);
+    }
+
+    while ( options.bMips && (levels.back().w > 1 || levels.back().h > 1) )
+        levels.push_back(Downsample(levels.back()));
+
+    // ETC1 has no alpha channel.
+    bool bETC1 = bOpaque && !options.bForceRGBA;
+    if ( !bOpaque && !options.bForceRGBA )
+        printf("assetcook: sprites have transparency, storing uncompressed RGBA\n");
+
+    if ( !WriteKTX(ktxPath.c_str(), levels, bETC1) ) {
+        fprintf(stderr, "assetcook: cannot write %s\n", ktxPath.c_str());
+        return 1;
+    }
+
+    FILE* f = fopen(atlasPath.c_str(), "w");
+    if ( !f ) {
+        fprintf(stderr, "assetcook: cannot write %s\n", atlasPath.c_str());
+        return 1;
+    }
+    fprintf(f, "atlas %s.ktx %d %d\n", BaseName(outBase).c_str(), iSize, iSize);
+    for ( size_t k = 0; k < sprites.size(); ++k ) {
+        const Sprite& s = sprites[k];
+        fprintf(f, "%s %d %d %d %d %.6f %.6f %.6f %.6f\n", s.name.c_str(), s.x, s.y, s.image.w, s.image.h,
+                (float)s.x / iSize, (float)s.y / iSize,
+                (float)(s.x + s.image.w) / iSize, (float)(s.y + s.image.h) / iSize);
+    }
+    fclose(f);
+
+    f = fopen(hashPath.c_str(), "w");
+    if ( f ) {
+        fputs(hashText, f);
+        fclose(f);
+    }
+
+    printf("assetcook: %s %dx%d, %d sprites, %d levels, %s\n", ktxPath.c_str(), iSize, iSize,
+           (int)sprites.size(), (int)levels.size(), bETC1 ? "ETC1" : "RGBA");
+    return 0;
+}
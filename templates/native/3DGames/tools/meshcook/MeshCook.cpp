@@ -0,0 +1,537 @@
+/**
+ * Offline mesh cooker.
+ *
+ * Converts a Wavefront OBJ model into the binary blob read by Mesh::Load
+ * (include/Mesh.h): interleaved 16 byte vertices with quantized position,
+ * normal and texture coordinate, 16-bit indices and one submesh per
+ * material. Submeshes with more than 65535 unique vertices are split.
+ *
+ * usage: meshcook [--bench N] <model.obj> <output.mesh>
+ *   --bench N   after cooking, time N loads of the text OBJ against N loads
+ *               of the cooked blob and print the averages
+ *
+ * Texture coordinates are flipped vertically to match the top-down rows of
+ * the KTX files written by assetcook.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+typedef unsigned char   u8;
+typedef unsigned short  u16;
+typedef unsigned int    u32;
+
+//Must match include/Mesh.h.
+static const char   MESH_MAGIC[4]       = { 'B', 'M', 'S', 'H' };
+static const u32    MESH_VERSION        = 1;
+static const u32    MESH_VERTEX_STRIDE  = 16;
+static const u32    MESH_HEADER_SIZE    = 76;
+static const u32    MESH_SUBMESH_SIZE   = 48;
+static const u32    MESH_NAME_SIZE      = 32;
+static const u32    MESH_MAX_VERTICES   = 65535;
+
+struct Corner
+{
+    int v, t, n;
+
+    bool operator<(const Corner& o) const
+    {
+        if ( v != o.v ) return v < o.v;
+        if ( t != o.t ) return t < o.t;
+        return n < o.n;
+    }
+};
+
+struct Group
+{
+    std::string         material;
+    std::vector<Corner> corners;    // three per triangle
+};
+
+struct Model
+{
+    std::vector<float>  positions;  // xyz
+    std::vector<float>  texcoords;  // uv
+    std::vector<float>  normals;    // xyz
+    std::vector<Group>  groups;
+};
+
+struct Submesh
+{
+    std::string         material;
+    std::vector<Corner> vertices;
+    std::vector<u16>    indices;
+};
+
+// ---
+// OBJ parsing
+
+/** OBJ indices are 1-based, negative values count back from the end. **/
+static int ResolveIndex(long iIndex, size_t iCount)
+{
+    if ( iIndex > 0 )
+        return (int)iIndex - 1;
+    if ( iIndex < 0 )
+        return (int)iCount + (int)iIndex;
+    return -1;
+}
+
+static bool ParseCorner(const char*& p, const Model& model, Corner& c)
+{
+    char* pEnd;
+    c.v = ResolveIndex(strtol(p, &pEnd, 10), model.positions.size() / 3);
+    if ( pEnd == p )
+        return false;
+    p = pEnd;
+    c.t = c.n = -1;
+
+    if ( *p == '/' ) {
+        ++p;
+        if ( *p != '/' ) {
+            c.t = ResolveIndex(strtol(p, &pEnd, 10), model.texcoords.size() / 2);
+            p = pEnd;
+        }
+        if ( *p == '/' ) {
+            ++p;
+            c.n = ResolveIndex(strtol(p, &pEnd, 10), model.normals.size() / 3);
+            p = pEnd;
+        }
+    }
+
+    return c.v >= 0 && c.v < (int)(model.positions.size() / 3);
+}
+
+static bool ParseOBJ(const char* czPath, Model& model)
+{
+    FILE* f = fopen(czPath, "r");
+    if ( !f )
+        return false;
+
+    model.groups.resize(1);
+    char line[1024];
+
+    while ( fgets(line, sizeof(line), f) ) {
+        const char* p = line;
+        while ( *p == ' ' || *p == '\t' )
+            ++p;
+
+        if ( p[0] == 'v' && (p[1] == ' ' || p[1] == '\t') ) {
+            float x = 0, y = 0, z = 0;
+            sscanf(p + 2, "%f %f %f", &x, &y, &z);
+            model.positions.push_back(x);
+            model.positions.push_back(y);
+            model.positions.push_back(z);
+        } else if ( p[0] == 'v' && p[1] == 't' ) {
+            float u = 0, v = 0;
+            sscanf(p + 2, "%f %f", &u, &v);
+            model.texcoords.push_back(u);
+            model.texcoords.push_back(1.0f - v);
+        } else if ( p[0] == 'v' && p[1] == 'n' ) {
+            float x = 0, y = 0, z = 0;
+            sscanf(p + 2, "%f %f %f", &x, &y, &z);
+            model.normals.push_back(x);
+            model.normals.push_back(y);
+            model.normals.push_back(z);
+        } else if ( p[0] == 'f' && (p[1] == ' ' || p[1] == '\t') ) {
+            // Triangulate polygons as a fan.
+            std::vector<Corner> face;
+            Corner c;
+            p += 2;
+            for ( ;; ) {
+                while ( *p == ' ' || *p == '\t' )
+                    ++p;
+                if ( !ParseCorner(p, model, c) )
+                    break;
+                face.push_back(c);
+            }
+
+            Group& group = model.groups.back();
+            for ( size_t k = 2; k < face.size(); ++k ) {
+                group.corners.push_back(face[0]);
+                group.corners.push_back(face[k - 1]);
+                group.corners.push_back(face[k]);
+            }
+        } else if ( strncmp(p, "usemtl", 6) == 0 ) {
+            char name[256] = "";
+            sscanf(p + 6, "%255s", name);
+            if ( !model.groups.back().corners.empty() )
+                model.groups.push_back(Group());
+            model.groups.back().material = name;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+/** Models without normals get smooth normals, one per position. **/
+static void GenerateNormals(Model& model)
+{
+    model.normals.assign(model.positions.size(), 0.0f);
+
+    for ( size_t g = 0; g < model.groups.size(); ++g ) {
+        std::vector<Corner>& corners = model.groups[g].corners;
+
+        for ( size_t k = 0; k + 2 < corners.size(); k += 3 ) {
+            const float* a = &model.positions[corners[k].v * 3];
+            const float* b = &model.positions[corners[k + 1].v * 3];
+            const float* c = &model.positions[corners[k + 2].v * 3];
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3]  = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+
+            for ( int i = 0; i < 3; ++i )
+                for ( int j = 0; j < 3; ++j )
+                    model.normals[corners[k + i].v * 3 + j] += n[j];
+        }
+
+        for ( size_t k = 0; k < corners.size(); ++k )
+            corners[k].n = corners[k].v;
+    }
+}
+
+// ---
+// cooking
+
+static void BuildSubmeshes(const Model& model, std::vector<Submesh>& submeshes)
+{
+    for ( size_t g = 0; g < model.groups.size(); ++g ) {
+        const Group& group = model.groups[g];
+        if ( group.corners.empty() )
+            continue;
+
+        std::map<Corner, u16> lookup;
+        submeshes.push_back(Submesh());
+        submeshes.back().material = group.material;
+
+        for ( size_t k = 0; k + 2 < group.corners.size(); k += 3 ) {
+            // Start a new range when the triangle could overflow 16-bit indices.
+            if ( submeshes.back().vertices.size() + 3 > MESH_MAX_VERTICES ) {
+                lookup.clear();
+                submeshes.push_back(Submesh());
+                submeshes.back().material = group.material;
+            }
+
+            Submesh& sub = submeshes.back();
+            for ( int i = 0; i < 3; ++i ) {
+                const Corner& c = group.corners[k + i];
+                std::map<Corner, u16>::iterator it = lookup.find(c);
+                if ( it == lookup.end() ) {
+                    it = lookup.insert(std::make_pair(c, (u16)sub.vertices.size())).first;
+                    sub.vertices.push_back(c);
+                }
+                sub.indices.push_back(it->second);
+            }
+        }
+    }
+}
+
+/** Inverse of the GLES2 signed normalized decode f = (2c + 1) / (2^n - 1). **/
+static int QuantizeSigned(float f, int iBits)
+{
+    float fMax = (float)((1 << iBits) - 1);
+    int c = (int)floorf((f * fMax - 1.0f) * 0.5f + 0.5f);
+    int iHigh = (1 << (iBits - 1)) - 1;
+    return c < -iHigh - 1 ? -iHigh - 1 : (c > iHigh ? iHigh : c);
+}
+
+static int QuantizeUnsigned(float f)
+{
+    int c = (int)floorf(f * 65535.0f + 0.5f);
+    return c < 0 ? 0 : (c > 65535 ? 65535 : c);
+}
+
+static void Put32(std::vector<u8>& out, u32 v)
+{
+    for ( int i = 0; i < 4; ++i )
+        out.push_back((u8)(v >> (i * 8)));
+}
+
+static void PutFloat(std::vector<u8>& out, float f)
+{
+    u32 v;
+    memcpy(&v, &f, 4);
+    Put32(out, v);
+}
+
+static void Put16(std::vector<u8>& out, u16 v)
+{
+    out.push_back((u8)v);
+    out.push_back((u8)(v >> 8));
+}
+
+static void Align(std::vector<u8>& out, size_t iAlignment)
+{
+    while ( out.size() % iAlignment )
+        out.push_back(0);
+}
+
+static void Bounds(const std::vector<float>& values, int iComponents, float* pScale, float* pBias)
+{
+    for ( int c = 0; c < iComponents; ++c ) {
+        float fMin = 0.0f, fMax = 0.0f;
+        for ( size_t k = c; k < values.size(); k += iComponents ) {
+            if ( k == (size_t)c || values[k] < fMin ) fMin = values[k];
+            if ( k == (size_t)c || values[k] > fMax ) fMax = values[k];
+        }
+        pBias[c]  = fMin;
+        pScale[c] = fMax > fMin ? fMax - fMin : 1.0f;
+    }
+}
+
+static void Cook(const Model& model, const std::vector<Submesh>& submeshes, std::vector<u8>& out)
+{
+    // Positions decode to [-1, 1], texture coordinates to [0, 1].
+    float posScale[3], posBias[3], uvScale[2] = { 1.0f, 1.0f }, uvBias[2] = { 0.0f, 0.0f };
+    Bounds(model.positions, 3, posScale, posBias);
+    for ( int c = 0; c < 3; ++c ) {
+        posScale[c] *= 0.5f;
+        posBias[c]  += posScale[c];
+    }
+    if ( !model.texcoords.empty() )
+        Bounds(model.texcoords, 2, uvScale, uvBias);
+
+    u32 iVertexCount = 0, iIndexCount = 0;
+    for ( size_t s = 0; s < submeshes.size(); ++s ) {
+        iVertexCount += (u32)submeshes[s].vertices.size();
+        iIndexCount  += (u32)submeshes[s].indices.size();
+    }
+
+    u32 iSubmeshOffset  = MESH_HEADER_SIZE;
+    u32 iVertexOffset   = (iSubmeshOffset + (u32)submeshes.size() * MESH_SUBMESH_SIZE + 15) & ~15u;
+    u32 iIndexOffset    = iVertexOffset + iVertexCount * MESH_VERTEX_STRIDE;
+
+    out.insert(out.end(), MESH_MAGIC, MESH_MAGIC + 4);
+    Put32(out, MESH_VERSION);
+    Put32(out, iVertexCount);
+    Put32(out, iIndexCount);
+    Put32(out, (u32)submeshes.size());
+    Put32(out, MESH_VERTEX_STRIDE);
+    for ( int c = 0; c < 3; ++c ) PutFloat(out, posScale[c]);
+    for ( int c = 0; c < 3; ++c ) PutFloat(out, posBias[c]);
+    for ( int c = 0; c < 2; ++c ) PutFloat(out, uvScale[c]);
+    for ( int c = 0; c < 2; ++c ) PutFloat(out, uvBias[c]);
+    Put32(out, iSubmeshOffset);
+    Put32(out, iVertexOffset);
+    Put32(out, iIndexOffset);
+
+    u32 iFirstVertex = 0, iFirstIndex = 0;
+    for ( size_t s = 0; s < submeshes.size(); ++s ) {
+        const Submesh& sub = submeshes[s];
+        Put32(out, iFirstIndex);
+        Put32(out, (u32)sub.indices.size());
+        Put32(out, iFirstVertex);
+        Put32(out, (u32)sub.vertices.size());
+
+        char name[MESH_NAME_SIZE];
+        memset(name, 0, sizeof(name));
+        strncpy(name, sub.material.c_str(), sizeof(name) - 1);
+        out.insert(out.end(), name, name + sizeof(name));
+
+        iFirstVertex += (u32)sub.vertices.size();
+        iFirstIndex  += (u32)sub.indices.size();
+    }
+    Align(out, 16);
+
+    // position: 4 x int16 (w unused), normal: 4 x int8 (w unused), uv: 2 x uint16
+    for ( size_t s = 0; s < submeshes.size(); ++s ) {
+        const std::vector<Corner>& vertices = submeshes[s].vertices;
+
+        for ( size_t k = 0; k < vertices.size(); ++k ) {
+            const Corner& c = vertices[k];
+            const float* p = &model.positions[c.v * 3];
+            for ( int i = 0; i < 3; ++i )
+                Put16(out, (u16)QuantizeSigned((p[i] - posBias[i]) / posScale[i], 16));
+            Put16(out, 0);
+
+            float n[3] = { 0.0f, 0.0f, 1.0f };
+            if ( c.n >= 0 && c.n < (int)(model.normals.size() / 3) ) {
+                const float* pn = &model.normals[c.n * 3];
+                float fLength = sqrtf(pn[0] * pn[0] + pn[1] * pn[1] + pn[2] * pn[2]);
+                if ( fLength > 0.0f )
+                    for ( int i = 0; i < 3; ++i )
+                        n[i] = pn[i] / fLength;
+            }
+            for ( int i = 0; i < 3; ++i )
+                out.push_back((u8)QuantizeSigned(n[i], 8));
+            out.push_back(0);
+
+            float uv[2] = { 0.0f, 0.0f };
+            if ( c.t >= 0 && c.t < (int)(model.texcoords.size() / 2) )
+                for ( int i = 0; i < 2; ++i )
+                    uv[i] = (model.texcoords[c.t * 2 + i] - uvBias[i]) / uvScale[i];
+            Put16(out, (u16)QuantizeUnsigned(uv[0]));
+            Put16(out, (u16)QuantizeUnsigned(uv[1]));
+        }
+    }
+
+    for ( size_t s = 0; s < submeshes.size(); ++s )
+        for ( size_t k = 0; k < submeshes[s].indices.size(); ++k )
+            Put16(out, submeshes[s].indices[k]);
+}
+
+// ---
+// benchmark
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * The text path: parse the OBJ and build the float vertex and index arrays a
+ * runtime OBJ loader would hand to glBufferData.
+ */
+static size_t LoadText(const char* czPath)
+{
+    Model model;
+    if ( !ParseOBJ(czPath, model) )
+        return 0;
+    if ( model.normals.empty() )
+        GenerateNormals(model);
+
+    std::vector<Submesh> submeshes;
+    BuildSubmeshes(model, submeshes);
+
+    std::vector<float> vertices;
+    size_t iBytes = 0;
+    for ( size_t s = 0; s < submeshes.size(); ++s ) {
+        const Submesh& sub = submeshes[s];
+        vertices.clear();
+        for ( size_t k = 0; k < sub.vertices.size(); ++k ) {
+            const Corner& c = sub.vertices[k];
+            vertices.insert(vertices.end(), &model.positions[c.v * 3], &model.positions[c.v * 3] + 3);
+            vertices.insert(vertices.end(), &model.normals[c.n * 3], &model.normals[c.n * 3] + 3);
+            for ( int i = 0; i < 2; ++i )
+                vertices.push_back(c.t >= 0 ? model.texcoords[c.t * 2 + i] : 0.0f);
+        }
+        iBytes += vertices.size() * sizeof(float) + sub.indices.size() * sizeof(u16);
+    }
+    return iBytes;
+}
+
+/** The blob path, as in Mesh::Load: map, check the header, read the buffers once. **/
+static size_t LoadBlob(const char* czPath)
+{
+    int fd = open(czPath, O_RDONLY);
+    if ( fd < 0 )
+        return 0;
+
+    struct stat st;
+    fstat(fd, &st);
+    void* pMap = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( pMap == MAP_FAILED )
+        return 0;
+
+    const u8* p = (const u8*)pMap;
+    u32 iVertexCount, iIndexCount, iVertexOffset, iIndexOffset;
+    memcpy(&iVertexCount, p + 8, 4);
+    memcpy(&iIndexCount, p + 12, 4);
+    memcpy(&iVertexOffset, p + 68, 4);
+    memcpy(&iIndexOffset, p + 72, 4);
+
+    // Stand-in for the driver copy done by glBufferData.
+    size_t iBytes = iVertexCount * MESH_VERTEX_STRIDE + iIndexCount * sizeof(u16);
+    std::vector<u8> upload(p + iVertexOffset, p + iVertexOffset + iVertexCount * MESH_VERTEX_STRIDE);
+    upload.insert(upload.end(), p + iIndexOffset, p + iIndexOffset + iIndexCount * sizeof(u16));
+
+    munmap(pMap, st.st_size);
+    return upload.size() == iBytes ? iBytes : 0;
+}
+
+static void Bench(const char* czObj, const char* czBlob, int iRuns)
+{
+    size_t iTextBytes = 0, iBlobBytes = 0;
+
+    double fStart = Now();
+    for ( int i = 0; i < iRuns; ++i )
+        iTextBytes = LoadText(czObj);
+    double fText = (Now() - fStart) / iRuns;
+
+    fStart = Now();
+    for ( int i = 0; i < iRuns; ++i )
+        iBlobBytes = LoadBlob(czBlob);
+    double fBlob = (Now() - fStart) / iRuns;
+
+    printf("meshcook: text OBJ %.3f ms (%u buffer bytes), blob %.3f ms (%u buffer bytes), %.1fx\n",
+           fText, (unsigned)iTextBytes, fBlob, (unsigned)iBlobBytes, fBlob > 0.0 ? fText / fBlob : 0.0);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: meshcook [--bench N] <model.obj> <output.mesh>\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    int iBenchRuns = 0;
+    int i = 1;
+
+    for ( ; i < argc && strncmp(argv[i], "--", 2) == 0; ++i ) {
+        if ( i + 1 < argc && strcmp(argv[i], "--bench") == 0 )
+            iBenchRuns = atoi(argv[++i]);
+        else
+            return Usage();
+    }
+
+    if ( argc - i != 2 )
+        return Usage();
+
+    const char* czInput  = argv[i];
+    const char* czOutput = argv[i + 1];
+
+    Model model;
+    if ( !ParseOBJ(czInput, model) ) {
+        fprintf(stderr, "meshcook: cannot read %s\n", czInput);
+        return 1;
+    }
+    if ( model.positions.empty() ) {
+        fprintf(stderr, "meshcook: %s has no geometry\n", czInput);
+        return 1;
+    }
+    if ( model.normals.empty() )
+        GenerateNormals(model);
+
+    std::vector<Submesh> submeshes;
+    BuildSubmeshes(model, submeshes);
+
+    std::vector<u8> out;
+    Cook(model, submeshes, out);
+
+    FILE* f = fopen(czOutput, "wb");
+    bool bOk = f && fwrite(&out[0], 1, out.size(), f) == out.size();
+    if ( f && fclose(f) != 0 )
+        bOk = false;
+    if ( !bOk ) {
+        fprintf(stderr, "meshcook: cannot write %s\n", czOutput);
+        return 1;
+    }
+
+    u32 iVertices = 0, iIndices = 0;
+    for ( size_t s = 0; s < submeshes.size(); ++s ) {
+        iVertices += (u32)submeshes[s].vertices.size();
+        iIndices  += (u32)submeshes[s].indices.size();
+    }
+    printf("meshcook: %s %u vertices, %u triangles, %d submeshes, %u bytes\n", czOutput,
+           iVertices, iIndices / 3, (int)submeshes.size(), (unsigned)out.size());
+
+    if ( iBenchRuns > 0 )
+        Bench(czInput, czOutput, iBenchRuns);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+
+#ifndef EVENTLOOP_H_
+#define EVENTLOOP_H_
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+/**
+ * Event driven main loop for apps whose screen only changes on input.
+ *
+ * WaitEvent() blocks in SDL_WaitEventTimeout() until an event arrives, the
+ * timer is due or Invalidate() is called, so an idle app does not wake up
+ * at all. Drawing happens only after something marked the content dirty:
+ *
+ *     while (!quit) {
+ *         while (loop.WaitEvent(event)) {
+ *             ... handle the event, loop.Invalidate() if the screen changes
+ *         }
+ *         if (loop.TakeTimer()) { ... periodic work }
+ *         if (loop.TakeDirty()) { ... draw and present }
+ *     }
+ *
+ * WaitEvent() returns false as soon as the content is dirty or the timer is
+ * due, so both must be taken before it is called again.
+ */
+class EventLoop
+{
+private:
+    //Set by Invalidate() from any thread.
+    SDL_atomic_t    Dirty;
+
+    bool            bVisible;
+    bool            bTimerDue;
+    Uint32          iTimerInterval;
+    Uint32          iNextTimer;
+
+    Uint32          iWakeups;
+    Uint32          iFrames;
+    Uint32          iStartTicks;
+    double          dStartCpuMs;
+
+    bool            IsReady     ();
+
+public:
+    EventLoop();
+
+    /**
+     * Wakes the loop every iIntervalMs even without events, see TakeTimer().
+     * 0, the default, waits for events only.
+     */
+    void    SetTimer    (Uint32 iIntervalMs);
+
+    /**
+     * While hidden (the app is in the background) a dirty screen does not
+     * stop WaitEvent(); drawing resumes once visible again.
+     */
+    void    SetVisible  (bool bVisible);
+
+    /**
+     * Marks the screen as needing a redraw. Safe from any thread, e.g. an
+     * audio callback; a blocked WaitEvent() wakes up.
+     */
+    void    Invalidate  ();
+
+    /**
+     * Returns the next event, blocking while there is nothing to draw. Window
+     * exposure and render resets invalidate the screen on their own.
+     * @return false when the screen is dirty or the timer is due.
+     */
+    bool    WaitEvent   (SDL_Event& event);
+
+    //True once per Invalidate() batch: the caller draws now.
+    bool    TakeDirty   ();
+
+    //True once per timer period.
+    bool    TakeTimer   ();
+
+    //Wake ups from a blocking wait and frames drawn, since construction.
+    Uint32  GetWakeups  () const { return iWakeups; }
+    Uint32  GetFrames   () const { return iFrames; }
+
+    //Prints the time run, the wake ups, the frames and the CPU time per minute.
+    void    Report      (FILE* pFile) const;
+};
+
+/**
+ * User plus system CPU time of this process in ms, 0 where unknown.
+ */
+double  GetProcessCpuMs ();
+
+#endif /* EVENTLOOP_H_ */
@@ -0,0 +1,59 @@
+
+#ifndef RENDERER2D_H_
+#define RENDERER2D_H_
+
+#include "SDL.h"
+
+enum Renderer2DBackend
+{
+    RENDERER_2D_TEXTURE,    // SDL_Renderer, the best driver available
+    RENDERER_2D_SURFACE     // software blits onto the window surface
+};
+
+/**
+ * 2D drawing of images and rectangles, behind which either SDL_Renderer
+ * textures or the window surface do the work.
+ *
+ * Images are uploaded once by LoadImage() and then drawn by id. The texture
+ * backend queues draws and sends each run of the same texture to the GPU in
+ * one SDL_RenderGeometry() call; the surface backend blits them one by one.
+ * A window hosts one backend at a time.
+ */
+class Renderer2D
+{
+public:
+    virtual ~Renderer2D() {}
+
+    //The SDL render driver in use, or "surface".
+    virtual const char* GetName         () const = 0;
+
+    /**
+     * Converts the surface to the backend format; it can be freed afterwards.
+     * @return The image id, or -1.
+     */
+    virtual int         LoadImage       (SDL_Surface* pSurface) = 0;
+
+    //Video memory taken by the loaded images, 0 for the surface backend.
+    virtual size_t      GetTextureBytes () const = 0;
+
+    virtual void        Clear           (Uint8 r, Uint8 g, Uint8 b) = 0;
+
+    //Draws the pSource part of the image (all of it if NULL) scaled to dest.
+    virtual void        Draw            (int iImage, const SDL_Rect* pSource, const SDL_Rect& dest) = 0;
+    virtual void        FillRect        (const SDL_Rect& rect, Uint8 r, Uint8 g, Uint8 b) = 0;
+
+    //Flushes the queued draws and shows the frame.
+    virtual void        Present         () = 0;
+
+    //SDL draw calls issued for the last presented frame.
+    virtual int         GetDrawCalls    () const = 0;
+};
+
+/**
+ * Creates the backend for the window, NULL if it is not available. The
+ * texture backend picks the render driver by its capabilities: hardware
+ * acceleration first, then render targets and the largest textures.
+ */
+Renderer2D* CreateRenderer2D(SDL_Window* pWindow, Renderer2DBackend eBackend, bool bVsync = true);
+
+#endif /* RENDERER2D_H_ */
@@ -0,0 +1,149 @@
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define EVENTLOOP_POSIX 1
+#endif
+
+#include "EventLoop.h"
+
+namespace {
+
+//Event type pushed by Invalidate() to wake a blocked WaitEvent(), registered once.
+Uint32 iWakeEvent = (Uint32)-1;
+
+}
+
+EventLoop::EventLoop()
+{
+    // The first frame is always drawn.
+    SDL_AtomicSet(&Dirty, 1);
+
+    bVisible        = true;
+    bTimerDue       = false;
+    iTimerInterval  = 0;
+    iNextTimer      = 0;
+
+    iWakeups        = 0;
+    iFrames         = 0;
+    iStartTicks     = SDL_GetTicks();
+    dStartCpuMs     = GetProcessCpuMs();
+
+    if (iWakeEvent == (Uint32)-1)
+        iWakeEvent = SDL_RegisterEvents(1);
+}
+
+void EventLoop::SetTimer(Uint32 iIntervalMs)
+{
+    iTimerInterval  = iIntervalMs;
+    iNextTimer      = SDL_GetTicks() + iIntervalMs;
+    bTimerDue       = false;
+}
+
+void EventLoop::SetVisible(bool bIsVisible)
+{
+    bVisible = bIsVisible;
+}
+
+void EventLoop::Invalidate()
+{
+    // Only the first call after a draw needs to wake the loop.
+    if (!SDL_AtomicCAS(&Dirty, 0, 1) || iWakeEvent == (Uint32)-1)
+        return;
+
+    SDL_Event wake;
+    SDL_zero(wake);
+    wake.type = iWakeEvent;
+    SDL_PushEvent(&wake);
+}
+
+/** True when WaitEvent() has to return: the timer is due or a visible screen is dirty. **/
+bool EventLoop::IsReady()
+{
+    if (iTimerInterval && !bTimerDue && (Sint32)(SDL_GetTicks() - iNextTimer) >= 0) {
+        bTimerDue = true;
+        iNextTimer += iTimerInterval;
+
+        // After a long stall the timer restarts instead of firing in a burst.
+        if ((Sint32)(SDL_GetTicks() - iNextTimer) >= 0)
+            iNextTimer = SDL_GetTicks() + iTimerInterval;
+    }
+
+    return bTimerDue || (bVisible && SDL_AtomicGet(&Dirty));
+}
+
+bool EventLoop::WaitEvent(SDL_Event& event)
+{
+    while (true) {
+        // Events already queued go first, then the caller gets to draw.
+        bool bReady = IsReady();
+
+        int iFound;
+        if (bReady) {
+            iFound = SDL_PollEvent(&event);
+        } else {
+            int iTimeout = iTimerInterval ? (int)(iNextTimer - SDL_GetTicks()) : -1;
+            iFound = SDL_WaitEventTimeout(&event, iTimeout);
+            ++iWakeups;
+        }
+
+        if (!iFound) {
+            if (bReady)
+                return false;
+            continue;
+        }
+
+        if (event.type == iWakeEvent)
+            continue;
+
+        if (event.type == SDL_WINDOWEVENT) {
+            Uint8 iWindowEvent = event.window.event;
+            if (iWindowEvent == SDL_WINDOWEVENT_EXPOSED || iWindowEvent == SDL_WINDOWEVENT_SHOWN
+                || iWindowEvent == SDL_WINDOWEVENT_SIZE_CHANGED || iWindowEvent == SDL_WINDOWEVENT_RESTORED)
+                SDL_AtomicSet(&Dirty, 1);
+        } else if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+            SDL_AtomicSet(&Dirty, 1);
+        }
+
+        return true;
+    }
+}
+
+bool EventLoop::TakeDirty()
+{
+    if (!bVisible || SDL_AtomicSet(&Dirty, 0) == 0)
+        return false;
+
+    ++iFrames;
+    return true;
+}
+
+bool EventLoop::TakeTimer()
+{
+    bool bDue = bTimerDue;
+    bTimerDue = false;
+    return bDue;
+}
+
+void EventLoop::Report(FILE* pFile) const
+{
+    double dSeconds = (SDL_GetTicks() - iStartTicks) / 1000.0;
+    double dCpuMs = GetProcessCpuMs() - dStartCpuMs;
+
+    fprintf(pFile, "event loop: %.1f s, %u wake ups, %u frames, %.1f ms CPU per minute (%.3f%% of a core)\n",
+            dSeconds, iWakeups, iFrames,
+            dSeconds > 0.0 ? dCpuMs * 60.0 / dSeconds : 0.0,
+            dSeconds > 0.0 ? dCpuMs / (dSeconds * 10.0) : 0.0);
+}
+
+double GetProcessCpuMs()
+{
+#if defined(EVENTLOOP_POSIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0
+         + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#else
+    return 0.0;
+#endif
+}
@@ -1,14 +1,27 @@
 #include <stdio.h>
 #include <SDL.h>
 
+#include "EventLoop.h"
+#include "Renderer2D.h"
+
 static const int WIDTH  = 1920;
 static const int HEIGHT = 1280;
 
+// Ends the idle measurement of IDLE_BENCH
+static Uint32 SDLCALL QuitTimer(Uint32 interval, void *param)
+{
+    SDL_Event quitEvent;
+    SDL_zero(quitEvent);
+    quitEvent.type = SDL_QUIT;
+    SDL_PushEvent(&quitEvent);
+    return 0;
+}
+
 int main( int argc, char* argv[] )
 {
     // Declare the window we'll be rendering to
     SDL_Window *window = NULL;
-    SDL_Renderer *renderer = NULL;
+    Renderer2D *renderer = NULL;
     Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_FULLSCREEN;
 
     // Declare application loop flag
@@ -32,30 +45,34 @@ int main( int argc, char* argv[] )
         return 0;
     }
 
-    // Create renderer with default
-    renderer = SDL_CreateRenderer(window, 1, SDL_RENDERER_ACCELERATED);
+    // Create renderer on the best available driver, RENDER_BACKEND=surface for software blits
+    const char *backend = SDL_getenv("RENDER_BACKEND");
+    renderer = CreateRenderer2D(window, (backend && SDL_strcmp(backend, "surface") == 0) ? RENDERER_2D_SURFACE : RENDERER_2D_TEXTURE);
     if(renderer == NULL)
     {
-        printf("SDL_CreateRenderer failed: %s\n", SDL_GetError());
+        printf("CreateRenderer2D failed: %s\n", SDL_GetError());
         return 0;
     }
+    printf("Renderer: %s\n", renderer->GetName());
+
+    //ToDo: Initialize your stub...
 
-    // Clear the entire screen
-    if(SDL_RenderClear(renderer) < 0)
+    // Sleeps until an event arrives and draws only when the screen is dirty.
+    // Animated content calls loop.Invalidate() every frame or loop.SetTimer().
+    EventLoop loop;
+
+    // IDLE_BENCH=60 leaves the app idle for 60 s, then prints the CPU time it used and quits
+    const char *idleBench = SDL_getenv("IDLE_BENCH");
+    if(idleBench)
     {
-        printf("SDL_RenderClear failed: %s\n", SDL_GetError());
-        return 0;
+        SDL_AddTimer(SDL_atoi(idleBench) * 1000, QuitTimer, NULL);
     }
 
-    //ToDo: Initialize your stub...
-
     // Start application loop
     while(quit == false)
     {
-        // ToDo: ...
-
-        // Start to poll event
-        while(SDL_PollEvent(&event))
+        // Wait for events, returns when there is something to draw
+        while(loop.WaitEvent(event))
         {
             // User requests quit
             if(event.type == SDL_QUIT)
@@ -64,15 +81,44 @@ int main( int argc, char* argv[] )
                 break;
             }
 
-            //ToDo: Event handling
+            // The screen is not drawn in the background
+            if(event.type == SDL_APP_DIDENTERBACKGROUND)
+            {
+                loop.SetVisible(false);
+            }
+            else if(event.type == SDL_APP_DIDENTERFOREGROUND)
+            {
+                loop.SetVisible(true);
+                loop.Invalidate();
+            }
+
+            //ToDo: Event handling, loop.Invalidate() when the screen has to change
         }
 
-        // Up until now everything was drawn behind the scenes.
-        SDL_RenderPresent(renderer);
+        // ToDo: Periodic work when loop.TakeTimer() is true
+
+        if(loop.TakeDirty())
+        {
+            // Clear the entire screen
+            renderer->Clear(0, 0, 0);
+
+            // ToDo: Load images once with renderer->LoadImage(), then renderer->Draw() them here...
+
+            // Up until now everything was drawn behind the scenes.
+            renderer->Present();
+        }
+    }
+
+    if(idleBench)
+    {
+        loop.Report(stdout);
     }
 
     // ToDo: Finalize your stub...
 
+    // Free the images and the renderer
+    delete renderer;
+
     // Finalize SDL
     SDL_Quit();
     return 0;
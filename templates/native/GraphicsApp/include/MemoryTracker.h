@@ -0,0 +1,117 @@
+
+#ifndef MEMORYTRACKER_H_
+#define MEMORYTRACKER_H_
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+/**
+ * Subsystem an allocation is charged to. Add application tags before
+ * MEM_TAG_COUNT and name them in MemoryTracker.cpp.
+ */
+enum MemoryTag
+{
+    MEM_TAG_OTHER = 0,      // untagged allocations of the main thread
+    MEM_TAG_THREADS,        // anything allocated by other threads, e.g. audio
+    MEM_TAG_IMAGES,
+    MEM_TAG_TEXT,
+    MEM_TAG_FONTS,
+    MEM_TAG_AUDIO,
+    MEM_TAG_GL_BUFFERS,     // reported with MemoryTracker::Add()/Remove()
+    MEM_TAG_GL_TEXTURES,
+    MEM_TAG_COUNT
+};
+
+/**
+ * Called when a tag goes over its budget.
+ */
+typedef void (*MemoryBudgetCallback)(MemoryTag eTag, size_t iCurrent, size_t iBudget, void* pUserData);
+
+/**
+ * Per subsystem accounting of SDL allocations.
+ *
+ * Install() routes SDL_malloc() and friends through the tracker with
+ * SDL_SetMemoryFunctions(), so surfaces, fonts, chunks and everything else
+ * SDL, SDL_ttf and SDL_mixer allocate is charged to the tag of the
+ * enclosing MemoryScope. Each block carries a small header with its size
+ * and tag; blocks allocated on other threads are charged to
+ * MEM_TAG_THREADS. Libraries calling malloc() directly, such as FreeType,
+ * are not seen.
+ *
+ * GL buffers and textures live in driver memory; report their sizes with
+ * Add() and Remove(), see GetTextureBytes().
+ *
+ * Budgets are soft: allocations always succeed, and the callback of a tag
+ * that went over its budget runs from the next CheckBudgets(), never
+ * inside the allocator.
+ */
+class MemoryTracker
+{
+public:
+    /**
+     * Must run before SDL_Init() and before anything else allocates through SDL.
+     * @return false if the memory functions could not be replaced.
+     */
+    static bool     Install         ();
+    static bool     IsInstalled     ();
+
+    //Charges memory SDL does not allocate, e.g. GL objects, to a tag.
+    static void     Add             (MemoryTag eTag, size_t iBytes);
+    static void     Remove          (MemoryTag eTag, size_t iBytes);
+
+    /**
+     * Sets a soft budget for a tag, 0 to remove it. The callback runs once
+     * per crossing, from CheckBudgets().
+     */
+    static void     SetBudget       (MemoryTag eTag, size_t iBytes, MemoryBudgetCallback pCallback, void* pUserData);
+    static size_t   GetBudget       (MemoryTag eTag);
+
+    /**
+     * Runs the callbacks of the tags that went over budget since the last
+     * call; call it once per frame or event.
+     */
+    static void     CheckBudgets    ();
+
+    static size_t   GetCurrent      (MemoryTag eTag);
+    static size_t   GetPeak         (MemoryTag eTag);
+    static size_t   GetBlocks       (MemoryTag eTag);
+    static size_t   GetTotal        ();
+    static size_t   GetTotalPeak    ();
+
+    static const char*  GetTagName  (MemoryTag eTag);
+
+    //Bytes of a w x h texture, plus a third for a full mipmap chain.
+    static size_t   GetTextureBytes (int iWidth, int iHeight, int iBytesPerPixel, bool bMipmaps);
+
+    /**
+     * Writes current, peak, live blocks and budget of every tag as JSON.
+     * Blocks still live after SDL_Quit() are leaks.
+     */
+    static void     WriteJson       (FILE* pFile);
+
+    /**
+     * Writes the JSON to the file named by the MEMORY_REPORT environment
+     * variable, or to stdout without it.
+     */
+    static bool     DumpJson        ();
+};
+
+/**
+ * Charges the allocations of the current thread to a tag until the scope
+ * ends; scopes nest.
+ */
+class MemoryScope
+{
+private:
+    MemoryTag ePrevious;
+
+    MemoryScope(const MemoryScope&);
+    MemoryScope& operator=(const MemoryScope&);
+
+public:
+    explicit MemoryScope(MemoryTag eTag);
+    ~MemoryScope();
+};
+
+#endif /* MEMORYTRACKER_H_ */
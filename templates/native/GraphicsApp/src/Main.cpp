@@ -1,5 +1,10 @@
 #include "SDL.h"
+#include "MemoryTracker.h"
+#include "Renderer2D.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
 
 using namespace std;
@@ -7,16 +12,141 @@ using namespace std;
 const int SCREEN_WIDTH = 1024;
 const int SCREEN_HEIGHT = 780;
 
+//Soft limit for decoded images.
+const size_t IMAGE_BUDGET = 8 * 1024 * 1024;
+
+/**
+ * Warns when a subsystem uses more memory than planned.
+ */
+void onOverBudget(MemoryTag tag, size_t current, size_t budget, void* userData) {
+    cout << "Memory budget exceeded: " << MemoryTracker::GetTagName(tag) << " uses " << current
+         << " of " << budget << " bytes" << endl;
+}
+
+/**
+ * Draws the image on the left side of the screen and a yellow rectangle.
+ */
+void drawScene(Renderer2D* renderer, int image) {
+
+    renderer->Clear(0, 0, 0);
+
+    //DISPLAY IMAGE on left side of screen
+    SDL_Rect Rect1;
+    Rect1.x = 200;
+    Rect1.y = 100;
+    Rect1.w = 500;
+    Rect1.h = 500;
+
+    SDL_Rect Dest = { 0, 0, Rect1.w, Rect1.h };
+    renderer->Draw(image, &Rect1, Dest);
+
+    SDL_Rect Rect;
+    Rect.x = 700;
+    Rect.y = 100;
+    Rect.w = 200;
+    Rect.h = 300;
+
+    renderer->FillRect(Rect, 255, 255, 0);
+
+    //Update Screen
+    renderer->Present();
+}
+
+/**
+ * Draws the given number of 64x64 tiles of res/lam.bmp per frame, moving,
+ * and a rectangle for every 16 of them, with the texture and then the
+ * surface backend, each in its own window for the given time. Prints the
+ * frame time and the draw calls per frame of each. Runs headless with
+ * SDL_VIDEODRIVER=offscreen.
+ */
+bool runRenderBenchmark(int seconds, int sprites) {
+
+    const Renderer2DBackend backends[2] = { RENDERER_2D_TEXTURE, RENDERER_2D_SURFACE };
+
+    for (int b = 0; b < 2; ++b) {
+        SDL_Window* window = SDL_CreateWindow("Renderer benchmark", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+        Renderer2D* renderer = CreateRenderer2D(window, backends[b], false);
+        if (renderer == NULL) {
+            cout << "Renderer creation failed " << SDL_GetError() << endl;
+            SDL_DestroyWindow(window);
+            return false;
+        }
+
+        SDL_Surface* surface = NULL;
+        int image = -1;
+        {
+            MemoryScope scope(MEM_TAG_IMAGES);
+            surface = SDL_LoadBMP("res/lam.bmp");
+            image = renderer->LoadImage(surface);
+            SDL_FreeSurface(surface);
+        }
+        if (image < 0) {
+            cout << "Image upload failed " << SDL_GetError() << endl;
+            delete renderer;
+            SDL_DestroyWindow(window);
+            return false;
+        }
+
+        Uint64 frequency = SDL_GetPerformanceFrequency();
+        Uint64 start = SDL_GetPerformanceCounter();
+        Uint64 end = start + frequency * seconds;
+        int frames = 0;
+
+        while (SDL_GetPerformanceCounter() < end) {
+            SDL_PumpEvents();
+            renderer->Clear(0, 0, 0);
+
+            for (int i = 0; i < sprites; ++i) {
+                SDL_Rect tile = { (i % 8) * 64, ((i / 8) % 8) * 64, 64, 64 };
+                SDL_Rect dest = { (i * 37 + frames * 3) % (SCREEN_WIDTH - 64),
+                                  (i * 53 + frames * 2) % (SCREEN_HEIGHT - 64), 64, 64 };
+                renderer->Draw(image, &tile, dest);
+            }
+
+            for (int i = 0; i < sprites / 16; ++i) {
+                SDL_Rect rect = { (i * 71 + frames) % (SCREEN_WIDTH - 16), (i * 29) % (SCREEN_HEIGHT - 16), 16, 16 };
+                renderer->FillRect(rect, 255, 255, 0);
+            }
+
+            renderer->Present();
+            ++frames;
+        }
+
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / (frames ? frames : 1);
+        printf("%-10s %d sprites: %d frames, %.2f ms per frame, %d draw calls per frame\n",
+               renderer->GetName(), sprites, frames, ms, renderer->GetDrawCalls());
+
+        delete renderer;
+        SDL_DestroyWindow(window);
+    }
+
+    return true;
+}
+
 int main(int argc, char* args[]) {
 
     //The images
     SDL_Surface* image = NULL;
     SDL_Window *screen = NULL;
-    SDL_Surface *WinSurface = NULL;
+    Renderer2D *renderer = NULL;
+    int imageId = -1;
+
+    //Account SDL allocations per subsystem, before SDL allocates anything
+    MemoryTracker::Install();
+    MemoryTracker::SetBudget(MEM_TAG_IMAGES, IMAGE_BUDGET, onOverBudget, NULL);
 
     //Start SDL
     SDL_Init(SDL_INIT_EVERYTHING);
 
+    //RENDER_BENCH=5 compares the texture and surface backends for 5 s each and exits
+    if (SDL_getenv("RENDER_BENCH")) {
+        int sprites = SDL_getenv("RENDER_SPRITES") ? atoi(SDL_getenv("RENDER_SPRITES")) : 2000;
+        bool done = runRenderBenchmark(atoi(SDL_getenv("RENDER_BENCH")), sprites);
+        SDL_Quit();
+        return done ? 0 : 1;
+    }
+
     //Set up the screen
     screen = SDL_CreateWindow("Monitor Music", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH,
             SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
@@ -27,40 +157,36 @@ int main(int argc, char* args[]) {
         return false;
     }
 
-    WinSurface = SDL_GetWindowSurface(screen);
-
-    //Load image
-    image = SDL_LoadBMP( "res/lam.bmp" );
-
-    //DISPLAY IMAGE on left side of screen
-    SDL_Rect Rect1;
-    Rect1.x = 200;
-    Rect1.y = 100;
-    Rect1.w = 500;
-    Rect1.h = 500;
-
-    //Apply image to screen
-    SDL_BlitSurface(image, &Rect1, WinSurface, NULL);
-
-    SDL_Rect Rect;
-    Rect.x = 700;
-    Rect.y = 100;
-    Rect.w = 200;
-    Rect.h = 300;
-    Uint32 Color = SDL_MapRGB(WinSurface->format, 255, 255, 0);
-
-    SDL_FillRect(WinSurface, &Rect, Color);
+    //Textures by default, RENDER_BACKEND=surface for the software blits
+    const char* backend = SDL_getenv("RENDER_BACKEND");
+    if (backend == NULL || strcmp(backend, "surface") != 0) {
+        renderer = CreateRenderer2D(screen, RENDERER_2D_TEXTURE);
+    }
+    if (renderer == NULL) {
+        renderer = CreateRenderer2D(screen, RENDERER_2D_SURFACE);
+    }
+    if (renderer == NULL) {
+        cout << "Renderer creation failed " << SDL_GetError() << endl;
+        return false;
+    }
 
-    // SDL_UpdateRect(screen,0,0,0,0);
+    //Load image and upload it once; the decoded copy is not needed afterwards
+    {
+        MemoryScope scope(MEM_TAG_IMAGES);
+        image = SDL_LoadBMP( "res/lam.bmp" );
+        imageId = renderer->LoadImage(image);
+        SDL_FreeSurface(image);
+    }
+    MemoryTracker::Add(MEM_TAG_GL_TEXTURES, renderer->GetTextureBytes());
 
-    //Update Screen
-    SDL_UpdateWindowSurface(screen);
+    drawScene(renderer, imageId);
 
     SDL_Event event;
     int done = 0;
     while (!done) {
         /* Check for events */
         SDL_WaitEvent(&event);
+        MemoryTracker::CheckBudgets();
         switch (event.type) {
         case SDL_KEYDOWN:
         case SDL_QUIT:
@@ -68,6 +194,10 @@ int main(int argc, char* args[]) {
             break;
         case SDL_KEYUP:
 
+            break;
+        case SDL_WINDOWEVENT:
+            //The backend may have lost the frame
+            drawScene(renderer, imageId);
             break;
         case SDL_MOUSEBUTTONDOWN:
             /* Any button press quits the app... */
@@ -82,16 +212,18 @@ int main(int argc, char* args[]) {
     //Pause
     //SDL_Delay( 2000 );
 
-    //Free the loaded image
-    SDL_FreeSurface(image);
-
-    SDL_FreeSurface(WinSurface);
+    //Free the uploaded image with the renderer
+    MemoryTracker::Remove(MEM_TAG_GL_TEXTURES, renderer->GetTextureBytes());
+    delete renderer;
 
     SDL_DestroyWindow(screen);
 
     //Quit SDL
     SDL_Quit();
 
+    //Blocks still live here were leaked, MEMORY_REPORT=path writes them to a file
+    MemoryTracker::DumpJson();
+
     return 0;
 }
 
@@ -0,0 +1,312 @@
+
+#include <stdlib.h>
+
+#include "MemoryTracker.h"
+
+namespace {
+
+//Keeps the blocks handed out by SDL_malloc() 16 byte aligned.
+//Counters are ints, so a single tag is tracked up to 2 GB.
+const size_t HEADER_SIZE = 16;
+
+struct BlockHeader
+{
+    size_t      iSize;
+    MemoryTag   eTag;
+};
+
+struct TagStats
+{
+    SDL_atomic_t            Current;
+    SDL_atomic_t            Peak;
+    SDL_atomic_t            Blocks;
+
+    size_t                  iBudget;
+    MemoryBudgetCallback    pCallback;
+    void*                   pUserData;
+
+    //0 under budget, 1 over and not reported yet, 2 reported.
+    SDL_atomic_t            OverBudget;
+};
+
+const char* TagNames[MEM_TAG_COUNT] = {
+    "other",
+    "threads",
+    "images",
+    "text",
+    "fonts",
+    "audio",
+    "gl_buffers",
+    "gl_textures"
+};
+
+TagStats        Stats[MEM_TAG_COUNT];
+SDL_atomic_t    TotalPeak;
+
+SDL_malloc_func     pNextMalloc     = 0;
+SDL_calloc_func     pNextCalloc     = 0;
+SDL_realloc_func    pNextRealloc    = 0;
+SDL_free_func       pNextFree       = 0;
+
+//Tags only apply to the thread that installed the tracker, see MemoryScope.
+SDL_threadID    iMainThread     = 0;
+MemoryTag       eCurrentTag     = MEM_TAG_OTHER;
+
+size_t Total()
+{
+    size_t iTotal = 0;
+    for (int i = 0; i < MEM_TAG_COUNT; ++i)
+        iTotal += (size_t)SDL_AtomicGet(&Stats[i].Current);
+    return iTotal;
+}
+
+void RaisePeak(SDL_atomic_t* pPeak, int iValue)
+{
+    int iPeak = SDL_AtomicGet(pPeak);
+    while (iValue > iPeak && !SDL_AtomicCAS(pPeak, iPeak, iValue))
+        iPeak = SDL_AtomicGet(pPeak);
+}
+
+void Charge(MemoryTag eTag, size_t iBytes, int iBlocks)
+{
+    TagStats& stats = Stats[eTag];
+
+    int iCurrent = SDL_AtomicAdd(&stats.Current, (int)iBytes) + (int)iBytes;
+    SDL_AtomicAdd(&stats.Blocks, iBlocks);
+
+    RaisePeak(&stats.Peak, iCurrent);
+    RaisePeak(&TotalPeak, (int)Total());
+
+    if (stats.iBudget > 0 && (size_t)iCurrent > stats.iBudget)
+        SDL_AtomicCAS(&stats.OverBudget, 0, 1);
+}
+
+void Release(MemoryTag eTag, size_t iBytes, int iBlocks)
+{
+    TagStats& stats = Stats[eTag];
+
+    int iCurrent = SDL_AtomicAdd(&stats.Current, -(int)iBytes) - (int)iBytes;
+    SDL_AtomicAdd(&stats.Blocks, -iBlocks);
+
+    // Rearm the callback once the tag is back under budget.
+    if ((size_t)iCurrent <= stats.iBudget)
+        SDL_AtomicSet(&stats.OverBudget, 0);
+}
+
+MemoryTag CallerTag()
+{
+    return SDL_ThreadID() == iMainThread ? eCurrentTag : MEM_TAG_THREADS;
+}
+
+void* Track(void* pBlock, size_t iSize, MemoryTag eTag)
+{
+    if (!pBlock)
+        return 0;
+
+    BlockHeader* pHeader = (BlockHeader*)pBlock;
+    pHeader->iSize = iSize;
+    pHeader->eTag = eTag;
+    Charge(eTag, iSize, 1);
+
+    return (char*)pBlock + HEADER_SIZE;
+}
+
+BlockHeader* HeaderOf(void* pMemory)
+{
+    return (BlockHeader*)((char*)pMemory - HEADER_SIZE);
+}
+
+void* SDLCALL TrackedMalloc(size_t iSize)
+{
+    if (iSize > (size_t)-1 - HEADER_SIZE)
+        return 0;
+
+    return Track(pNextMalloc(iSize + HEADER_SIZE), iSize, CallerTag());
+}
+
+void* SDLCALL TrackedCalloc(size_t iCount, size_t iSize)
+{
+    if (iSize != 0 && iCount > ((size_t)-1 - HEADER_SIZE) / iSize)
+        return 0;
+
+    // One zeroed block for the header and all elements.
+    size_t iBytes = iCount * iSize;
+    void* pBlock = pNextCalloc(1, iBytes + HEADER_SIZE);
+
+    return Track(pBlock, iBytes, CallerTag());
+}
+
+void* SDLCALL TrackedRealloc(void* pMemory, size_t iSize)
+{
+    if (!pMemory)
+        return TrackedMalloc(iSize);
+
+    if (iSize > (size_t)-1 - HEADER_SIZE)
+        return 0;
+
+    BlockHeader* pHeader = HeaderOf(pMemory);
+    size_t iOldSize = pHeader->iSize;
+    MemoryTag eTag = pHeader->eTag;
+
+    void* pBlock = pNextRealloc(pHeader, iSize + HEADER_SIZE);
+    if (!pBlock)
+        return 0;
+
+    // A grown block stays with the subsystem that allocated it.
+    ((BlockHeader*)pBlock)->iSize = iSize;
+    if (iSize >= iOldSize)
+        Charge(eTag, iSize - iOldSize, 0);
+    else
+        Release(eTag, iOldSize - iSize, 0);
+
+    return (char*)pBlock + HEADER_SIZE;
+}
+
+void SDLCALL TrackedFree(void* pMemory)
+{
+    if (!pMemory)
+        return;
+
+    BlockHeader* pHeader = HeaderOf(pMemory);
+    Release(pHeader->eTag, pHeader->iSize, 1);
+    pNextFree(pHeader);
+}
+
+}
+
+bool MemoryTracker::Install()
+{
+    if (IsInstalled())
+        return true;
+
+    SDL_GetMemoryFunctions(&pNextMalloc, &pNextCalloc, &pNextRealloc, &pNextFree);
+    iMainThread = SDL_ThreadID();
+
+    if (SDL_SetMemoryFunctions(TrackedMalloc, TrackedCalloc, TrackedRealloc, TrackedFree) < 0) {
+        pNextMalloc = 0;
+        return false;
+    }
+    return true;
+}
+
+bool MemoryTracker::IsInstalled()
+{
+    return pNextMalloc != 0;
+}
+
+void MemoryTracker::Add(MemoryTag eTag, size_t iBytes)
+{
+    Charge(eTag, iBytes, 1);
+}
+
+void MemoryTracker::Remove(MemoryTag eTag, size_t iBytes)
+{
+    Release(eTag, iBytes, 1);
+}
+
+void MemoryTracker::SetBudget(MemoryTag eTag, size_t iBytes, MemoryBudgetCallback pCallback, void* pUserData)
+{
+    TagStats& stats = Stats[eTag];
+
+    stats.iBudget   = iBytes;
+    stats.pCallback = pCallback;
+    stats.pUserData = pUserData;
+
+    SDL_AtomicSet(&stats.OverBudget, iBytes > 0 && GetCurrent(eTag) > iBytes ? 1 : 0);
+}
+
+size_t MemoryTracker::GetBudget(MemoryTag eTag)
+{
+    return Stats[eTag].iBudget;
+}
+
+void MemoryTracker::CheckBudgets()
+{
+    for (int i = 0; i < MEM_TAG_COUNT; ++i) {
+        TagStats& stats = Stats[i];
+
+        if (SDL_AtomicCAS(&stats.OverBudget, 1, 2) && stats.pCallback)
+            stats.pCallback((MemoryTag)i, GetCurrent((MemoryTag)i), stats.iBudget, stats.pUserData);
+    }
+}
+
+size_t MemoryTracker::GetCurrent(MemoryTag eTag)
+{
+    return (size_t)SDL_AtomicGet(&Stats[eTag].Current);
+}
+
+size_t MemoryTracker::GetPeak(MemoryTag eTag)
+{
+    return (size_t)SDL_AtomicGet(&Stats[eTag].Peak);
+}
+
+size_t MemoryTracker::GetBlocks(MemoryTag eTag)
+{
+    return (size_t)SDL_AtomicGet(&Stats[eTag].Blocks);
+}
+
+size_t MemoryTracker::GetTotal()
+{
+    return Total();
+}
+
+size_t MemoryTracker::GetTotalPeak()
+{
+    return (size_t)SDL_AtomicGet(&TotalPeak);
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag eTag)
+{
+    return eTag < MEM_TAG_COUNT ? TagNames[eTag] : "unknown";
+}
+
+size_t MemoryTracker::GetTextureBytes(int iWidth, int iHeight, int iBytesPerPixel, bool bMipmaps)
+{
+    size_t iBytes = (size_t)iWidth * iHeight * iBytesPerPixel;
+    return bMipmaps ? iBytes + iBytes / 3 : iBytes;
+}
+
+void MemoryTracker::WriteJson(FILE* pFile)
+{
+    fprintf(pFile, "{\n  \"total\": %lu,\n  \"peak\": %lu,\n  \"tags\": {\n",
+            (unsigned long)GetTotal(), (unsigned long)GetTotalPeak());
+
+    for (int i = 0; i < MEM_TAG_COUNT; ++i) {
+        MemoryTag eTag = (MemoryTag)i;
+        fprintf(pFile, "    \"%s\": { \"current\": %lu, \"peak\": %lu, \"blocks\": %lu, \"budget\": %lu }%s\n",
+                GetTagName(eTag), (unsigned long)GetCurrent(eTag), (unsigned long)GetPeak(eTag),
+                (unsigned long)GetBlocks(eTag), (unsigned long)GetBudget(eTag), i + 1 < MEM_TAG_COUNT ? "," : "");
+    }
+
+    fprintf(pFile, "  }\n}\n");
+}
+
+bool MemoryTracker::DumpJson()
+{
+    const char* czPath = getenv("MEMORY_REPORT");
+    if (!czPath) {
+        WriteJson(stdout);
+        return true;
+    }
+
+    FILE* pFile = fopen(czPath, "w");
+    if (!pFile)
+        return false;
+
+    WriteJson(pFile);
+    fclose(pFile);
+    return true;
+}
+
+MemoryScope::MemoryScope(MemoryTag eTag)
+{
+    ePrevious = eCurrentTag;
+    if (SDL_ThreadID() == iMainThread)
+        eCurrentTag = eTag;
+}
+
+MemoryScope::~MemoryScope()
+{
+    if (SDL_ThreadID() == iMainThread)
+        eCurrentTag = ePrevious;
+}
@@ -0,0 +1,343 @@
+#include <vector>
+
+#include "Renderer2D.h"
+
+namespace {
+
+/** Ranks a render driver: acceleration outweighs everything else. **/
+int ScoreDriver(const SDL_RendererInfo& info)
+{
+    int iScore = 0;
+
+    if (info.flags & SDL_RENDERER_ACCELERATED)
+        iScore += 1000;
+    if (info.flags & SDL_RENDERER_TARGETTEXTURE)
+        iScore += 100;
+
+    int iMaxSize = info.max_texture_width < info.max_texture_height ? info.max_texture_width : info.max_texture_height;
+    iScore += (iMaxSize > 16384 ? 16384 : iMaxSize) / 1024;
+
+    return iScore;
+}
+
+class TextureRenderer2D : public Renderer2D
+{
+private:
+    struct Image
+    {
+        SDL_Texture*    pTexture;
+        int             iWidth;
+        int             iHeight;
+    };
+
+    SDL_Renderer*       pRenderer;
+    SDL_RendererInfo    Info;
+    std::vector<Image>  Images;
+    size_t              iTextureBytes;
+
+    //Quads queued for pBatchTexture (NULL for filled rectangles).
+    SDL_Texture*        pBatchTexture;
+    std::vector<SDL_Vertex> Vertices;
+    std::vector<int>    Indices;
+
+    int                 iDrawCalls;
+    int                 iFrameDrawCalls;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    void Flush()
+    {
+        if (Indices.empty())
+            return;
+
+        SDL_RenderGeometry(pRenderer, pBatchTexture, &Vertices[0], (int)Vertices.size(), &Indices[0], (int)Indices.size());
+        ++iDrawCalls;
+
+        Vertices.clear();
+        Indices.clear();
+    }
+
+    void AddQuad(SDL_Texture* pTexture, const SDL_Rect& dest, float u0, float v0, float u1, float v1, SDL_Color color)
+    {
+        if (pTexture != pBatchTexture) {
+            Flush();
+            pBatchTexture = pTexture;
+        }
+
+        int iBase = (int)Vertices.size();
+        float x0 = (float)dest.x, y0 = (float)dest.y;
+        float x1 = (float)(dest.x + dest.w), y1 = (float)(dest.y + dest.h);
+
+        SDL_Vertex corners[4] = {
+            { { x0, y0 }, color, { u0, v0 } },
+            { { x1, y0 }, color, { u1, v0 } },
+            { { x1, y1 }, color, { u1, v1 } },
+            { { x0, y1 }, color, { u0, v1 } }
+        };
+        Vertices.insert(Vertices.end(), corners, corners + 4);
+
+        int quad[6] = { iBase, iBase + 1, iBase + 2, iBase, iBase + 2, iBase + 3 };
+        Indices.insert(Indices.end(), quad, quad + 6);
+    }
+#else
+    // Without SDL_RenderGeometry() the draws go straight to SDL, which batches them itself since 2.0.10.
+    void Flush()
+    {
+    }
+#endif
+
+public:
+    TextureRenderer2D()
+    {
+        pRenderer       = 0;
+        iTextureBytes   = 0;
+        pBatchTexture   = 0;
+        iDrawCalls      = 0;
+        iFrameDrawCalls = 0;
+    }
+
+    ~TextureRenderer2D()
+    {
+        for (size_t i = 0; i < Images.size(); ++i)
+            SDL_DestroyTexture(Images[i].pTexture);
+        if (pRenderer)
+            SDL_DestroyRenderer(pRenderer);
+    }
+
+    bool Open(SDL_Window* pWindow, bool bVsync)
+    {
+        int iBest = -1, iBestScore = -1;
+        SDL_RendererInfo info;
+
+        for (int i = 0; i < SDL_GetNumRenderDrivers(); ++i) {
+            if (SDL_GetRenderDriverInfo(i, &info) == 0 && ScoreDriver(info) > iBestScore) {
+                iBest = i;
+                iBestScore = ScoreDriver(info);
+            }
+        }
+
+        Uint32 iFlags = bVsync ? SDL_RENDERER_PRESENTVSYNC : 0;
+        if (iBest >= 0) {
+            SDL_GetRenderDriverInfo(iBest, &info);
+            iFlags |= (info.flags & SDL_RENDERER_ACCELERATED) ? SDL_RENDERER_ACCELERATED : SDL_RENDERER_SOFTWARE;
+        }
+
+        // SDL picks on its own if the best driver does not start.
+        pRenderer = SDL_CreateRenderer(pWindow, iBest, iFlags);
+        if (!pRenderer && iBest >= 0)
+            pRenderer = SDL_CreateRenderer(pWindow, -1, bVsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+
+        return pRenderer && SDL_GetRendererInfo(pRenderer, &Info) == 0;
+    }
+
+    const char* GetName() const
+    {
+        return Info.name;
+    }
+
+    int LoadImage(SDL_Surface* pSurface)
+    {
+        if (!pSurface)
+            return -1;
+
+        // Static texture: uploaded here and never touched by the CPU again.
+        Image image;
+        image.pTexture = SDL_CreateTextureFromSurface(pRenderer, pSurface);
+        if (!image.pTexture)
+            return -1;
+
+        image.iWidth = pSurface->w;
+        image.iHeight = pSurface->h;
+        iTextureBytes += (size_t)image.iWidth * image.iHeight * 4;
+
+        Images.push_back(image);
+        return (int)Images.size() - 1;
+    }
+
+    size_t GetTextureBytes() const
+    {
+        return iTextureBytes;
+    }
+
+    void Clear(Uint8 r, Uint8 g, Uint8 b)
+    {
+        Vertices.clear();
+        Indices.clear();
+
+        SDL_SetRenderDrawColor(pRenderer, r, g, b, 255);
+        SDL_RenderClear(pRenderer);
+    }
+
+    void Draw(int iImage, const SDL_Rect* pSource, const SDL_Rect& dest)
+    {
+        if (iImage < 0 || iImage >= (int)Images.size())
+            return;
+
+        const Image& image = Images[iImage];
+        SDL_Rect source = { 0, 0, image.iWidth, image.iHeight };
+        if (pSource)
+            source = *pSource;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        SDL_Color white = { 255, 255, 255, 255 };
+        AddQuad(image.pTexture, dest,
+                (float)source.x / image.iWidth, (float)source.y / image.iHeight,
+                (float)(source.x + source.w) / image.iWidth, (float)(source.y + source.h) / image.iHeight, white);
+#else
+        SDL_RenderCopy(pRenderer, image.pTexture, &source, &dest);
+        ++iDrawCalls;
+#endif
+    }
+
+    void FillRect(const SDL_Rect& rect, Uint8 r, Uint8 g, Uint8 b)
+    {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        SDL_Color color = { r, g, b, 255 };
+        AddQuad(0, rect, 0.0f, 0.0f, 0.0f, 0.0f, color);
+#else
+        SDL_SetRenderDrawColor(pRenderer, r, g, b, 255);
+        SDL_RenderFillRect(pRenderer, &rect);
+        ++iDrawCalls;
+#endif
+    }
+
+    void Present()
+    {
+        Flush();
+        SDL_RenderPresent(pRenderer);
+
+        iFrameDrawCalls = iDrawCalls;
+        iDrawCalls = 0;
+    }
+
+    int GetDrawCalls() const
+    {
+        return iFrameDrawCalls;
+    }
+};
+
+class SurfaceRenderer2D : public Renderer2D
+{
+private:
+    SDL_Window*                 pWindow;
+    SDL_Surface*                pTarget;
+    std::vector<SDL_Surface*>   Images;
+
+    int                         iDrawCalls;
+    int                         iFrameDrawCalls;
+
+public:
+    SurfaceRenderer2D()
+    {
+        pWindow         = 0;
+        pTarget         = 0;
+        iDrawCalls      = 0;
+        iFrameDrawCalls = 0;
+    }
+
+    ~SurfaceRenderer2D()
+    {
+        //pTarget belongs to the window
+        for (size_t i = 0; i < Images.size(); ++i)
+            SDL_FreeSurface(Images[i]);
+    }
+
+    bool Open(SDL_Window* pTargetWindow)
+    {
+        pWindow = pTargetWindow;
+        pTarget = SDL_GetWindowSurface(pWindow);
+        return pTarget != 0;
+    }
+
+    const char* GetName() const
+    {
+        return "surface";
+    }
+
+    int LoadImage(SDL_Surface* pSurface)
+    {
+        if (!pSurface)
+            return -1;
+
+        // In the window format blits are plain copies.
+        SDL_Surface* pImage = SDL_ConvertSurface(pSurface, pTarget->format, 0);
+        if (!pImage)
+            return -1;
+
+        Images.push_back(pImage);
+        return (int)Images.size() - 1;
+    }
+
+    size_t GetTextureBytes() const
+    {
+        return 0;
+    }
+
+    void Clear(Uint8 r, Uint8 g, Uint8 b)
+    {
+        // The window surface is replaced when the window is resized.
+        pTarget = SDL_GetWindowSurface(pWindow);
+        if (pTarget)
+            SDL_FillRect(pTarget, NULL, SDL_MapRGB(pTarget->format, r, g, b));
+    }
+
+    void Draw(int iImage, const SDL_Rect* pSource, const SDL_Rect& dest)
+    {
+        if (!pTarget || iImage < 0 || iImage >= (int)Images.size())
+            return;
+
+        SDL_Surface* pImage = Images[iImage];
+        SDL_Rect target = dest;
+
+        if (pSource ? (pSource->w == dest.w && pSource->h == dest.h) : (pImage->w == dest.w && pImage->h == dest.h))
+            SDL_BlitSurface(pImage, pSource, pTarget, &target);
+        else
+            SDL_BlitScaled(pImage, pSource, pTarget, &target);
+        ++iDrawCalls;
+    }
+
+    void FillRect(const SDL_Rect& rect, Uint8 r, Uint8 g, Uint8 b)
+    {
+        if (!pTarget)
+            return;
+
+        SDL_FillRect(pTarget, &rect, SDL_MapRGB(pTarget->format, r, g, b));
+        ++iDrawCalls;
+    }
+
+    void Present()
+    {
+        SDL_UpdateWindowSurface(pWindow);
+
+        iFrameDrawCalls = iDrawCalls;
+        iDrawCalls = 0;
+    }
+
+    int GetDrawCalls() const
+    {
+        return iFrameDrawCalls;
+    }
+};
+
+}
+
+Renderer2D* CreateRenderer2D(SDL_Window* pWindow, Renderer2DBackend eBackend, bool bVsync)
+{
+    if (!pWindow)
+        return 0;
+
+    if (eBackend == RENDERER_2D_SURFACE) {
+        SurfaceRenderer2D* pSurface = new SurfaceRenderer2D();
+        if (!pSurface->Open(pWindow)) {
+            delete pSurface;
+            return 0;
+        }
+        return pSurface;
+    }
+
+    TextureRenderer2D* pTexture = new TextureRenderer2D();
+    if (!pTexture->Open(pWindow, bVsync)) {
+        delete pTexture;
+        return 0;
+    }
+    return pTexture;
+}
@@ -0,0 +1,234 @@
+
+#ifndef AUDIOMIXER_H_
+#define AUDIOMIXER_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+/**
+ * Hot loops of the mixer. The SIMD variant (SSE2 or NEON, whichever this
+ * build targets) and the scalar one give the same results up to float
+ * rounding; MixS16 is bit-identical.
+ */
+struct MixerKernels
+{
+    //"sse2", "neon" or "scalar".
+    const char* czName;
+
+    //Adds n samples scaled by iVolume (0 to 128) to the destination, with saturation.
+    void (*MixS16)          (Sint16* pDest, const Sint16* pSource, int n, int iVolume);
+
+    /**
+     * Adds iFrames frames of a mono or stereo source to a stereo bus, with
+     * the gain moving linearly from fStart to fEnd over the frames.
+     */
+    void (*MixFloatRamp)    (float* pBus, const float* pSource, int iFrames, int iSourceChannels,
+                             float fStart, float fEnd);
+
+    //Converts n samples in [-1, 1] to 16 bits, with saturation.
+    void (*FloatToS16)      (Sint16* pDest, const float* pSource, int n);
+
+    /**
+     * Polyphase filter loop: output frame n is the dot product of the iLength
+     * interleaved samples of its window with the coefficients of its phase,
+     * summed per channel. Windows start at pWindow and move by iDown / iUp
+     * frames per output. iLength is a multiple of 4, iChannels 1 or 2.
+     * @return The input frames consumed; iPhase is updated.
+     */
+    int  (*Resample)        (const float* pWindow, const float* pCoefficients, int iLength, int iChannels,
+                             int iUp, int iDown, int& iPhase, float* pOut, int iOutFrames);
+};
+
+/**
+ * The SIMD kernels of this build if bSimd is set and there are any, else the scalar ones.
+ */
+const MixerKernels& GetMixerKernels(bool bSimd = true);
+
+/**
+ * Windowed sinc filter bank for a fixed rate pair, e.g. 44100 to 32000 Hz.
+ *
+ * The rates reduce to an up/down ratio L/M; each of the L phases has its
+ * own iTaps coefficients, laid out so an output frame is one contiguous dot
+ * product over the last iTaps input frames. One filter is shared by every
+ * PolyphaseResampler of the same rates.
+ */
+class PolyphaseFilter
+{
+private:
+    int                 iUp;
+    int                 iDown;
+    int                 iTaps;
+    int                 iChannels;
+
+    //iUp phases of iTaps * iChannels coefficients, each repeated per channel.
+    std::vector<float>  Coefficients;
+
+public:
+    PolyphaseFilter();
+
+    /**
+     * @param iTaps Taps per phase, a multiple of 4; 16 passes up to 90% of
+     *        the lower Nyquist frequency. The delay is iTaps / 2 input frames.
+     * @return false for invalid taps, channel counts (1 or 2) or rates whose
+     *         ratio needs more than 1024 phases.
+     */
+    bool            Init            (int iInRate, int iOutRate, int iChannels, int iTaps = 16);
+
+    //Input frames consumed by iOutFrames output frames starting at iPhase.
+    int             GetInputFrames  (int iPhase, int iOutFrames) const;
+
+    //The most input frames iOutFrames output frames can consume.
+    int             GetMaxInputFrames (int iOutFrames) const { return GetInputFrames(iUp - 1, iOutFrames); }
+
+    bool            IsPassThrough   () const { return iUp == iDown; }
+    int             GetTaps         () const { return iTaps; }
+    int             GetChannels     () const { return iChannels; }
+
+    friend class PolyphaseResampler;
+};
+
+/**
+ * Streams through a PolyphaseFilter: keeps the filter history between
+ * calls, so a sound can be resampled in chunks of any size.
+ */
+class PolyphaseResampler
+{
+private:
+    const PolyphaseFilter*  pFilter;
+
+    //The last iTaps input frames, followed by the input of the current call.
+    std::vector<float>      Window;
+
+    //Position between two input frames, in 1 / L steps.
+    int                     iPhase;
+
+public:
+    PolyphaseResampler();
+
+    //Resets the history; sized for up to iMaxOutFrames frames per Process().
+    void    Init            (const PolyphaseFilter& filter, int iMaxOutFrames);
+
+    //Input frames the next iOutFrames output frames consume.
+    int     GetInputFrames  (int iOutFrames) const;
+
+    /**
+     * Writes iOutFrames frames, consuming exactly GetInputFrames(iOutFrames)
+     * frames of pIn.
+     */
+    void    Process         (const float* pIn, float* pOut, int iOutFrames, const MixerKernels& kernels);
+};
+
+/**
+ * Mixes in-memory sounds into an SDL_mixer or SDL audio stream.
+ *
+ * Sounds are stored as float at their own rate and resampled to the device
+ * rate while mixing. Voices are summed on a float stereo bus with volume
+ * ramps, so gain changes and stops never click, then added to the stream
+ * with saturation.
+ *
+ * Plug it in with Mix_SetPostMix(VoiceMixer::PostMix, &mixer), which adds
+ * the voices to whatever SDL_mixer played, or pass VoiceMixer::Callback as
+ * the callback of SDL_OpenAudioDevice(). The device format must be AUDIO_S16SYS.
+ */
+class VoiceMixer
+{
+private:
+    struct Sound
+    {
+        std::vector<float>  Samples;
+        int                 iFrames;
+        int                 iChannels;
+        PolyphaseFilter     Filter;
+    };
+
+    struct Voice
+    {
+        int                 iSound;
+        int                 iPosition;
+        bool                bLoop;
+        bool                bStopping;
+        float               fGain;
+        float               fTargetGain;
+        PolyphaseResampler  Resampler;
+    };
+
+    int                 iRate;
+    int                 iChannels;
+    int                 iMaxFrames;
+    bool                bSimd;
+
+    std::vector<Sound*> Sounds;
+    std::vector<Voice>  Voices;
+
+    //Float stereo bus, resampler input and output, and the converted bus.
+    std::vector<float>  Bus;
+    std::vector<float>  Input;
+    std::vector<float>  Resampled;
+    std::vector<Sint16> Output;
+
+    //Play() and Stop() come from the main thread, Mix() from the audio thread.
+    SDL_mutex*          pLock;
+
+    Uint32              iMixCalls;
+    double              dMixMs;
+
+    const float*        ReadSound   (Voice& voice, int iFrames);
+    void                MixVoice    (Voice& voice, int iFrames, const MixerKernels& kernels);
+
+    VoiceMixer(const VoiceMixer&);
+    VoiceMixer& operator=(const VoiceMixer&);
+
+public:
+    VoiceMixer();
+    ~VoiceMixer();
+
+    /**
+     * Sizes every buffer up front, the audio thread never allocates.
+     * @param iDeviceChannels 1 or 2; the bus is stereo and folded down for mono.
+     * @param iMaxFrames Frames mixed per step; longer callbacks take several steps.
+     */
+    bool    Open        (int iDeviceRate, int iDeviceChannels, int iMaxFrames = 4096, int iMaxVoices = 32);
+    void    Close       ();
+
+    /**
+     * Copies signed 16-bit samples at iSoundRate into a new sound.
+     * @return The sound id, -1 on failure.
+     */
+    int     AddSound    (const Sint16* pSamples, int iFrames, int iSoundChannels, int iSoundRate);
+
+    /**
+     * Starts a sound on a free voice.
+     * @return The voice, -1 if all voices are busy.
+     */
+    int     Play        (int iSound, float fGain = 1.0f, bool bLoop = false);
+
+    //Fades the voice to the new gain, or out, over the next callback.
+    void    SetGain     (int iVoice, float fGain);
+    void    Stop        (int iVoice);
+
+    int     GetActiveVoices () const;
+
+    //Scalar kernels instead of SIMD ones, to compare them.
+    void    SetSimd     (bool bEnable) { bSimd = bEnable; }
+    const char* GetKernelName () const { return GetMixerKernels(bSimd).czName; }
+
+    /**
+     * Mixes iFrames frames into pStream: added to its contents with
+     * saturation if bAdd, replacing them otherwise.
+     */
+    void    Mix         (Sint16* pStream, int iFrames, bool bAdd);
+
+    //Calls to Mix() and their mean cost since Open().
+    Uint32  GetMixCalls () const { return iMixCalls; }
+    double  GetMixMs    () const { return iMixCalls > 0 ? dMixMs / iMixCalls : 0.0; }
+    void    ResetStats  ();
+
+    //For Mix_SetPostMix(): adds the voices to the output of SDL_mixer.
+    static void SDLCALL PostMix     (void* pUserData, Uint8* pStream, int iLength);
+
+    //For SDL_OpenAudioDevice(): the voices are the whole output.
+    static void SDLCALL Callback    (void* pUserData, Uint8* pStream, int iLength);
+};
+
+#endif /* AUDIOMIXER_H_ */
@@ -0,0 +1,129 @@
+
+#ifndef MUSICSTREAM_H_
+#define MUSICSTREAM_H_
+
+#include <vector>
+
+#include "SDL.h"
+#include "AudioMixer.h"
+
+//Buffers in the ring between the decode thread and the audio callback.
+const int MUSIC_STREAM_BUFFERS = 4;
+
+/**
+ * Plays a long 16-bit PCM WAV file with bounded memory.
+ *
+ * The file is memory-mapped instead of read into RAM. A background thread
+ * converts it to the device rate and channels, one buffer at a time, into
+ * a ring of MUSIC_STREAM_BUFFERS buffers that the audio callback drains.
+ * Pages of the file behind the decode position are handed back to the
+ * kernel, so resident memory stays around the ring size plus a window of
+ * the file whatever its length. Loops restart inside the decoder, without
+ * a gap or a click at the seam.
+ *
+ * Hook it into SDL_mixer with Mix_HookMusic(MusicStream::HookMusic, &stream);
+ * it then replaces Mix_LoadMUS()/Mix_PlayMusic() and SDL_mixer mixes the
+ * channels over it. The device format must be AUDIO_S16SYS.
+ */
+class MusicStream
+{
+private:
+    //The mapped file, and the samples of its data chunk.
+    int                 iFile;
+    Uint8*              pMap;
+    size_t              iMapSize;
+    const Uint8*        pData;
+    int                 iFrames;
+    int                 iSourceChannels;
+
+    int                 iChannels;
+    int                 iBufferFrames;
+
+    //Decode state, owned by the thread while it fills a buffer.
+    int                 iPosition;
+    int                 iLoopsLeft;
+
+    //Offset in the file up to which pages were released.
+    size_t              iReleased;
+    PolyphaseFilter     Filter;
+    PolyphaseResampler  Resampler;
+    std::vector<Sint16> Source;
+    std::vector<float>  Input;
+    std::vector<float>  Resampled;
+    std::vector<float>  Converted;
+
+    //Buffers filled and drained so far; the ring index is the count modulo its size.
+    std::vector<Sint16> Ring;
+    SDL_atomic_t        Written;
+    SDL_atomic_t        Drained;
+    int                 iReadOffset;
+
+    //Written count after the last buffer with music, -1 while the file goes on.
+    SDL_atomic_t        EndBuffer;
+
+    SDL_atomic_t        Playing;
+    SDL_atomic_t        Paused;
+    SDL_atomic_t        Volume;
+    SDL_atomic_t        Callbacks;
+    SDL_atomic_t        Underruns;
+
+    SDL_Thread*         pThread;
+    SDL_atomic_t        Quit;
+
+    //Held by the thread while it decodes, and by Play() to reset the decoder.
+    SDL_mutex*          pDecodeLock;
+    SDL_cond*           pWake;
+
+    //Held by the callback while it drains; Play() and Halt() take it to stop it.
+    SDL_mutex*          pCallbackLock;
+
+    static int SDLCALL  DecodeThread    (void* pUserData);
+
+    void                ReadSource      (Sint16* pDest, int iCount);
+    void                FillBuffer      (Sint16* pDest);
+    void                ReleasePages    (size_t iEnd);
+    void                Drain           (Sint16* pStream, int iFrames);
+
+    MusicStream(const MusicStream&);
+    MusicStream& operator=(const MusicStream&);
+
+public:
+    MusicStream();
+    ~MusicStream();
+
+    /**
+     * Maps a WAV file and starts the decode thread.
+     * @param iBufferFrames Frames per ring buffer, e.g. the callback size.
+     * @return false if the file is not a mono or stereo 16-bit PCM WAV file,
+     * holds no samples or has a chunk before the samples that runs past its end.
+     */
+    bool    Open        (const char* czPath, int iDeviceRate, int iDeviceChannels, int iBufferFrames = 4096);
+    void    Close       ();
+
+    /**
+     * Starts from the beginning; iLoops -1 repeats forever, otherwise the
+     * file plays iLoops times (at least once), like Mix_PlayMusic().
+     */
+    bool    Play        (int iLoops);
+    void    Halt        ();
+    void    Pause       ();
+    void    Resume      ();
+
+    bool    IsPlaying   () { return SDL_AtomicGet(&Playing) != 0; }
+    bool    IsPaused    () { return SDL_AtomicGet(&Paused) != 0; }
+
+    //0 to 128, like Mix_VolumeMusic().
+    void    SetVolume   (int iVolume);
+
+    //Callbacks served, and those that ran dry before their buffer was full.
+    Uint32  GetCallbacks    () { return (Uint32)SDL_AtomicGet(&Callbacks); }
+    Uint32  GetUnderruns    () { return (Uint32)SDL_AtomicGet(&Underruns); }
+
+    //Bytes of the ring; the only decoded audio held in memory.
+    size_t  GetRingBytes    () const { return Ring.size() * sizeof(Sint16); }
+
+    //For Mix_HookMusic().
+    static void SDLCALL HookMusic   (void* pUserData, Uint8* pStream, int iLength);
+};
+
+#endif /* MUSICSTREAM_H_ */
@@ -0,0 +1,137 @@
+
+#ifndef TEXTCACHE_H_
+#define TEXTCACHE_H_
+
+#include <stdio.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_ttf.h"
+
+/**
+ * Rendered text surfaces, kept for reuse under a byte budget.
+ *
+ * Entries are keyed by font, style, colour and string; a TTF_Font is opened
+ * at one point size, so the font pointer stands for the face and the size.
+ * When the surfaces outgrow the budget the least recently used ones are
+ * freed. A surface returned by Get() stays valid until the next Get() or
+ * Clear(), which may evict it: blit it right away.
+ */
+class TextCache
+{
+private:
+    struct Key
+    {
+        TTF_Font*       pFont;
+        int             iStyle;
+        Uint32          iColor;
+        std::string     Text;
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Entry
+    {
+        Key             key;
+        SDL_Surface*    pSurface;
+        size_t          iBytes;
+    };
+
+    //Most recently used first.
+    typedef std::list<Entry> EntryList;
+
+    EntryList                               Entries;
+    std::map<Key, EntryList::iterator>      Index;
+
+    size_t          iBudget;
+    size_t          iBytes;
+    size_t          iPeakBytes;
+
+    Uint32          iHits;
+    Uint32          iMisses;
+    Uint32          iEvictions;
+    double          dRenderMs;
+
+    void            Evict       ();
+
+    TextCache(const TextCache&);
+    TextCache& operator=(const TextCache&);
+
+public:
+    explicit TextCache(size_t iBudgetBytes = 512 * 1024);
+    ~TextCache();
+
+    //Frees least recently used surfaces down to the new budget.
+    void            SetBudget   (size_t iBudgetBytes);
+
+    /**
+     * The text rendered with TTF_RenderText_Solid(), from the cache or
+     * rendered now. The cache owns the surface.
+     * @param iStyle TTF_STYLE_* flags, set on the font for the render only.
+     */
+    SDL_Surface*    Get         (TTF_Font* pFont, int iStyle, SDL_Color color, const std::string& text);
+
+    //Frees every surface; call it before the fonts are closed.
+    void            Clear       ();
+
+    size_t          GetBytes    () const { return iBytes; }
+    size_t          GetPeakBytes() const { return iPeakBytes; }
+    size_t          GetEntries  () const { return Entries.size(); }
+
+    Uint32          GetHits     () const { return iHits; }
+    Uint32          GetMisses   () const { return iMisses; }
+    Uint32          GetEvictions() const { return iEvictions; }
+    double          GetHitRate  () const { return iHits + iMisses ? (double)iHits / (iHits + iMisses) : 0.0; }
+
+    //Time spent rasterizing on misses.
+    double          GetRenderMs () const { return dRenderMs; }
+
+    void            ResetStats  ();
+
+    //Prints the entries, the bytes, the hit rate and the rasterizing time.
+    void            Report      (FILE* pFile) const;
+};
+
+/**
+ * A line of text that changes in place, e.g. a timer or a track name.
+ *
+ * The text is split into runs of digits, of spaces and of other characters,
+ * and each run is drawn from the TextCache on its own. When "01:59" becomes
+ * "02:00" only the new digit runs are rasterized; the ":" is a cache hit.
+ * Kerning across run boundaries is lost, which monospaced digits hide.
+ */
+class TextLabel
+{
+private:
+    TextCache*                  pCache;
+    TTF_Font*                   pFont;
+    int                         iStyle;
+    SDL_Color                   Color;
+
+    std::string                 Text;
+    std::vector<std::string>    Runs;
+
+public:
+    TextLabel(TextCache& cache, TTF_Font* pFont, SDL_Color color, int iStyle = TTF_STYLE_NORMAL);
+
+    /**
+     * Changes the text.
+     * @return false if it was already the text.
+     */
+    bool                SetText     (const std::string& text);
+    const std::string&  GetText     () const { return Text; }
+
+    //Width and height of the label as drawn.
+    void                GetSize     (int& iWidth, int& iHeight);
+
+    /**
+     * Blits the runs left to right from x, y.
+     * @return The area covered.
+     */
+    SDL_Rect            Draw        (SDL_Surface* pDest, int x, int y);
+};
+
+#endif /* TEXTCACHE_H_ */
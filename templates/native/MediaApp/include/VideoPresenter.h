@@ -0,0 +1,111 @@
+
+#ifndef VIDEOPRESENTER_H_
+#define VIDEOPRESENTER_H_
+
+#include "SDL.h"
+
+//Textures between the decoder and the screen: one on screen, the others queued or being written.
+const int VIDEO_QUEUE_FRAMES = 3;
+
+/**
+ * Planes of a frame being written. I420 has three planes; NV12 has its
+ * interleaved UV plane in pU and no pV.
+ */
+struct VideoPlanes
+{
+    Uint8*  pY;
+    Uint8*  pU;
+    Uint8*  pV;
+    int     iPitchY;
+    int     iPitchUV;
+};
+
+/**
+ * Shows planar YUV frames (SDL_PIXELFORMAT_IYUV or NV12) with an SDL renderer.
+ *
+ * The decoder writes each frame straight into a locked streaming texture,
+ * there is no intermediate frame buffer and no YUV to RGB conversion on the
+ * CPU: the GLES2 renderer uploads the planes on unlock and converts the
+ * colours in its fragment shader. Frames carry a presentation time; Draw()
+ * shows the newest one that is due and drops the ones it overtook, so the
+ * queue follows the clock whatever the display rate.
+ */
+class VideoPresenter
+{
+private:
+    struct Frame
+    {
+        SDL_Texture*    pTexture;
+        double          dPts;
+    };
+
+    SDL_Renderer*       pRenderer;
+    Uint32              iFormat;
+    int                 iWidth;
+    int                 iHeight;
+    bool                bNative;
+
+    //Frames in decode order from iOldest: the one on screen if bShowing, the queued ones, the one being written if bWriting.
+    Frame               Frames[VIDEO_QUEUE_FRAMES];
+    int                 iOldest;
+    int                 iUsed;
+    bool                bShowing;
+    bool                bWriting;
+
+    Uint32              iSubmitted;
+    Uint32              iShown;
+    Uint32              iDropped;
+    double              dUploadMs;
+    double              dLateMs;
+    double              dMaxLateMs;
+
+    VideoPresenter(const VideoPresenter&);
+    VideoPresenter& operator=(const VideoPresenter&);
+
+public:
+    VideoPresenter();
+    ~VideoPresenter();
+
+    /**
+     * Creates the streaming textures.
+     * @param iFormat SDL_PIXELFORMAT_IYUV or SDL_PIXELFORMAT_NV12, with an even width and height.
+     */
+    bool    Open        (SDL_Renderer* pRenderer, Uint32 iFormat, int iWidth, int iHeight);
+    void    Close       ();
+
+    //False if the renderer converts this format in software instead of in a shader.
+    bool    IsNative    () const { return bNative; }
+
+    //True when a texture is free for the next frame.
+    bool    CanAcquire  () const { return !bWriting && iUsed < VIDEO_QUEUE_FRAMES; }
+
+    /**
+     * Locks the texture of the next frame; the decoder writes the planes in
+     * place, then calls SubmitFrame().
+     */
+    bool    AcquireFrame(VideoPlanes& planes);
+
+    //Uploads the frame written since AcquireFrame() and queues it for dPts seconds.
+    void    SubmitFrame (double dPts);
+
+    /**
+     * Shows the newest queued frame due at dClock seconds, or keeps the one
+     * on screen, and copies it to pDest (the whole target if NULL).
+     * @return true if a new frame was shown.
+     */
+    bool    Draw        (double dClock, const SDL_Rect* pDest = NULL);
+
+    //Frames submitted, shown, and queued but overtaken before they were shown.
+    Uint32  GetSubmitted    () const { return iSubmitted; }
+    Uint32  GetShown        () const { return iShown; }
+    Uint32  GetDropped      () const { return iDropped; }
+
+    //Mean time spent in SDL_UnlockTexture() per frame.
+    double  GetUploadMs     () const { return iSubmitted ? dUploadMs / iSubmitted : 0.0; }
+
+    //How far past its time a frame was when it was shown, mean and worst.
+    double  GetLateMs       () const { return iShown ? dLateMs / iShown : 0.0; }
+    double  GetMaxLateMs    () const { return dMaxLateMs; }
+};
+
+#endif /* VIDEOPRESENTER_H_ */
@@ -0,0 +1,677 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIXER_SSE2 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIXER_NEON 1
+#endif
+
+#include "AudioMixer.h"
+
+namespace {
+
+const int MAX_PHASES = 1024;
+
+void MixS16Scalar(Sint16* pDest, const Sint16* pSource, int n, int iVolume)
+{
+    for (int i = 0; i < n; ++i) {
+        int iSample = pDest[i] + ((pSource[i] * iVolume) >> 7);
+        pDest[i] = (Sint16)(iSample > 32767 ? 32767 : (iSample < -32768 ? -32768 : iSample));
+    }
+}
+
+void MixFloatRampScalar(float* pBus, const float* pSource, int iFrames, int iSourceChannels,
+                        float fStart, float fEnd)
+{
+    float fStep = (fEnd - fStart) / iFrames;
+
+    if (iSourceChannels == 2) {
+        for (int f = 0; f < iFrames; ++f) {
+            float fGain = fStart + fStep * f;
+            pBus[f * 2]     += pSource[f * 2] * fGain;
+            pBus[f * 2 + 1] += pSource[f * 2 + 1] * fGain;
+        }
+    } else {
+        for (int f = 0; f < iFrames; ++f) {
+            float fSample = pSource[f] * (fStart + fStep * f);
+            pBus[f * 2]     += fSample;
+            pBus[f * 2 + 1] += fSample;
+        }
+    }
+}
+
+void FloatToS16Scalar(Sint16* pDest, const float* pSource, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        float fSample = pSource[i] * 32767.0f;
+        fSample = fSample > 32767.0f ? 32767.0f : (fSample < -32768.0f ? -32768.0f : fSample);
+        pDest[i] = (Sint16)lrintf(fSample);
+    }
+}
+
+int ResampleScalar(const float* pWindow, const float* pCoefficients, int iLength, int iChannels,
+                   int iUp, int iDown, int& iPhase, float* pOut, int iOutFrames)
+{
+    const int iStepFrames = iDown / iUp, iStepPhase = iDown % iUp;
+    int iConsumed = 0;
+
+    for (int n = 0; n < iOutFrames; ++n) {
+        const float* pSamples = pWindow + iConsumed * iChannels;
+        const float* pPhase = pCoefficients + iPhase * iLength;
+        float fSum[2] = { 0.0f, 0.0f };
+
+        for (int i = 0; i < iLength; i += 2) {
+            fSum[0] += pSamples[i] * pPhase[i];
+            fSum[1] += pSamples[i + 1] * pPhase[i + 1];
+        }
+
+        if (iChannels == 2) {
+            pOut[n * 2]     = fSum[0];
+            pOut[n * 2 + 1] = fSum[1];
+        } else {
+            pOut[n] = fSum[0] + fSum[1];
+        }
+
+        iPhase += iStepPhase;
+        iConsumed += iStepFrames;
+        if (iPhase >= iUp) {
+            iPhase -= iUp;
+            ++iConsumed;
+        }
+    }
+    return iConsumed;
+}
+
+#if defined(MIXER_SSE2)
+
+void MixS16SSE2(Sint16* pDest, const Sint16* pSource, int n, int iVolume)
+{
+    __m128i v = _mm_set1_epi16((short)iVolume);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i*)&pSource[i]);
+        __m128i lo = _mm_mullo_epi16(s, v), hi = _mm_mulhi_epi16(s, v);
+
+        // Full 32-bit products, shifted back down to 16 bits.
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 7);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 7);
+
+        __m128i d = _mm_loadu_si128((const __m128i*)&pDest[i]);
+        _mm_storeu_si128((__m128i*)&pDest[i], _mm_adds_epi16(d, _mm_packs_epi32(p0, p1)));
+    }
+
+    MixS16Scalar(pDest + i, pSource + i, n - i, iVolume);
+}
+
+void MixFloatRampSSE2(float* pBus, const float* pSource, int iFrames, int iSourceChannels,
+                      float fStart, float fEnd)
+{
+    float fStep = (fEnd - fStart) / iFrames;
+
+    // Two stereo frames per vector: L0 R0 L1 R1.
+    const __m128 offset = _mm_set_ps(fStep, fStep, 0.0f, 0.0f);
+    int f = 0;
+
+    if (iSourceChannels == 2) {
+        for (; f + 2 <= iFrames; f += 2) {
+            __m128 gain = _mm_add_ps(_mm_set1_ps(fStart + fStep * f), offset);
+            __m128 s = _mm_loadu_ps(&pSource[f * 2]);
+            _mm_storeu_ps(&pBus[f * 2], _mm_add_ps(_mm_loadu_ps(&pBus[f * 2]), _mm_mul_ps(s, gain)));
+        }
+    } else {
+        for (; f + 2 <= iFrames; f += 2) {
+            __m128 gain = _mm_add_ps(_mm_set1_ps(fStart + fStep * f), offset);
+            __m128 m = _mm_castpd_ps(_mm_load_sd((const double*)&pSource[f]));
+            __m128 s = _mm_unpacklo_ps(m, m);
+            _mm_storeu_ps(&pBus[f * 2], _mm_add_ps(_mm_loadu_ps(&pBus[f * 2]), _mm_mul_ps(s, gain)));
+        }
+    }
+
+    MixFloatRampScalar(pBus + f * 2, pSource + f * iSourceChannels, iFrames - f, iSourceChannels,
+                       fStart + fStep * f, fEnd);
+}
+
+void FloatToS16SSE2(Sint16* pDest, const float* pSource, int n)
+{
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 low = _mm_set1_ps(-1.0f), high = _mm_set1_ps(1.0f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&pSource[i]), low), high);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&pSource[i + 4]), low), high);
+        __m128i p = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+        _mm_storeu_si128((__m128i*)&pDest[i], p);
+    }
+
+    FloatToS16Scalar(pDest + i, pSource + i, n - i);
+}
+
+int ResampleSSE2(const float* pWindow, const float* pCoefficients, int iLength, int iChannels,
+                 int iUp, int iDown, int& iPhase, float* pOut, int iOutFrames)
+{
+    const int iStepFrames = iDown / iUp, iStepPhase = iDown % iUp;
+    int iConsumed = 0;
+
+    for (int n = 0; n < iOutFrames; ++n) {
+        const float* pSamples = pWindow + iConsumed * iChannels;
+        const float* pPhase = pCoefficients + iPhase * iLength;
+        __m128 sum = _mm_setzero_ps();
+
+        for (int i = 0; i < iLength; i += 4)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&pSamples[i]), _mm_loadu_ps(&pPhase[i])));
+
+        // Lanes hold L R L R for stereo.
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+        if (iChannels == 2) {
+            _mm_storel_pi((__m64*)&pOut[n * 2], sum);
+        } else {
+            _mm_store_ss(&pOut[n], _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1)));
+        }
+
+        iPhase += iStepPhase;
+        iConsumed += iStepFrames;
+        if (iPhase >= iUp) {
+            iPhase -= iUp;
+            ++iConsumed;
+        }
+    }
+    return iConsumed;
+}
+
+#elif defined(MIXER_NEON)
+
+void MixS16NEON(Sint16* pDest, const Sint16* pSource, int n, int iVolume)
+{
+    int16x4_t v = vdup_n_s16((int16_t)iVolume);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t s = vld1q_s16(&pSource[i]);
+        int16x4_t p0 = vqshrn_n_s32(vmull_s16(vget_low_s16(s), v), 7);
+        int16x4_t p1 = vqshrn_n_s32(vmull_s16(vget_high_s16(s), v), 7);
+        vst1q_s16(&pDest[i], vqaddq_s16(vld1q_s16(&pDest[i]), vcombine_s16(p0, p1)));
+    }
+
+    MixS16Scalar(pDest + i, pSource + i, n - i, iVolume);
+}
+
+void MixFloatRampNEON(float* pBus, const float* pSource, int iFrames, int iSourceChannels,
+                      float fStart, float fEnd)
+{
+    float fStep = (fEnd - fStart) / iFrames;
+
+    // Two stereo frames per vector: L0 R0 L1 R1.
+    const float fOffset[4] = { 0.0f, 0.0f, fStep, fStep };
+    const float32x4_t offset = vld1q_f32(fOffset);
+    int f = 0;
+
+    if (iSourceChannels == 2) {
+        for (; f + 2 <= iFrames; f += 2) {
+            float32x4_t gain = vaddq_f32(vdupq_n_f32(fStart + fStep * f), offset);
+            vst1q_f32(&pBus[f * 2], vmlaq_f32(vld1q_f32(&pBus[f * 2]), vld1q_f32(&pSource[f * 2]), gain));
+        }
+    } else {
+        for (; f + 2 <= iFrames; f += 2) {
+            float32x4_t gain = vaddq_f32(vdupq_n_f32(fStart + fStep * f), offset);
+            float32x2_t m = vld1_f32(&pSource[f]);
+            float32x2x2_t z = vzip_f32(m, m);
+            float32x4_t s = vcombine_f32(z.val[0], z.val[1]);
+            vst1q_f32(&pBus[f * 2], vmlaq_f32(vld1q_f32(&pBus[f * 2]), s, gain));
+        }
+    }
+
+    MixFloatRampScalar(pBus + f * 2, pSource + f * iSourceChannels, iFrames - f, iSourceChannels,
+                       fStart + fStep * f, fEnd);
+}
+
+void FloatToS16NEON(Sint16* pDest, const float* pSource, int n)
+{
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    const float32x4_t low = vdupq_n_f32(-1.0f), high = vdupq_n_f32(1.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(&pSource[i]), low), high), scale);
+        float32x4_t b = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(&pSource[i + 4]), low), high), scale);
+
+        // vcvtq truncates, so round half away from zero first.
+        a = vaddq_f32(a, vbslq_f32(vcltq_f32(a, vdupq_n_f32(0.0f)), vnegq_f32(half), half));
+        b = vaddq_f32(b, vbslq_f32(vcltq_f32(b, vdupq_n_f32(0.0f)), vnegq_f32(half), half));
+
+        vst1q_s16(&pDest[i], vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+    }
+
+    FloatToS16Scalar(pDest + i, pSource + i, n - i);
+}
+
+int ResampleNEON(const float* pWindow, const float* pCoefficients, int iLength, int iChannels,
+                 int iUp, int iDown, int& iPhase, float* pOut, int iOutFrames)
+{
+    const int iStepFrames = iDown / iUp, iStepPhase = iDown % iUp;
+    int iConsumed = 0;
+
+    for (int n = 0; n < iOutFrames; ++n) {
+        const float* pSamples = pWindow + iConsumed * iChannels;
+        const float* pPhase = pCoefficients + iPhase * iLength;
+        float32x4_t sum = vdupq_n_f32(0.0f);
+
+        for (int i = 0; i < iLength; i += 4)
+            sum = vmlaq_f32(sum, vld1q_f32(&pSamples[i]), vld1q_f32(&pPhase[i]));
+
+        // Lanes hold L R L R for stereo.
+        float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+
+        if (iChannels == 2)
+            vst1_f32(&pOut[n * 2], pair);
+        else
+            pOut[n] = vget_lane_f32(pair, 0) + vget_lane_f32(pair, 1);
+
+        iPhase += iStepPhase;
+        iConsumed += iStepFrames;
+        if (iPhase >= iUp) {
+            iPhase -= iUp;
+            ++iConsumed;
+        }
+    }
+    return iConsumed;
+}
+
+#endif
+
+const MixerKernels ScalarKernels = {
+    "scalar", MixS16Scalar, MixFloatRampScalar, FloatToS16Scalar, ResampleScalar
+};
+
+#if defined(MIXER_SSE2)
+const MixerKernels SimdKernels = {
+    "sse2", MixS16SSE2, MixFloatRampSSE2, FloatToS16SSE2, ResampleSSE2
+};
+#elif defined(MIXER_NEON)
+const MixerKernels SimdKernels = {
+    "neon", MixS16NEON, MixFloatRampNEON, FloatToS16NEON, ResampleNEON
+};
+#else
+const MixerKernels& SimdKernels = ScalarKernels;
+#endif
+
+int GreatestCommonDivisor(int a, int b)
+{
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+}
+
+const MixerKernels& GetMixerKernels(bool bSimd)
+{
+    return bSimd ? SimdKernels : ScalarKernels;
+}
+
+PolyphaseFilter::PolyphaseFilter()
+{
+    iUp         = 1;
+    iDown       = 1;
+    iTaps       = 0;
+    iChannels   = 0;
+}
+
+bool PolyphaseFilter::Init(int iInRate, int iOutRate, int iChannelCount, int iTapCount)
+{
+    if (iInRate <= 0 || iOutRate <= 0 || iTapCount <= 0 || iTapCount % 4 != 0
+        || (iChannelCount != 1 && iChannelCount != 2))
+        return false;
+
+    int iDivisor = GreatestCommonDivisor(iInRate, iOutRate);
+    if (iOutRate / iDivisor > MAX_PHASES)
+        return false;
+
+    iUp         = iOutRate / iDivisor;
+    iDown       = iInRate / iDivisor;
+    iTaps       = iTapCount;
+    iChannels   = iChannelCount;
+
+    // Prototype low pass at L times the input rate, cut at 90% of the lower Nyquist frequency.
+    int iLength = iUp * iTaps;
+    double dCutoff = 0.45 / (iUp > iDown ? iUp : iDown);
+    double dCenter = (iLength - 1) * 0.5;
+
+    std::vector<double> Prototype(iLength);
+    for (int j = 0; j < iLength; ++j) {
+        double x = j - dCenter;
+        double dSinc = x == 0.0 ? 2.0 * dCutoff : sin(2.0 * M_PI * dCutoff * x) / (M_PI * x);
+        double dWindow = 0.42 - 0.5 * cos(2.0 * M_PI * j / (iLength - 1)) + 0.08 * cos(4.0 * M_PI * j / (iLength - 1));
+        Prototype[j] = dSinc * dWindow;
+    }
+
+    // Phase p uses taps p, p + L, p + 2L, ... on the newest input frame first;
+    // store them oldest first, and normalize each phase to unity gain.
+    Coefficients.assign(iUp * iTaps * iChannels, 0.0f);
+
+    for (int p = 0; p < iUp; ++p) {
+        double dSum = 0.0;
+        for (int k = 0; k < iTaps; ++k)
+            dSum += Prototype[p + k * iUp];
+
+        float* pPhase = &Coefficients[p * iTaps * iChannels];
+        for (int t = 0; t < iTaps; ++t) {
+            float fCoefficient = (float)(Prototype[p + (iTaps - 1 - t) * iUp] / dSum);
+            for (int c = 0; c < iChannels; ++c)
+                pPhase[t * iChannels + c] = fCoefficient;
+        }
+    }
+    return true;
+}
+
+int PolyphaseFilter::GetInputFrames(int iPhase, int iOutFrames) const
+{
+    return (int)(((Sint64)iPhase + (Sint64)iOutFrames * iDown) / iUp);
+}
+
+PolyphaseResampler::PolyphaseResampler()
+{
+    pFilter = 0;
+    iPhase  = 0;
+}
+
+void PolyphaseResampler::Init(const PolyphaseFilter& filter, int iMaxOutFrames)
+{
+    pFilter = &filter;
+    iPhase  = 0;
+
+    int iFrames = filter.iTaps + filter.GetMaxInputFrames(iMaxOutFrames);
+    Window.assign(iFrames * filter.iChannels, 0.0f);
+}
+
+int PolyphaseResampler::GetInputFrames(int iOutFrames) const
+{
+    return pFilter->GetInputFrames(iPhase, iOutFrames);
+}
+
+void PolyphaseResampler::Process(const float* pIn, float* pOut, int iOutFrames, const MixerKernels& kernels)
+{
+    const int iChannels = pFilter->iChannels;
+    const int iLength   = pFilter->iTaps * iChannels;
+
+    int iInFrames = GetInputFrames(iOutFrames);
+    memcpy(&Window[iLength], pIn, iInFrames * iChannels * sizeof(float));
+
+    // Each output frame ends its window on the newest input frame consumed so far.
+    int iConsumed = kernels.Resample(&Window[0], &pFilter->Coefficients[0], iLength, iChannels,
+                                     pFilter->iUp, pFilter->iDown, iPhase, pOut, iOutFrames);
+
+    memmove(&Window[0], &Window[iConsumed * iChannels], iLength * sizeof(float));
+}
+
+VoiceMixer::VoiceMixer()
+{
+    iRate       = 0;
+    iChannels   = 0;
+    iMaxFrames  = 0;
+    bSimd       = true;
+    pLock       = 0;
+    iMixCalls   = 0;
+    dMixMs      = 0.0;
+}
+
+VoiceMixer::~VoiceMixer()
+{
+    Close();
+}
+
+bool VoiceMixer::Open(int iDeviceRate, int iDeviceChannels, int iFrames, int iMaxVoices)
+{
+    Close();
+
+    if (iDeviceRate <= 0 || (iDeviceChannels != 1 && iDeviceChannels != 2) || iFrames <= 0 || iMaxVoices <= 0)
+        return false;
+
+    pLock = SDL_CreateMutex();
+    if (!pLock)
+        return false;
+
+    iRate       = iDeviceRate;
+    iChannels   = iDeviceChannels;
+    iMaxFrames  = iFrames;
+
+    Voices.resize(iMaxVoices);
+    for (size_t i = 0; i < Voices.size(); ++i)
+        Voices[i].iSound = -1;
+
+    Bus.assign(iMaxFrames * 2, 0.0f);
+    Resampled.assign(iMaxFrames * 2, 0.0f);
+    Output.assign(iMaxFrames * 2, 0);
+    Input.clear();
+
+    ResetStats();
+    return true;
+}
+
+void VoiceMixer::Close()
+{
+    for (size_t i = 0; i < Sounds.size(); ++i)
+        delete Sounds[i];
+
+    Sounds.clear();
+    Voices.clear();
+
+    if (pLock) {
+        SDL_DestroyMutex(pLock);
+        pLock = 0;
+    }
+}
+
+int VoiceMixer::AddSound(const Sint16* pSamples, int iFrames, int iSoundChannels, int iSoundRate)
+{
+    if (!pLock || iFrames <= 0)
+        return -1;
+
+    Sound* pSound = new Sound();
+    if (!pSound->Filter.Init(iSoundRate, iRate, iSoundChannels)) {
+        delete pSound;
+        return -1;
+    }
+
+    pSound->iFrames     = iFrames;
+    pSound->iChannels   = iSoundChannels;
+    pSound->Samples.resize(iFrames * iSoundChannels);
+    for (size_t i = 0; i < pSound->Samples.size(); ++i)
+        pSound->Samples[i] = pSamples[i] * (1.0f / 32768.0f);
+
+    // Room for the input of the fastest step of any sound.
+    size_t iInput = pSound->Filter.GetMaxInputFrames(iMaxFrames) * iSoundChannels;
+
+    SDL_LockMutex(pLock);
+    if (Input.size() < iInput)
+        Input.resize(iInput);
+    Sounds.push_back(pSound);
+    SDL_UnlockMutex(pLock);
+
+    return (int)Sounds.size() - 1;
+}
+
+int VoiceMixer::Play(int iSound, float fGain, bool bLoop)
+{
+    if (iSound < 0 || iSound >= (int)Sounds.size())
+        return -1;
+
+    SDL_LockMutex(pLock);
+
+    int iVoice = -1;
+    for (size_t i = 0; i < Voices.size() && iVoice < 0; ++i)
+        if (Voices[i].iSound < 0)
+            iVoice = (int)i;
+
+    if (iVoice >= 0) {
+        Voice& voice = Voices[iVoice];
+        voice.iSound        = iSound;
+        voice.iPosition     = 0;
+        voice.bLoop         = bLoop;
+        voice.bStopping     = false;
+        voice.fGain         = fGain;
+        voice.fTargetGain   = fGain;
+        voice.Resampler.Init(Sounds[iSound]->Filter, iMaxFrames);
+    }
+
+    SDL_UnlockMutex(pLock);
+    return iVoice;
+}
+
+void VoiceMixer::SetGain(int iVoice, float fGain)
+{
+    if (iVoice < 0 || iVoice >= (int)Voices.size())
+        return;
+
+    SDL_LockMutex(pLock);
+    Voices[iVoice].fTargetGain = fGain;
+    SDL_UnlockMutex(pLock);
+}
+
+void VoiceMixer::Stop(int iVoice)
+{
+    if (iVoice < 0 || iVoice >= (int)Voices.size())
+        return;
+
+    SDL_LockMutex(pLock);
+    Voices[iVoice].bStopping = true;
+    SDL_UnlockMutex(pLock);
+}
+
+int VoiceMixer::GetActiveVoices() const
+{
+    int iActive = 0;
+    for (size_t i = 0; i < Voices.size(); ++i)
+        iActive += Voices[i].iSound >= 0;
+    return iActive;
+}
+
+void VoiceMixer::ResetStats()
+{
+    iMixCalls = 0;
+    dMixMs = 0.0;
+}
+
+/** Returns iFrames frames of the sound at the voice position, looping or padded with silence. **/
+const float* VoiceMixer::ReadSound(Voice& voice, int iFrames)
+{
+    const Sound& sound = *Sounds[voice.iSound];
+    const int iSoundChannels = sound.iChannels;
+
+    // Most reads are one contiguous run of the sound.
+    if (voice.iPosition + iFrames <= sound.iFrames) {
+        const float* pRun = &sound.Samples[voice.iPosition * iSoundChannels];
+        voice.iPosition += iFrames;
+        return pRun;
+    }
+
+    float* pInput = &Input[0];
+    int iCopied = 0;
+
+    while (iCopied < iFrames) {
+        if (voice.iPosition >= sound.iFrames) {
+            if (!voice.bLoop) {
+                memset(pInput + iCopied * iSoundChannels, 0, (iFrames - iCopied) * iSoundChannels * sizeof(float));
+                break;
+            }
+            voice.iPosition = 0;
+        }
+
+        int iRun = sound.iFrames - voice.iPosition;
+        if (iRun > iFrames - iCopied)
+            iRun = iFrames - iCopied;
+
+        memcpy(pInput + iCopied * iSoundChannels, &sound.Samples[voice.iPosition * iSoundChannels],
+               iRun * iSoundChannels * sizeof(float));
+        iCopied += iRun;
+        voice.iPosition += iRun;
+    }
+    return pInput;
+}
+
+void VoiceMixer::MixVoice(Voice& voice, int iFrames, const MixerKernels& kernels)
+{
+    const Sound& sound = *Sounds[voice.iSound];
+    const float* pSource;
+
+    if (sound.Filter.IsPassThrough()) {
+        pSource = ReadSound(voice, iFrames);
+    } else {
+        const float* pIn = ReadSound(voice, voice.Resampler.GetInputFrames(iFrames));
+        voice.Resampler.Process(pIn, &Resampled[0], iFrames, kernels);
+        pSource = &Resampled[0];
+    }
+
+    // Gain changes and stops ramp over the whole step.
+    float fTarget = voice.bStopping ? 0.0f : voice.fTargetGain;
+    kernels.MixFloatRamp(&Bus[0], pSource, iFrames, sound.iChannels, voice.fGain, fTarget);
+    voice.fGain = fTarget;
+
+    if (voice.bStopping || (!voice.bLoop && voice.iPosition >= sound.iFrames))
+        voice.iSound = -1;
+}
+
+void VoiceMixer::Mix(Sint16* pStream, int iFrames, bool bAdd)
+{
+    if (!pLock) {
+        if (!bAdd)
+            memset(pStream, 0, iFrames * iChannels * sizeof(Sint16));
+        return;
+    }
+
+    Uint64 iStart = SDL_GetPerformanceCounter();
+    const MixerKernels& kernels = GetMixerKernels(bSimd);
+
+    SDL_LockMutex(pLock);
+
+    for (int iDone = 0; iDone < iFrames; ) {
+        int iStep = iFrames - iDone < iMaxFrames ? iFrames - iDone : iMaxFrames;
+        Sint16* pDest = pStream + iDone * iChannels;
+
+        memset(&Bus[0], 0, iStep * 2 * sizeof(float));
+        for (size_t i = 0; i < Voices.size(); ++i)
+            if (Voices[i].iSound >= 0)
+                MixVoice(Voices[i], iStep, kernels);
+
+        // A mono device gets the mean of both sides.
+        if (iChannels == 1)
+            for (int f = 0; f < iStep; ++f)
+                Bus[f] = (Bus[f * 2] + Bus[f * 2 + 1]) * 0.5f;
+
+        int iSamples = iStep * iChannels;
+        if (bAdd) {
+            kernels.FloatToS16(&Output[0], &Bus[0], iSamples);
+            kernels.MixS16(pDest, &Output[0], iSamples, SDL_MIX_MAXVOLUME);
+        } else {
+            kernels.FloatToS16(pDest, &Bus[0], iSamples);
+        }
+
+        iDone += iStep;
+    }
+
+    SDL_UnlockMutex(pLock);
+
+    dMixMs += (SDL_GetPerformanceCounter() - iStart) * 1000.0 / SDL_GetPerformanceFrequency();
+    ++iMixCalls;
+}
+
+void SDLCALL VoiceMixer::PostMix(void* pUserData, Uint8* pStream, int iLength)
+{
+    VoiceMixer* pMixer = (VoiceMixer*)pUserData;
+    pMixer->Mix((Sint16*)pStream, iLength / (pMixer->iChannels * (int)sizeof(Sint16)), true);
+}
+
+void SDLCALL VoiceMixer::Callback(void* pUserData, Uint8* pStream, int iLength)
+{
+    VoiceMixer* pMixer = (VoiceMixer*)pUserData;
+    pMixer->Mix((Sint16*)pStream, iLength / (pMixer->iChannels * (int)sizeof(Sint16)), false);
+}
@@ -1,7 +1,15 @@
 #include "SDL.h"
 #include "SDL_ttf.h"
 #include "SDL_mixer.h"
-
+#include "AudioMixer.h"
+#include "EventLoop.h"
+#include "MemoryTracker.h"
+#include "MusicStream.h"
+#include "TextCache.h"
+#include "VideoPresenter.h"
+
+#include <stdio.h>
+#include <string.h>
 #include <string>
 #include <iostream>
 
@@ -12,12 +20,19 @@ const int     WINDOW_WIDTH    = 1280;
 const int     WINDOW_HEIGHT    = 720;
 const char* WINDOW_TITLE    = "Media Application Sample!!!";
 
+//Audio device: rate and frames per callback.
+const int     AUDIO_RATE        = 32000;
+const int     AUDIO_CHUNK_SIZE  = 4096;
+
 //Surface Area global variables.
 SDL_Surface     *backgroundArea     = NULL;
 SDL_Surface     *textArea            = NULL;
 SDL_Window         *screen             = NULL;
 SDL_Surface     *WinSurface         = NULL;
 
+//Renderer of the video benchmark, which draws with it instead of the window surface.
+SDL_Renderer    *renderer           = NULL;
+
 //The event handler constant
 SDL_Event event;
 
@@ -27,8 +42,29 @@ TTF_Font *font = NULL;
 //font color
 SDL_Color fontColor = { 125, 125, 125 };
 
-//Mixer information that will be played.
-Mix_Music *music = NULL;
+//Music streamed from the mapped file by a decode thread, hooked into SDL_mixer.
+MusicStream music;
+
+//Soft memory limits of the subsystems, in bytes.
+const size_t IMAGE_BUDGET   = 8 * 1024 * 1024;
+const size_t TEXT_BUDGET    = 1024 * 1024;
+const size_t AUDIO_BUDGET   = 4 * 1024 * 1024;
+
+//Rendered labels kept for reuse, within the text budget.
+const size_t TEXT_CACHE_BUDGET = 256 * 1024;
+TextCache textCache(TEXT_CACHE_BUDGET);
+
+//Row of the music time label, and the seconds it shows.
+const int PLAY_TIME_Y = 400;
+int playSeconds = 0;
+
+/**
+ * Warns when a subsystem uses more memory than planned.
+ */
+void onOverBudget(MemoryTag tag, size_t current, size_t budget, void* userData) {
+    cout << "Memory budget exceeded: " << MemoryTracker::GetTagName(tag) << " uses " << current
+         << " of " << budget << " bytes" << endl;
+}
 
 /**
  * Loads the back ground image
@@ -36,6 +72,7 @@ Mix_Music *music = NULL;
 SDL_Surface *loadImageOnSurface(std::string filePath) {
 
     SDL_Surface* imgSurface = NULL;
+    MemoryScope scope(MEM_TAG_IMAGES);
 
     //Load the image
     imgSurface = SDL_LoadBMP( filePath.c_str() );
@@ -70,6 +107,12 @@ void apply_surface(int x, int y, SDL_Surface* source, SDL_Surface* destination,
  */
 bool initializeSDL() {
 
+    //Account SDL allocations per subsystem, before SDL allocates anything
+    MemoryTracker::Install();
+    MemoryTracker::SetBudget(MEM_TAG_IMAGES, IMAGE_BUDGET, onOverBudget, NULL);
+    MemoryTracker::SetBudget(MEM_TAG_TEXT, TEXT_BUDGET, onOverBudget, NULL);
+    MemoryTracker::SetBudget(MEM_TAG_AUDIO, AUDIO_BUDGET, onOverBudget, NULL);
+
     //Initialize all SDL subsystems
     if (SDL_Init(SDL_INIT_EVERYTHING) == -1) {
         return false;
@@ -85,7 +128,18 @@ bool initializeSDL() {
         return false;
     }
 
-    WinSurface = SDL_GetWindowSurface(screen);
+    //A renderer and the window surface cannot share the window
+    if (SDL_getenv("VIDEO_BENCH")) {
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengles2");
+        renderer = SDL_CreateRenderer(screen, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        if (renderer == NULL) {
+            cout << "SDL Renderer creation failed " << SDL_GetError() << endl;
+            return false;
+        }
+    }
+    else {
+        WinSurface = SDL_GetWindowSurface(screen);
+    }
 
     //Initialize the fonts
     if (TTF_Init() == -1) {
@@ -93,7 +147,8 @@ bool initializeSDL() {
     }
 
     //Initialize SDL_mixer APIs
-    if (Mix_OpenAudio(32000, MIX_DEFAULT_FORMAT, 2, 4096) == -1) {
+    MemoryScope scope(MEM_TAG_AUDIO);
+    if (Mix_OpenAudio(AUDIO_RATE, MIX_DEFAULT_FORMAT, 2, AUDIO_CHUNK_SIZE) == -1) {
         return false;
     }
 
@@ -115,25 +170,345 @@ bool load_files() {
     }
 
     //Open the font
-    font = TTF_OpenFont("res/samplefont.ttf", 17);
+    {
+        MemoryScope scope(MEM_TAG_FONTS);
+        font = TTF_OpenFont("res/samplefont.ttf", 17);
+    }
 
     //If there was an error in loading the font
     if (font == NULL) {
         return false;
     }
 
-    //Load the music
-    music = Mix_LoadMUS("res/play.wav");
+    //Open the music in the format of the device
+    int rate = 0, channels = 0;
+    Uint16 format = 0;
+    Mix_QuerySpec(&rate, &format, &channels);
 
-    //If there was a problem loading the music
-    if (music == NULL) {
+    bool opened = false;
+    {
+        MemoryScope scope(MEM_TAG_AUDIO);
+        opened = format == AUDIO_S16SYS && music.Open("res/play.wav", rate, channels, AUDIO_CHUNK_SIZE);
+    }
+
+    //If there was a problem opening the music
+    if (!opened) {
         return false;
     }
 
+    //SDL_mixer pulls the music from the stream and mixes the channels over it
+    Mix_HookMusic(MusicStream::HookMusic, &music);
+
     //If Music loaded fine
     return true;
 }
 
+/**
+ * Mixes voices of res/play.wav over the music through Mix_SetPostMix(),
+ * with the scalar and then the SIMD kernels, and prints the cost of each
+ * callback. Runs headless with SDL_AUDIODRIVER=dummy.
+ */
+bool runMixerBenchmark(int voices, int seconds) {
+
+    int rate = 0, channels = 0;
+    Uint16 format = 0;
+    Mix_QuerySpec(&rate, &format, &channels);
+
+    SDL_AudioSpec spec;
+    Uint8* buffer = NULL;
+    Uint32 length = 0;
+    if (SDL_LoadWAV("res/play.wav", &spec, &buffer, &length) == NULL || spec.format != AUDIO_S16SYS) {
+        cout << "Mixer benchmark needs a 16-bit res/play.wav " << SDL_GetError() << endl;
+        return false;
+    }
+
+    VoiceMixer mixer;
+    if (format != AUDIO_S16SYS || !mixer.Open(rate, channels, AUDIO_CHUNK_SIZE, voices)) {
+        SDL_FreeWAV(buffer);
+        return false;
+    }
+
+    //The same samples declared at three rates, so two of three voices are resampled
+    int rates[3] = { spec.freq, 44100, 48000 };
+    int sounds[3];
+    for (int i = 0; i < 3; ++i) {
+        sounds[i] = mixer.AddSound((const Sint16*)buffer, length / (spec.channels * 2), spec.channels, rates[i]);
+    }
+    SDL_FreeWAV(buffer);
+
+    for (int i = 0; i < voices; ++i) {
+        mixer.Play(sounds[i % 3], 1.0f / voices, true);
+    }
+
+    music.Play(-1);
+
+    for (int simd = 0; simd < 2; ++simd) {
+        mixer.SetSimd(simd == 1);
+        mixer.ResetStats();
+
+        //Mix_SetPostMix() locks the audio device, so the stats are not read mid-callback
+        Mix_SetPostMix(VoiceMixer::PostMix, &mixer);
+        SDL_Delay(seconds * 1000);
+        Mix_SetPostMix(NULL, NULL);
+
+        double period = AUDIO_CHUNK_SIZE * 1000.0 / rate;
+        printf("mixer (%s): %d voices, %u callbacks, %.3f ms each (%.1f%% of %.0f ms)\n",
+               mixer.GetKernelName(), voices, mixer.GetMixCalls(), mixer.GetMixMs(),
+               mixer.GetMixMs() * 100.0 / period, period);
+    }
+
+    music.Halt();
+    return true;
+}
+
+/**
+ * Returns the VmHWM (peak) or VmRSS (current) line of /proc/self/status in kB.
+ */
+long readMemoryStatus(const char* key) {
+
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    long kb = -1;
+    size_t length = strlen(key);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, length) == 0 && line[length] == ':') {
+            kb = atol(line + length + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return kb;
+}
+
+/**
+ * Plays the music looped for the given time and prints the callbacks, the
+ * underruns and the peak resident memory, next to the size res/play.wav
+ * takes when decoded whole. Runs headless with SDL_AUDIODRIVER=dummy.
+ */
+bool runMusicStreamBenchmark(int seconds) {
+
+    long before = readMemoryStatus("VmRSS");
+
+    music.Play(-1);
+    SDL_Delay(seconds * 1000);
+    music.Halt();
+
+    printf("music stream: %u callbacks, %u underruns, %lu kB ring\n",
+           music.GetCallbacks(), music.GetUnderruns(), (unsigned long)(music.GetRingBytes() / 1024));
+    printf("music stream: resident %ld kB before, %ld kB peak\n", before, readMemoryStatus("VmHWM"));
+
+    //What Mix_LoadWAV() would keep in memory for the same file
+    Mix_Chunk* chunk = Mix_LoadWAV("res/play.wav");
+    if (chunk == NULL) {
+        return false;
+    }
+    printf("whole file decode: %lu kB\n", (unsigned long)(chunk->alen / 1024));
+    Mix_FreeChunk(chunk);
+
+    return music.GetUnderruns() == 0;
+}
+
+/**
+ * Stands in for a video decoder: writes frame number `frame` of a moving
+ * test pattern into the planes, horizontal bands scrolling down and a bar
+ * sweeping across.
+ */
+void fillTestFrame(const VideoPlanes& planes, Uint32 format, int width, int height, int frame) {
+
+    int bar = (frame * 16) % width;
+
+    for (int y = 0; y < height; ++y) {
+        Uint8* row = planes.pY + y * planes.iPitchY;
+        memset(row, 16 + ((y + frame * 4) & 0x7F) + 64, width);
+        memset(row + bar, 235, (width - bar < 64) ? width - bar : 64);
+    }
+
+    for (int y = 0; y < height / 2; ++y) {
+        Uint8 u = (Uint8)(128 + ((y * 2 + frame) & 0x3F) - 32);
+        Uint8 v = (Uint8)(128 - ((y * 2 + frame) & 0x3F) + 32);
+
+        if (format == SDL_PIXELFORMAT_NV12) {
+            Uint8* row = planes.pU + y * planes.iPitchUV;
+            for (int x = 0; x < width / 2; ++x) {
+                row[x * 2] = u;
+                row[x * 2 + 1] = v;
+            }
+        }
+        else {
+            memset(planes.pU + y * planes.iPitchUV, u, width / 2);
+            memset(planes.pV + y * planes.iPitchUV, v, width / 2);
+        }
+    }
+}
+
+/**
+ * Plays synthetic 1080p60 video through the YUV texture path for the given
+ * time and prints how many frames were shown, dropped or skipped, the
+ * upload cost and the lateness. VIDEO_FORMAT=nv12 uses NV12 instead of I420.
+ */
+bool runVideoBenchmark(int seconds) {
+
+    const int width = 1920, height = 1080, fps = 60;
+    const char* name = SDL_getenv("VIDEO_FORMAT");
+    Uint32 format = (name != NULL && strcmp(name, "nv12") == 0) ? SDL_PIXELFORMAT_NV12 : SDL_PIXELFORMAT_IYUV;
+
+    VideoPresenter video;
+    if (!video.Open(renderer, format, width, height)) {
+        cout << "Video textures creation failed " << SDL_GetError() << endl;
+        return false;
+    }
+
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(renderer, &info);
+    printf("video: %dx%d %s at %d fps on %s, %s\n", width, height,
+           format == SDL_PIXELFORMAT_NV12 ? "nv12" : "i420", fps, info.name,
+           video.IsNative() ? "converted in the shader" : "converted in software");
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 lastShown = start;
+    double fillMs = 0.0, maxIntervalMs = 0.0;
+    int next = 0, filled = 0, skipped = 0;
+
+    while (true) {
+        double clock = (double)(SDL_GetPerformanceCounter() - start) / frequency;
+        if (clock >= seconds) {
+            break;
+        }
+
+        //Decode ahead while a texture is free; frames a whole period late are not decoded at all
+        VideoPlanes planes;
+        while (video.CanAcquire()) {
+            if ((next + 1.0) / fps <= clock) {
+                ++next;
+                ++skipped;
+                continue;
+            }
+            if (!video.AcquireFrame(planes)) {
+                break;
+            }
+
+            Uint64 fillStart = SDL_GetPerformanceCounter();
+            fillTestFrame(planes, format, width, height, next);
+            fillMs += (double)(SDL_GetPerformanceCounter() - fillStart) * 1000.0 / frequency;
+            ++filled;
+
+            video.SubmitFrame((double)next / fps);
+            ++next;
+        }
+
+        SDL_PumpEvents();
+        SDL_RenderClear(renderer);
+        bool shown = video.Draw((double)(SDL_GetPerformanceCounter() - start) / frequency);
+        SDL_RenderPresent(renderer);
+
+        if (shown) {
+            Uint64 now = SDL_GetPerformanceCounter();
+            double intervalMs = (double)(now - lastShown) * 1000.0 / frequency;
+            if (video.GetShown() > 1 && intervalMs > maxIntervalMs) {
+                maxIntervalMs = intervalMs;
+            }
+            lastShown = now;
+        }
+    }
+
+    printf("video: %u submitted, %u shown, %u dropped, %d skipped before decode\n",
+           video.GetSubmitted(), video.GetShown(), video.GetDropped(), skipped);
+    printf("video: fill %.2f ms, upload %.2f ms per frame, late %.2f ms mean, %.2f ms worst, longest gap %.1f ms\n",
+           filled ? fillMs / filled : 0.0, video.GetUploadMs(), video.GetLateMs(), video.GetMaxLateMs(),
+           maxIntervalMs);
+
+    return video.IsNative();
+}
+
+/**
+ * Shows the music time under the instructions. The label only rasterizes
+ * the digit runs that changed, the rest comes from the text cache.
+ */
+void drawPlayTime(TextLabel& label, int seconds) {
+
+    char text[32];
+    sprintf(text, "Music %02d:%02d", (seconds / 60) % 100, seconds % 60);
+    if (!label.SetText(text)) {
+        return;
+    }
+
+    MemoryScope scope(MEM_TAG_TEXT);
+    int width = 0, height = 0;
+    label.GetSize(width, height);
+
+    //Restore the background under the previous text
+    SDL_Rect row = { 0, PLAY_TIME_Y, WINDOW_WIDTH, height };
+    SDL_Rect dest = row;
+    SDL_BlitSurface(backgroundArea, &row, WinSurface, &dest);
+
+    label.Draw(WinSurface, (WINDOW_WIDTH - width) / 2, PLAY_TIME_Y);
+}
+
+/**
+ * Updates a timer label every frame, through the text cache and then by
+ * rasterizing the whole string each time, and prints the frame time of
+ * both and the hit rate of the cache.
+ */
+bool runTextBenchmark(int frames) {
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    double cachedMs = 0.0, cachedMax = 0.0, directMs = 0.0, directMax = 0.0;
+    char text[64];
+
+    TextLabel label(textCache, font, fontColor);
+    textCache.ResetStats();
+
+    for (int i = 0; i < frames; ++i) {
+        //A centisecond timer: the last digits change every frame
+        sprintf(text, "Track 01  %02d:%02d.%02d", (i / 6000) % 60, (i / 100) % 60, i % 100);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        {
+            MemoryScope scope(MEM_TAG_TEXT);
+            label.SetText(text);
+            label.Draw(WinSurface, 100, PLAY_TIME_Y);
+        }
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+        cachedMs += ms;
+        cachedMax = ms > cachedMax ? ms : cachedMax;
+
+        start = SDL_GetPerformanceCounter();
+        {
+            MemoryScope scope(MEM_TAG_TEXT);
+            SDL_Surface* surface = TTF_RenderText_Solid(font, text, fontColor);
+            apply_surface(100, PLAY_TIME_Y, surface, WinSurface);
+            SDL_FreeSurface(surface);
+        }
+        ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+        directMs += ms;
+        directMax = ms > directMax ? ms : directMax;
+    }
+
+    if (frames > 0) {
+        printf("text: %d frames, cached %.3f ms per frame (worst %.3f), whole string %.3f ms per frame (worst %.3f)\n",
+               frames, cachedMs / frames, cachedMax, directMs / frames, directMax);
+    }
+    textCache.Report(stdout);
+    return true;
+}
+
+/**
+ * Ends the idle measurement of IDLE_BENCH.
+ */
+Uint32 SDLCALL quitTimer(Uint32 interval, void* param) {
+
+    SDL_Event quitEvent;
+    SDL_zero(quitEvent);
+    quitEvent.type = SDL_QUIT;
+    SDL_PushEvent(&quitEvent);
+    return 0;
+}
+
 /**
  * Release all the resources and clean exit.
  */
@@ -141,10 +516,17 @@ void clean_up() {
 
     //Free the surfaces
     SDL_FreeSurface(backgroundArea);
+    if (renderer != NULL) {
+        SDL_DestroyRenderer(renderer);
+    }
     SDL_DestroyWindow(screen);
 
-    //Free the music
-    Mix_FreeMusic(music);
+    //Free the cached text before its font
+    textCache.Clear();
+
+    //Unhook and close the music
+    Mix_HookMusic(NULL, NULL);
+    music.Close();
 
     //Close the font
     TTF_CloseFont(font);
@@ -157,6 +539,9 @@ void clean_up() {
 
     //Quit SDL
     SDL_Quit();
+
+    //Blocks still live here were leaked, MEMORY_REPORT=path writes them to a file
+    MemoryTracker::DumpJson();
 }
 
 
@@ -167,7 +552,6 @@ int main(int argc, char* args[]) {
 
     //Quit flag
     bool quit = false;
-    int foreground = 1;
 
     //Initialize the SDL sub systems.
     if (initializeSDL() == false) {
@@ -179,70 +563,117 @@ int main(int argc, char* args[]) {
         return 1;
     }
 
+    //MIXER_BENCH=32 measures the cost of mixing 32 voices per callback and exits
+    if (SDL_getenv("MIXER_BENCH")) {
+        bool done = runMixerBenchmark(atoi(SDL_getenv("MIXER_BENCH")), 3);
+        clean_up();
+        return done ? 0 : 1;
+    }
+
+    //MUSIC_STREAM_BENCH=10 streams the music for 10 s, reports underruns and memory and exits
+    if (SDL_getenv("MUSIC_STREAM_BENCH")) {
+        bool done = runMusicStreamBenchmark(atoi(SDL_getenv("MUSIC_STREAM_BENCH")));
+        clean_up();
+        return done ? 0 : 1;
+    }
+
+    //TEXT_BENCH=1000 updates a timer label for 1000 frames, with and without the text cache, and exits
+    if (SDL_getenv("TEXT_BENCH")) {
+        bool done = runTextBenchmark(atoi(SDL_getenv("TEXT_BENCH")));
+        clean_up();
+        return done ? 0 : 1;
+    }
+
+    //VIDEO_BENCH=10 plays 10 s of synthetic 1080p60 video through the YUV textures and exits
+    if (SDL_getenv("VIDEO_BENCH")) {
+        bool done = runVideoBenchmark(atoi(SDL_getenv("VIDEO_BENCH")));
+        clean_up();
+        return done ? 0 : 1;
+    }
+
     //Apply the backgroundArea
     apply_surface(0, 0, backgroundArea, WinSurface);
 
-    //Render the text
-    textArea = TTF_RenderText_Solid(font, "Press 1 to play or pause the music", fontColor);
+    //Render the text, or take it from the cache
+    {
+        MemoryScope scope(MEM_TAG_TEXT);
+        textArea = textCache.Get(font, TTF_STYLE_NORMAL, fontColor, "Press 1 to play or pause the music");
+    }
 
     //If there was an error in rendering the text
     if (textArea == NULL) {
         return 1;
     }
 
-    //Show the textArea on the screen
+    //Show the textArea on the screen; the cache owns it
     apply_surface((WINDOW_WIDTH - textArea->w) / 2, 200, textArea, WinSurface);
 
-    //Free the textArea
-    SDL_FreeSurface(textArea);
-
-    //Render the text
-    textArea = TTF_RenderText_Solid(font, "Press 0 to stop the music", fontColor);
+    //Render the text, or take it from the cache
+    {
+        MemoryScope scope(MEM_TAG_TEXT);
+        textArea = textCache.Get(font, TTF_STYLE_NORMAL, fontColor, "Press 0 to stop the music");
+    }
 
     //If there was an error in rendering the text
     if (textArea == NULL) {
         return 1;
     }
 
-    //Show the textArea on the screen
+    //Show the textArea on the screen; the cache owns it
     apply_surface((WINDOW_WIDTH - textArea->w) / 2, 300, textArea, WinSurface);
 
-    //Free the textArea
-    SDL_FreeSurface(textArea);
+    //Music time, updated once a second while the music plays
+    TextLabel playTime(textCache, font, fontColor);
+    drawPlayTime(playTime, playSeconds);
 
+    //The screen is static: the loop sleeps until an event and updates the window only when it is dirty
+    EventLoop loop;
+
+    //IDLE_BENCH=60 leaves the app idle for 60 s, then prints the CPU time it used and quits
+    const char* idleBench = SDL_getenv("IDLE_BENCH");
+    if (idleBench) {
+        SDL_AddTimer(atoi(idleBench) * 1000, quitTimer, NULL);
+    }
 
     //While the user hasn't quit
     while (quit == false) {
-        //While there's events to handle
-        while (SDL_PollEvent(&event)) {
+        //While there's events to handle, sleeping while there are none
+        while (loop.WaitEvent(event)) {
             if(event.type == SDL_APP_DIDENTERFOREGROUND) {
-                foreground = 1;
+                loop.SetVisible(true);
+                loop.Invalidate();
             }
             else if(event.type == SDL_APP_DIDENTERBACKGROUND) {
-                foreground = 0;
+                loop.SetVisible(false);
             }
             //If a key was pressed
             else if (event.type == SDL_KEYDOWN) {
                 //If 1 was pressed
                 if (event.key.keysym.sym == SDLK_1) {
                     //If there is no music playing
-                    if (Mix_PlayingMusic() == 0) {
+                    if (!music.IsPlaying()) {
                         //Play the music
-                        if (Mix_PlayMusic(music, -1) == -1) {
+                        if (!music.Play(-1)) {
                             return 1;
                         }
+                        playSeconds = 0;
+                        drawPlayTime(playTime, playSeconds);
+                        loop.Invalidate();
+                        loop.SetTimer(1000);
                     }
                     //If music is being played
                     else {
                         //If the music is paused
-                        if (Mix_PausedMusic() == 1) {
+                        if (music.IsPaused()) {
                             //Resume the music
-                            Mix_ResumeMusic();
+                            music.Resume();
+                            loop.SetTimer(1000);
                         }
                         //If the music is playing
                         else {
                             //Pause the music
-                            Mix_PauseMusic();
+                            music.Pause();
+                            loop.SetTimer(0);
                         }
                     }
                 }
@@ -250,27 +681,38 @@ int main(int argc, char* args[]) {
                 //If 0 was pressed
                 else if (event.key.keysym.sym == SDLK_0) {
                     //Stop the music
-                    Mix_HaltMusic();
+                    music.Halt();
+                    loop.SetTimer(0);
                 }
             }
             //If the user has Xed out the window
             else if (event.type == SDL_QUIT || event.type == SDL_MOUSEBUTTONDOWN) {
                 //Quit the program
                 quit = true;
+                break;
             }
         }
-        /* render at only foreground */
-        if(foreground == 1) {
+        MemoryTracker::CheckBudgets();
+
+        //A second of music went by
+        if (loop.TakeTimer() && music.IsPlaying() && !music.IsPaused()) {
+            drawPlayTime(playTime, ++playSeconds);
+            loop.Invalidate();
+        }
+
+        /* render at only foreground, and only when the screen changed */
+        /* In the background the loop sleeps until an event, so it does not burn CPU */
+        /* If your apps use cpu too much then webOS system manger may kill your apps */
+        if (loop.TakeDirty()) {
             //Update the screen
             if (SDL_UpdateWindowSurface(screen) == -1) {
                 return 1;
             }
         }
-        /* When your apps goes background, your app should prevent CPU burn */
-        /* If your apps use cpu too much then webOS system manger may kill your apps */
-        else {
-            SDL_Delay(30);
-        }
+    }
+
+    if (idleBench) {
+        loop.Report(stdout);
     }
 
     //Free surfaces, fonts and sounds
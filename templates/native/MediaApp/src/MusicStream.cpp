@@ -0,0 +1,432 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MusicStream.h"
+
+namespace {
+
+//Pages behind the decode position are released in steps of this size.
+const size_t RELEASE_STEP = 256 * 1024;
+
+Uint32 ReadLE32(const Uint8* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+Uint16 ReadLE16(const Uint8* p)
+{
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+}
+
+MusicStream::MusicStream()
+{
+    iFile           = -1;
+    pMap            = 0;
+    iMapSize        = 0;
+    pData           = 0;
+    iFrames         = 0;
+    iSourceChannels = 0;
+    iChannels       = 0;
+    iBufferFrames   = 0;
+    iPosition       = 0;
+    iLoopsLeft      = 0;
+    iReleased       = 0;
+    iReadOffset     = 0;
+    pThread         = 0;
+    pDecodeLock     = 0;
+    pWake           = 0;
+    pCallbackLock   = 0;
+
+    SDL_AtomicSet(&Written, 0);
+    SDL_AtomicSet(&Drained, 0);
+    SDL_AtomicSet(&EndBuffer, -1);
+    SDL_AtomicSet(&Playing, 0);
+    SDL_AtomicSet(&Paused, 0);
+    SDL_AtomicSet(&Volume, SDL_MIX_MAXVOLUME);
+    SDL_AtomicSet(&Callbacks, 0);
+    SDL_AtomicSet(&Underruns, 0);
+    SDL_AtomicSet(&Quit, 0);
+}
+
+MusicStream::~MusicStream()
+{
+    Close();
+}
+
+bool MusicStream::Open(const char* czPath, int iDeviceRate, int iDeviceChannels, int iFramesPerBuffer)
+{
+    Close();
+
+    if ((iDeviceChannels != 1 && iDeviceChannels != 2) || iFramesPerBuffer <= 0)
+        return false;
+
+    iFile = open(czPath, O_RDONLY);
+    if (iFile < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(iFile, &info) != 0 || info.st_size < 12) {
+        Close();
+        return false;
+    }
+
+    iMapSize = (size_t)info.st_size;
+    void* pMapping = mmap(0, iMapSize, PROT_READ, MAP_PRIVATE, iFile, 0);
+    if (pMapping == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    pMap = (Uint8*)pMapping;
+    madvise(pMap, iMapSize, MADV_SEQUENTIAL);
+
+    if (memcmp(pMap, "RIFF", 4) != 0 || memcmp(pMap + 8, "WAVE", 4) != 0) {
+        Close();
+        return false;
+    }
+
+    // Walk the chunks for the format and the samples.
+    int iRate = 0, iBits = 0;
+    size_t iDataSize = 0;
+
+    for (size_t i = 12; i + 8 <= iMapSize; ) {
+        const Uint8* pChunk = pMap + i;
+        size_t iSize = ReadLE32(pChunk + 4);
+        size_t iAvailable = iMapSize - i - 8;
+
+        if (memcmp(pChunk, "fmt ", 4) == 0 && iSize >= 16 && iSize <= iAvailable) {
+            Uint16 iFormat = ReadLE16(pChunk + 8);
+            iSourceChannels = ReadLE16(pChunk + 10);
+            iRate = (int)ReadLE32(pChunk + 12);
+            iBits = ReadLE16(pChunk + 22);
+
+            // 1 is PCM, 0xFFFE the extensible header, taken as PCM too.
+            if (iFormat != 1 && iFormat != 0xFFFE)
+                iBits = 0;
+        } else if (memcmp(pChunk, "data", 4) == 0) {
+            pData = pChunk + 8;
+            iDataSize = iSize < iAvailable ? iSize : iAvailable;
+            break;
+        }
+
+        // A chunk running past the end of the file would wrap the offset on 32 bit.
+        if (iSize > iAvailable) {
+            Close();
+            return false;
+        }
+
+        i += 8 + iSize + (iSize & 1);
+    }
+
+    if (!pData || iBits != 16 || (iSourceChannels != 1 && iSourceChannels != 2)
+        || !Filter.Init(iRate, iDeviceRate, iSourceChannels)) {
+        Close();
+        return false;
+    }
+
+    iFrames         = (int)(iDataSize / (iSourceChannels * sizeof(Sint16)));
+
+    // Without a single frame looping would never make progress.
+    if (iFrames == 0) {
+        Close();
+        return false;
+    }
+
+    iChannels       = iDeviceChannels;
+    iBufferFrames   = iFramesPerBuffer;
+
+    int iMaxInput = Filter.GetMaxInputFrames(iBufferFrames);
+    if (iMaxInput < iBufferFrames)
+        iMaxInput = iBufferFrames;
+    Source.resize(iMaxInput * iSourceChannels);
+    Input.resize(iMaxInput * iSourceChannels);
+    Resampled.resize(iBufferFrames * iSourceChannels);
+    Converted.resize(iBufferFrames * iChannels);
+    Ring.assign(MUSIC_STREAM_BUFFERS * iBufferFrames * iChannels, 0);
+
+    pDecodeLock     = SDL_CreateMutex();
+    pCallbackLock   = SDL_CreateMutex();
+    pWake           = SDL_CreateCond();
+    SDL_AtomicSet(&Quit, 0);
+
+    if (pDecodeLock && pCallbackLock && pWake)
+        pThread = SDL_CreateThread(DecodeThread, "MusicStream", this);
+
+    if (!pThread) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MusicStream::Close()
+{
+    SDL_AtomicSet(&Playing, 0);
+
+    if (pThread) {
+        SDL_AtomicSet(&Quit, 1);
+        SDL_CondSignal(pWake);
+        SDL_WaitThread(pThread, NULL);
+        pThread = 0;
+    }
+
+    if (pWake)
+        SDL_DestroyCond(pWake);
+    if (pDecodeLock)
+        SDL_DestroyMutex(pDecodeLock);
+    if (pCallbackLock)
+        SDL_DestroyMutex(pCallbackLock);
+    pWake = 0;
+    pDecodeLock = 0;
+    pCallbackLock = 0;
+
+    if (pMap)
+        munmap(pMap, iMapSize);
+    if (iFile >= 0)
+        close(iFile);
+
+    pMap = 0;
+    iFile = -1;
+    pData = 0;
+    iFrames = 0;
+}
+
+bool MusicStream::Play(int iLoops)
+{
+    if (!pThread)
+        return false;
+
+    // Keep the callback out while the ring is reset, then the thread.
+    SDL_LockMutex(pCallbackLock);
+    SDL_LockMutex(pDecodeLock);
+
+    iPosition   = 0;
+    iLoopsLeft  = iLoops < 0 ? -1 : (iLoops > 1 ? iLoops - 1 : 0);
+    iReleased   = 0;
+    iReadOffset = 0;
+    Resampler.Init(Filter, iBufferFrames);
+
+    SDL_AtomicSet(&Drained, 0);
+    SDL_AtomicSet(&EndBuffer, -1);
+
+    // The first buffer is decoded here, so playback never starts dry.
+    FillBuffer(&Ring[0]);
+    SDL_AtomicSet(&Written, 1);
+    if (iLoopsLeft == 0 && iPosition >= iFrames)
+        SDL_AtomicSet(&EndBuffer, 1);
+
+    SDL_AtomicSet(&Paused, 0);
+    SDL_AtomicSet(&Playing, 1);
+
+    SDL_UnlockMutex(pDecodeLock);
+    SDL_UnlockMutex(pCallbackLock);
+
+    SDL_CondSignal(pWake);
+    return true;
+}
+
+void MusicStream::Halt()
+{
+    if (!pCallbackLock)
+        return;
+
+    SDL_LockMutex(pCallbackLock);
+    SDL_AtomicSet(&Playing, 0);
+    SDL_UnlockMutex(pCallbackLock);
+}
+
+void MusicStream::Pause()
+{
+    SDL_AtomicSet(&Paused, 1);
+}
+
+void MusicStream::Resume()
+{
+    SDL_AtomicSet(&Paused, 0);
+}
+
+void MusicStream::SetVolume(int iVolume)
+{
+    SDL_AtomicSet(&Volume, iVolume < 0 ? 0 : (iVolume > SDL_MIX_MAXVOLUME ? SDL_MIX_MAXVOLUME : iVolume));
+}
+
+/** Hands the pages of the file before iEnd back to the kernel; they are read again on the next loop. **/
+void MusicStream::ReleasePages(size_t iEnd)
+{
+    size_t iPage = (size_t)sysconf(_SC_PAGESIZE);
+    size_t iFrom = iReleased / iPage * iPage;
+    size_t iTo = iEnd / iPage * iPage;
+
+    if (iTo > iFrom)
+        madvise(pMap + iFrom, iTo - iFrom, MADV_DONTNEED);
+
+    iReleased = iTo;
+}
+
+/** Reads iCount source frames, looping as asked, with silence after the end. **/
+void MusicStream::ReadSource(Sint16* pDest, int iCount)
+{
+    const Sint16* pSamples = (const Sint16*)pData;
+    int iRead = 0;
+
+    while (iRead < iCount) {
+        if (iPosition >= iFrames) {
+            if (iLoopsLeft == 0) {
+                memset(pDest + iRead * iSourceChannels, 0, (iCount - iRead) * iSourceChannels * sizeof(Sint16));
+                break;
+            }
+
+            // Loops continue in the same buffer, the filter history carries over the seam.
+            ReleasePages(iMapSize);
+            iReleased = 0;
+            iPosition = 0;
+            if (iLoopsLeft > 0)
+                --iLoopsLeft;
+        }
+
+        int iRun = iFrames - iPosition;
+        if (iRun > iCount - iRead)
+            iRun = iCount - iRead;
+
+        const Sint16* pRun = pSamples + iPosition * iSourceChannels;
+        Sint16* pOut = pDest + iRead * iSourceChannels;
+        for (int i = 0; i < iRun * iSourceChannels; ++i)
+            pOut[i] = (Sint16)SDL_SwapLE16((Uint16)pRun[i]);
+
+        iRead += iRun;
+        iPosition += iRun;
+    }
+
+    size_t iOffset = (size_t)(pData - pMap) + (size_t)iPosition * iSourceChannels * sizeof(Sint16);
+    if (iOffset >= iReleased + RELEASE_STEP)
+        ReleasePages(iOffset);
+}
+
+/** Decodes the next iBufferFrames frames in the device format. **/
+void MusicStream::FillBuffer(Sint16* pDest)
+{
+    // Same rate and channels: the samples go straight to the ring.
+    if (Filter.IsPassThrough() && iSourceChannels == iChannels) {
+        ReadSource(pDest, iBufferFrames);
+        return;
+    }
+
+    const MixerKernels& kernels = GetMixerKernels();
+    int iCount = Filter.IsPassThrough() ? iBufferFrames : Resampler.GetInputFrames(iBufferFrames);
+
+    ReadSource(&Source[0], iCount);
+    for (int i = 0; i < iCount * iSourceChannels; ++i)
+        Input[i] = Source[i] * (1.0f / 32768.0f);
+
+    const float* pResampled = &Input[0];
+    if (!Filter.IsPassThrough()) {
+        Resampler.Process(&Input[0], &Resampled[0], iBufferFrames, kernels);
+        pResampled = &Resampled[0];
+    }
+
+    const float* pConverted = pResampled;
+    if (iSourceChannels != iChannels) {
+        for (int f = 0; f < iBufferFrames; ++f) {
+            if (iChannels == 2)
+                Converted[f * 2] = Converted[f * 2 + 1] = pResampled[f];
+            else
+                Converted[f] = (pResampled[f * 2] + pResampled[f * 2 + 1]) * 0.5f;
+        }
+        pConverted = &Converted[0];
+    }
+
+    kernels.FloatToS16(pDest, pConverted, iBufferFrames * iChannels);
+}
+
+int SDLCALL MusicStream::DecodeThread(void* pUserData)
+{
+    MusicStream* pStream = (MusicStream*)pUserData;
+    const int iBufferSamples = pStream->iBufferFrames * pStream->iChannels;
+
+    SDL_LockMutex(pStream->pDecodeLock);
+
+    while (!SDL_AtomicGet(&pStream->Quit)) {
+        int iWritten = SDL_AtomicGet(&pStream->Written);
+
+        bool bRoom = SDL_AtomicGet(&pStream->Playing) && SDL_AtomicGet(&pStream->EndBuffer) < 0
+            && iWritten - SDL_AtomicGet(&pStream->Drained) < MUSIC_STREAM_BUFFERS;
+
+        if (!bRoom) {
+            // The callback signals after each buffer; the timeout covers a missed wake up.
+            SDL_CondWaitTimeout(pStream->pWake, pStream->pDecodeLock, 20);
+            continue;
+        }
+
+        pStream->FillBuffer(&pStream->Ring[(iWritten % MUSIC_STREAM_BUFFERS) * iBufferSamples]);
+
+        if (pStream->iLoopsLeft == 0 && pStream->iPosition >= pStream->iFrames)
+            SDL_AtomicSet(&pStream->EndBuffer, iWritten + 1);
+
+        // SDL atomics are full barriers: the samples are visible before the count.
+        SDL_AtomicSet(&pStream->Written, iWritten + 1);
+    }
+
+    SDL_UnlockMutex(pStream->pDecodeLock);
+    return 0;
+}
+
+/** Copies ring buffers into the stream; never waits for the decoder. **/
+void MusicStream::Drain(Sint16* pStream, int iStreamFrames)
+{
+    const int iBufferSamples = iBufferFrames * iChannels;
+    const MixerKernels& kernels = GetMixerKernels();
+    int iVolume = SDL_AtomicGet(&Volume);
+    int iDone = 0;
+
+    while (iDone < iStreamFrames) {
+        int iDrained = SDL_AtomicGet(&Drained);
+
+        if (iDrained == SDL_AtomicGet(&Written)) {
+            if (SDL_AtomicGet(&EndBuffer) == iDrained)
+                SDL_AtomicSet(&Playing, 0);
+            else
+                SDL_AtomicAdd(&Underruns, 1);
+            break;
+        }
+
+        const Sint16* pBuffer = &Ring[(iDrained % MUSIC_STREAM_BUFFERS) * iBufferSamples];
+        int iRun = iBufferFrames - iReadOffset;
+        if (iRun > iStreamFrames - iDone)
+            iRun = iStreamFrames - iDone;
+
+        kernels.MixS16(pStream + iDone * iChannels, pBuffer + iReadOffset * iChannels, iRun * iChannels, iVolume);
+
+        iDone += iRun;
+        iReadOffset += iRun;
+        if (iReadOffset == iBufferFrames) {
+            iReadOffset = 0;
+            SDL_AtomicSet(&Drained, iDrained + 1);
+            SDL_CondSignal(pWake);
+        }
+    }
+}
+
+void SDLCALL MusicStream::HookMusic(void* pUserData, Uint8* pStream, int iLength)
+{
+    MusicStream* pMusic = (MusicStream*)pUserData;
+
+    memset(pStream, 0, iLength);
+
+    if (!pMusic->IsPlaying() || pMusic->IsPaused())
+        return;
+
+    // Play() or Halt() is resetting the ring; this callback stays silent.
+    if (SDL_TryLockMutex(pMusic->pCallbackLock) != 0)
+        return;
+
+    if (pMusic->IsPlaying()) {
+        SDL_AtomicAdd(&pMusic->Callbacks, 1);
+        pMusic->Drain((Sint16*)pStream, iLength / (pMusic->iChannels * (int)sizeof(Sint16)));
+    }
+
+    SDL_UnlockMutex(pMusic->pCallbackLock);
+}
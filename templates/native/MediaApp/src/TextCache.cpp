@@ -0,0 +1,209 @@
+#include "TextCache.h"
+
+namespace {
+
+enum RunClass
+{
+    RUN_DIGITS,
+    RUN_SPACES,
+    RUN_OTHER
+};
+
+RunClass GetRunClass(char c)
+{
+    if (c >= '0' && c <= '9')
+        return RUN_DIGITS;
+    if (c == ' ')
+        return RUN_SPACES;
+    return RUN_OTHER;
+}
+
+}
+
+bool TextCache::Key::operator<(const Key& other) const
+{
+    if (pFont != other.pFont)
+        return pFont < other.pFont;
+    if (iStyle != other.iStyle)
+        return iStyle < other.iStyle;
+    if (iColor != other.iColor)
+        return iColor < other.iColor;
+    return Text < other.Text;
+}
+
+TextCache::TextCache(size_t iBudgetBytes)
+{
+    iBudget     = iBudgetBytes;
+    iBytes      = 0;
+    iPeakBytes  = 0;
+
+    ResetStats();
+}
+
+TextCache::~TextCache()
+{
+    Clear();
+}
+
+void TextCache::SetBudget(size_t iBudgetBytes)
+{
+    iBudget = iBudgetBytes;
+    Evict();
+}
+
+/** Frees least recently used entries while over budget, keeping the newest one. **/
+void TextCache::Evict()
+{
+    while (iBytes > iBudget && Entries.size() > 1) {
+        Entry& entry = Entries.back();
+
+        SDL_FreeSurface(entry.pSurface);
+        iBytes -= entry.iBytes;
+        Index.erase(entry.key);
+        Entries.pop_back();
+        ++iEvictions;
+    }
+}
+
+SDL_Surface* TextCache::Get(TTF_Font* pFont, int iStyle, SDL_Color color, const std::string& text)
+{
+    if (!pFont || text.empty())
+        return NULL;
+
+    Key key;
+    key.pFont   = pFont;
+    key.iStyle  = iStyle;
+    key.iColor  = ((Uint32)color.r << 24) | ((Uint32)color.g << 16) | ((Uint32)color.b << 8) | color.a;
+    key.Text    = text;
+
+    std::map<Key, EntryList::iterator>::iterator found = Index.find(key);
+    if (found != Index.end()) {
+        // Move to the front, the iterator stays valid.
+        Entries.splice(Entries.begin(), Entries, found->second);
+        ++iHits;
+        return found->second->pSurface;
+    }
+
+    ++iMisses;
+
+    Uint64 iStart = SDL_GetPerformanceCounter();
+
+    int iOldStyle = TTF_GetFontStyle(pFont);
+    if (iOldStyle != iStyle)
+        TTF_SetFontStyle(pFont, iStyle);
+
+    SDL_Surface* pSurface = TTF_RenderText_Solid(pFont, text.c_str(), color);
+
+    if (iOldStyle != iStyle)
+        TTF_SetFontStyle(pFont, iOldStyle);
+
+    dRenderMs += (SDL_GetPerformanceCounter() - iStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if (!pSurface)
+        return NULL;
+
+    Entry entry;
+    entry.key       = key;
+    entry.pSurface  = pSurface;
+    entry.iBytes    = (size_t)pSurface->pitch * pSurface->h;
+
+    Entries.push_front(entry);
+    Index[key] = Entries.begin();
+
+    iBytes += entry.iBytes;
+    if (iBytes > iPeakBytes)
+        iPeakBytes = iBytes;
+
+    Evict();
+    return pSurface;
+}
+
+void TextCache::Clear()
+{
+    for (EntryList::iterator it = Entries.begin(); it != Entries.end(); ++it)
+        SDL_FreeSurface(it->pSurface);
+
+    Entries.clear();
+    Index.clear();
+    iBytes = 0;
+}
+
+void TextCache::ResetStats()
+{
+    iHits       = 0;
+    iMisses     = 0;
+    iEvictions  = 0;
+    dRenderMs   = 0.0;
+}
+
+void TextCache::Report(FILE* pFile) const
+{
+    fprintf(pFile, "text cache: %lu entries, %lu of %lu bytes (peak %lu), %u hits, %u misses (%.1f%% hit rate), "
+            "%u evictions, %.2f ms rasterizing\n",
+            (unsigned long)Entries.size(), (unsigned long)iBytes, (unsigned long)iBudget, (unsigned long)iPeakBytes,
+            iHits, iMisses, GetHitRate() * 100.0, iEvictions, dRenderMs);
+}
+
+TextLabel::TextLabel(TextCache& cache, TTF_Font* pLabelFont, SDL_Color color, int iLabelStyle)
+{
+    pCache  = &cache;
+    pFont   = pLabelFont;
+    iStyle  = iLabelStyle;
+    Color   = color;
+}
+
+bool TextLabel::SetText(const std::string& text)
+{
+    if (text == Text)
+        return false;
+
+    Text = text;
+    Runs.clear();
+
+    size_t iStart = 0;
+    for (size_t i = 1; i <= Text.size(); ++i) {
+        if (i == Text.size() || GetRunClass(Text[i]) != GetRunClass(Text[iStart])) {
+            Runs.push_back(Text.substr(iStart, i - iStart));
+            iStart = i;
+        }
+    }
+
+    return true;
+}
+
+void TextLabel::GetSize(int& iWidth, int& iHeight)
+{
+    iWidth = 0;
+    iHeight = 0;
+
+    for (size_t i = 0; i < Runs.size(); ++i) {
+        SDL_Surface* pRun = pCache->Get(pFont, iStyle, Color, Runs[i]);
+        if (!pRun)
+            continue;
+
+        iWidth += pRun->w;
+        if (pRun->h > iHeight)
+            iHeight = pRun->h;
+    }
+}
+
+SDL_Rect TextLabel::Draw(SDL_Surface* pDest, int x, int y)
+{
+    SDL_Rect area = { x, y, 0, 0 };
+
+    for (size_t i = 0; i < Runs.size(); ++i) {
+        // Surfaces are only valid until the next lookup: blit each one at once.
+        SDL_Surface* pRun = pCache->Get(pFont, iStyle, Color, Runs[i]);
+        if (!pRun)
+            continue;
+
+        SDL_Rect dest = { x + area.w, y, 0, 0 };
+        SDL_BlitSurface(pRun, NULL, pDest, &dest);
+
+        area.w += pRun->w;
+        if (pRun->h > area.h)
+            area.h = pRun->h;
+    }
+
+    return area;
+}
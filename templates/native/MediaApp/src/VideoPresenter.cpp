@@ -0,0 +1,177 @@
+#include "VideoPresenter.h"
+
+VideoPresenter::VideoPresenter()
+{
+    pRenderer   = 0;
+    iFormat     = 0;
+    iWidth      = 0;
+    iHeight     = 0;
+    bNative     = false;
+
+    for (int i = 0; i < VIDEO_QUEUE_FRAMES; ++i) {
+        Frames[i].pTexture = 0;
+        Frames[i].dPts = 0.0;
+    }
+
+    iOldest     = 0;
+    iUsed       = 0;
+    bShowing    = false;
+    bWriting    = false;
+
+    iSubmitted  = 0;
+    iShown      = 0;
+    iDropped    = 0;
+    dUploadMs   = 0.0;
+    dLateMs     = 0.0;
+    dMaxLateMs  = 0.0;
+}
+
+VideoPresenter::~VideoPresenter()
+{
+    Close();
+}
+
+bool VideoPresenter::Open(SDL_Renderer* pTarget, Uint32 iPixelFormat, int iFrameWidth, int iFrameHeight)
+{
+    Close();
+
+    if (!pTarget || (iPixelFormat != SDL_PIXELFORMAT_IYUV && iPixelFormat != SDL_PIXELFORMAT_NV12)
+        || iFrameWidth <= 0 || iFrameHeight <= 0 || (iFrameWidth & 1) || (iFrameHeight & 1))
+        return false;
+
+    pRenderer   = pTarget;
+    iFormat     = iPixelFormat;
+    iWidth      = iFrameWidth;
+    iHeight     = iFrameHeight;
+
+    // Formats the renderer lists are sampled as planes and converted in its shader.
+    SDL_RendererInfo info;
+    bNative = false;
+    if (SDL_GetRendererInfo(pRenderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+            if (info.texture_formats[i] == iFormat)
+                bNative = true;
+        }
+    }
+
+    // BT.601 for SD sizes, BT.709 for HD ones.
+    SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_AUTOMATIC);
+
+    for (int i = 0; i < VIDEO_QUEUE_FRAMES; ++i) {
+        Frames[i].pTexture = SDL_CreateTexture(pRenderer, iFormat, SDL_TEXTUREACCESS_STREAMING, iWidth, iHeight);
+        if (!Frames[i].pTexture) {
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void VideoPresenter::Close()
+{
+    if (bWriting)
+        SDL_UnlockTexture(Frames[(iOldest + iUsed - 1) % VIDEO_QUEUE_FRAMES].pTexture);
+
+    for (int i = 0; i < VIDEO_QUEUE_FRAMES; ++i) {
+        if (Frames[i].pTexture)
+            SDL_DestroyTexture(Frames[i].pTexture);
+        Frames[i].pTexture = 0;
+    }
+
+    pRenderer   = 0;
+    iOldest     = 0;
+    iUsed       = 0;
+    bShowing    = false;
+    bWriting    = false;
+
+    iSubmitted  = 0;
+    iShown      = 0;
+    iDropped    = 0;
+    dUploadMs   = 0.0;
+    dLateMs     = 0.0;
+    dMaxLateMs  = 0.0;
+}
+
+bool VideoPresenter::AcquireFrame(VideoPlanes& planes)
+{
+    if (!pRenderer || !CanAcquire())
+        return false;
+
+    Frame& frame = Frames[(iOldest + iUsed) % VIDEO_QUEUE_FRAMES];
+
+    void* pPixels = 0;
+    int iPitch = 0;
+    if (SDL_LockTexture(frame.pTexture, NULL, &pPixels, &iPitch) != 0)
+        return false;
+
+    // SDL hands out the planes back to back: Y, then U and V (IYUV) or UV (NV12).
+    planes.pY       = (Uint8*)pPixels;
+    planes.iPitchY  = iPitch;
+    planes.pU       = planes.pY + iPitch * iHeight;
+
+    if (iFormat == SDL_PIXELFORMAT_NV12) {
+        planes.iPitchUV = 2 * ((iPitch + 1) / 2);
+        planes.pV       = 0;
+    } else {
+        planes.iPitchUV = (iPitch + 1) / 2;
+        planes.pV       = planes.pU + planes.iPitchUV * ((iHeight + 1) / 2);
+    }
+
+    ++iUsed;
+    bWriting = true;
+    return true;
+}
+
+void VideoPresenter::SubmitFrame(double dPts)
+{
+    if (!bWriting)
+        return;
+
+    Frame& frame = Frames[(iOldest + iUsed - 1) % VIDEO_QUEUE_FRAMES];
+
+    // The renderer copies the planes to the GL textures here.
+    Uint64 iStart = SDL_GetPerformanceCounter();
+    SDL_UnlockTexture(frame.pTexture);
+    dUploadMs += (SDL_GetPerformanceCounter() - iStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    frame.dPts = dPts;
+    bWriting = false;
+    ++iSubmitted;
+}
+
+bool VideoPresenter::Draw(double dClock, const SDL_Rect* pDest)
+{
+    if (!pRenderer)
+        return false;
+
+    // Queued frames sit between the one on screen and the one being written.
+    int iFirst = bShowing ? 1 : 0;
+    int iQueued = iUsed - iFirst - (bWriting ? 1 : 0);
+
+    int iDue = -1;
+    for (int i = 0; i < iQueued; ++i) {
+        if (Frames[(iOldest + iFirst + i) % VIDEO_QUEUE_FRAMES].dPts <= dClock)
+            iDue = i;
+    }
+
+    bool bNew = iDue >= 0;
+    if (bNew) {
+        // The frame on screen and the due frames before the newest one are freed.
+        iDropped += iDue;
+        iOldest = (iOldest + iFirst + iDue) % VIDEO_QUEUE_FRAMES;
+        iUsed -= iFirst + iDue;
+        bShowing = true;
+        ++iShown;
+
+        double dLate = (dClock - Frames[iOldest].dPts) * 1000.0;
+        dLateMs += dLate;
+        if (dLate > dMaxLateMs)
+            dMaxLateMs = dLate;
+    }
+
+    if (bShowing)
+        SDL_RenderCopy(pRenderer, Frames[iOldest].pTexture, NULL, pDest);
+
+    return bNew;
+}
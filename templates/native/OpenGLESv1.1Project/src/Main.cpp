@@ -2,6 +2,8 @@
 #include <SDL.h>
 #include <SDL_opengles.h>
 
+#include "FramePacer.h"
+
 #define PI 3.1415926534f
 #define TO_RADIAN(a) (a/180.0f*PI)
 
@@ -54,6 +56,12 @@ int main( int argc, char* argv[] )
     Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_FULLSCREEN;
     int foreground = 1;
 
+    // Declare the present policy: vsync unless PRESENT_MODE is set to
+    // "adaptive", "uncapped" or a frame rate cap such as "30"
+    FramePacer pacer;
+    PresentMode present_mode = PRESENT_VSYNC;
+    int cap_hz = 0;
+
     // Declare application loop flag
     bool quit = false;
 
@@ -88,6 +96,15 @@ int main( int argc, char* argv[] )
         goto cleanup;
     }
 
+    // Set the swap interval of the present policy
+    if(SDL_getenv("PRESENT_MODE") && !ParsePresentMode(SDL_getenv("PRESENT_MODE"), present_mode, cap_hz)) {
+        printf("Unknown present mode %s, using vsync\n", SDL_getenv("PRESENT_MODE"));
+    }
+    if(!pacer.SetMode(window, present_mode, cap_hz)) {
+        printf("Present mode %s is not supported, using %s\n",
+               GetPresentModeName(present_mode), GetPresentModeName(pacer.GetMode()));
+    }
+
     // Create renderer with OpenGL ES v1.1
     InitializeRender(WIDTH, HEIGHT);
 
@@ -125,10 +142,11 @@ int main( int argc, char* argv[] )
         }
 
         // Refresh the entire screen
-        if(foreground == 1) {
+        // A frame that would miss its refresh is skipped, see FramePacer.h
+        if(foreground == 1 && pacer.BeginFrame()) {
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             Render(WIDTH, HEIGHT);
-            SDL_GL_SwapWindow(window);
+            pacer.Present();
         }
     }
 
@@ -137,6 +155,10 @@ int main( int argc, char* argv[] )
     // Finalize SDL
     FinalizeRender(window);
 
+    printf("frames: %u, missed: %u, skipped: %u, %s at %d Hz\n",
+           pacer.GetPresentedFrames(), pacer.GetMissedFrames(), pacer.GetSkippedFrames(),
+           GetPresentModeName(pacer.GetMode()), pacer.GetRate());
+
 cleanup:
     SDL_GL_DeleteContext(context);
     SDL_DestroyWindow(window);
@@ -0,0 +1,189 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "FramePacer.h"
+
+namespace {
+
+//Rate assumed when the display does not report one.
+const int       DEFAULT_REFRESH_HZ  = 60;
+
+//Headroom kept before a slot when waiting for it, in ms.
+const double    SLOT_MARGIN_MS      = 1.0;
+
+//Weight of the newest frame in the running average.
+const double    FRAME_AVERAGE_WEIGHT = 0.125;
+
+}
+
+FramePacer::FramePacer()
+{
+    pWindow         = 0;
+    eMode           = PRESENT_VSYNC;
+    iRateHz         = DEFAULT_REFRESH_HZ;
+    bSkipLate       = true;
+
+    dTicksPerMs     = SDL_GetPerformanceFrequency() / 1000.0;
+    iSlotTicks      = SDL_GetPerformanceFrequency() / iRateHz;
+
+    iLastPresent    = 0;
+    iTargetSlot     = 0;
+    iFrameStart     = 0;
+    dFrameTicks     = 0.0;
+
+    iPresented      = 0;
+    iMissed         = 0;
+    iSkipped        = 0;
+}
+
+bool FramePacer::SetMode(SDL_Window* pWindow, PresentMode eMode, int iCapHz)
+{
+    this->pWindow   = pWindow;
+    this->eMode     = eMode;
+
+    bool bSupported = true;
+    int iInterval   = eMode == PRESENT_VSYNC ? 1 : eMode == PRESENT_ADAPTIVE ? -1 : 0;
+
+    if ( SDL_GL_SetSwapInterval( iInterval ) < 0 )
+    {
+        bSupported = false;
+
+        // Late swap tearing needs EXT_swap_control_tear or the EGL equivalent.
+        if ( eMode == PRESENT_ADAPTIVE )
+        {
+            this->eMode = PRESENT_VSYNC;
+            SDL_GL_SetSwapInterval( 1 );
+        }
+    }
+
+    SDL_DisplayMode mode;
+    int iRefreshHz = DEFAULT_REFRESH_HZ;
+    if ( pWindow && SDL_GetWindowDisplayMode( pWindow, &mode ) == 0 && mode.refresh_rate > 0 )
+        iRefreshHz = mode.refresh_rate;
+
+    if ( this->eMode == PRESENT_UNCAPPED )
+        iRateHz = 0;
+    else if ( this->eMode == PRESENT_CAPPED )
+        iRateHz = iCapHz > 0 ? iCapHz : iRefreshHz;
+    else
+        iRateHz = iRefreshHz;
+
+    iSlotTicks      = iRateHz > 0 ? SDL_GetPerformanceFrequency() / iRateHz : 0;
+    iLastPresent    = SDL_GetPerformanceCounter();
+    iTargetSlot     = 0;
+
+    return bSupported;
+}
+
+/** First slot after iTime on the grid of the last present. **/
+Uint64 FramePacer::NextSlot(Uint64 iTime) const
+{
+    if ( iTime < iLastPresent )
+        return iLastPresent + iSlotTicks;
+
+    return iLastPresent + ( ( iTime - iLastPresent ) / iSlotTicks + 1 ) * iSlotTicks;
+}
+
+/** Sleeps most of the way, then spins for the last ms, which SDL_Delay() cannot hit. **/
+void FramePacer::WaitUntil(Uint64 iTime) const
+{
+    for ( ;; )
+    {
+        Uint64 iNow = SDL_GetPerformanceCounter();
+        if ( iNow >= iTime )
+            return;
+
+        double dLeftMs = ( iTime - iNow ) / dTicksPerMs;
+        if ( dLeftMs > 2.0 )
+            SDL_Delay( (Uint32)( dLeftMs - 1.0 ) );
+    }
+}
+
+bool FramePacer::BeginFrame()
+{
+    Uint64 iNow = SDL_GetPerformanceCounter();
+    iFrameStart = iNow;
+
+    if ( iSlotTicks == 0 )
+        return true;
+
+    Uint64 iNext = NextSlot( iNow );
+    Uint64 iEstimate = (Uint64)dFrameTicks;
+    Uint64 iMargin = (Uint64)( SLOT_MARGIN_MS * dTicksPerMs );
+
+    iTargetSlot = iNext;
+
+    // A frame longer than a slot can never make the next one; waiting would not help.
+    if ( !bSkipLate || iEstimate + iMargin >= iSlotTicks || iNow + iEstimate <= iNext )
+        return true;
+
+    // Too late for the next slot: start again just in time for the one after.
+    ++iSkipped;
+    WaitUntil( iNext + iSlotTicks - iEstimate - iMargin );
+    return false;
+}
+
+void FramePacer::Present()
+{
+    Uint64 iSwap = SDL_GetPerformanceCounter();
+
+    if ( iFrameStart != 0 )
+        dFrameTicks += ( (double)( iSwap - iFrameStart ) - dFrameTicks ) * FRAME_AVERAGE_WEIGHT;
+
+    // Without a swap interval the cap comes from waiting for the slot here.
+    if ( eMode == PRESENT_CAPPED && iTargetSlot > iSwap )
+        WaitUntil( iTargetSlot );
+
+    SDL_GL_SwapWindow( pWindow );
+
+    Uint64 iNow = SDL_GetPerformanceCounter();
+
+    if ( iSlotTicks > 0 && iTargetSlot != 0 && iNow > iTargetSlot + iSlotTicks / 2 )
+        ++iMissed;
+
+    ++iPresented;
+    iFrameStart = 0;
+
+    // A capped grid keeps its phase; a synchronized one follows the blanks.
+    if ( eMode == PRESENT_CAPPED && iTargetSlot != 0 && iNow < iTargetSlot + iSlotTicks )
+        iLastPresent = iTargetSlot;
+    else
+        iLastPresent = iNow;
+}
+
+bool ParsePresentMode(const char* czText, PresentMode& eMode, int& iCapHz)
+{
+    if ( !czText )
+        return false;
+
+    iCapHz = 0;
+
+    if ( strcmp( czText, "vsync" ) == 0 )
+        eMode = PRESENT_VSYNC;
+    else if ( strcmp( czText, "adaptive" ) == 0 )
+        eMode = PRESENT_ADAPTIVE;
+    else if ( strcmp( czText, "uncapped" ) == 0 )
+        eMode = PRESENT_UNCAPPED;
+    else if ( atoi( czText ) > 0 )
+    {
+        eMode = PRESENT_CAPPED;
+        iCapHz = atoi( czText );
+    }
+    else
+        return false;
+
+    return true;
+}
+
+const char* GetPresentModeName(PresentMode eMode)
+{
+    switch ( eMode )
+    {
+        case PRESENT_VSYNC:     return "vsync";
+        case PRESENT_ADAPTIVE:  return "adaptive";
+        case PRESENT_UNCAPPED:  return "uncapped";
+        case PRESENT_CAPPED:    return "capped";
+    }
+    return "unknown";
+}
@@ -2,6 +2,9 @@
 #include <SDL.h>
 #include <SDL_opengles2.h>
 
+#include "FramePacer.h"
+#include "GpuTimer.h"
+
 #define PROJECTION_FAR        30.0f
 #define PROJECTION_FOVY       30.0f
 #define PROJECTION_NEAR       0.1f
@@ -28,6 +31,9 @@ static glMatrix projection;
 static glMatrix modelview;
 static glMatrix mvp;
 
+/* GPU time of Render(), measured when GPU_TIMER is set */
+static GpuTimer gpu_timer;
+
 static const GLushort indices[] =
 {
     0, 2, 3, 0, 3, 1,    // front
@@ -38,16 +44,23 @@ static const GLushort indices[] =
     1, 3, 5, 1, 5, 7    // bottom
 };
 
-static const GLfloat vertices[] =
+/* 16 bytes per vertex: colors are normalized bytes instead of three floats */
+typedef struct
+{
+    GLfloat position[3];
+    GLubyte color[4];
+}Vertex;
+
+static const Vertex vertices[] =
 {
-     0.5f,  0.5f, -0.5f, 1.0f, 1.0f, 1.0f,        // 0
-     0.5f, -0.5f, -0.5f, 1.0f,    0,    0,        // 1
-    -0.5f,  0.5f, -0.5f, 1.0f, 1.0f,    0,        // 2
-    -0.5f, -0.5f, -0.5f, 1.0f,    0, 1.0f,        // 3
-    -0.5f,  0.5f,  0.5f,    0, 1.0f, 1.0f,        // 4
-    -0.5f, -0.5f,  0.5f,    0, 1.0f,    0,        // 5
-     0.5f,  0.5f,  0.5f,    0,    0, 1.0f,        // 6
-     0.5f, -0.5f,  0.5f,  0.5f, 1.0f, 0.5        // 7
+    { {  0.5f,  0.5f, -0.5f }, { 255, 255, 255, 255 } },   // 0
+    { {  0.5f, -0.5f, -0.5f }, { 255,   0,   0, 255 } },   // 1
+    { { -0.5f,  0.5f, -0.5f }, { 255, 255,   0, 255 } },   // 2
+    { { -0.5f, -0.5f, -0.5f }, { 255,   0, 255, 255 } },   // 3
+    { { -0.5f,  0.5f,  0.5f }, {   0, 255, 255, 255 } },   // 4
+    { { -0.5f, -0.5f,  0.5f }, {   0, 255,   0, 255 } },   // 5
+    { {  0.5f,  0.5f,  0.5f }, {   0,   0, 255, 255 } },   // 6
+    { {  0.5f, -0.5f,  0.5f }, { 128, 255, 128, 255 } }    // 7
 };
 
 static void InitShader(void);
@@ -69,6 +82,12 @@ int main( int argc, char* argv[] )
     SDL_GLContext context = 0;
     int foreground = 1;
 
+    // Declare the present policy: vsync unless PRESENT_MODE is set to
+    // "adaptive", "uncapped" or a frame rate cap such as "30"
+    FramePacer pacer;
+    PresentMode present_mode = PRESENT_VSYNC;
+    int cap_hz = 0;
+
     // Declare application loop flag
     bool quit = false;
 
@@ -104,9 +123,23 @@ int main( int argc, char* argv[] )
         goto cleanup;
     }
 
+    // Set the swap interval of the present policy
+    if(SDL_getenv("PRESENT_MODE") && !ParsePresentMode(SDL_getenv("PRESENT_MODE"), present_mode, cap_hz)) {
+        printf("Unknown present mode %s, using vsync\n", SDL_getenv("PRESENT_MODE"));
+    }
+    if(!pacer.SetMode(window, present_mode, cap_hz)) {
+        printf("Present mode %s is not supported, using %s\n",
+               GetPresentModeName(present_mode), GetPresentModeName(pacer.GetMode()));
+    }
+
     //ToDo: Initialize your stub...
     InitializeRender(WIDTH, HEIGHT);
 
+    // Time the GPU passes with timer queries (glFinish in debug builds without them)
+    if(SDL_getenv("GPU_TIMER") && !gpu_timer.Init()) {
+        printf("GPU timer queries are not supported\n");
+    }
+
     // Start application loop
     while(quit == false)
     {
@@ -137,17 +170,26 @@ int main( int argc, char* argv[] )
             }
         }
 
-        if(foreground == 1) {
+        // A frame that would miss its refresh is skipped, see FramePacer.h
+        if(foreground == 1 && pacer.BeginFrame()) {
+            gpu_timer.BeginFrame();
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             Render();
+            gpu_timer.EndFrame();
             // Refresh the entire screen
-            SDL_GL_SwapWindow(window);
+            pacer.Present();
         }
     }
 
+    gpu_timer.Report(stdout);
+
     // ToDo: Finalize your stub...
     FinalizeRender(window);
 
+    printf("frames: %u, missed: %u, skipped: %u, %s at %d Hz\n",
+           pacer.GetPresentedFrames(), pacer.GetMissedFrames(), pacer.GetSkippedFrames(),
+           GetPresentModeName(pacer.GetMode()), pacer.GetRate());
+
     // Finalize SDL
 cleanup:
     SDL_GL_DeleteContext(context);
@@ -257,6 +299,8 @@ static void Render(void)
     /* Compute the final MVP by multiplying the model-view and perspective matrices together */
     MultiplyMatrix(&mvp, &modelview, &projection);
 
+    gpu_timer.Begin("cube");
+
     glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
     glUseProgram(program_object);
@@ -264,8 +308,8 @@ static void Render(void)
     /* Enable cube array */
     glBindBuffer(GL_ARRAY_BUFFER, vertexID);
 
-    glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), BUFFER_OFFSET(0));
-    glVertexAttribPointer(color_loc,    3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), BUFFER_OFFSET(3 * sizeof(GLfloat)));
+    glVertexAttribPointer(position_loc, 3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
+    glVertexAttribPointer(color_loc,    4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), BUFFER_OFFSET(3 * sizeof(GLfloat)));
 
     glEnableVertexAttribArray(position_loc);
     glEnableVertexAttribArray(color_loc);
@@ -276,10 +320,13 @@ static void Render(void)
     /* Finally draw the elements */
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indiceID);
     glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(GLushort), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
+
+    gpu_timer.End();
 }
 
 static void FinalizeRender(SDL_Window *window)
 {
+    gpu_timer.Release();
     glDeleteProgram(program_object);
     glDeleteBuffers(1, &vertexID);
     glDeleteBuffers(1, &indiceID);